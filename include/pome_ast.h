@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory> // For std::unique_ptr
 #include <string>
+#include <algorithm>
+#include <cstddef>
 
 namespace Pome
 {
@@ -13,6 +15,67 @@ namespace Pome
      */
     class ASTVisitor;
 
+    /**
+     * Bump allocator for the nodes of one parse.
+     *
+     * While a Scope is open, every ASTNode the thread creates is carved out of
+     * the arena, and deleting such a node only runs its destructor. The blocks
+     * are released together when the arena dies; Parser hands it to the
+     * Program, which outlives every node in it.
+     */
+    class AstArena
+    {
+    public:
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+        static constexpr size_t ALIGN = alignof(void *); // Nodes hold pointers, strings and doubles
+
+        AstArena() = default;
+        AstArena(const AstArena &) = delete;
+        AstArena &operator=(const AstArena &) = delete;
+
+        void *allocate(size_t size)
+        {
+            size = (size + ALIGN - 1) & ~(ALIGN - 1);
+            if (size > remaining_)
+            {
+                size_t blockSize = std::max(BLOCK_SIZE, size);
+                blocks_.emplace_back(new char[blockSize]);
+                next_ = blocks_.back().get();
+                remaining_ = blockSize;
+                reserved_ += blockSize;
+            }
+            void *ptr = next_;
+            next_ += size;
+            remaining_ -= size;
+            return ptr;
+        }
+
+        size_t bytesReserved() const { return reserved_; }
+
+        // Routes this thread's node allocations to an arena until it is destroyed
+        class Scope
+        {
+        public:
+            explicit Scope(AstArena &arena) : previous_(current_) { current_ = &arena; }
+            ~Scope() { current_ = previous_; }
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            AstArena *previous_;
+        };
+
+        static AstArena *current() { return current_; }
+
+    private:
+        static inline thread_local AstArena *current_ = nullptr;
+
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        char *next_ = nullptr;
+        size_t remaining_ = 0;
+        size_t reserved_ = 0;
+    };
+
     /**
      * Base class for all AST nodes
      */
@@ -72,6 +135,22 @@ namespace Pome
         ASTNode(NodeType type, int line, int col) : type_(type), line_(line), col_(col) {}
         virtual ~ASTNode() = default;
 
+        // Each node is prefixed by the arena it came from, or nullptr for the heap
+        static void *operator new(size_t size)
+        {
+            AstArena *arena = AstArena::current();
+            void *block = arena ? arena->allocate(size + HEADER) : ::operator new(size + HEADER);
+            *static_cast<AstArena **>(block) = arena;
+            return static_cast<char *>(block) + HEADER;
+        }
+
+        static void operator delete(void *ptr)
+        {
+            if (!ptr) return;
+            void *block = static_cast<char *>(ptr) - HEADER;
+            if (!*static_cast<AstArena **>(block)) ::operator delete(block);
+        }
+
         NodeType getType() const { return type_; }
         int getLine() const { return line_; }
         int getColumn() const { return col_; }
@@ -82,6 +161,8 @@ namespace Pome
         virtual void accept(ASTVisitor &visitor) = 0;
 
     private:
+        static constexpr size_t HEADER = AstArena::ALIGN;
+
         NodeType type_;
         int line_;
         int col_;
@@ -618,7 +699,12 @@ namespace Pome
         
         bool isStrict = false; // Strict mode flag
 
+        // The arena the statements were allocated from; it is released after them
+        void adoptArena(std::unique_ptr<AstArena> arena) { arena_ = std::move(arena); }
+        const AstArena *getArena() const { return arena_.get(); }
+
     private:
+        std::unique_ptr<AstArena> arena_; // Declared first so it is destroyed last
         std::vector<std::unique_ptr<Statement>> statements_;
     };
 
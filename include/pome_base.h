@@ -13,12 +13,14 @@
 #include <thread>
 #include <atomic>
 #include "pome_ast.h"
+#include "pome_nursery.h"
 
 namespace Pome {
 
     class GarbageCollector;
     class Chunk;
     class Statement;
+    class VM;
 
     enum class ObjectType {
         STRING,
@@ -33,7 +35,11 @@ namespace Pome {
         TASK,
         UPVALUE,
         SHAPE,
-        NATIVE_OBJECT 
+        NATIVE_OBJECT,
+        BUFFER,
+        FILE,
+        CHANNEL,
+        SOCKET
     };
 
     class PomeObject {
@@ -42,14 +48,42 @@ namespace Pome {
         virtual ObjectType type() const = 0;
         virtual std::string toString() const = 0;
 
-        bool isMarked = false;
+        // Each object is prefixed by a header naming its nursery block and slot size, or 0 for the heap
+        static void* operator new(size_t size) {
+            void* slot = ::operator new(size + Nursery::HEADER);
+            *static_cast<uintptr_t*>(slot) = 0;
+            return static_cast<char*>(slot) + Nursery::HEADER;
+        }
+
+        static void* operator new(size_t size, Nursery& nursery) { return nursery.allocate(size); }
+
+        static void operator delete(void* ptr) {
+            if (!ptr) return;
+            if (Nursery::blockOf(ptr)) Nursery::release(ptr);
+            else ::operator delete(static_cast<char*>(ptr) - Nursery::HEADER);
+        }
+
+        // Only reached when a constructor throws; the header knows the slot's size
+        static void operator delete(void* ptr, Nursery&) { Nursery::release(ptr); }
+
+        // Atomic so parallel mark workers can race to claim an object; use the helpers below
+        std::atomic<bool> isMarked{false};
         bool inZCT = false;     // Added for Reference Counting
+        bool isRemembered = false; // Old object already in the collector's remembered set
+        bool frozen = false;    // Immutable and shared between isolates (see FrozenHeap)
         uint32_t refCount = 0;  // Added for Reference Counting
         uint8_t generation = 0; 
         uint8_t age = 0;        
+        uint16_t slotSize = 0;  // Nursery slot holding this object, 0 when it lives on the heap
+        uint32_t heapId = 0;    // Collector that allocated it; no other collector marks it
         size_t gcSize = 0;      
         PomeObject* next = nullptr;
 
+        bool marked() const { return isMarked.load(std::memory_order_relaxed); }
+        void setMarked(bool value) { isMarked.store(value, std::memory_order_relaxed); }
+        // True for exactly one of several threads marking the object at once
+        bool tryMark() { return !isMarked.exchange(true, std::memory_order_relaxed); }
+
         virtual void markChildren(GarbageCollector& gc) {}
         virtual size_t extraSize() const { return 0; }
     };
@@ -66,11 +100,34 @@ namespace Pome {
     class PomeThread;
     class PomeTask;
     class PomeShape;
+    class PomeBuffer;
+    class PomeFile;
 
     class PomeValue;
     using ModuleLoader = std::function<PomeValue(const std::string&)>;
     using NativeFn = std::function<PomeValue(const std::vector<PomeValue> &)>;
 
+    /**
+     * Caller state handed to fast natives
+     */
+    struct NativeContext {
+        VM* vm;
+        GarbageCollector& gc;
+        NativeFunction* callee = nullptr; // The native being called, for those that carry data
+    };
+
+    // Fast native ABI: args points into the caller's registers (module receiver
+    // already stripped) and is only valid for the duration of the call. Fast
+    // natives must not re-enter the interpreter.
+    using FastNativeFn = PomeValue (*)(NativeContext& ctx, const PomeValue* args, int argc);
+
+    // Builtins the interpreter may execute inline instead of calling
+    enum class NativeIntrinsic : uint8_t {
+        NONE,
+        LEN,
+        PUSH
+    };
+
     class PomeValue {
     public:
         PomeValue();
@@ -97,6 +154,8 @@ namespace Pome {
         bool isModule() const;
         bool isTask() const;
         bool isShape() const;
+        bool isBuffer() const;
+        bool isFile() const;
 
         inline bool asBool() const {
             if (value_ == (QNAN | TAG_TRUE) || value_ == (QNAN | TAG_FALSE))
@@ -122,6 +181,7 @@ namespace Pome {
         }
 
         const std::string &asString() const;
+        PomeString* asPomeString() const;
         PomeFunction* asPomeFunction() const;
         NativeFunction* asNativeFunction() const;
         PomeList* asList() const;
@@ -130,6 +190,8 @@ namespace Pome {
         PomeInstance* asInstance() const;
         PomeModule* asModule() const;
         PomeShape* asShape() const;
+        PomeBuffer* asBuffer() const;
+        PomeFile* asFile() const;
 
         std::string toString() const;
         bool operator==(const PomeValue &other) const;
@@ -149,6 +211,7 @@ namespace Pome {
         uint64_t getRaw() const { return value_; }
 
     private:
+        friend class Jit; // Emits NaN-box tag checks
         uint64_t value_;
         static constexpr uint64_t QNAN = 0x7ffc000000000000;
         static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
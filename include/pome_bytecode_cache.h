@@ -0,0 +1,62 @@
+#ifndef POME_BYTECODE_CACHE_H
+#define POME_BYTECODE_CACHE_H
+
+#include "pome_chunk.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Pome {
+
+    class GarbageCollector;
+
+    // What a cache file must match to be used in place of compiling its source
+    struct CacheKey {
+        uint64_t sourceSize = 0;
+        int64_t sourceMtime = 0; // Nanoseconds since the epoch
+        uint64_t sourceHash = 0; // FNV-1a of the source text
+        uint32_t optLevel = 0;
+    };
+
+    /**
+     * On-disk compiled chunks (.pomec) behind module import, script startup
+     * and `pome compile`.
+     *
+     * A cache file is a versioned header followed by the script chunk: code,
+     * lines, constants, try ranges, inlined-call ranges and maxRegisters.
+     * Function and class constants are written where they first appear and
+     * referenced by index afterwards, so a method shared by a class and a
+     * CHECKMETHOD guard is still one object once loaded. Inline cache slots
+     * are not stored; Chunk::write rebuilds them.
+     *
+     * Files live next to their source (`util.pome` -> `util.pomec`), or in
+     * $POME_CACHE_DIR when it is set. Anything stale, truncated or written by
+     * another format version is ignored and the source is compiled instead.
+     */
+    class BytecodeCache {
+    public:
+        static constexpr uint32_t MAGIC = 0x43454d50; // "PMEC"
+        // Bump whenever the bytecode a given source compiles to changes
+        static constexpr uint32_t FORMAT_VERSION = 2;
+
+        static std::string cachePath(const std::string& sourcePath);
+        // False when the source cannot be stat'ed
+        static bool keyFor(const std::string& sourcePath, const std::string& source, int optLevel, CacheKey& key);
+
+        // The cached chunk for sourcePath, or null when there is none or it does not match key
+        static std::unique_ptr<Chunk> load(GarbageCollector& gc, const std::string& sourcePath, const CacheKey& key);
+        // False when the chunk holds a constant the format cannot store or the file cannot be written
+        static bool store(const Chunk& chunk, const std::string& sourcePath, const CacheKey& key);
+        // Atomically replaces the cache for sourcePath with serialized bytes
+        static bool writeFile(const std::vector<uint8_t>& bytes, const std::string& sourcePath);
+
+        static bool serialize(const Chunk& chunk, const CacheKey& key, std::vector<uint8_t>& out);
+        // Null on a mismatched key or malformed data
+        static std::unique_ptr<Chunk> deserialize(GarbageCollector& gc, const uint8_t* data, size_t size,
+                                                  const CacheKey& key);
+    };
+
+}
+
+#endif // POME_BYTECODE_CACHE_H
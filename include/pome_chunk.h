@@ -1,9 +1,11 @@
 #ifndef POME_CHUNK_H
 #define POME_CHUNK_H
 
+#include <atomic>
 #include <vector>
-#include <map>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include "pome_opcode.h"
 #include "pome_value.h"
 
@@ -11,26 +13,137 @@ namespace Pome {
 
     using Instruction = uint32_t;
 
+    class JitCode;
+
+    // Lifecycle of a GETFIELD/SETFIELD site: each new receiver kind moves it one step right
+    enum class CacheState : uint8_t { UNINITIALIZED, MONOMORPHIC, POLYMORPHIC, MEGAMORPHIC };
+
+    // One receiver kind seen by a field access site
+    struct FieldCacheEntry {
+        PomeShape* shape = nullptr;      // receiver shape (property and method hits)
+        PomeClass* klass = nullptr;      // receiver class (method hits only)
+        PomeFunction* method = nullptr;  // resolved method, or nullptr for a property slot
+        int index = -1;                  // property slot in PomeInstance::properties
+    };
+
+    // GETGLOBAL/SETGLOBAL link: cells for the name, valid while the running module is module
+    struct GlobalLink {
+        GlobalCell* moduleCell = nullptr;
+        GlobalCell* globalCell = nullptr; // nullptr until linked
+        PomeModule* module = nullptr;
+    };
+
     struct InstructionMetadata {
-        PomeValue globalCache;          // cached value (by copy, safe across map rehash)
-        bool globalCacheValid = false;   // whether globalCache holds a valid entry
+        static constexpr int MAX_FIELD_ENTRIES = 4;
+
+        GlobalLink global; // Only the chunk's globalOwner reads or writes it
         PomeClass* klassCache = nullptr;
         PomeObject* objectCache = nullptr;
         int indexCache = -1;
+
+        // Polymorphic field cache (GETFIELD/SETFIELD only)
+        CacheState fieldState = CacheState::UNINITIALIZED;
+        uint8_t fieldCount = 0;
+        FieldCacheEntry fields[MAX_FIELD_ENTRIES];
+    };
+
+    // A try block: a throw at a pc in [start, end) continues at target, the catch block
+    struct ExceptionRange {
+        uint32_t start;
+        uint32_t end;
+        uint32_t target;
+    };
+
+    // A call the compiler inlined: code in [start, end) is the body of `name`, called from callLine
+    struct InlinedCall {
+        uint32_t start;
+        uint32_t end;
+        int callLine;
+        std::string name;
     };
 
     // A chunk of bytecode
     class Chunk {
     public:
+        static constexpr uint32_t NO_CACHE = UINT32_MAX;
+
         std::vector<Instruction> code;
         std::vector<PomeValue> constants;
         std::vector<int> lines; // Debug info: Line number for each instruction
-        std::map<int, InstructionMetadata> metadata;
+        std::vector<uint32_t> cacheSlots; // Parallel to code: index into inlineCaches, or NO_CACHE
+        std::vector<InstructionMetadata> inlineCaches; // One dense slot per cacheable instruction
         int maxRegisters = 0;
+        // Innermost first: the compiler appends a range once its try block is compiled
+        std::vector<ExceptionRange> handlers;
+        // Innermost first, like handlers; stack traces report each as its own frame
+        std::vector<InlinedCall> inlinedCalls;
+
+        // Baseline JIT: calls and loop back edges heat the chunk until VM::tierUp compiles it
+        uint32_t hotness = 0;
+        bool jitFailed = false;
+        std::shared_ptr<JitCode> jitCode;
+
+        // Heap id of the VM whose globals the links in inlineCaches point into, claimed by the first VM
+        // to link one. Other VMs running the chunk (threads, isolates) keep their own links instead.
+        std::atomic<uint32_t> globalOwner{0};
+        // Tells a chunk from an earlier one at the same address
+        const uint64_t serial = nextSerial.fetch_add(1, std::memory_order_relaxed);
 
         void write(Instruction instruction, int line) {
             code.push_back(instruction);
             lines.push_back(line);
+            if (hasInlineCache(getOpCode(instruction))) {
+                cacheSlots.push_back(static_cast<uint32_t>(inlineCaches.size()));
+                inlineCaches.emplace_back();
+            } else {
+                cacheSlots.push_back(NO_CACHE);
+            }
+        }
+
+        // Opcodes (and their quickened forms) that own an inline cache slot
+        static bool hasInlineCache(OpCode op) {
+            switch (op) {
+                case OpCode::GETGLOBAL:
+                case OpCode::GETGLOBAL_CACHE:
+                case OpCode::SETGLOBAL:
+                case OpCode::GETFIELD:
+                case OpCode::GETFIELD_CACHE:
+                case OpCode::SETFIELD:
+                case OpCode::SETFIELD_CACHE:
+                case OpCode::CALL:
+                case OpCode::TAILCALL:
+                case OpCode::CHECKMETHOD:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // Cache slot for the instruction at pc (pc must point into code)
+        InstructionMetadata& cacheFor(const Instruction* pc) {
+            return inlineCaches[cacheSlots[pc - code.data()]];
+        }
+
+        void markCaches(GarbageCollector& gc);
+
+        // Inlined calls covering pc, innermost first, then the line pc itself is on
+        template <typename Visit>
+        int forEachInlinedCall(uint32_t pc, Visit visit) const {
+            int line = pc < lines.size() ? lines[pc] : 0;
+            for (const InlinedCall& call : inlinedCalls) {
+                if (pc < call.start || pc >= call.end) continue;
+                visit(call, line);
+                line = call.callLine;
+            }
+            return line;
+        }
+
+        // Innermost try block covering pc, or nullptr
+        const ExceptionRange* findHandler(uint32_t pc) const {
+            for (const ExceptionRange& range : handlers) {
+                if (pc >= range.start && pc < range.end) return &range;
+            }
+            return nullptr;
         }
         
         // Add constant and return its index
@@ -106,11 +219,15 @@ namespace Pome {
         static int getSBx(Instruction i) {
             return getBx(i) - MAXARG_sBx;
         }
+
+    private:
+        static inline std::atomic<uint64_t> nextSerial{1};
     };
 
     // Debugging
     void disassembleChunk(Chunk& chunk, const char* name);
     int disassembleInstruction(Chunk& chunk, int offset);
+    const char* opcodeName(OpCode op); // "MOVE", "ADD_NN", ...; "UNKNOWN" past OP_COUNT
 
 }
 
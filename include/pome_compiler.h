@@ -4,9 +4,12 @@
 #include "pome_ast.h"
 #include "pome_chunk.h"
 #include "pome_gc.h" 
+#include "pome_optimizer.h"
 #include <vector>
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace Pome {
 
@@ -14,6 +17,11 @@ namespace Pome {
     public:
         Compiler(GarbageCollector& gc, Compiler* parent = nullptr);
         std::unique_ptr<Chunk> compile(Program& program);
+        // 0: plain code generation, 1: folding, dead code and MOVE coalescing, 2: also
+        // propagates constant locals. Nested function compilers inherit it.
+        void setOptimizationLevel(int level) { optLevel = level; }
+        // Compile errors normally end the process; with this set they throw std::runtime_error instead
+        void setErrorsThrow(bool enabled) { errorsThrow = enabled; }
         
         // Visitor implementation
         void visit(NumberExpr &expr) override;
@@ -64,6 +72,21 @@ namespace Pome {
             int depth;
             int reg;
             bool isCaptured = false;
+            bool hasConstant = false; // -O2: never rebound, so reads load `constant` instead
+            PomeValue constant;
+            bool spilled = false;     // Lives in a module global of the same name, not a register
+            int spillSlot = -1;       // Spilled function locals: key in the function's spill table instead
+            bool reusable = false;    // A var below script level: its register goes back to the pool once dead
+            int loops = 0;            // Loops enclosing the declaration
+        };
+
+        // Per-function register bookkeeping besides freeReg; beginFunction starts a fresh one
+        struct RegisterPlan {
+            Optimizer::Liveness liveness;
+            std::vector<int> holes;   // Registers of dead or popped locals below freeReg, for later declarations
+            int reservedReg = -1;     // Highest register of a popped captured local; upvalues close at RETURN
+            int spillReg = -1;        // The spill table, in a function declaring more locals than fit
+            int spillSlots = 0;
         };
         
         struct Upvalue {
@@ -78,12 +101,15 @@ namespace Pome {
         };
 
         std::vector<Local> locals;
+        RegisterPlan plan;
         std::vector<Upvalue> upvalues;
         std::vector<Loop> loops;
         int scopeDepth = 0;
         Compiler* parent = nullptr;
         
-        int resolveLocal(const std::string& name);
+        const Local* findLocal(const std::string& name) const;
+        int resolveLocal(const std::string& name); // -1 for spilled locals too
+        bool isSpilled(const std::string& name) const;
         int resolveUpvalue(const std::string& name);
         int addUpvalue(uint8_t index, bool isLocal);
         int addConstant(PomeValue value);
@@ -91,15 +117,77 @@ namespace Pome {
         
         int emitJump(OpCode op);
         void patchJump(int instructionIndex);
+        void patchJumpTo(int instructionIndex, int target);
         void resetFreeReg();
+        // Frees the registers of locals declared in this loop iteration (or outside any loop) that
+        // nothing after stmt reads. Captured locals keep theirs.
+        void releaseDeadLocals(const Statement* stmt);
+        void endScope(); // Pops the innermost scope's locals
+        int declareReg();
+
+        // Statements after a return, break, continue or throw are not compiled (-O1)
+        void compileBlock(const std::vector<std::unique_ptr<Statement>>& statements);
+        // Compile-time value of expr, if it has one at this optimization level
+        bool evaluateConstant(Expression* expr, PomeValue& value);
+        bool emitConstant(Expression* expr);
+        void emitLoad(PomeValue value, int reg, int line);
+        // Register holding expr's value: a local's own register when reading it directly is safe
+        int compileOperand(Expression* expr);
+        // R(dest) := R(src). At -O1 the instruction that produced a temporary src is retargeted instead.
+        void emitMoveTo(int dest, int src, int tempBase, int line);
+        void beginFunction(const std::vector<std::unique_ptr<Statement>>& body);
+        // Stores a spilled declaration's value in the global of the same name, or in its spill table slot
+        void emitSpilledStore(VarDeclStmt& stmt, const Local& local);
+        // Made on entry to a function that declares more locals than fit below SPILL_THRESHOLD
+        void emitSpillTable(int line);
+        std::string spillTableName() const;
+        // R(reg) := local, or local := R(reg), for a spilled local of owner (this compiler or an enclosing one)
+        void emitSpillAccess(const Compiler& owner, const Local& local, int reg, bool store, int line);
+        void emitSpilledLoad(const std::string& name, int dest, int line);
+        void emitSpilledWrite(const std::string& name, int src, int line);
+
+        // -O2 inlining. Targets live on the outermost compiler, which sees every declaration.
+        struct InlineTarget {
+            const FunctionDeclStmt* decl = nullptr;
+            Expression* body = nullptr;     // Null when the call has to stay
+            std::vector<std::string> freeNames;
+            PomeFunction* method = nullptr; // What CHECKMETHOD expects; null for plain functions
+        };
+        Compiler& root();
+        [[noreturn]] void error(const std::string& message);
+        bool bindsLocally(const std::string& name) const; // A local or upvalue, not a global
+        bool canInline(const InlineTarget& target, size_t argCount) const;
+        void registerInlineTarget(const FunctionDeclStmt& decl, PomeFunction* method);
+        bool inlineCall(CallExpr& expr);
+        bool inlineMethodCall(CallExpr& expr, MemberAccessExpr* member, int objReg);
+        void emitInlinedBody(CallExpr& expr, const InlineTarget& target, int resultReg, int thisReg);
+        void emitMethodCall(CallExpr& expr, MemberAccessExpr* member, int objReg);
+
+        // Runs once a chunk is complete and every jump is patched
+        void finishChunk(Chunk& chunk);
+        static void fuseSuperinstructions(Chunk& chunk);
         
         int lastResultReg = -1; 
         bool strictMode = false;
+        int optLevel = Optimizer::DEFAULT_LEVEL;
+        bool errorsThrow = false; // Read from the outermost compiler
+        std::unordered_set<std::string> reboundNames; // Locals that may not hold a constant
+        int lastJumpTarget = -1; // Largest pc any patched jump lands on
+        Chunk* topLevelChunk = nullptr; // The script's chunk; only its variables spill
+        std::unordered_set<const FunctionDeclStmt*> scriptFunctions; // Top-level and bound once
+        std::unordered_map<std::string, InlineTarget> inlineFunctions;
+        std::unordered_map<std::string, InlineTarget> inlineMethods;
+        std::vector<const FunctionDeclStmt*> inlineStack; // Bodies being inlined, outermost first
+
+        static constexpr int MAX_REGISTERS = 250;
+        // Declarations past this spill, leaving registers for temporaries, at every optimisation level:
+        // top-level script variables to module globals, function locals to the function's spill table.
+        // Dead locals give their registers back first, so only that many live at once count.
+        static constexpr int SPILL_THRESHOLD = 200;
         
         int allocReg() { 
-            if (freeReg >= 250) {
-                std::cerr << "Compiler Error: Register pool overflow (max 250)." << std::endl;
-                exit(1);
+            if (freeReg >= MAX_REGISTERS) {
+                error("Register pool overflow (max 250): too many locals and temporaries live in one function.");
             }
             int reg = freeReg++; 
             if (currentChunk && freeReg > currentChunk->maxRegisters) {
@@ -0,0 +1,81 @@
+#ifndef POME_FFI_H
+#define POME_FFI_H
+
+#include "pome_value.h"
+
+#include <ffi.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Pome {
+
+    /**
+     * A C function signature prepared for libffi once: the ffi_cif, the
+     * ffi_types of its structs, and where each argument goes in a call's
+     * scratch space. A call then only converts values and jumps.
+     *
+     * Types are void (results only), int, int64, float, double, ptr (a buffer's
+     * bytes, a string's characters, a pointer a C function returned, or nil),
+     * string (a C string, copied when returned) and {type, ...} for a struct
+     * passed or returned by value, given and returned as a list of its fields.
+     */
+    class FfiSignature {
+    public:
+        // Parses "result(argument, ...)"; null, with error set, when it is malformed
+        static std::unique_ptr<FfiSignature> parse(const std::string& text, std::string& error);
+        static bool isTypeName(const std::string& name);
+        // From separate type names, as ffi.call takes them
+        static std::unique_ptr<FfiSignature> fromNames(const std::string& result, const std::vector<std::string>& args,
+                                                       std::string& error);
+
+        FfiSignature(const FfiSignature&) = delete;
+        FfiSignature& operator=(const FfiSignature&) = delete;
+
+        size_t arity() const { return args_.size(); }
+        // Calls function with args[0, arity()); nil without calling if an argument has the wrong type
+        PomeValue call(GarbageCollector& gc, void* function, const PomeValue* args) const;
+
+    private:
+        enum class Kind : uint8_t { VOID, INT, INT64, FLOAT, DOUBLE, PTR, STRING, STRUCT };
+
+        struct Type {
+            Kind kind = Kind::VOID;
+            ffi_type* ffi = nullptr;
+            size_t offset = 0;        // From the start of the scratch space, or of the enclosing struct
+            std::vector<Type> fields; // STRUCT
+        };
+
+        struct StructType {
+            ffi_type type;
+            std::vector<ffi_type*> elements; // Null-terminated, as libffi wants
+        };
+
+        FfiSignature() = default;
+        // Parses one type at pos; false, with error set, when there is none
+        bool parseType(const std::string& text, size_t& pos, Type& type, std::string& error);
+        static bool parseName(const std::string& name, Type& type, std::string& error);
+        // Builds the struct ffi_types and the cif, and lays out the scratch space
+        bool prepare(std::string& error);
+
+        static bool store(const Type& type, const PomeValue& value, unsigned char* at);
+        static PomeValue load(GarbageCollector& gc, const Type& type, const unsigned char* at);
+
+        Type result_;
+        std::vector<Type> args_;
+        std::vector<ffi_type*> argTypes_;
+        std::vector<std::unique_ptr<StructType>> structs_;
+        ffi_cif cif_;
+        size_t scratchSize_ = 0; // Arguments, then the result
+        size_t resultOffset_ = 0;
+    };
+
+    // A C function bound to its signature by ffi.bind
+    struct FfiBinding {
+        void* function;
+        std::unique_ptr<FfiSignature> signature;
+    };
+
+} // namespace Pome
+
+#endif // POME_FFI_H
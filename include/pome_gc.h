@@ -2,47 +2,137 @@
 #define POME_GC_H
 
 #include "pome_base.h"
+#include "pome_gc_workers.h"
+#include "pome_string_pool.h"
 
+#include <chrono>
+#include <deque>
 #include <fstream>
+#include <list>
 #include <sstream>
+#include <string_view>
 
 namespace Pome {
 
 class VM;
+class FrozenHeap;
 
 class GarbageCollector {
 public:
-    static size_t getRSS() {
-        std::ifstream is("/proc/self/status");
-        std::string line;
-        while (std::getline(is, line)) {
-            if (line.substr(0, 6) == "VmRSS:") {
-                std::stringstream ss(line.substr(7));
-                size_t rss;
-                ss >> rss;
-                return rss; // in KB
-            }
+    // Resident set size in KB, or 0 where /proc is not available
+    static size_t getRSS();
+
+    // A single stop of the mutator: a whole collection or one slice of an incremental one
+    struct Pause {
+        enum class Kind : uint8_t { MINOR, MAJOR, MARK_SLICE, SWEEP_SLICE };
+        static constexpr size_t KINDS = 4;
+
+        Kind kind = Kind::MINOR;
+        double milliseconds = 0;
+        size_t heapBefore = 0;
+        size_t heapAfter = 0;
+        size_t promotedBytes = 0; // Young bytes moved to the old generation
+
+        size_t reclaimedBytes() const { return heapBefore > heapAfter ? heapBefore - heapAfter : 0; }
+        static const char* kindName(Kind kind);
+    };
+
+    // Running totals since the collector was created
+    struct Stats {
+        static constexpr size_t HISTOGRAM_BUCKETS = 8;
+        // Upper bounds in ms of all but the last, open-ended, bucket
+        static constexpr double HISTOGRAM_BOUNDS[HISTOGRAM_BUCKETS - 1] = {0.1, 0.5, 1, 5, 10, 50, 100};
+        static constexpr size_t RECENT_PAUSES = 32;
+
+        uint64_t pauseCount[Pause::KINDS] = {};
+        double pauseTotalMs[Pause::KINDS] = {};
+        double pauseMaxMs[Pause::KINDS] = {};
+        uint64_t histogram[HISTOGRAM_BUCKETS] = {};
+        std::deque<Pause> recent; // The last RECENT_PAUSES pauses, oldest first
+
+        uint64_t reclaimedBytes = 0;
+        uint64_t promotedBytes = 0;
+        uint64_t sweptYoungBytes = 0; // Young bytes that have been through a collection
+        uint64_t listPoolHits = 0;
+        uint64_t listPoolMisses = 0;
+
+        double promotionRate() const { return sweptYoungBytes ? static_cast<double>(promotedBytes) / sweptYoungBytes : 0; }
+        double listPoolHitRate() const {
+            uint64_t total = listPoolHits + listPoolMisses;
+            return total ? static_cast<double>(listPoolHits) / total : 0;
         }
-        return 0;
-    }
+    };
+
+    struct TypeUsage {
+        size_t objects = 0;
+        size_t bytes = 0;
+    };
+
+    enum class TraceFormat : uint8_t { OFF, JSON, CSV };
 
     explicit GarbageCollector();
+    ~GarbageCollector();
+
+    // A heap for values on their way between isolates, or frozen for good: it never collects and
+    // keeps nothing in a nursery, so adopt() can hand its objects to another heap, and it frees
+    // whatever is still in it when it is destroyed
+    static std::unique_ptr<GarbageCollector> createTransferHeap();
+    // Takes over every object of transfer, which nothing else may point into; values copied
+    // into it become values of this heap without being copied again
+    void adopt(GarbageCollector& transfer);
+
+    // Keeps a frozen heap alive while objects here may point into it; a major collection
+    // that no longer reaches any of its objects lets go of it
+    void retainFrozen(std::shared_ptr<FrozenHeap> heap);
+    // Retains the frozen heap that frozen belongs to
+    void retainFrozen(const PomeObject* frozen);
+    size_t getFrozenHeapCount() const { return frozenHeaps_.size(); }
     
     void setVM(VM* vm);
 
     template<typename T, typename... Args>
     T* allocate(Args&&... args);
 
-    PomeString* allocateString(const std::string& value);
+    // The pooled string with this value, allocated if there is none yet
+    PomeString* allocateString(std::string_view value);
+    // left + right. Once left reaches BUILDER_MIN_LENGTH the result is a builder string that
+    // shares left's buffer where it can, so building a string piece by piece is linear overall
+    PomeString* concatStrings(const PomeString* left, const std::string& right);
+    static constexpr size_t BUILDER_MIN_LENGTH = 256;
+    // str[start, start + length), clamped to str. Long slices share str's bytes rather than copy them,
+    // unless they would keep alive a string more than SLICE_MAX_PIN times their length
+    PomeString* sliceString(const PomeString* str, size_t start, size_t length);
+    static constexpr size_t SLICE_MIN_LENGTH = 64;
+    static constexpr size_t SLICE_MAX_PIN = 8;
     PomeList* allocateList();
 
-    void removeStringFromPool(const std::string& str) {
-        stringPool_.erase(str);
-    }
+    // Drops str from the intern pool if it is the pooled string for its value
+    void removeStringFromPool(PomeString* str);
 
     void updateSize(PomeObject* obj, size_t oldSize, size_t newSize);
+    // Destroys an unreachable object, keeping its nursery slot for reuse
+    void freeObject(PomeObject* obj);
 
+    // A major collection finishes any incremental cycle in progress rather than starting another
     void collect(bool minor = false);
+    // Called by allocation once a threshold is passed: runs a minor collection or the next major slice
+    void collectIfDue();
+
+    static constexpr double DEFAULT_PAUSE_TARGET_MS = 5.0;
+    // Major collections mark and sweep in slices of about this long; 0 stops the world instead
+    void setPauseTarget(double milliseconds) { pauseTargetMs_ = milliseconds; }
+    // Pause target for collectors created afterwards, isolates included (set by --gc-pause)
+    static void setDefaultPauseTarget(double milliseconds) { defaultPauseTargetMs_ = milliseconds; }
+    double getPauseTarget() const { return pauseTargetMs_; }
+    bool isCycleInProgress() const { return phase_ != Phase::IDLE; }
+
+    // Threads that mark and sweep heaps of PARALLEL_MIN_HEAP bytes or more; 1 keeps collections on the mutator thread
+    void setGcThreads(size_t count) { gcThreads_ = count > 0 ? count : 1; }
+    size_t getGcThreads() const { return gcThreads_; }
+    // Thread count for collectors created afterwards (set by --gc-threads); 0 means one per core
+    static void setDefaultGcThreads(size_t count) { defaultGcThreads_ = count; }
+    static constexpr size_t PARALLEL_MIN_HEAP = 32 * 1024 * 1024;
+
     void addTemporaryRoot(PomeObject* obj);
     void removeTemporaryRoot(PomeObject* obj);
 
@@ -56,21 +146,77 @@ public:
 
     size_t getObjectCount() const;
     size_t getGCCount() const { return gcCount_; }
+    uint32_t getHeapId() const { return heapId_; }
+    const Stats& getStats() const { return stats_; }
+    // Walks the heap, so meant for occasional inspection rather than every collection
+    std::map<ObjectType, TypeUsage> getUsageByType() const;
+    size_t getHeapBytes() const { return bytesAllocated_; }
+    size_t getYoungBytes() const { return youngBytesAllocated_; }
+    size_t getZCTSize() const { return zct_.size(); }
+    size_t getRememberedSetSize() const { return rememberedSet_.size(); }
+    // Writes one line per pause to stderr; OFF costs a branch per pause
+    void setTrace(TraceFormat format) { trace_ = format; }
+    // Trace format for collectors created afterwards (set by --gc-trace)
+    static void setDefaultTrace(TraceFormat format) { defaultTrace_ = format; }
     std::string getInfo() const;
+    Nursery::Stats getNurseryStats() const { return nursery_.stats(); }
     PomeShape* getRootShape() const;
     void dumpHeap() const;
     
     void writeBarrier(PomeObject* parent, const PomeValue& child);
+    // For stores writeBarrier does not see (shape trees, inline caches): keeps child alive through a marking cycle
+    void shade(PomeObject* child) {
+        if (phase_ == Phase::MARKING && child && !child->marked()) markObject(child);
+    }
     void rcWriteBarrier(PomeValue* slot, const PomeValue& newValue);
     void rcMapSet(std::unordered_map<PomeValue, PomeValue>& map, const PomeValue& key, const PomeValue& value);
 
     bool pendingGC = false;
-    bool shouldCollectMinor() const { return youngBytesAllocated_ > nextMinorGC_; }
+    bool isCollectionDue() const {
+        return deferrals_ == 0 && (youngBytesAllocated_ > nextMinorGC_ || bytesAllocated_ > nextStep_);
+    }
+    // While any CollectionDeferral is alive allocation never collects (see below)
+    void deferCollections() { ++deferrals_; }
+    void resumeCollections() { --deferrals_; }
 
 private:
+    friend class FrozenHeap;
+
+    // IDLE -> MARKING (slices trace the gray stack) -> SWEEPING (slices free dead old objects) -> IDLE
+    enum class Phase : uint8_t { IDLE, MARKING, SWEEPING };
+
+    // Floating-point, so an infinite pause target is still a valid deadline
+    using Deadline = std::chrono::time_point<std::chrono::steady_clock, std::chrono::duration<double, std::milli>>;
+
+    // Bytes allocated between two slices of an incremental cycle
+    static constexpr size_t SLICE_INTERVAL = 256 * 1024;
+    // Objects traced or swept between two looks at the clock
+    static constexpr size_t CLOCK_CHECK_INTERVAL = 256;
+    static constexpr size_t MIN_MAJOR_THRESHOLD = 16 * 1024 * 1024;
+    // While marking, minor collections wait until the young generation is this many times its budget
+    static constexpr size_t MINOR_DEFERRAL_FACTOR = 4;
+
+    static inline double defaultPauseTargetMs_ = DEFAULT_PAUSE_TARGET_MS;
+    static inline size_t defaultGcThreads_ = 0;
+    static inline TraceFormat defaultTrace_ = TraceFormat::OFF;
+    // Old objects per segment handed to a parallel sweep worker
+    static constexpr size_t SWEEP_SEGMENT = 4096;
+
     VM* vm_ = nullptr;
     size_t gcCount_ = 0;
+    static inline std::atomic<uint32_t> nextHeapId_{1};
+    uint32_t heapId_; // Stamped on every object this collector allocates
+    int deferrals_ = 0;
+    bool transfer_ = false; // See createTransferHeap
+
+    struct FrozenReference {
+        std::shared_ptr<FrozenHeap> heap;
+        uint32_t heapId;
+        std::atomic<bool> reached{false}; // Since the last major mark; set by parallel markers too
+    };
+    std::list<FrozenReference> frozenHeaps_; // Stays put while markers hold on to elements
     
+    Nursery nursery_; // Backs young objects no larger than Nursery::MAX_OBJECT_SIZE
     PomeObject* youngObjects_ = nullptr;
     PomeObject* oldObjects_ = nullptr;
     
@@ -82,15 +228,60 @@ private:
     size_t youngBytesAllocated_ = 0;
     size_t nextGC_ = 64 * 1024 * 1024; 
     size_t nextMinorGC_ = 16 * 1024 * 1024; 
+    size_t nextStep_ = nextGC_; // nextGC_ while idle, the next slice during a cycle
+
+    Phase phase_ = Phase::IDLE;
+    double pauseTargetMs_;
+    PomeObject* unsweptObjects_ = nullptr; // Old objects the sweeping phase has not reached yet
+
+    size_t gcThreads_;
+    bool parallelMarking_ = false; // markObject hands objects to the calling worker's MarkQueue
+
+    Stats stats_;
+    TraceFormat trace_;
+    size_t promotedBytes_ = 0; // Running total, so a pause can tell how much it promoted
+
+    struct PauseStart {
+        std::chrono::steady_clock::time_point time;
+        size_t heap;
+        size_t promoted;
+    };
+    PauseStart beginPause() const {
+        return {std::chrono::steady_clock::now(), bytesAllocated_, promotedBytes_};
+    }
+    void endPause(Pause::Kind kind, const PauseStart& start);
+    void tracePause(const Pause& pause) const;
 
     std::vector<PomeObject*> tempRoots_;
-    std::unordered_map<std::string, PomeString*> stringPool_;
+    StringPool stringPool_;
     std::vector<PomeObject*> grayStack_; 
 
     void mark(bool minor);
+    void markRootSet();
+    void clearRememberedSet();
     void traceReferences(bool minor); 
     void markTable(std::map<PomeValue, PomeValue>& table);
+    void noteFrozen(uint32_t heapId);
+    // Called once a major mark is complete
+    void releaseUnreachedFrozen();
     void sweep(bool minor);
+    void sweepYoung();
+    // Frees an unreachable object, or parks it in listPool_
+    void release(PomeObject* unreached);
+
+    void startCycle();
+    // Each returns once the slice has run for about the pause target
+    void markSlice();
+    void sweepSlice();
+    void finishMarking();
+    void finishSweeping();
+    void finishCycle();
+
+    bool useParallel() const { return gcThreads_ > 1 && bytesAllocated_ >= PARALLEL_MIN_HEAP; }
+    // Traces the gray stack on gcThreads_ workers; returns false with the rest back on the gray stack if deadline passes
+    bool traceParallel(Deadline deadline);
+    // Sweeps list (old objects) on gcThreads_ workers; returns the survivors, marks cleared, and their last object
+    PomeObject* sweepParallel(PomeObject* list, PomeObject*& tail);
 };
 
 class RootGuard {
@@ -110,6 +301,51 @@ private:
     PomeObject* obj_;
 };
 
+// Copying a graph of objects between heaps roots nothing until the copy is complete,
+// so the target heap must not collect part way through
+class CollectionDeferral {
+public:
+    explicit CollectionDeferral(GarbageCollector& gc) : gc_(gc) { gc_.deferCollections(); }
+    ~CollectionDeferral() { gc_.resumeCollections(); }
+
+    CollectionDeferral(const CollectionDeferral&) = delete;
+    CollectionDeferral& operator=(const CollectionDeferral&) = delete;
+
+private:
+    GarbageCollector& gc_;
+};
+
+/**
+ * Values frozen by threading.freeze. Each freeze copies its value into a
+ * transfer heap of its own and marks every object in the copy frozen: no
+ * one may change them, and every isolate reads them in place, so they cross
+ * isolates by reference, never by copy. The heap never collects; the heaps,
+ * jobs and channels holding its values share it, and it goes once the last
+ * of them lets go.
+ */
+class FrozenHeap {
+public:
+    // A frozen copy of value, or nullptr when value holds anything but nil, booleans,
+    // numbers, strings, lists, tables and frozen values
+    static std::shared_ptr<FrozenHeap> freeze(const PomeValue& value);
+    // The frozen heap with this heap id, while anything retains it
+    static std::shared_ptr<FrozenHeap> find(uint32_t heapId);
+
+    ~FrozenHeap();
+    FrozenHeap(const FrozenHeap&) = delete;
+    FrozenHeap& operator=(const FrozenHeap&) = delete;
+
+    PomeValue value() const { return value_; }
+    uint32_t heapId() const { return heapId_; }
+
+private:
+    FrozenHeap() = default;
+
+    std::unique_ptr<GarbageCollector> heap_;
+    PomeValue value_;
+    uint32_t heapId_ = 0;
+};
+
 } // namespace Pome
 
 #include "pome_gc_impl.h"
@@ -5,22 +5,25 @@ namespace Pome {
 
     template<typename T, typename... Args>
     T* GarbageCollector::allocate(Args&&... args) {
-        if (youngBytesAllocated_ > nextMinorGC_) {
-            collect(true);
-        }
-        if (bytesAllocated_ > nextGC_) {
-            collect(false);
+        if (isCollectionDue()) {
+            collectIfDue();
         }
 
+        static_assert(alignof(T) <= Nursery::ALIGN, "nursery slots are only pointer-aligned");
         T* object = nullptr;
+        bool inNursery = sizeof(T) <= Nursery::MAX_OBJECT_SIZE && !transfer_;
         try {
-            object = new T(std::forward<Args>(args)...);
+            if (inNursery) object = new (nursery_) T(std::forward<Args>(args)...);
+            else object = new T(std::forward<Args>(args)...);
         } catch (const std::bad_alloc& e) {
             collect(false);
             object = new T(std::forward<Args>(args)...);
+            inNursery = false;
         }
 
         PomeObject* obj = static_cast<PomeObject*>(object);
+        obj->slotSize = inNursery ? Nursery::slotSize(sizeof(T)) : 0;
+        obj->heapId = heapId_;
         obj->gcSize = sizeof(T) + obj->extraSize();
 
         obj->generation = 0;
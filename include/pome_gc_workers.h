@@ -0,0 +1,48 @@
+#ifndef POME_GC_WORKERS_H
+#define POME_GC_WORKERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Pome {
+
+    class PomeObject;
+
+    /**
+     * Gray objects of one parallel mark worker.
+     *
+     * The owner pushes and pops `local` without locking. Whenever it holds more
+     * than SHARE_THRESHOLD objects and its previous offer has been taken, it
+     * moves the older half into `shared`. Idle workers steal half of another
+     * worker's `shared` under its lock. Each worker looks at its own offer
+     * first, so a worker that runs dry takes back what nobody stole.
+     */
+    class MarkQueue {
+    public:
+        static constexpr size_t SHARE_THRESHOLD = 64;
+
+        std::vector<PomeObject*> local;
+
+        void push(PomeObject* object) { local.push_back(object); }
+        void maybeShare();
+        // Moves up to half of victim's offer into local
+        bool stealFrom(MarkQueue& victim);
+        bool hasOffer() const { return offered_.load(std::memory_order_acquire) > 0; }
+        // Whatever is left in local and on offer, for when tracing stops early
+        void drainInto(std::vector<PomeObject*>& out);
+
+    private:
+        std::mutex lock_;
+        std::vector<PomeObject*> shared_;
+        std::atomic<size_t> offered_{0};
+    };
+
+    // Runs body(0) .. body(count - 1) at once, body(0) on the calling thread
+    void runGcWorkers(size_t count, const std::function<void(size_t)>& body);
+
+} // namespace Pome
+
+#endif // POME_GC_WORKERS_H
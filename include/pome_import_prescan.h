@@ -0,0 +1,89 @@
+#ifndef POME_IMPORT_PRESCAN_H
+#define POME_IMPORT_PRESCAN_H
+
+#include "pome_bytecode_cache.h"
+#include "pome_chunk.h"
+#include "pome_module_resolver.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Pome {
+
+    class GarbageCollector;
+
+    /**
+     * Compiles a script's module graph ahead of execution.
+     *
+     * start() reads the IMPORT instructions of the script's chunk (one per
+     * `import` or `from ... import`), resolves each name the way the module
+     * loader will, and hands the files to a small thread pool. A worker parses
+     * and compiles its file with a GarbageCollector of its own, serializes the
+     * chunk in the .pomec format, and queues the modules that file imports in
+     * turn. Nothing is shared with the VM's heap until take(), which the
+     * loader calls from the main thread when IMPORT runs; execution therefore
+     * still happens one module at a time, in import order.
+     *
+     * A module the workers could not compile (a syntax or compile error, or a
+     * constant the cache format cannot hold) is left to the loader, which
+     * compiles it itself and reports the error at the usual point.
+     */
+    class ImportPrescan {
+    public:
+        // Names the loader serves itself (math, io, ...), never looked up on disk
+        ImportPrescan(const ModuleResolver& resolver, std::unordered_set<std::string> builtinModules, int optLevel,
+                      bool useCache);
+        ~ImportPrescan();
+
+        ImportPrescan(const ImportPrescan&) = delete;
+        ImportPrescan& operator=(const ImportPrescan&) = delete;
+
+        // Queues the modules chunk imports; scriptPath is where the chunk's source lives
+        void start(const Chunk& chunk, const std::string& scriptPath);
+
+        // The chunk compiled for the module file at path, waiting for its worker if need be. Null
+        // when the prescan never reached path, or left it to the loader.
+        std::unique_ptr<Chunk> take(GarbageCollector& gc, const std::string& path);
+
+        // Module names the IMPORT instructions of chunk and its nested functions load
+        static std::vector<std::string> importsOf(const Chunk& chunk);
+
+        static constexpr unsigned MAX_WORKERS = 8;
+
+    private:
+        struct Module {
+            bool done = false;
+            bool compiled = false; // bytes holds the serialized chunk
+            CacheKey key;
+            std::vector<uint8_t> bytes;
+        };
+
+        const ModuleResolver& resolver;
+        std::unordered_set<std::string> builtinModules;
+        int optLevel;
+        bool useCache;
+
+        std::mutex mutex;
+        std::condition_variable moduleDone;
+        std::condition_variable workAvailable;
+        std::unordered_map<std::string, Module> modules; // By the path the loader will open
+        std::deque<std::string> queue;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+
+        // Call with mutex held
+        void enqueue(const std::vector<std::string>& names, const std::string& importerPath);
+        void work();
+        // Compiles path into module and returns what it imports
+        std::vector<std::string> compile(const std::string& path, Module& module) const;
+    };
+
+}
+
+#endif // POME_IMPORT_PRESCAN_H
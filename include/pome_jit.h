@@ -0,0 +1,122 @@
+#ifndef POME_JIT_H
+#define POME_JIT_H
+
+#include "pome_chunk.h"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <vector>
+
+namespace Pome {
+
+    class VM;
+    struct CallFrame;
+
+    // State shared by VM::runJit and the machine code of one activation
+    struct JitFrame {
+        PomeValue* R;             // Must stay first: the prologue loads it from [rdi]
+        VM* vm;
+        CallFrame* frame;
+        Chunk* chunk;
+        std::exception_ptr error; // Set by a helper before an EXIT_THROW
+    };
+
+    /**
+     * Machine code for one Chunk, produced by Jit::compile.
+     *
+     * Every bytecode instruction has an entry point, and bytecode registers stay
+     * in the frame's register window. Leaving machine code at an instruction
+     * boundary therefore only means resuming the interpreter at that pc.
+     */
+    class JitCode {
+    public:
+        enum Exit : uint32_t {
+            EXIT_INTERPRET = 1, // Not compiled, or a cache the helper cannot use; interpret it
+            EXIT_GUARD = 2,     // A type guard failed; the interpreter deopts the instruction
+            EXIT_THROW = 3      // A native called from machine code threw; rethrow at pc
+        };
+        static constexpr int EXIT_SHIFT = 28;
+        static constexpr uint32_t PC_MASK = (1u << EXIT_SHIFT) - 1;
+
+        static uint32_t exitCode(Exit reason, uint32_t pc) { return (reason << EXIT_SHIFT) | pc; }
+
+        JitCode(void* memory, size_t size, std::vector<uint32_t> entries);
+        ~JitCode();
+
+        JitCode(const JitCode&) = delete;
+        JitCode& operator=(const JitCode&) = delete;
+
+        // Runs from instruction pc until the first exit and returns its exitCode()
+        uint32_t run(JitFrame& frame, uint32_t pc) const {
+            return reinterpret_cast<EntryFn>(memory)(&frame, static_cast<const uint8_t*>(memory) + entries[pc]);
+        }
+
+        size_t size() const { return codeSize; }
+
+        uint32_t guardExits = 0;
+
+    private:
+        using EntryFn = uint32_t (*)(JitFrame*, const void*);
+
+        void* memory;
+        size_t codeSize;
+        std::vector<uint32_t> entries; // Offset of each instruction's code in memory
+    };
+
+    // Counters behind jit_info()
+    struct JitStats {
+        size_t compiled = 0;
+        size_t failed = 0;
+        size_t discarded = 0;   // Deopted for good after too many guard exits
+        size_t codeBytes = 0;
+        uint64_t entries = 0;
+        uint64_t guardExits = 0;
+    };
+
+    /**
+     * Baseline template JIT for x86-64 (System V).
+     *
+     * Each instruction becomes a fixed template. Arithmetic, comparisons,
+     * branches and moves are inlined behind number guards. Table, field,
+     * global and native-call instructions call the helpers below, which take
+     * only the interpreter's fast paths. Anything else exits to the
+     * interpreter, which runs that instruction and re-enters machine code at
+     * the next loop back edge, call or return. Other targets report
+     * supported() == false and stay interpreted.
+     */
+    class Jit {
+    public:
+        static constexpr uint32_t HOT_THRESHOLD = 1000;  // Calls plus loop back edges before compiling
+        static constexpr uint32_t MAX_GUARD_EXITS = 1000; // Before a chunk returns to the interpreter for good
+
+        static bool supported();
+        // Null when the chunk cannot be compiled
+        static std::shared_ptr<JitCode> compile(const Chunk& chunk);
+
+    private:
+        class Codegen;
+
+        // Called from machine code: 0 to continue, otherwise the exit code to return
+        static uint32_t getTable(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t setTable(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t getField(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t setField(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t getGlobal(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t getUpvalue(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t setUpvalue(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t callNative(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t checkMethod(JitFrame* f, uint32_t pc) noexcept;
+        static uint32_t equal(JitFrame* f, uint32_t pc) noexcept;
+
+        static constexpr uint64_t NUMBER_MASK = PomeValue::QNAN;
+        static constexpr uint64_t NIL_BITS = PomeValue::QNAN | PomeValue::TAG_NIL;
+        static constexpr uint64_t FALSE_BITS = PomeValue::QNAN | PomeValue::TAG_FALSE;
+        static constexpr uint64_t TRUE_BITS = PomeValue::QNAN | PomeValue::TAG_TRUE;
+        static constexpr uint64_t OBJECT_BITS = PomeValue::QNAN | PomeValue::SIGN_BIT; // All set only for objects
+        static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000ULL; // What PomeValue(double) stores for NaN
+    };
+
+}
+
+#endif // POME_JIT_H
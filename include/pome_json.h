@@ -0,0 +1,98 @@
+#ifndef POME_JSON_H
+#define POME_JSON_H
+
+#include "pome_value.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Pome {
+
+    class PomeShape;
+
+    /**
+     * Builds values straight from JSON text in one pass, with no document in
+     * between: objects become tables, arrays lists, null nil. Members and
+     * elements collect on a stack until their container closes, so each table
+     * and list is allocated once at its final size. Arrays of numbers or
+     * booleans get unboxed lists. Objects remember the shape of the last object
+     * at the same depth: when the next one has the same keys in the same order,
+     * as records in an array do, its keys are matched against that shape's
+     * instead of being looked up in the intern pool, and the table takes the
+     * shape without walking its transitions.
+     */
+    class JsonParser {
+    public:
+        static constexpr int MAX_DEPTH = 512;
+
+        explicit JsonParser(GarbageCollector& gc) : gc_(gc) {}
+
+        // source is the string holding text, which long string values may share; false, with error set, when
+        // text is not a single JSON value
+        bool parse(const PomeString* source, PomeValue& result);
+        const std::string& error() const { return error_; }
+
+    private:
+        // The keys of a shape in slot order
+        struct ShapeHint {
+            PomeShape* shape = nullptr;
+            std::vector<PomeValue> keys;
+        };
+
+        bool parseValue(PomeValue& out, int depth);
+        bool parseObject(PomeValue& out, int depth);
+        bool parseArray(PomeValue& out, int depth);
+        // Leaves the contents in text, pointing into the source or into scratch_ when it had escapes
+        bool parseString(std::string_view& text, bool& escaped);
+        bool parseNumber(PomeValue& out);
+        bool parseLiteral(const char* word, PomeValue value, PomeValue& out);
+        PomeValue makeKey(std::string_view text, const ShapeHint* hint, size_t slot);
+        void skipSpace();
+        bool fail(const std::string& message);
+
+        GarbageCollector& gc_;
+        const PomeString* source_ = nullptr;
+        const char* begin_ = nullptr;
+        const char* pos_ = nullptr;
+        const char* end_ = nullptr;
+        std::string scratch_;
+        std::string error_;
+        std::vector<PomeValue> stack_; // Keys and values of the open containers
+        std::vector<ShapeHint> hints_; // By depth
+    };
+
+    /**
+     * Appends JSON text to a buffer kept between calls, so serialising many
+     * values reuses one allocation. Tables become objects and lists arrays;
+     * functions, tasks and other values JSON has no form for are refused, as
+     * are structures nested more than MAX_DEPTH deep (cycles included).
+     */
+    class JsonWriter {
+    public:
+        static constexpr int MAX_DEPTH = 512;
+
+        // Starts a new text; the buffer keeps its capacity unless it grew past RETAIN_BYTES
+        void clear();
+        // Appends value, indenting nested members by indent spaces when it is above zero; false when value
+        // cannot be written, leaving the text incomplete
+        bool write(const PomeValue& value, int indent = 0);
+        const std::string& text() const { return out_; }
+
+        static constexpr size_t RETAIN_BYTES = 1 << 20;
+
+    private:
+        bool writeValue(const PomeValue& value, int depth);
+        bool writeKey(const PomeValue& key);
+        void writeString(std::string_view text);
+        void writeNumber(double number);
+        void newline(int depth);
+
+        std::string out_;
+        int indent_ = 0;
+        std::vector<PomeShape*> chain_; // Shapes of the open tables, newest key first
+    };
+
+} // namespace Pome
+
+#endif // POME_JSON_H
@@ -1,7 +1,9 @@
 #ifndef POME_LEXER_H
 #define POME_LEXER_H
 
+#include <deque>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 
@@ -86,10 +88,13 @@ namespace Pome
     struct Token
     {
         TokenType type;
-        std::string value;
+        // A slice of the source (or of the Lexer, for strings with escapes); valid while the Lexer lives
+        std::string_view value;
         int line;
         int column;
 
+        std::string text() const { return std::string(value); }
+
         static std::string toString(TokenType type);
         std::string debugString() const;
     };
@@ -97,12 +102,15 @@ namespace Pome
     class Lexer
     {
     public:
-        Lexer(const std::string &source);
+        // The source is not copied: it must outlive the Lexer
+        explicit Lexer(std::string_view source);
+        Lexer(std::string &&source) = delete; // Tokens would point into a dead temporary
         Token getNextToken();
         char peek(); 
 
     private:
-        std::string source;
+        std::string_view source;
+        std::deque<std::string> ownedText; // Unescaped string literals and error messages
         size_t currentPos;
         int currentLine;
         int currentCol;
@@ -110,7 +118,8 @@ namespace Pome
         Token readIdentifier();
         Token readNumber();
         Token readString();
-        Token makeToken(TokenType type, const std::string &value);
+        Token makeToken(TokenType type, std::string_view value);
+        std::string_view keep(std::string text);
         void skipWhitespace();
         char advance();
     };
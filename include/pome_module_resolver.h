@@ -34,7 +34,7 @@ public:
      * @param logicalPath The path to resolve (e.g. "os", "my_pkg.sub")
      * @param originPath The absolute directory path of the module making the request (for relative imports)
      */
-    ResolutionResult resolve(const std::string& logicalPath, const std::string& originPath = "");
+    ResolutionResult resolve(const std::string& logicalPath, const std::string& originPath = "") const;
 
     /**
      * Get the platform-specific shared library extension.
@@ -47,7 +47,7 @@ private:
     std::vector<std::string> searchPaths_;
 
     // Helper to check for pome_pkg.json
-    bool isNativeModule(const std::string& pkgRoot, const std::string& moduleName);
+    bool isNativeModule(const std::string& pkgRoot, const std::string& moduleName) const;
 };
 
 } // namespace Pome
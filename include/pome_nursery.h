@@ -0,0 +1,178 @@
+#ifndef POME_NURSERY_H
+#define POME_NURSERY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Pome {
+
+    /**
+     * Bump-pointer space for young objects.
+     *
+     * Small objects are carved out of 64 KB blocks in allocation order instead
+     * of coming from malloc one by one. Objects never move: a survivor that is
+     * promoted to the old generation keeps its address and its block. Each
+     * block counts the bytes still in use in it, and reclaim() (run after
+     * every collection) rewinds or recycles the blocks whose count reached
+     * zero.
+     *
+     * Slots the collector frees are kept on per-size-class free lists, up to
+     * MAX_CACHED_BYTES, and handed to the next object of the same size before
+     * the bump pointer moves. Each collector (one per isolate) owns its
+     * nursery, so the free lists need no locking.
+     *
+     * Slots beyond that go back to their block. A block that still holds
+     * survivors but has RECYCLE_MIN_FREE bytes or more to give is queued by
+     * reclaim(), and the bump pointer then runs through its runs of free
+     * slots, coalesced, before any empty block is taken. So a few scattered
+     * survivors do not keep a whole block from objects of any size.
+     *
+     * Every object carries a one-word header: its block's address, which is
+     * BLOCK_SIZE-aligned, with the slot size in the low bits and FREE set
+     * once the slot is given back. It is 0 when the object came from the heap
+     * (see PomeObject::operator new).
+     */
+    class Nursery {
+    public:
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+        static constexpr size_t ALIGN = alignof(void*);
+        static constexpr size_t HEADER = ALIGN;
+        // Larger objects go to the heap, so one of them cannot strand a mostly empty block
+        static constexpr size_t MAX_OBJECT_SIZE = 1024;
+        static_assert(sizeof(std::atomic<uintptr_t>) == HEADER, "a slot header is one word");
+        static constexpr size_t SIZE_CLASSES = (MAX_OBJECT_SIZE + HEADER) / ALIGN + 1;
+        // Free slots kept for reuse beyond this are given back to their blocks
+        static constexpr size_t MAX_CACHED_BYTES = 4 * 1024 * 1024;
+        // A block with survivors is bumped through again once this much of it is free
+        static constexpr size_t RECYCLE_MIN_FREE = BLOCK_SIZE / 8;
+
+        // Header bits below the block address
+        static constexpr uintptr_t FREE = 1 << 15;
+        static constexpr uintptr_t SLOT_UNITS = FREE - 1; // Slot size / ALIGN
+        static_assert(BLOCK_SIZE > FREE && BLOCK_SIZE / ALIGN <= SLOT_UNITS, "slot headers need the low 16 bits");
+
+        struct Block {
+            std::atomic<uint32_t> liveBytes{0}; // Slots allocated here and not yet given back
+            const Nursery* owner = nullptr;
+            char* next = nullptr; // The run being bumped through
+            char* end = nullptr;
+            char* top = nullptr;  // Slots with headers end here; the rest of the block is untouched
+            char* scan = nullptr; // Where the search for the next free run resumes
+            // Objects follow the block header
+        };
+
+        struct Stats {
+            uint64_t bumpAllocations = 0;
+            uint64_t slotReuses = 0;  // Allocations served from a free list
+            size_t reservedBytes = 0; // Whole blocks
+            size_t usedBytes = 0;     // Below the bump pointers
+            size_t liveBytes = 0;     // Slots holding objects
+            size_t cachedBytes = 0;   // Slots on the free lists
+            size_t recycledBytes = 0; // Free slots in blocks queued for reuse
+            uint64_t recycledBlocks = 0; // Times a block with survivors was bumped through again
+
+            double reuseRate() const {
+                uint64_t total = bumpAllocations + slotReuses;
+                return total ? static_cast<double>(slotReuses) / total : 0;
+            }
+            // Share of the bumped-over bytes that are dead but cannot be reused yet
+            double fragmentation() const {
+                return usedBytes ? static_cast<double>(usedBytes - liveBytes - cachedBytes - recycledBytes) / usedBytes
+                                 : 0;
+            }
+        };
+
+        Nursery() = default;
+        ~Nursery();
+        Nursery(const Nursery&) = delete;
+        Nursery& operator=(const Nursery&) = delete;
+
+        // Bytes an object of size bytes occupies, header included
+        static constexpr size_t slotSize(size_t size) { return (size + HEADER + ALIGN - 1) & ~(ALIGN - 1); }
+
+        // Memory for an object of size bytes, its header already written
+        void* allocate(size_t size) {
+            size_t slot = slotSize(size);
+            std::vector<void*>& cached = freeSlots_[slot / ALIGN];
+            if (!cached.empty()) {
+                void* ptr = cached.back();
+                cached.pop_back();
+                cachedBytes_ -= slot;
+                ++slotReuses_;
+                return ptr;
+            }
+            if (!current_ || static_cast<size_t>(current_->end - current_->next) < slot) nextRun(slot);
+            char* memory = current_->next;
+            current_->next += slot;
+            current_->liveBytes.fetch_add(static_cast<uint32_t>(slot), std::memory_order_relaxed);
+            header(memory).store(reinterpret_cast<uintptr_t>(current_) | (slot / ALIGN), std::memory_order_relaxed);
+            ++bumpAllocations_;
+            return memory + HEADER;
+        }
+
+        // Takes back the slot of a destroyed object for the next one of its size
+        void recycle(void* ptr, size_t slot) {
+            if (blockOf(ptr)->owner != this || cachedBytes_ + slot > MAX_CACHED_BYTES) {
+                release(ptr);
+                return;
+            }
+            freeSlots_[slot / ALIGN].push_back(ptr);
+            cachedBytes_ += slot;
+        }
+
+        // Gives the slot of ptr back to its block for good; may run on any thread
+        static void release(void* ptr) {
+            uintptr_t word = header(static_cast<char*>(ptr) - HEADER).fetch_or(FREE, std::memory_order_relaxed);
+            reinterpret_cast<Block*>(word & ~(BLOCK_SIZE - 1))
+                ->liveBytes.fetch_sub(static_cast<uint32_t>((word & SLOT_UNITS) * ALIGN), std::memory_order_acq_rel);
+        }
+
+        // nullptr for an object from the heap
+        static Block* blockOf(void* ptr) {
+            uintptr_t word = header(static_cast<char*>(ptr) - HEADER).load(std::memory_order_relaxed);
+            return reinterpret_cast<Block*>(word & ~(BLOCK_SIZE - 1));
+        }
+
+        // Rewinds or frees the empty blocks, and queues the ones with enough free slots to bump through again
+        void reclaim();
+
+        size_t blockCount() const { return full_.size() + recyclable_.size() + free_.size() + (current_ ? 1 : 0); }
+        size_t bytesReserved() const { return blockCount() * BLOCK_SIZE; }
+        Stats stats() const;
+
+    private:
+        // Empty blocks kept for reuse beyond this are returned to the system
+        static constexpr size_t MAX_FREE_BLOCKS = 64;
+
+        Block* current_ = nullptr;
+        std::vector<Block*> full_;       // Retired blocks that still hold objects
+        std::vector<Block*> recyclable_; // Blocks with survivors and RECYCLE_MIN_FREE bytes or more free
+        std::vector<Block*> free_;
+
+        std::vector<void*> freeSlots_[SIZE_CLASSES]; // By slot size / ALIGN
+        size_t cachedBytes_ = 0;
+        uint64_t bumpAllocations_ = 0;
+        uint64_t slotReuses_ = 0;
+        uint64_t recycledBlocks_ = 0;
+
+        // release() can reach a header from another thread while the owner searches its block
+        static std::atomic<uintptr_t>& header(char* slot) { return *reinterpret_cast<std::atomic<uintptr_t>*>(slot); }
+        static char* blockStart(Block* block) { return reinterpret_cast<char*>(block + 1); }
+        static char* blockEnd(Block* block) { return reinterpret_cast<char*>(block) + BLOCK_SIZE; }
+
+        // Moves the bump pointer to a free run of at least slot bytes: later in the current block,
+        // in a recyclable block, or in an empty one
+        void nextRun(size_t slot);
+        // Leaves the current run; what it did not use stays a free slot
+        void closeRun();
+        static bool findRun(Block* block, size_t slot);
+        static size_t freeBytes(const Block* block);
+        Block* newBlock() const;
+        static void rewind(Block* block);
+    };
+
+}
+
+#endif // POME_NURSERY_H
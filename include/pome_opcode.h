@@ -59,7 +59,7 @@ namespace Pome {
         OR,
         SLICE,
         PRINT,
-        TRY,        // Added for error handling
+        TRY,        // Unused: try blocks are found through Chunk::handlers
         THROW,      // Added for error handling
         CATCH,      // Retrieve pending exception
         ASYNC,      // Create a task from a function
@@ -91,6 +91,21 @@ namespace Pome {
         GETLIST_I,  // Specialized Int32
         SETLIST_I,
 
+        // Superinstructions, fused by the compiler. Only the first word is
+        // rewritten; the words it covers stay in place so jumps into the
+        // middle of a sequence still land on valid instructions.
+        LT_JMP,     // LT A B C; TEST A k; JMP sBx
+        LE_JMP,     // LE A B C; TEST A k; JMP sBx
+        LOADK_ADD,  // LOADK A Bx; ADD x y z (y or z is A)
+        LOADK_SUB,  // LOADK A Bx; SUB x y z
+        LOADK_MUL,  // LOADK A Bx; MUL x y z
+        LOADK_ADD_JMP, // LOADK A Bx; ADD x y z; JMP sBx (loop step and back edge)
+        MOVE2,      // MOVE A B; MOVE x y
+        GETTABLE_ADD_SET, // GETTABLE A B C; ADD A A x; SETTABLE B C A
+
+        // Guard in front of a method body the compiler inlined
+        CHECKMETHOD, // if R(A).name resolves to K(Bx), the method named K(Bx).name, then PC++
+
         OP_COUNT
     };
 
@@ -0,0 +1,69 @@
+#ifndef POME_OPTIMIZER_H
+#define POME_OPTIMIZER_H
+
+#include "pome_ast.h"
+#include "pome_chunk.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Pome {
+
+    class GarbageCollector;
+
+    /**
+     * Passes behind `pome -O1` and `-O2`.
+     *
+     * The Compiler folds constants while it walks the AST, since it owns the
+     * locals and registers; the arithmetic lives here so a folded value is
+     * exactly what the interpreter would have computed. Once a chunk is
+     * complete, removeUnreachable() cleans up the bytecode before
+     * superinstructions are fused.
+     *
+     * At -O2 the Compiler also inlines calls to small functions: top-level
+     * functions bound exactly once, and methods behind a CHECKMETHOD guard
+     * that falls back to the real call when the receiver resolves the name
+     * to anything else.
+     */
+    class Optimizer {
+    public:
+        static constexpr int DEFAULT_LEVEL = 2;
+        static constexpr int MAX_INLINE_NODES = 24; // AST nodes in an inlined body
+        static constexpr int MAX_INLINE_DEPTH = 3;  // Inlined calls inside inlined bodies
+
+        // False whenever the interpreter could do anything else: raise, or call an operator method
+        static bool foldUnary(const std::string& op, PomeValue operand, PomeValue& result);
+        static bool foldBinary(GarbageCollector& gc, const std::string& op, PomeValue left, PomeValue right,
+                               PomeValue& result);
+
+        // Names a function body may write after declaring them: assignment targets, loop and
+        // catch variables, and names declared more than once. Nested functions are included.
+        static std::unordered_set<std::string> reboundNames(const std::vector<std::unique_ptr<Statement>>& body);
+        // How often each name is declared or written anywhere in body
+        static std::unordered_map<std::string, int> bindingCounts(const std::vector<std::unique_ptr<Statement>>& body);
+
+        // Name occurrences in a function body, numbered in the order the compiler emits them (nested
+        // functions included). A local whose name occurs nowhere past the end of a statement is dead
+        // there, unless a loop around both runs that statement again.
+        struct Liveness {
+            std::unordered_map<std::string, int> lastUses;
+            std::unordered_map<const Statement*, int> statementEnds;
+            int declarations = 0; // var declarations outside nested functions
+        };
+        static Liveness liveness(const std::vector<std::unique_ptr<Statement>>& body);
+
+        // The expression fn returns, if fn is small enough to inline: one return of an expression
+        // that only reads, with no closures and no call to fn by name. freeNames receives the
+        // names it reads besides its parameters (and `this`, for methods).
+        static Expression* inlineBody(const FunctionDeclStmt& fn, bool isMethod, std::vector<std::string>& freeNames);
+
+        // Drops instructions no path reaches and jumps to the next instruction, and
+        // threads jumps to jumps. Offsets, lines, cache slots and try ranges are remapped.
+        static void removeUnreachable(Chunk& chunk);
+    };
+
+}
+
+#endif // POME_OPTIMIZER_H
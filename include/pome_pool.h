@@ -0,0 +1,140 @@
+#ifndef POME_POOL_H
+#define POME_POOL_H
+
+#include "pome_gc.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Pome {
+
+    class VM;
+
+    /**
+     * One call for the isolate pool. Arguments are copied into a transfer heap,
+     * which the worker's heap then adopts, and the result comes back the same
+     * way, so the submitting VM and the worker never touch each other's objects
+     * and nothing is copied twice. Frozen values are not copied at all. The
+     * function itself is shared, as it is with threading.spawn: its chunk and
+     * module stay in the submitting heap, which keeps them alive.
+     */
+    struct PoolJob {
+        enum class Kind : uint8_t {
+            CALL, // function(args...)
+            MAP   // args[0] is a list; the result lists function(element) for each element
+        };
+
+        Kind kind = Kind::CALL;
+        PomeFunction* function = nullptr;
+        std::unique_ptr<GarbageCollector> inbox; // Transfer heaps
+        std::vector<PomeValue> args;   // In inbox
+        std::unique_ptr<GarbageCollector> outbox;
+        PomeValue result;              // In outbox, when it is an object
+        bool failed = false;           // result holds the exception the call threw
+        std::atomic<bool> done{false};
+
+        // A job whose arguments are copies of args[0, count)
+        static std::shared_ptr<PoolJob> create(Kind kind, PomeFunction* function, const PomeValue* args, size_t count);
+        // A MAP job over list[begin, end)
+        static std::shared_ptr<PoolJob> createMap(PomeFunction* function, PomeList* list, size_t begin, size_t end);
+        // Hands the result of a finished job over to gc
+        PomeValue takeResult(GarbageCollector& gc);
+    };
+
+    /**
+     * Process-wide pool of isolate workers, started on first use. Each worker
+     * keeps one VM and heap for every job it runs, and owns a deque of jobs: it
+     * takes the newest of its own, and once that runs dry steals the oldest from
+     * the others. A worker waiting on jobs it submitted runs queued jobs meanwhile,
+     * so nested parallel calls cannot starve the pool.
+     */
+    class IsolatePool {
+    public:
+        static IsolatePool& instance();
+        // Workers for a pool started afterwards (set by --workers); 0 means one per core
+        static void setDefaultWorkerCount(size_t count) { defaultWorkers_ = count; }
+
+        ~IsolatePool();
+        IsolatePool(const IsolatePool&) = delete;
+        IsolatePool& operator=(const IsolatePool&) = delete;
+
+        size_t workerCount() const { return workers_.size(); }
+        void submit(std::shared_ptr<PoolJob> job);
+        // Finished jobs so far; pass the count seen before checking on jobs to waitForCompletion
+        uint64_t completedCount() const { return completed_.load(std::memory_order_acquire); }
+        // Returns once another job has finished since completedCount() returned seen
+        void waitForCompletion(uint64_t seen);
+        // An eventfd to signal whenever a job finishes, for event loops that wait in epoll
+        static void addCompletionFd(int fd);
+        static void removeCompletionFd(int fd);
+
+    private:
+        struct Worker {
+            std::mutex lock;
+            std::deque<std::shared_ptr<PoolJob>> jobs;
+            std::thread thread;
+            std::unique_ptr<GarbageCollector> gc;
+            std::unique_ptr<VM> vm;
+        };
+
+        explicit IsolatePool(size_t count);
+        void workerLoop(size_t index);
+        // The calling worker's newest job, or the oldest job of another worker
+        std::shared_ptr<PoolJob> take(size_t index);
+        void run(Worker& worker, PoolJob& job);
+
+        static inline size_t defaultWorkers_ = 0;
+        static inline std::mutex completionFdsLock_;
+        static inline std::vector<int> completionFds_;
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::atomic<size_t> nextWorker_{0}; // Round robin for submissions from outside the pool
+        std::atomic<size_t> queued_{0};
+        std::atomic<uint64_t> completed_{0};
+        std::mutex sleepLock_;
+        std::condition_variable wake_;      // A job was queued, or the pool is stopping
+        std::condition_variable finished_;  // A job finished
+        bool stopping_ = false;
+    };
+
+    /**
+     * Bounded queue of values between isolates (threading.channel). send copies a
+     * value into a transfer heap, once, and receive has the receiving heap adopt
+     * it, so a message changes hands rather than being copied twice. Frozen
+     * values and primitives travel as they are. Waiting blocks the thread: a
+     * pool worker blocked on a channel runs nothing else meanwhile, since the
+     * job it would pick up could be the one meant to unblock it.
+     */
+    class Channel {
+    public:
+        explicit Channel(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+        // Blocks while the channel is full; false, with value dropped, once it is closed
+        bool send(const PomeValue& value);
+        // Blocks while the channel is empty and open; false once it is closed and drained
+        bool receive(GarbageCollector& gc, PomeValue& value);
+        // Wakes everyone waiting; messages already sent can still be received
+        void close();
+
+    private:
+        struct Message {
+            PomeValue value;
+            std::unique_ptr<GarbageCollector> heap; // Holds value when it is an object and not frozen
+            std::shared_ptr<FrozenHeap> frozen;     // Holds value when it is frozen
+        };
+
+        size_t capacity_;
+        std::mutex lock_;
+        std::condition_variable changed_; // A message was sent or received, or the channel closed
+        std::deque<Message> messages_;
+        bool closed_ = false;
+    };
+
+} // namespace Pome
+
+#endif // POME_POOL_H
@@ -0,0 +1,86 @@
+#ifndef POME_PROFILER_H
+#define POME_PROFILER_H
+
+#include "pome_chunk.h"
+#include <array>
+#include <csignal>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Pome {
+
+    struct CallFrame;
+
+    /**
+     * Built-in profiler behind `pome --profile`.
+     *
+     * While attached to a VM, every dispatch goes through onInstruction(),
+     * which counts opcodes and notices instructions that rewrote themselves
+     * (quickening such as GETFIELD -> GETFIELD_CACHE, or the reverse deopt).
+     * A SIGPROF interval timer raises a flag, and the next dispatch records the
+     * CallFrame chain as a folded stack keyed by Chunk::lines. A VM with no
+     * profiler uses its normal dispatch table, so it pays nothing.
+     */
+    class Profiler {
+    public:
+        explicit Profiler(int sampleIntervalUs = 1000);
+        ~Profiler();
+
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        // Arms the process-wide CPU-time timer; only one profiler may run at a time
+        void start();
+        void stop();
+
+        void onInstruction(const uint32_t* pc, const Chunk* chunk, const CallFrame* frames, int frameCount) {
+            uint8_t op = static_cast<uint8_t>(*pc & 0xFF);
+            ++opCounts[op];
+            // Only the running instruction rewrites itself, so compare it on the next dispatch.
+            // Comparing within one chunk also never reads a chunk freed after its frame returned.
+            if (lastChunk == chunk && lastPc) {
+                uint8_t now = static_cast<uint8_t>(*lastPc & 0xFF);
+                if (now != lastOp) ++transitions[{lastOp, now}];
+                // Straight-line successors are the superinstruction candidates
+                if (pc == lastPc + 1) ++pairCounts[(now << 8) | op];
+            }
+            lastPc = pc;
+            lastOp = op;
+            lastChunk = chunk;
+            if (samplePending) takeSample(pc, frames, frameCount);
+        }
+
+        // Brendan Gregg's folded format: "outer:line;inner:line count" per line
+        void writeFolded(std::ostream& out) const;
+        // Opcode dispatch counts, hottest adjacent pairs and quickening/deopt transitions
+        void writeSummary(std::ostream& out) const;
+
+        uint64_t getSampleCount() const { return sampleCount; }
+
+    private:
+        void takeSample(const uint32_t* pc, const CallFrame* frames, int frameCount);
+        static void onSignal(int);
+
+        static volatile std::sig_atomic_t samplePending;
+        static Profiler* running;
+
+        int intervalUs;
+        std::array<uint64_t, 256> opCounts{};
+        std::vector<uint64_t> pairCounts = std::vector<uint64_t>(256 * 256); // [first << 8 | second]
+        std::map<std::pair<uint8_t, uint8_t>, uint64_t> transitions;
+        std::unordered_map<std::string, uint64_t> stacks;
+        uint64_t sampleCount = 0;
+
+        const uint32_t* lastPc = nullptr;
+        const Chunk* lastChunk = nullptr;
+        uint8_t lastOp = 0;
+    };
+
+}
+
+#endif // POME_PROFILER_H
@@ -0,0 +1,117 @@
+#ifndef POME_REACTOR_H
+#define POME_REACTOR_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Pome {
+
+    class GarbageCollector;
+    class PomeTask;
+
+    /**
+     * A VM's timers and pending I/O, each settling one task. Everything the
+     * event loop can wait for is in one epoll set: a timerfd armed for the
+     * nearest deadline, the sockets that have operations waiting, an eventfd the
+     * isolate pool signals when a job finishes and, when the kernel has
+     * io_uring, the ring that reads and writes regular files, which epoll cannot
+     * wait on. Without io_uring, file operations run when they are submitted.
+     * Socket operations are tried straight away and only wait when the socket
+     * would block; several on one socket run in the order they were submitted.
+     */
+    class Reactor {
+    public:
+        enum class Kind : uint8_t {
+            SLEEP,      // Settles with nil
+            READ,       // Up to max bytes from a socket; an empty read means the peer closed
+            WRITE,      // All of data to a socket; settles with the byte count
+            ACCEPT,     // Settles with the descriptor of the connection
+            CONNECT,    // Settles once the socket's connect finishes
+            READ_FILE,  // A whole regular file
+            WRITE_FILE  // data to a regular file; settles with the byte count
+        };
+
+        struct Completion {
+            PomeTask* task;
+            Kind kind;
+            bool failed = false;
+            std::string data;  // What was read, or the error message
+            int64_t count = 0; // Bytes written, or the descriptor accepted
+        };
+
+        Reactor();
+        ~Reactor();
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        void sleep(PomeTask* task, double seconds);
+        void read(PomeTask* task, int fd, size_t max);
+        void write(PomeTask* task, int fd, std::string data);
+        void accept(PomeTask* task, int fd);
+        // fd is a non-blocking socket whose connect() has been started
+        void connect(PomeTask* task, int fd);
+        // The reactor owns fd from here on and closes it once the file is done
+        void readFile(PomeTask* task, int fd);
+        void writeFile(PomeTask* task, int fd, std::string data);
+        // Fails the operations waiting on fd, before its owner closes it
+        void cancel(int fd, const std::string& reason);
+
+        bool hasPending() const { return !ops_.empty() || !ready_.empty(); }
+        bool usesIoUring() const { return ring_ != nullptr; }
+        // Appends what has finished. With block set, first waits in the kernel
+        // until something finishes or an isolate pool job does.
+        void poll(bool block, std::vector<Completion>& done);
+        void markTasks(GarbageCollector& gc) const;
+
+    private:
+        struct Op;
+        struct Ring;
+        struct Watch {
+            std::deque<Op*> readers; // ACCEPT and READ, oldest first
+            std::deque<Op*> writers; // CONNECT and WRITE
+            uint32_t events = 0;     // Registered with epoll
+        };
+        struct Deadline {
+            int64_t at; // CLOCK_MONOTONIC nanoseconds
+            uint64_t id;
+            bool operator>(const Deadline& other) const { return at > other.at; }
+        };
+
+        Op* start(PomeTask* task, Kind kind, int fd);
+        // Removes op and queues its completion
+        void finish(Op* op, bool failed, std::string data, int64_t count = 0);
+        void fail(Op* op, int error);
+        // Runs the socket operations at the front of fd's queues until one would
+        // block; events is what epoll reported for fd, or 0 when trying eagerly
+        void drive(int fd, uint32_t events);
+        // False when op would block
+        bool attempt(Op* op, uint32_t events);
+        void watch(int fd, Op* op, bool writer);
+        void updateWatch(int fd);
+        void armTimer();
+        void expireTimers();
+        void submitFile(Op* op);
+        void runFileSync(Op* op);
+        void reapRing();
+
+        int epoll_ = -1;
+        int timer_ = -1;
+        int wake_ = -1;
+        std::unique_ptr<Ring> ring_;
+        uint64_t nextId_ = 1;
+        std::unordered_map<uint64_t, std::unique_ptr<Op>> ops_;
+        std::unordered_map<int, Watch> watches_;
+        std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+        int64_t armedAt_ = 0; // Deadline the timerfd is set for; 0 when disarmed
+        std::vector<Completion> ready_;
+    };
+
+} // namespace Pome
+
+#endif // POME_REACTOR_H
@@ -3,17 +3,31 @@
 
 #include "pome_base.h"
 #include <unordered_map>
+#include <memory>
 #include <string>
 
 namespace Pome {
 
+    // key -> slot for a run of shapes along one transition chain
+    using PropertyIndex = std::unordered_map<PomeValue, int>;
+
     class PomeShape : public PomeObject {
     public:
+        // Chains at least this long get a hash index instead of a parent walk
+        static constexpr int INDEX_THRESHOLD = 8;
+        // Tables past either limit stop creating shapes and switch to dictionary mode
+        static constexpr int MAX_TABLE_PROPERTIES = 128;
+        static constexpr size_t MAX_TABLE_TRANSITIONS = 32;
+
         PomeShape* parent;
         PomeValue propertyKey;
         int propertyIndex;
         std::unordered_map<PomeValue, PomeShape*> transitions;
 
+        // Shared with descendants that extend this chain linearly. Entries with
+        // a slot greater than propertyIndex belong to descendants and are ignored.
+        std::shared_ptr<PropertyIndex> index;
+
         PomeShape(PomeShape* parent, PomeValue key, int index)
             : parent(parent), propertyKey(key), propertyIndex(index) {}
 
@@ -23,6 +37,15 @@ namespace Pome {
 
         PomeShape* transition(GarbageCollector& gc, PomeValue key);
         int getIndex(PomeValue key);
+        // Builds the index getIndex would otherwise build on first use, for shapes that must not change
+        // once shared (frozen values)
+        void ensureIndex() {
+            if (!index && propertyIndex + 1 >= INDEX_THRESHOLD) buildIndex();
+        }
+        PomeShape* root();
+
+    private:
+        void buildIndex();
     };
 
 } // namespace Pome
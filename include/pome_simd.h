@@ -0,0 +1,46 @@
+#ifndef POME_SIMD_H
+#define POME_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Pome {
+
+    /**
+     * Vector kernels over unboxed list storage.
+     *
+     * Each call goes through a table picked once per process: AVX2 when the
+     * CPU has it (x86-64), NEON on AArch64, and plain loops otherwise. Floating
+     * point sums and dot products add in several lanes, so their rounding can
+     * differ from a left-to-right loop in the last bits.
+     */
+    namespace Simd {
+
+        // "avx2", "neon" or "scalar"
+        const char* isa();
+
+        double sum(const double* data, size_t count);
+        double sum(const int32_t* data, size_t count); // Exact: lanes widen to 64 bits
+        void addScalar(double* data, size_t count, double scalar);
+        void addScalar(int32_t* data, size_t count, int32_t scalar); // Wraps on overflow
+        void scale(double* data, size_t count, double factor);
+        void add(double* out, const double* a, const double* b, size_t count);
+        void mul(double* out, const double* a, const double* b, size_t count);
+        double dot(const double* a, const double* b, size_t count);
+        void fill(double* data, size_t count, double value);
+        void fill(int32_t* data, size_t count, int32_t value);
+        void widen(double* out, const int32_t* data, size_t count);
+
+        // count must be at least 1; ties go to the first index
+        double min(const double* data, size_t count);
+        double max(const double* data, size_t count);
+        size_t argmax(const double* data, size_t count);
+        int32_t min(const int32_t* data, size_t count);
+        int32_t max(const int32_t* data, size_t count);
+        size_t argmax(const int32_t* data, size_t count);
+
+    } // namespace Simd
+
+} // namespace Pome
+
+#endif // POME_SIMD_H
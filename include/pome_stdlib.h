@@ -6,6 +6,8 @@
 
 namespace Pome
 {
+    class VM;
+
     namespace StdLib
     {
 
@@ -34,6 +36,11 @@ namespace Pome
          */
         PomeModule* createTimeModule(GarbageCollector& gc);
 
+        /**
+         * Creates and returns the 'net' module
+         */
+        PomeModule* createNetModule(GarbageCollector& gc);
+
         /**
          * Creates and returns the 'list' module
          */
@@ -49,6 +56,33 @@ namespace Pome
          */
         PomeModule* createFFIModule(GarbageCollector& gc);
 
+        /**
+         * Creates and returns the 'json' module
+         */
+        PomeModule* createJsonModule(GarbageCollector& gc);
+
+        /**
+         * Creates and returns the 'buffer' module
+         */
+        PomeModule* createBufferModule(GarbageCollector& gc);
+
+        /**
+         * Registers the global functions every VM has (print, len, push, tonumber, type) and PI
+         */
+        void registerBuiltins(VM& vm);
+
+        /**
+         * Writes values separated by spaces plus a newline to stdout in one call.
+         * Output goes through stdio's buffer: flushed per line on a terminal, in
+         * blocks when redirected, and always at exit.
+         */
+        void printLine(const PomeValue* values, size_t count);
+
+        /**
+         * Flushes buffered print output, e.g. before writing to stderr or reading stdin
+         */
+        void flushOutput();
+
     }
 }
 
@@ -0,0 +1,60 @@
+#ifndef POME_STRING_POOL_H
+#define POME_STRING_POOL_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace Pome {
+
+    class PomeString;
+
+    /**
+     * The collector's intern pool: one PomeString per distinct value.
+     *
+     * An open-addressed table of (hash, string) pairs probed linearly. The
+     * strings are the keys, so their bytes are stored once, and the hash each
+     * string caches is all a probe or a resize needs. Erased entries leave a
+     * tombstone until the next resize.
+     */
+    class StringPool {
+    public:
+        PomeString* find(std::string_view value, size_t hash) const;
+        // str must be a plain string (no builder or slice) whose value is not in the pool yet
+        void insert(PomeString* str);
+        // Removes str itself, not another string with the same value
+        void erase(PomeString* str);
+        // Removes every string for which drop(str) is true
+        template<typename Pred>
+        void eraseIf(Pred drop) {
+            for (Slot& slot : slots_) {
+                if (slot.str && slot.str != TOMBSTONE && drop(slot.str)) {
+                    slot.str = TOMBSTONE;
+                    --size_;
+                    ++tombstones_;
+                }
+            }
+        }
+
+        size_t size() const { return size_; }
+
+    private:
+        struct Slot {
+            size_t hash = 0;
+            PomeString* str = nullptr;
+        };
+
+        static constexpr size_t MIN_CAPACITY = 64;
+        static inline PomeString* const TOMBSTONE = reinterpret_cast<PomeString*>(1);
+
+        std::vector<Slot> slots_;
+        size_t size_ = 0;
+        size_t tombstones_ = 0;
+
+        // Kept at most half full, tombstones included
+        void grow();
+    };
+
+} // namespace Pome
+
+#endif // POME_STRING_POOL_H
@@ -3,25 +3,105 @@
 
 #include "pome_gc.h"
 #include <unordered_map>
+#include <deque>
+#include <memory>
+#include <string_view>
 
 namespace Pome
 {
     /**
      * String Object
+     *
+     * Plain strings own their bytes. Two kinds borrow them until something needs
+     * the contents as a std::string, and then copy them out (flatten):
+     * builders, a range of a buffer shared with the strings they were concatenated
+     * from, and slices, a range of a plain string they keep alive as a GC child.
      */
     class PomeString : public PomeObject
     {
     public:
         explicit PomeString(std::string value);
+        PomeString(std::string value, size_t hash);
+        // A builder: length bytes of buffer from offset, charged to the collector for charged bytes
+        PomeString(std::shared_ptr<std::string> buffer, size_t offset, size_t length, size_t charged);
+        // A slice of source, sharing its buffer or its plain parent
+        PomeString(const PomeString *source, size_t offset, size_t length);
+
         ObjectType type() const override { return ObjectType::STRING; }
-        std::string toString() const override { return value_; }
-        const std::string &getValue() const { return value_; }
-        size_t extraSize() const { return value_.capacity(); }
-        size_t getHash() const { return hash_; }
+        std::string toString() const override { return std::string(view()); }
+        void markChildren(GarbageCollector &gc) override;
+
+        const std::string &getValue() const
+        {
+            if (borrowed_) flatten();
+            return value_;
+        }
+        // The contents without flattening; valid until the shared buffer is next appended to
+        std::string_view view() const
+        {
+            if (!borrowed_) return value_;
+            if (borrowed_->buffer) return std::string_view(*borrowed_->buffer).substr(borrowed_->offset, borrowed_->length);
+            return std::string_view(borrowed_->parent->value_).substr(borrowed_->offset, borrowed_->length);
+        }
+        size_t length() const { return borrowed_ ? borrowed_->length : value_.size(); }
+        // Bytes kept alive by this string: its own, or all of the buffer or parent it borrows from
+        size_t backingLength() const
+        {
+            if (!borrowed_) return value_.size();
+            return borrowed_->buffer ? borrowed_->buffer->size() : borrowed_->parent->value_.size();
+        }
+        // Borrowed strings are charged only for what they added, as the rest belongs to another string
+        size_t extraSize() const { return borrowed_ ? sizeof(Borrowed) + borrowed_->charged : value_.capacity(); }
+        size_t getHash() const
+        {
+            if (!hashed_)
+            {
+                hash_ = std::hash<std::string_view>{}(view());
+                hashed_ = true;
+            }
+            return hash_;
+        }
+
+        bool isPlain() const { return !borrowed_; }
+        // The buffer, when this string runs to its end and so may be appended to in place
+        const std::shared_ptr<std::string> &extensibleBuffer() const
+        {
+            static const std::shared_ptr<std::string> none;
+            if (!borrowed_ || !borrowed_->buffer) return none;
+            return borrowed_->offset + borrowed_->length == borrowed_->buffer->size() ? borrowed_->buffer : none;
+        }
+        size_t bufferOffset() const { return borrowed_ ? borrowed_->offset : 0; }
+        void appendTo(std::string &out) const { out.append(view()); }
+
+        // Set by the collector for the one string per value in its intern pool.
+        // Interned strings are equal only to themselves; any other pair compares contents.
+        bool interned = false;
+        static bool equals(const PomeString *a, const PomeString *b)
+        {
+            if (a == b) return true;
+            // Each heap interns its own copy, so only strings of one heap compare by address
+            if (a->interned && b->interned && a->heapId == b->heapId) return false;
+            return a->view() == b->view();
+        }
 
     private:
-        std::string value_;
-        size_t hash_;
+        // Where a builder or slice finds its bytes: buffer when shared, parent otherwise
+        struct Borrowed
+        {
+            std::shared_ptr<std::string> buffer;
+            const PomeString *parent = nullptr;
+            size_t offset = 0;
+            size_t length = 0;
+            size_t charged = 0;
+        };
+
+        void flatten() const;
+
+        mutable std::string value_;
+        mutable size_t hash_ = 0;
+        mutable bool hashed_ = false;
+        // Kept out of line, as most strings are plain
+        mutable std::unique_ptr<Borrowed> borrowed_;
     };
 
     /**
@@ -71,15 +151,33 @@ namespace Pome
         explicit NativeFunction(std::string name, NativeFn func)
             : name_(std::move(name)), function_(std::move(func)) {}
 
+        // Fast native: arity is the minimum argument count (-1 for variadic)
+        NativeFunction(std::string name, FastNativeFn fn, int arity,
+                       NativeIntrinsic intrinsic = NativeIntrinsic::NONE)
+            : name_(std::move(name)), fast_(fn), arity_(arity), intrinsic_(intrinsic) {}
+
+        // Fast native that finds data through ctx.callee, which it keeps alive
+        NativeFunction(std::string name, FastNativeFn fn, int arity, std::shared_ptr<void> data)
+            : name_(std::move(name)), fast_(fn), arity_(arity), data_(std::move(data)) {}
+
         ObjectType type() const override { return ObjectType::NATIVE_FUNCTION; }
         std::string toString() const override { return "<native fn " + name_ + ">"; }
 
         PomeValue call(const std::vector<PomeValue> &args);
+        PomeValue call(NativeContext &ctx, const PomeValue *args, int argc);
         const std::string &getName() const { return name_; }
+        FastNativeFn fast() const { return fast_; }
+        int arity() const { return arity_; }
+        NativeIntrinsic intrinsic() const { return intrinsic_; }
+        void* data() const { return data_.get(); }
 
     private:
         std::string name_;
         NativeFn function_;
+        FastNativeFn fast_ = nullptr;
+        int arity_ = -1;
+        NativeIntrinsic intrinsic_ = NativeIntrinsic::NONE;
+        std::shared_ptr<void> data_;
     };
 
     /**
@@ -88,7 +186,8 @@ namespace Pome
     enum class ListType : uint8_t {
         MIXED,
         DOUBLE,
-        INT32
+        INT32,
+        BOOL // One byte per element, 0 or 1
     };
 
     /**
@@ -119,10 +218,175 @@ namespace Pome
         void push(GarbageCollector& gc, PomeValue val);
         
         void switchTo(ListType newType);
-        
+
+        size_t size() const { return isUnboxed() ? unboxedCount : elements.size(); }
+        // Element i boxed as a value; i must be below size()
+        PomeValue at(size_t i) const;
+        static size_t elementSize(ListType type);
+
+        // Vector kernels (pome_simd.h) on unboxed storage, element by element otherwise.
+        // Non-numbers count as 0 in sum and are left alone by addScalar
+        double sum() const;
+        void addScalar(double scalar);
+
         // Inline accessors for speed
         double* asDouble() const { return (double*)unboxedData; }
         int32_t* asInt32() const { return (int32_t*)unboxedData; }
+        uint8_t* asBool() const { return (uint8_t*)unboxedData; }
+    };
+
+    /**
+     * Bytes behind one or more buffers: zeroed memory from the C heap, or a
+     * file mapped with mmap. Shared by the buffer that created them and every
+     * view of it, and released with the last one.
+     */
+    struct BufferStorage {
+        uint8_t* bytes;
+        size_t length;
+        bool mapped;   // munmap rather than free
+        bool writable; // False for files mapped read-only
+
+        BufferStorage(uint8_t* b, size_t len, bool m, bool w) : bytes(b), length(len), mapped(m), writable(w) {}
+        ~BufferStorage();
+        BufferStorage(const BufferStorage&) = delete;
+        BufferStorage& operator=(const BufferStorage&) = delete;
+
+        // nullptr when the memory is not available
+        static std::shared_ptr<BufferStorage> allocate(size_t length);
+        // nullptr with errno set when the file cannot be opened or mapped; writes to a writable map reach the file
+        static std::shared_ptr<BufferStorage> map(const std::string& path, bool writable);
+    };
+
+    enum class BufferType : uint8_t {
+        U8,
+        I32,
+        F64
+    };
+
+    /**
+     * Buffer Object: a typed array over BufferStorage
+     */
+    class PomeBuffer : public PomeObject
+    {
+    public:
+        std::shared_ptr<BufferStorage> storage;
+        size_t offset;          // Byte offset of element 0 in storage
+        size_t count;           // Elements
+        BufferType elementType;
+        bool charged;           // Counts storage's heap bytes towards the collector; views and maps do not
+
+        PomeBuffer(std::shared_ptr<BufferStorage> s, BufferType type, size_t byteOffset, size_t elements, bool charge)
+            : storage(std::move(s)), offset(byteOffset), count(elements), elementType(type), charged(charge) {}
+
+        ObjectType type() const override { return ObjectType::BUFFER; }
+        std::string toString() const override;
+        size_t extraSize() const override { return charged && !storage->mapped ? storage->length : 0; }
+
+        static size_t elementSize(BufferType type) {
+            return type == BufferType::U8 ? 1 : type == BufferType::I32 ? sizeof(int32_t) : sizeof(double);
+        }
+        static const char* typeName(BufferType type);
+        // "u8", "i32" or "f64"
+        static bool parseType(std::string_view name, BufferType& type);
+
+        uint8_t* data() const { return storage->bytes + offset; }
+        size_t byteLength() const { return count * elementSize(elementType); }
+        bool writable() const { return storage->writable; }
+
+        // Views may start at any byte, so elements are copied rather than dereferenced in place
+        PomeValue get(size_t i) const {
+            const uint8_t* p = data() + i * elementSize(elementType);
+            if (elementType == BufferType::U8) return PomeValue((double)*p);
+            if (elementType == BufferType::I32) {
+                int32_t v;
+                std::memcpy(&v, p, sizeof(v));
+                return PomeValue((double)v);
+            }
+            double d;
+            std::memcpy(&d, p, sizeof(d));
+            return PomeValue(d);
+        }
+
+        // Integer types keep the low bits of the truncated number
+        void set(size_t i, double number) {
+            uint8_t* p = data() + i * elementSize(elementType);
+            if (elementType == BufferType::F64) {
+                std::memcpy(p, &number, sizeof(number));
+                return;
+            }
+            int64_t whole = number > -9.2e18 && number < 9.2e18 ? (int64_t)number : 0; // NaN and overflow store 0
+            if (elementType == BufferType::U8) {
+                *p = (uint8_t)whole;
+            } else {
+                int32_t v = (int32_t)whole;
+                std::memcpy(p, &v, sizeof(v));
+            }
+        }
+    };
+
+    /**
+     * File Object: an open file read and written through a stdio buffer
+     */
+    class PomeFile : public PomeObject
+    {
+    public:
+        static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+        std::string path;
+        bool closeAtEnd; // Opened by io.lines(path): closed once iteration reaches the end
+
+        PomeFile(FILE* handle, std::string p, bool autoClose = false);
+        ~PomeFile() override;
+
+        ObjectType type() const override { return ObjectType::FILE; }
+        std::string toString() const override { return "<file " + path + ">"; }
+        size_t extraSize() const override { return BUFFER_SIZE; } // The stdio buffer
+
+        FILE* handle() const { return handle_; }
+        bool isOpen() const { return handle_ != nullptr; }
+        // The next line without its line break; false at the end of the file or once closed
+        bool readLine(std::string_view& line);
+        void close();
+
+    private:
+        FILE* handle_;
+        char* line_ = nullptr; // getline's buffer, reused from one line to the next
+        size_t lineCapacity_ = 0;
+    };
+
+    /**
+     * Socket Object: a non-blocking TCP socket from the net module, closed once collected
+     */
+    class PomeSocket : public PomeObject
+    {
+    public:
+        explicit PomeSocket(int fd) : fd_(fd) {}
+        ~PomeSocket() override;
+
+        ObjectType type() const override { return ObjectType::SOCKET; }
+        std::string toString() const override { return fd_ >= 0 ? "<socket>" : "<closed socket>"; }
+
+        int fd() const { return fd_; }
+        bool isOpen() const { return fd_ >= 0; }
+        void close();
+
+    private:
+        int fd_;
+    };
+
+    /**
+     * Channel Object: one isolate's handle on a channel the isolates it reaches share
+     */
+    class Channel;
+
+    class PomeChannel : public PomeObject
+    {
+    public:
+        std::shared_ptr<Channel> channel;
+
+        explicit PomeChannel(std::shared_ptr<Channel> c) : channel(std::move(c)) {}
+        ObjectType type() const override { return ObjectType::CHANNEL; }
+        std::string toString() const override { return "<channel>"; }
     };
 
     /**
@@ -134,20 +398,53 @@ namespace Pome
         PomeShape* shape;
         std::vector<PomeValue> properties;
         std::unordered_map<PomeValue, PomeValue> backfill; 
+        bool isDictionary = false; // Keys live only in backfill; no further shape transitions
+
+        // Array part: integer keys 0..array.size()-1, nil marks an absent key
+        std::vector<PomeValue> array;
+        size_t arrayCount = 0;   // Non-nil slots in array
+        size_t hashIntKeys = 0;  // Non-negative integer keys currently in backfill
+        size_t rehashAt = 4;     // hashIntKeys value that triggers the next array resize check
 
         PomeTable(PomeShape* s);
 
         void set(GarbageCollector& gc, PomeValue key, PomeValue value);
+        void setField(GarbageCollector& gc, PomeValue key, PomeValue value); // Named store: may grow the shape
+        void enterDictionaryMode();
         PomeValue get(PomeValue key);
 
+        // Slot index for keys that are non-negative integers
+        static bool arrayIndex(PomeValue key, size_t& index) {
+            if (!key.isNumber()) return false;
+            double d = key.asNumber();
+            if (!(d >= 0.0 && d < 4294967296.0)) return false;
+            index = static_cast<size_t>(d);
+            return static_cast<double>(index) == d;
+        }
+
+        // Array-part slot holding key, or nullptr when key lives elsewhere
+        PomeValue* arraySlot(PomeValue key) {
+            size_t i;
+            if (arrayIndex(key, i) && i < array.size()) return &array[i];
+            return nullptr;
+        }
+
+        size_t count() const { return arrayCount + properties.size() + backfill.size(); }
+
         ObjectType type() const override { return ObjectType::TABLE; }
         std::string toString() const override;
         void markChildren(GarbageCollector& gc) override;
         std::vector<PomeValue> getSortedKeys() const;
         size_t extraSize() const {
             return properties.capacity() * sizeof(PomeValue) + 
+                   array.capacity() * sizeof(PomeValue) +
                    backfill.size() * (sizeof(PomeValue) * 2 + 16); // 16 bytes overhead for hash map entry
         }
+
+    private:
+        void setArraySlot(GarbageCollector& gc, size_t index, PomeValue value);
+        void migrateFromBackfill();
+        void rehashArray();
     };
 
     /**
@@ -190,6 +487,57 @@ namespace Pome
         void markChildren(GarbageCollector& gc) override;
     };
 
+    /**
+     * Global Variable Cell
+     * One module-level or VM-wide binding. Cells never move once created,
+     * so inline caches can hold a pointer to them.
+     */
+    struct GlobalCell {
+        PomeValue value;
+        bool defined = false; // false until the first store; reads of an undefined cell see nil
+    };
+
+    /**
+     * Name -> cell table backing VM globals and module variables
+     */
+    class GlobalTable
+    {
+    public:
+        GlobalCell* find(const PomeValue& key) {
+            auto it = index_.find(key);
+            return it != index_.end() ? it->second : nullptr;
+        }
+
+        // Existing cell for key, or a new undefined one
+        GlobalCell* intern(const PomeValue& key) {
+            auto it = index_.find(key);
+            if (it != index_.end()) return it->second;
+            key.incRef();
+            GlobalCell* cell = &cells_.emplace_back();
+            index_.emplace(key, cell);
+            return cell;
+        }
+
+        // Visits defined bindings only
+        template <typename Fn>
+        void forEach(Fn&& fn) const {
+            for (auto const& [key, cell] : index_) {
+                if (cell->defined) fn(key, cell->value);
+            }
+        }
+
+        void mark(GarbageCollector& gc) const {
+            for (auto const& [key, cell] : index_) {
+                key.mark(gc);
+                cell->value.mark(gc);
+            }
+        }
+
+    private:
+        std::deque<GlobalCell> cells_;
+        std::unordered_map<PomeValue, GlobalCell*> index_;
+    };
+
     /**
      * Module Object
      */
@@ -198,7 +546,7 @@ namespace Pome
     public:
         std::string scriptPath;
         std::unordered_map<PomeValue, PomeValue> exports;
-        std::unordered_map<PomeValue, PomeValue> variables;
+        GlobalTable variables;
 
         ObjectType type() const override { return ObjectType::MODULE; }
         std::string toString() const override { return "<module " + scriptPath + ">"; }
@@ -224,18 +572,36 @@ namespace Pome
     /**
      * Task Object
      */
+    struct ExecutionContext;
+    struct PoolJob;
+
+    enum class TaskState : uint8_t {
+        CREATED,   // Queued, no frames yet
+        RUNNING,
+        SUSPENDED, // Parked in AWAIT; context holds its frames and registers
+        COMPLETED,
+        FAILED     // result holds the uncaught exception
+    };
+
     class PomeTask : public PomeObject
     {
     public:
         PomeFunction* function;
         std::vector<PomeValue> args;
         PomeValue result;
-        bool isCompleted = false;
+        TaskState state = TaskState::CREATED;
+        std::unique_ptr<ExecutionContext> context; // Own coroutine stack while started and unfinished
+        std::vector<PomeTask*> waiters;            // Tasks to wake when this one finishes
+        std::shared_ptr<PoolJob> job;              // Set for a future of the isolate pool, which a worker finishes
 
-        explicit PomeTask(PomeFunction* f) : function(f) {}
+        explicit PomeTask(PomeFunction* f);
+        ~PomeTask() override;
         ObjectType type() const override { return ObjectType::TASK; }
         std::string toString() const override { return "<task>"; }
         void markChildren(GarbageCollector& gc) override;
+
+        bool isDone() const { return state == TaskState::COMPLETED || state == TaskState::FAILED; }
+        size_t extraSize() const;
     };
 
     /**
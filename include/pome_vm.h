@@ -2,30 +2,102 @@
 #define POME_VM_H
 
 #include "pome_chunk.h"
+#include "pome_jit.h"
 #include "pome_value.h"
 #include "pome_gc.h" 
 #include <vector>
 #include <map> 
 #include <unordered_map>
+#include <unordered_set>
 #include <functional>
 #include <deque>
+#include <memory>
 
 namespace Pome {
 
+    class Reactor;
+
     struct CallFrame {
         PomeFunction* function;
         PomeModule* module;
         Chunk* chunk;
         uint32_t* ip;
-        int base; // Index in stack where R0 for this frame starts
+        PomeValue* base; // Where R0 for this frame starts
+        int segment;     // RegisterStack segment holding the frame's window
         int destReg; // Register in PREVIOUS frame where result should be stored
         PomeTask* task = nullptr; // Task this frame belongs to (if any)
     };
 
-    struct ExceptionHandler {
-        int frameIdx;
-        uint32_t* catchIp;
-        int stackTop;
+    /**
+     * Register file built from segments that are never reallocated. Every
+     * frame's window of FRAME_WINDOW registers lies inside one segment; a call
+     * that would run past the end continues at the start of the next segment,
+     * carrying its callee and arguments along. Addresses stay valid for the
+     * lifetime of a frame, so open upvalues and native argument pointers can
+     * point straight into the stack.
+     */
+    class RegisterStack {
+    public:
+        static constexpr size_t FRAME_WINDOW = 256; // Registers addressable by one frame
+        static constexpr size_t MAX_SEGMENT = 65536;
+
+        RegisterStack() = default;
+        explicit RegisterStack(size_t firstSegment);
+
+        PomeValue* begin() const { return segments.empty() ? nullptr : segments[0].slots.get(); }
+
+        // Base for a frame starting at `base` in `segment`. Moves to the next
+        // segment (updating `segment`) when the window would not fit, copying
+        // the first `carry` registers.
+        PomeValue* window(PomeValue* base, int& segment, int carry) {
+            const Segment& seg = segments[segment];
+            if (base + FRAME_WINDOW <= seg.slots.get() + seg.size) return base;
+            return spill(base, segment, carry);
+        }
+
+        // True if `slot` belongs to a deeper frame than `last` (in `segment`)
+        bool isAbove(const PomeValue* slot, const PomeValue* last, int segment) const {
+            const Segment& seg = segments[segment];
+            if (slot >= seg.slots.get() && slot < seg.slots.get() + seg.size) return slot >= last;
+            return segmentOf(slot) > segment;
+        }
+
+        // Marks the live windows of the first `count` frames
+        void mark(GarbageCollector& gc, const CallFrame* frames, int count) const;
+        // Frees segments that no frame beyond `inUse` can reach
+        void trim(int inUse);
+        size_t memoryUsage() const;
+        size_t segmentCount() const { return segments.size(); }
+
+    private:
+        struct Segment {
+            std::unique_ptr<PomeValue[]> slots;
+            size_t size;
+        };
+
+        PomeValue* spill(PomeValue* base, int& segment, int carry);
+        int segmentOf(const PomeValue* slot) const;
+
+        std::vector<Segment> segments;
+    };
+
+    /**
+     * Everything a coroutine needs to stop and later continue: its register
+     * segment, call frames and open upvalues. Switching tasks
+     * moves these in and out of the VM, which never copies the contents.
+     */
+    struct ExecutionContext {
+        RegisterStack stack;
+        std::vector<CallFrame> frames;
+        int frameCount = 0;
+        PomeValue* stackTop = nullptr;
+        PomeUpvalue* openUpvalues = nullptr;
+
+        void mark(GarbageCollector& gc) const;
+        size_t memoryUsage() const {
+            return stack.memoryUsage() +
+                   frames.capacity() * sizeof(CallFrame);
+        }
     };
 
     class VMException : public std::exception {
@@ -34,9 +106,17 @@ namespace Pome {
         explicit VMException(PomeValue val) : value(val) {}
     };
 
+    // Number of GETFIELD/SETFIELD sites currently in each inline cache state
+    struct InlineCacheStats {
+        size_t monomorphic = 0;
+        size_t polymorphic = 0;
+        size_t megamorphic = 0;
+    };
+
     using ModuleLoader = std::function<PomeValue(const std::string&)>;
 
     class PomeUpvalue; // Added
+    class Profiler;
 
     class VM {
     public:
@@ -44,24 +124,125 @@ namespace Pome {
         ~VM();
 
         PomeValue interpret(Chunk* chunk, PomeModule* module = nullptr);
+        // Calls function with args on top of whatever this VM is running; errors propagate as VMException
+        PomeValue call(PomeFunction* function, const std::vector<PomeValue>& args);
         void registerNative(const std::string& name, NativeFn fn);
+        void registerFastNative(const std::string& name, FastNativeFn fn, int arity,
+                                NativeIntrinsic intrinsic = NativeIntrinsic::NONE);
         void registerGlobal(const std::string& name, PomeValue value);
+        // Throws message as a Pome error; natives use it too, and the nearest catch block gets it
+        void runtimeError(const std::string& message);
         
         void markRoots();
         GarbageCollector& getGC() { return gc; }
         PomeValue loadNativeModule(const std::string& libraryPath, PomeModule* moduleObj);
         void runEventLoop();
         PomeModule* getCurrentModule() const { return currentModule; }
+        size_t getSuspendedTaskCount() const { return suspendedTasks.size(); }
+        size_t getSuspendedTaskMemory() const;
+        size_t getReadyTaskCount() const { return taskQueue.size(); }
+        // A future whose job runs on the isolate pool; awaiting it, or the end of the event loop, waits for the job
+        void addJobTask(PomeTask* task) { jobTasks.push_back(task); }
+        size_t getJobTaskCount() const { return jobTasks.size(); }
+        // Timers and I/O that settle tasks, created on first use
+        Reactor& getReactor();
+        bool hasPendingIo() const;
         PomeShape* getRootShape() const { return rootShape; }
+        const InlineCacheStats& getInlineCacheStats() const { return icStats; }
+        // While set, execute() dispatches through the profiler's hook (and never enters the JIT)
+        void setProfiler(Profiler* p) { profiler = p; }
+        void setJitEnabled(bool on) { jitEnabled = on && Jit::supported(); }
+        // Calls may nest this deep before "Stack overflow". The frame array only grows as deep as calls
+        // actually go, so the limit costs nothing until it is reached.
+        static constexpr int DEFAULT_MAX_FRAMES = 200000;
+        void setMaxFrames(int count);
+        int getMaxFrames() const { return maxFrames; }
+        // Limit for VMs created afterwards, isolates included (set by --max-frames)
+        static void setDefaultMaxFrames(int count) { defaultMaxFrames = count > 0 ? count : DEFAULT_MAX_FRAMES; }
+        const JitStats& getJitStats() const { return jitStats; }
 
         bool hasError = false;
         PomeValue pendingException;
 
     private:
-        void runtimeError(const std::string& message);
+        friend class Jit; // Helpers called from machine code use the interpreter's caches and GC
+
+        static constexpr int TRACE_EDGE_FRAMES = 16;       // Innermost and outermost frames a deep trace shows
+        static constexpr size_t INITIAL_STACK = 16384;     // First register segment of a VM
+        static constexpr size_t INITIAL_FRAMES = 64;
+        static constexpr size_t TASK_INITIAL_STACK = 512;  // First register segment of a task
+        static constexpr size_t TASK_INITIAL_FRAMES = 8;
+        static constexpr int IO_POLL_INTERVAL = 64;        // Tasks resumed between looks at pending I/O
+
+        PomeValue execute(int initialFrameIdx);
+        // The dispatch loop; execute() only turns a native's VMException into an unwind
+        PomeValue run(int initialFrameIdx);
+        CallFrame* pushFrame() {
+            if (frameCount >= (int)frames.size()) growFrames();
+            return &frames[frameCount++];
+        }
+        // Pushes a frame whose R0 is `base`, an address in `segment`. The first
+        // `carry` registers (callee and arguments) follow it if the window spills.
+        CallFrame* pushFrameAt(PomeValue* base, int segment, int carry) {
+            if (frameCount >= (int)frames.size()) growFrames();
+            PomeValue* windowBase = stack.window(base, segment, carry);
+            CallFrame* frame = &frames[frameCount++];
+            frame->base = windowBase;
+            frame->segment = segment;
+            return frame;
+        }
+        void growFrames();
+
+        // Coroutine scheduling
+        void saveContext(ExecutionContext& ctx);
+        void loadContext(ExecutionContext& ctx);
+        void resumeTask(PomeTask* task);
+        void completeTask(PomeTask* task, PomeValue result, bool failed);
+        void runUntilComplete(PomeTask* task);
+        // Completes the job tasks whose jobs have finished; true if there were any
+        bool settleJobs();
+        // Blocks until at least one job task completes
+        void waitForJobs();
+        // Completes the tasks whose reactor operations have finished, after waiting for one if block is set
+        bool settleIo(bool block);
+        // Nothing is ready to run: blocks until a job or an operation completes
+        void waitForEvents();
+
         void throwException(PomeValue value);
-        PomeUpvalue* captureUpvalue(PomeValue* local); // Added
-        void closeUpvalues(PomeValue* last);           // Added
+        // The value runtimeError throws; prints a stack trace when nothing will catch it
+        PomeValue errorValue(const std::string& message);
+        // Whether some frame is inside a try block at its saved ip
+        bool canCatch() const;
+        // Pops frames above initialFrameIdx down to the innermost try block and points its
+        // frame at the catch block. False (frames untouched) when none covers the throw.
+        bool unwind(PomeValue exception, int initialFrameIdx);
+        PomeUpvalue* captureUpvalue(PomeValue* local, int segment);
+        void closeUpvalues(PomeValue* last, int segment);
+        bool addFieldCacheEntry(InstructionMetadata& meta, const FieldCacheEntry& entry);
+        // The link for the GETGLOBAL/SETGLOBAL at pc: in the chunk's metadata when this VM owns the chunk's
+        // links, otherwise in foreignLinks
+        GlobalLink& globalLink(Chunk& chunk, const Instruction* pc) {
+            if (chunk.globalOwner.load(std::memory_order_relaxed) == gc.getHeapId()) return chunk.cacheFor(pc).global;
+            return foreignGlobalLink(chunk, pc);
+        }
+        GlobalLink& foreignGlobalLink(Chunk& chunk, const Instruction* pc);
+        void linkGlobal(GlobalLink& link, const PomeValue& key);
+        bool globalLinked(const GlobalLink& link) const {
+            return link.globalCell && link.module == currentModule;
+        }
+        
+        // Baseline JIT: counts a call or back edge and compiles the chunk once it is hot
+        bool tierUp(Chunk& chunk);
+        // Runs frame's chunk as machine code from frame->ip; returns where the interpreter resumes
+        uint32_t* runJit(CallFrame* frame);
+
+        static inline int defaultMaxFrames = DEFAULT_MAX_FRAMES;
+        int maxFrames = defaultMaxFrames;
+
+        InlineCacheStats icStats;
+        Profiler* profiler = nullptr;
+        bool jitEnabled = Jit::supported();
+        JitStats jitStats;
         
         PomeShape* rootShape = nullptr; // Added
         
@@ -69,32 +250,42 @@ namespace Pome {
 
         GarbageCollector& gc; 
         ModuleLoader moduleLoader;
-        std::unordered_map<PomeValue, PomeValue> globals; 
+        GlobalTable globals; 
+        // Links for chunks whose globalOwner is another VM, by cache slot
+        struct ForeignLinks {
+            uint64_t serial = 0; // Chunk::serial of the chunk they were made for
+            std::vector<GlobalLink> links;
+        };
+        std::unordered_map<const Chunk*, ForeignLinks> foreignLinks;
         std::unordered_map<std::string, PomeValue> moduleCache;
         PomeModule* currentModule = nullptr;
         
-        std::vector<PomeValue> stack;
-        int stackTop = 0;
+        RegisterStack stack;
+        PomeValue* stackTop = nullptr;
         
         // Upvalues
         PomeUpvalue* openUpvalues = nullptr; // Added
 
         // Call Stack
-        CallFrame frames[8192];
+        std::vector<CallFrame> frames;
         int frameCount;
 
-        // Exception Handlers
-        std::vector<ExceptionHandler> handlers;
-
-        // Async Task Queue
-        std::deque<PomeTask*> taskQueue;
+        // Async Tasks
+        std::deque<PomeTask*> taskQueue;             // Ready to start or resume
+        std::unordered_set<PomeTask*> suspendedTasks; // Parked in AWAIT until woken
+        std::vector<ExecutionContext*> parkedContexts; // Contexts waiting on a running task
+        std::vector<PomeTask*> jobTasks;              // Futures whose pool jobs have not been settled yet
+        std::unique_ptr<Reactor> reactor;              // Settles the tasks of timers and I/O
+        PomeTask* activeTask = nullptr;
+        int activeTaskDepth = 0; // execute() nesting level that may suspend activeTask
+        int executeDepth = 0;
+        bool taskSuspended = false;
         
         // Native Function Arguments
         std::vector<PomeValue> args;
         
         // Active pointers for current frame (optimizations)
         uint32_t* ip;
-        int frameBase; 
     };
 
 }
@@ -7,6 +7,8 @@
 #include <chrono>
 #include <cmath>
 #include <algorithm> // Added for std::replace
+#include <filesystem>
+#include <unordered_set>
 
 #include "pome_lexer.h"
 #include "pome_parser.h"
@@ -14,6 +16,10 @@
 #include "pome_vm.h"
 #include "pome_chunk.h"
 #include "pome_stdlib.h" // Added for stdlib
+#include "pome_profiler.h"
+#include "pome_bytecode_cache.h"
+#include "pome_import_prescan.h"
+#include "pome_pool.h"
 #include "../include/pome_module_resolver.h" // Added for ModuleResolver
 #include "../include/pome_file_utils.hpp" // Added for FileUtils
 
@@ -112,22 +118,63 @@ namespace Pome {
     class VM;
 }
 Pome::VM* currentVM = nullptr;
+Pome::Profiler* activeProfiler = nullptr; // Set by --profile
+bool jitDisabled = false; // Set by --no-jit
+int optLevel = Pome::Optimizer::DEFAULT_LEVEL; // Set by -O0, -O1 or -O2
+bool bytecodeCacheDisabled = false; // Set by --no-cache
+bool importPrescanDisabled = false; // Set by --no-prescan
+
+// Served by the module loader without looking on disk
+const std::unordered_set<std::string> BUILTIN_MODULES = {
+    "math", "io", "string", "time", "list", "threading", "ffi", "system", "buffer", "net", "json"
+};
+
+// Compiles the source of the file at path, reading its .pomec instead when that is
+// fresh and writing one otherwise. Sources without a file (the REPL) always compile.
+std::unique_ptr<Pome::Chunk> compileSource(Pome::GarbageCollector& gc, const std::string& source,
+                                           const std::string& path) {
+    Pome::CacheKey key;
+    bool cacheable = !bytecodeCacheDisabled && !path.empty() && path != "<repl>" &&
+                     Pome::BytecodeCache::keyFor(path, source, optLevel, key);
+    if (cacheable) {
+        if (auto chunk = Pome::BytecodeCache::load(gc, path, key)) return chunk;
+    }
+
+    Pome::Lexer lexer(source);
+    Pome::Parser parser(lexer);
+    std::unique_ptr<Pome::Program> program = parser.parseProgram();
+    if (!program) return nullptr;
+
+    Pome::Compiler compiler(gc);
+    compiler.setOptimizationLevel(optLevel);
+    compiler.setErrorsThrow(true); // Reported like a parse error by the caller
+    auto chunk = compiler.compile(*program);
+    // A directory we cannot write to just means compiling again next time
+    if (cacheable) Pome::BytecodeCache::store(*chunk, path, key);
+    return chunk;
+}
 
 // --- CORE EXECUTION LOGIC ---
 
 bool executeSource(const std::string& source, const std::string& scriptPath = "") {
     try {
-        Pome::Lexer lexer(source);
-        Pome::Parser parser(lexer);
-        std::unique_ptr<Pome::Program> program = parser.parseProgram();
-        
-        if (program) {
-            Pome::GarbageCollector gc;
+        Pome::GarbageCollector gc;
+        std::unique_ptr<Pome::Chunk> chunk = compileSource(gc, source, scriptPath);
+
+        if (chunk) {
             Pome::ModuleResolver resolver;
             
             if (!scriptPath.empty() && scriptPath != "<repl>") {
                 resolver.addSearchPath(Pome::FileUtils::getDirectory(scriptPath));
             }
+
+            // Compile the module graph on worker threads while the script starts running
+            std::unique_ptr<Pome::ImportPrescan> prescan;
+            if (!importPrescanDisabled && !scriptPath.empty() && scriptPath != "<repl>") {
+                prescan = std::make_unique<Pome::ImportPrescan>(resolver, BUILTIN_MODULES, optLevel,
+                                                                !bytecodeCacheDisabled);
+                prescan->start(*chunk, scriptPath);
+            }
             
             Pome::ModuleLoader loader = [&](const std::string& moduleName) -> Pome::PomeValue {
                 // Built-in modules
@@ -139,6 +186,9 @@ bool executeSource(const std::string& source, const std::string& scriptPath = ""
                 if (moduleName == "threading") return Pome::PomeValue(Pome::StdLib::createThreadingModule(gc, loader));
                 if (moduleName == "ffi") return Pome::PomeValue(Pome::StdLib::createFFIModule(gc));
                 if (moduleName == "system") return Pome::PomeValue(Pome::StdLib::createSystemModule(gc));
+                if (moduleName == "buffer") return Pome::PomeValue(Pome::StdLib::createBufferModule(gc));
+                if (moduleName == "net") return Pome::PomeValue(Pome::StdLib::createNetModule(gc));
+                if (moduleName == "json") return Pome::PomeValue(Pome::StdLib::createJsonModule(gc));
 
                 extern Pome::VM* currentVM;
                 std::string originPath = "";
@@ -167,24 +217,21 @@ bool executeSource(const std::string& source, const std::string& scriptPath = ""
                          filePath += "/__init__.pome";
                      }
 
-                    std::ifstream mFile(filePath);
-                    if (!mFile.is_open()) return Pome::PomeValue();
-                    
-                    std::stringstream mBuffer;
-                    mBuffer << mFile.rdbuf();
-                    mFile.close();
-                    
-                    // 2. Parse
-                    Pome::Lexer mLexer(mBuffer.str());
-                    Pome::Parser mParser(mLexer);
-                    auto mProgram = mParser.parseProgram();
-                    if (!mProgram) return Pome::PomeValue();
-                    
-                    // 3. Compile
-                    Pome::Compiler mCompiler(gc);
-                    auto mChunk = mCompiler.compile(*mProgram);
+                    // 2. Take the chunk the prescan compiled, or compile (or load the cached chunk) now
+                    std::unique_ptr<Pome::Chunk> mChunk = prescan ? prescan->take(gc, filePath) : nullptr;
+                    if (!mChunk) {
+                        std::ifstream mFile(filePath);
+                        if (!mFile.is_open()) return Pome::PomeValue();
+
+                        std::stringstream mBuffer;
+                        mBuffer << mFile.rdbuf();
+                        mFile.close();
+
+                        mChunk = compileSource(gc, mBuffer.str(), filePath);
+                        if (!mChunk) return Pome::PomeValue();
+                    }
                     
-                    // 4. Execute in a new module object
+                    // 3. Execute in a new module object
                     Pome::PomeModule* moduleObj = gc.allocate<Pome::PomeModule>();
                     moduleObj->scriptPath = filePath;
                     
@@ -207,11 +254,10 @@ bool executeSource(const std::string& source, const std::string& scriptPath = ""
                 return Pome::PomeValue();
             };
 
-            Pome::Compiler compiler(gc);
-            auto chunk = compiler.compile(*program);
-            
             Pome::VM vm(gc, loader);
             gc.setVM(&vm);
+            if (activeProfiler) vm.setProfiler(activeProfiler);
+            if (jitDisabled) vm.setJitEnabled(false);
             
             // Set global VM pointer for the loader
             extern Pome::VM* currentVM;
@@ -221,60 +267,7 @@ bool executeSource(const std::string& source, const std::string& scriptPath = ""
             mainModule->scriptPath = scriptPath.empty() ? "<script>" : scriptPath;
 
             // Register Standard Functions
-            vm.registerGlobal("PI", Pome::PomeValue(3.141592653589793));
-            
-            vm.registerNative("print", [](const std::vector<Pome::PomeValue>& args) {
-                for (size_t i = 0; i < args.size(); ++i) {
-                    std::cout << args[i].toString();
-                    if (i < args.size() - 1) std::cout << " ";
-                }
-                std::cout << std::endl;
-                return Pome::PomeValue(std::monostate{});
-            });
-
-            vm.registerNative("len", [](const std::vector<Pome::PomeValue>& args) {
-                if (args.empty()) return Pome::PomeValue(0.0);
-                if (args[0].isString()) return Pome::PomeValue((double)args[0].asString().length());
-                if (args[0].isList()) {
-                    Pome::PomeList* lst = args[0].asList();
-                    return Pome::PomeValue((double)(lst->isUnboxed() ? lst->unboxedCount : lst->elements.size()));
-                }
-                if (args[0].isTable()) return Pome::PomeValue((double)(args[0].asTable()->properties.size() + args[0].asTable()->backfill.size()));
-                return Pome::PomeValue(0.0);
-            });
-
-            vm.registerNative("push", [&gc](const std::vector<Pome::PomeValue>& args) {
-                if (args.size() < 2 || !args[0].isList()) return Pome::PomeValue(std::monostate{});
-                Pome::PomeList* lst = args[0].asList();
-                size_t oldSize = lst->extraSize();
-                lst->push(gc, args[1]);
-                gc.updateSize(lst, sizeof(Pome::PomeList) + oldSize, sizeof(Pome::PomeList) + lst->extraSize());
-                gc.writeBarrier(lst, const_cast<Pome::PomeValue&>(args[1]));
-                return Pome::PomeValue(std::monostate{});
-            });
-
-            vm.registerNative("tonumber", [](const std::vector<Pome::PomeValue>& args) {
-                if (args.empty() || !args[0].isString()) return Pome::PomeValue(std::monostate{});
-                try {
-                    return Pome::PomeValue(std::stod(args[0].asString()));
-                } catch (...) {
-                    return Pome::PomeValue(std::monostate{});
-                }
-            });
-
-            vm.registerNative("type", [&gc](const std::vector<Pome::PomeValue>& args) {
-                if (args.empty()) return Pome::PomeValue(std::monostate{});
-                if (args[0].isNil()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("nil"));
-                if (args[0].isBool()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("boolean"));
-                if (args[0].isNumber()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("number"));
-                if (args[0].isString()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("string"));
-                if (args[0].isList()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("list"));
-                if (args[0].isTable()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("table"));
-                if (args[0].isClass()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("class"));
-                if (args[0].isInstance()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("instance"));
-                if (args[0].isFunction()) return Pome::PomeValue(gc.allocate<Pome::PomeString>("function"));
-                return Pome::PomeValue(gc.allocate<Pome::PomeString>("unknown"));
-            });
+            Pome::StdLib::registerBuiltins(vm);
 
             vm.registerNative("gc_count", [&gc](const std::vector<Pome::PomeValue>& args) {
                 return Pome::PomeValue((double)gc.getGCCount());
@@ -289,6 +282,43 @@ bool executeSource(const std::string& source, const std::string& scriptPath = ""
                 std::cout << "GC Info:" << std::endl;
                 std::cout << "  Total Cycles: " << gc.getGCCount() << std::endl;
                 std::cout << "  Objects:      " << gc.getObjectCount() << std::endl;
+                std::cout << "  Pause Target: " << gc.getPauseTarget() << " ms"
+                          << (gc.isCycleInProgress() ? " (cycle in progress)" : "") << std::endl;
+                std::cout << "  GC Threads:   " << gc.getGcThreads() << std::endl;
+                Pome::Nursery::Stats nursery = gc.getNurseryStats();
+                std::cout << "  Nursery:      " << nursery.reservedBytes / 1024 << " KB in blocks, "
+                          << nursery.liveBytes / 1024 << " KB live, " << nursery.cachedBytes / 1024 << " KB free slots"
+                          << std::endl;
+                std::cout << "  Slot Reuse:   " << static_cast<int>(nursery.reuseRate() * 100) << "%" << std::endl;
+                std::cout << "  Fragmented:   " << static_cast<int>(nursery.fragmentation() * 100) << "%" << std::endl;
+                return Pome::PomeValue(std::monostate{});
+            });
+
+            vm.registerNative("ic_info", [&vm](const std::vector<Pome::PomeValue>& args) {
+                const Pome::InlineCacheStats& stats = vm.getInlineCacheStats();
+                std::cout << "Inline Cache Info:" << std::endl;
+                std::cout << "  Monomorphic:  " << stats.monomorphic << std::endl;
+                std::cout << "  Polymorphic:  " << stats.polymorphic << std::endl;
+                std::cout << "  Megamorphic:  " << stats.megamorphic << std::endl;
+                return Pome::PomeValue(std::monostate{});
+            });
+
+            vm.registerNative("task_info", [&vm](const std::vector<Pome::PomeValue>& args) {
+                std::cout << "Task Info:" << std::endl;
+                std::cout << "  Ready:     " << vm.getReadyTaskCount() << std::endl;
+                std::cout << "  Suspended: " << vm.getSuspendedTaskCount() << std::endl;
+                std::cout << "  Memory:    " << vm.getSuspendedTaskMemory() / 1024 << " KB" << std::endl;
+                return Pome::PomeValue(std::monostate{});
+            });
+
+            vm.registerNative("jit_info", [&vm](const std::vector<Pome::PomeValue>& args) {
+                const Pome::JitStats& stats = vm.getJitStats();
+                std::cout << "JIT Info:" << std::endl;
+                std::cout << "  Supported:   " << (Pome::Jit::supported() ? "yes" : "no") << std::endl;
+                std::cout << "  Compiled:    " << stats.compiled << " chunks, " << stats.codeBytes << " bytes" << std::endl;
+                std::cout << "  Entries:     " << stats.entries << std::endl;
+                std::cout << "  Guard exits: " << stats.guardExits << std::endl;
+                std::cout << "  Discarded:   " << stats.discarded << std::endl;
                 return Pome::PomeValue(std::monostate{});
             });
 
@@ -296,9 +326,13 @@ bool executeSource(const std::string& source, const std::string& scriptPath = ""
 
             Pome::PomeValue result = vm.interpret(chunk.get(), mainModule);
             if (vm.hasError) return false;
+            // Tasks nobody awaited still run to completion before exit
+            vm.runEventLoop();
+            if (vm.hasError) return false;
         }
         return true;
     } catch (const std::exception& e) {
+        Pome::StdLib::flushOutput();
         std::cerr << RED << "Error: " << RESET << e.what() << std::endl;
         return false;
     }
@@ -339,11 +373,123 @@ int runFile(const std::string& path) {
 
 void printUsage() {
     std::cout << "Usage: pome [script]" << std::endl;
+    std::cout << "   Or: pome --profile[=out.folded] <script>" << std::endl;
+    std::cout << "   Or: pome --no-jit <script>" << std::endl;
+    std::cout << "   Or: pome -O0|-O1|-O2 <script>  (default -O2)" << std::endl;
+    std::cout << "   Or: pome --no-cache <script>  (skip .pomec bytecode caches)" << std::endl;
+    std::cout << "   Or: pome compile <file|dir>   (write .pomec caches ahead of time)" << std::endl;
+    std::cout << "   Or: pome --no-prescan <script>  (compile imports only when they run)" << std::endl;
+    std::cout << "   Or: pome --gc-pause=<ms> <script>  (major GC slice length, default 5; 0 stops the world)" << std::endl;
+    std::cout << "   Or: pome --gc-threads=<n> <script>  (GC mark/sweep threads for large heaps, default one per core)" << std::endl;
+    std::cout << "   Or: pome --gc-trace[=json|csv] <script>  (one line per GC pause on stderr)" << std::endl;
+    std::cout << "   Or: pome --max-frames=<n> <script>  (call depth before \"Stack overflow\", default 200000)" << std::endl;
+    std::cout << "   Or: pome --workers=<n> <script>  (threads in the threading pool, default one per core)" << std::endl;
     std::cout << "   Or: pome --version" << std::endl;
 }
 
+// Runs a script under the profiler, writing folded stacks for flamegraph.pl
+// and an opcode/rewrite summary on stderr
+int runProfiled(const std::string& path, const std::string& foldedPath) {
+    Pome::Profiler profiler;
+    activeProfiler = &profiler;
+    profiler.start();
+    int status = runFile(path);
+    profiler.stop();
+    activeProfiler = nullptr;
+
+    std::ofstream folded(foldedPath);
+    if (!folded.is_open()) {
+        std::cerr << "Could not write profile to '" << foldedPath << "'." << std::endl;
+        return 74;
+    }
+    profiler.writeFolded(folded);
+    Pome::StdLib::flushOutput();
+    profiler.writeSummary(std::cerr);
+    std::cerr << "Folded stacks written to " << foldedPath << std::endl;
+    return status;
+}
+
+// Writes the .pomec cache of every .pome file under path, without running any of them
+int compileTree(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> sources;
+    std::error_code ec;
+    if (fs::is_directory(path, ec)) {
+        for (fs::recursive_directory_iterator it(path, ec), end; it != end; it.increment(ec)) {
+            if (it->is_regular_file(ec) && it->path().extension() == ".pome") sources.push_back(it->path().string());
+        }
+        std::sort(sources.begin(), sources.end());
+    } else {
+        sources.push_back(path);
+    }
+
+    int failed = 0;
+    for (const std::string& source : sources) {
+        std::ifstream file(source);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file '" << source << "'." << std::endl;
+            ++failed;
+            continue;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string text = buffer.str();
+
+        Pome::CacheKey key;
+        try {
+            Pome::GarbageCollector gc;
+            Pome::Lexer lexer(text);
+            Pome::Parser parser(lexer);
+            auto program = parser.parseProgram();
+            if (!program || !Pome::BytecodeCache::keyFor(source, text, optLevel, key)) {
+                throw std::runtime_error("could not compile");
+            }
+            Pome::Compiler compiler(gc);
+            compiler.setOptimizationLevel(optLevel);
+            compiler.setErrorsThrow(true);
+            auto chunk = compiler.compile(*program);
+            if (!Pome::BytecodeCache::store(*chunk, source, key)) {
+                throw std::runtime_error("could not write " + Pome::BytecodeCache::cachePath(source));
+            }
+        } catch (const std::exception& e) {
+            std::cerr << RED << "Error: " << RESET << source << ": " << e.what() << std::endl;
+            ++failed;
+        }
+    }
+    std::cout << "Compiled " << (sources.size() - failed) << " of " << sources.size() << " files" << std::endl;
+    return failed ? 65 : 0;
+}
+
 // --- MAIN ---
 int main(int argc, char* argv[]) {
+    // -O<level>, --no-cache, --no-prescan, --max-frames, --workers and the --gc-* options may appear anywhere; the remaining arguments dispatch as usual
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            optLevel = arg[2] - '0';
+        } else if (arg == "--no-cache") {
+            bytecodeCacheDisabled = true;
+        } else if (arg == "--no-prescan") {
+            importPrescanDisabled = true;
+        } else if (arg.rfind("--gc-pause=", 0) == 0) {
+            Pome::GarbageCollector::setDefaultPauseTarget(std::atof(arg.c_str() + 11));
+        } else if (arg.rfind("--gc-threads=", 0) == 0) {
+            Pome::GarbageCollector::setDefaultGcThreads(std::atoi(arg.c_str() + 13));
+        } else if (arg.rfind("--max-frames=", 0) == 0) {
+            Pome::VM::setDefaultMaxFrames(std::atoi(arg.c_str() + 13));
+        } else if (arg.rfind("--workers=", 0) == 0) {
+            Pome::IsolatePool::setDefaultWorkerCount(std::atoi(arg.c_str() + 10));
+        } else if (arg == "--gc-trace" || arg == "--gc-trace=json") {
+            Pome::GarbageCollector::setDefaultTrace(Pome::GarbageCollector::TraceFormat::JSON);
+        } else if (arg == "--gc-trace=csv") {
+            Pome::GarbageCollector::setDefaultTrace(Pome::GarbageCollector::TraceFormat::CSV);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
     if (argc == 1) {
         runPrompt();
     } 
@@ -360,17 +506,30 @@ int main(int argc, char* argv[]) {
     else if (argc == 3) {
         std::string arg1 = argv[1];
         std::string arg2 = argv[2];
+        if (arg1 == "--profile" || arg1.rfind("--profile=", 0) == 0) {
+            std::string out = arg1.size() > 10 ? arg1.substr(10) : "pome.folded";
+            return runProfiled(arg2, out);
+        }
+        if (arg1 == "--no-jit") {
+            jitDisabled = true;
+            return runFile(arg2);
+        }
+        if (arg1 == "compile") {
+            return compileTree(arg2);
+        }
         if (arg1 == "-d") {
             std::ifstream file(arg2);
             if (!file.is_open()) return 74;
             std::stringstream buffer;
             buffer << file.rdbuf();
+            std::string source = buffer.str();
             Pome::GarbageCollector gc;
-            Pome::Lexer lexer(buffer.str());
+            Pome::Lexer lexer(source);
             Pome::Parser parser(lexer);
             auto program = parser.parseProgram();
             if (!program) return 65;
             Pome::Compiler compiler(gc);
+            compiler.setOptimizationLevel(optLevel);
             auto chunk = compiler.compile(*program);
             Pome::disassembleChunk(*chunk, arg2.c_str());
             return 0;
@@ -0,0 +1,511 @@
+// Microbenchmarks of the VM's subsystems, measured in-process against libpome.
+//
+//   pome-bench [--list] [--filter text] [--reps N] [--save file.json]
+//              [--baseline file.json] [--threshold percent]
+//
+// Each benchmark does its own setup, then times only the work it measures and
+// reports the cost of one operation: a byte of source, a loop iteration, an
+// allocation, a collection. It runs once to warm up and then --reps times
+// (10 by default); the median, mean, spread and best of the repetitions are
+// printed. --save writes them as JSON. Given a file saved earlier with
+// --baseline, every benchmark is compared with it, and one whose median is
+// more than --threshold percent (10 by default) slower counts as a
+// regression: they are listed and the exit status is 1.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "pome_compiler.h"
+#include "pome_gc.h"
+#include "pome_lexer.h"
+#include "pome_parser.h"
+#include "pome_stdlib.h"
+#include "pome_value.h"
+#include "pome_vm.h"
+
+using namespace Pome;
+using Clock = std::chrono::steady_clock;
+
+static constexpr int DEFAULT_REPS = 10;
+static constexpr double DEFAULT_THRESHOLD = 10.0; // Percent
+static constexpr size_t SOURCE_BYTES = 1024 * 1024;
+// Less for the compiler, whose constant pool search grows with the number of top-level names
+static constexpr size_t COMPILE_BYTES = 256 * 1024;
+static constexpr int LOOP_ITERATIONS = 2000000;
+static constexpr int BASELINE_VERSION = 1;
+
+// One timed repetition: how long the measured part took and how many operations it did
+struct Sample {
+    double seconds;
+    size_t operations;
+};
+
+struct Benchmark {
+    std::string name;
+    const char* unit; // What one operation is
+    std::function<Sample()> run;
+};
+
+struct Result {
+    std::string name;
+    std::string unit;
+    double medianNs, meanNs, stddevNs, minNs;
+};
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// ---- Front end ----
+
+// A script of about bytes mixing functions, classes, loops and literals
+static std::string benchSource(size_t bytes) {
+    std::string source;
+    for (int i = 0; source.size() < bytes; ++i) {
+        std::string n = std::to_string(i);
+        source += "fun compute_" + n + "(a, b) {\n"
+                  "    var total = 0;\n"
+                  "    for (var i = 0; i < a; i = i + 1) {\n"
+                  "        if (i % 3 == 0 and b > 2) { total = total + i * b; } else { total = total - 1.5; }\n"
+                  "    }\n"
+                  "    return total > 100 ? \"big_" + n + "\" : [total, a, b, {\"key\": \"value\\n\"}];\n"
+                  "}\n"
+                  "class Shape_" + n + " {\n"
+                  "    fun init(w, h) { this.w = w; this.h = h; }\n"
+                  "    fun area() { return this.w * this.h; }\n"
+                  "}\n"
+                  "var shape_" + n + " = Shape_" + n + "(" + n + ", 2);\n";
+    }
+    return source;
+}
+
+static Sample lexSource() {
+    static const std::string source = benchSource(SOURCE_BYTES);
+    auto start = Clock::now();
+    Lexer lexer(source);
+    while (lexer.getNextToken().type != TokenType::END_OF_FILE) {
+    }
+    return {secondsSince(start), source.size()};
+}
+
+static Sample parseSource() {
+    static const std::string source = benchSource(SOURCE_BYTES);
+    auto start = Clock::now();
+    Lexer lexer(source);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+    return {secondsSince(start), source.size()};
+}
+
+static Sample compileSource() {
+    static const std::string source = benchSource(COMPILE_BYTES);
+    Lexer lexer(source);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+    GarbageCollector gc;
+    Compiler compiler(gc);
+    compiler.setErrorsThrow(true);
+    auto start = Clock::now();
+    auto chunk = compiler.compile(*program);
+    return {secondsSince(start), source.size()};
+}
+
+// ---- Interpreter ----
+
+// Runs body LOOP_ITERATIONS times inside a function after setup, so their variables are
+// registers; prelude holds the imports, functions and classes they use
+static Sample runLoop(const std::string& prelude, const std::string& setup, const std::string& body, bool jit) {
+    std::string source = prelude + "\nfun bench(n) {\n    var x = 0;\n    " + setup + "\n"
+                         "    for (var i = 0; i < n; i = i + 1) { " + body + " }\n"
+                         "    return x;\n}\nbench(" + std::to_string(LOOP_ITERATIONS) + ");\n";
+    GarbageCollector gc;
+    ModuleLoader loader = [&gc](const std::string& name) {
+        if (name == "ffi") return PomeValue(StdLib::createFFIModule(gc));
+        return PomeValue();
+    };
+    VM vm(gc, loader);
+    gc.setVM(&vm);
+    vm.setJitEnabled(jit);
+    StdLib::registerBuiltins(vm);
+    vm.registerNative("slow_identity", [](const std::vector<PomeValue>& args) {
+        return args.empty() ? PomeValue() : args[0];
+    });
+
+    Lexer lexer(source);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+    Compiler compiler(gc);
+    compiler.setErrorsThrow(true);
+    auto chunk = compiler.compile(*program);
+    PomeModule* module = gc.allocate<PomeModule>();
+    module->scriptPath = "<bench>";
+
+    auto start = Clock::now();
+    vm.interpret(chunk.get(), module);
+    return {secondsSince(start), static_cast<size_t>(LOOP_ITERATIONS)};
+}
+
+// ---- Collector ----
+
+// count lists of elements numbers each, held by a rooted list
+static PomeList* liveLists(GarbageCollector& gc, size_t count, size_t elements) {
+    PomeList* outer = gc.allocateList();
+    gc.addTemporaryRoot(outer);
+    for (size_t i = 0; i < count; ++i) {
+        PomeList* inner = gc.allocateList();
+        outer->elements.push_back(PomeValue(inner));
+        for (size_t e = 0; e < elements; ++e) inner->elements.push_back(PomeValue(static_cast<double>(e)));
+    }
+    return outer;
+}
+
+static Sample allocateTables() {
+    static constexpr size_t COUNT = 200000;
+    GarbageCollector gc;
+    PomeShape* root = gc.getRootShape();
+    auto start = Clock::now();
+    for (size_t i = 0; i < COUNT; ++i) gc.allocate<PomeTable>(root);
+    return {secondsSince(start), COUNT};
+}
+
+static Sample allocateStrings() {
+    static constexpr size_t COUNT = 200000;
+    GarbageCollector gc;
+    std::vector<std::string> texts;
+    for (size_t i = 0; i < COUNT; ++i) texts.push_back("string " + std::to_string(i));
+    auto start = Clock::now();
+    for (const std::string& text : texts) gc.allocateString(text);
+    return {secondsSince(start), COUNT};
+}
+
+// A minor collection of a nursery where one object in ten survives
+static Sample minorCollection() {
+    static constexpr size_t LIVE = 10000;
+    GarbageCollector gc;
+    gc.setGcThreads(1);
+    PomeList* outer = liveLists(gc, LIVE, 0);
+    for (size_t i = 0; i < LIVE * 9; ++i) gc.allocateList();
+    auto start = Clock::now();
+    gc.collect(true);
+    double seconds = secondsSince(start);
+    gc.removeTemporaryRoot(outer);
+    return {seconds, 1};
+}
+
+// A full major collection of an old heap of lists
+static Sample majorCollection() {
+    static constexpr size_t LIVE = 100000;
+    GarbageCollector gc;
+    gc.setGcThreads(1);
+    PomeList* outer = liveLists(gc, LIVE, 4);
+    gc.collect(true);
+    gc.collect(true);
+    for (size_t i = 0; i < LIVE; ++i) gc.allocateList();
+    auto start = Clock::now();
+    gc.collect(false);
+    double seconds = secondsSince(start);
+    gc.removeTemporaryRoot(outer);
+    return {seconds, 1};
+}
+
+// ---- Shapes ----
+
+static std::vector<PomeValue> shapeKeys(GarbageCollector& gc, size_t count) {
+    std::vector<PomeValue> keys;
+    for (size_t i = 0; i < count; ++i) {
+        PomeString* key = gc.allocateString("field_" + std::to_string(i));
+        gc.addTemporaryRoot(key);
+        keys.push_back(PomeValue(key));
+    }
+    return keys;
+}
+
+// Adding keys to fresh tables along transitions that already exist
+static Sample shapeTransitions() {
+    static constexpr size_t TABLES = 20000;
+    static constexpr size_t KEYS = 8;
+    GarbageCollector gc;
+    std::vector<PomeValue> keys = shapeKeys(gc, KEYS);
+    PomeList* holder = gc.allocateList();
+    gc.addTemporaryRoot(holder);
+    std::vector<PomeTable*> tables;
+    for (size_t t = 0; t < TABLES; ++t) {
+        tables.push_back(gc.allocate<PomeTable>(gc.getRootShape()));
+        holder->elements.push_back(PomeValue(tables.back()));
+    }
+    // The first table mints the shapes; the timed ones only follow them
+    for (const PomeValue& key : keys) tables[0]->setField(gc, key, PomeValue(1.0));
+    auto start = Clock::now();
+    for (size_t t = 1; t < TABLES; ++t) {
+        for (const PomeValue& key : keys) tables[t]->setField(gc, key, PomeValue(1.0));
+    }
+    return {secondsSince(start), (TABLES - 1) * KEYS};
+}
+
+// Finding keys of a table with enough of them to have a shape index
+static Sample shapeLookups() {
+    static constexpr size_t KEYS = 32;
+    static constexpr size_t ROUNDS = 50000;
+    GarbageCollector gc;
+    std::vector<PomeValue> keys = shapeKeys(gc, KEYS);
+    PomeTable* table = gc.allocate<PomeTable>(gc.getRootShape());
+    gc.addTemporaryRoot(table);
+    for (size_t i = 0; i < KEYS; ++i) table->setField(gc, keys[i], PomeValue(static_cast<double>(i)));
+    double sum = 0;
+    auto start = Clock::now();
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        for (const PomeValue& key : keys) sum += table->get(key).asNumber();
+    }
+    double seconds = secondsSince(start);
+    if (sum < 0) std::cout << sum; // Keeps the lookups from being optimised away
+    return {seconds, ROUNDS * KEYS};
+}
+
+// ---- deepCopy ----
+
+// Copying records {id, name, tags, child} into another heap, as isolates do
+static Sample deepCopyRecords() {
+    static constexpr size_t RECORDS = 5000;
+    GarbageCollector source;
+    PomeList* records = source.allocateList();
+    source.addTemporaryRoot(records);
+    PomeValue id = PomeValue(source.allocateString("id"));
+    PomeValue name = PomeValue(source.allocateString("name"));
+    PomeValue tags = PomeValue(source.allocateString("tags"));
+    PomeValue child = PomeValue(source.allocateString("child"));
+    for (size_t i = 0; i < RECORDS; ++i) {
+        PomeTable* record = source.allocate<PomeTable>(source.getRootShape());
+        records->elements.push_back(PomeValue(record));
+        record->setField(source, id, PomeValue(static_cast<double>(i)));
+        record->setField(source, name, PomeValue(source.allocateString("user " + std::to_string(i))));
+        PomeList* list = source.allocateList();
+        record->setField(source, tags, PomeValue(list));
+        for (int t = 0; t < 4; ++t) list->elements.push_back(PomeValue(static_cast<double>(t)));
+        PomeTable* inner = source.allocate<PomeTable>(source.getRootShape());
+        record->setField(source, child, PomeValue(inner));
+        inner->setField(source, id, PomeValue(static_cast<double>(i)));
+    }
+
+    GarbageCollector target;
+    std::map<PomeObject*, PomeObject*> copied;
+    auto start = Clock::now();
+    PomeValue copy = PomeValue(records).deepCopy(target, copied);
+    double seconds = secondsSince(start);
+    (void)copy;
+    return {seconds, copied.size()};
+}
+
+static std::vector<Benchmark> benchmarks() {
+    std::vector<Benchmark> list = {
+        {"frontend.lex", "byte", lexSource},
+        {"frontend.parse", "byte", parseSource},
+        {"frontend.compile", "byte", compileSource},
+    };
+
+    // Per-opcode dispatch: the interpreter only, so the loop itself is the reference
+    struct LoopCase {
+        const char* name;
+        const char* prelude;
+        const char* setup;
+        const char* body;
+    };
+    const LoopCase loops[] = {
+        {"loop", "", "", ""},
+        {"add", "", "", "x = x + i;"},
+        {"mul_div", "", "", "x = i * 3 / 2;"},
+        {"compare", "", "", "if (i < 0) x = 1;"},
+        {"global", "var g = 0;", "", "g = g + 1;"},
+        {"get_field", "", "var t = {\"a\": 1, \"b\": 2};", "x = t.b;"},
+        {"set_field", "", "var t = {\"a\": 1, \"b\": 2};", "t.b = i;"},
+        {"get_index", "", "var l = [1, 2, 3, 4];", "x = l[2];"},
+        {"set_index", "", "var l = [1, 2, 3, 4];", "l[2] = i;"},
+        {"call", "fun id(v) { return v; }", "var f = id;", "x = f(i);"},
+        {"method", "class C { fun get() { return 1; } }", "var c = C();", "x = c.get();"},
+        {"concat", "", "", "x = \"a\" + \"b\";"},
+    };
+    for (const LoopCase& loop : loops) {
+        std::string prelude = loop.prelude, setup = loop.setup, body = loop.body;
+        list.push_back({std::string("dispatch.") + loop.name, "iteration",
+                        [prelude, setup, body] { return runLoop(prelude, setup, body, false); }});
+    }
+    list.push_back({"jit.loop", "iteration", [] { return runLoop("", "", "", true); }});
+    list.push_back({"jit.add", "iteration", [] { return runLoop("", "", "x = x + i;", true); }});
+
+    list.push_back({"native.fast", "iteration", [] { return runLoop("", "var l = [1];", "x = len(l);", false); }});
+    list.push_back({"native.slow", "iteration", [] { return runLoop("", "", "x = slow_identity(i);", false); }});
+    list.push_back({"native.ffi_bind", "iteration", [] {
+        return runLoop("import ffi;", "var abs = ffi.bind(ffi.get(ffi.load(\"libc.so.6\"), \"abs\"), \"int(int)\");",
+                       "x = abs(i);", false);
+    }});
+
+    list.push_back({"gc.alloc_table", "object", allocateTables});
+    list.push_back({"gc.alloc_string", "object", allocateStrings});
+    list.push_back({"gc.minor", "collection", minorCollection});
+    list.push_back({"gc.major", "collection", majorCollection});
+    list.push_back({"shape.transition", "store", shapeTransitions});
+    list.push_back({"shape.lookup", "lookup", shapeLookups});
+    list.push_back({"isolate.deep_copy", "object", deepCopyRecords});
+    return list;
+}
+
+// ---- Harness ----
+
+static Result measure(const Benchmark& benchmark, int reps) {
+    benchmark.run(); // Warm-up: caches, page faults, the shared intern pool of the source
+    std::vector<double> ns;
+    for (int rep = 0; rep < reps; ++rep) {
+        Sample sample = benchmark.run();
+        ns.push_back(sample.seconds * 1e9 / std::max<size_t>(sample.operations, 1));
+    }
+    std::sort(ns.begin(), ns.end());
+    Result result{benchmark.name, benchmark.unit, 0, 0, 0, ns.front()};
+    size_t mid = ns.size() / 2;
+    result.medianNs = ns.size() % 2 ? ns[mid] : (ns[mid - 1] + ns[mid]) / 2;
+    for (double value : ns) result.meanNs += value;
+    result.meanNs /= ns.size();
+    for (double value : ns) result.stddevNs += (value - result.meanNs) * (value - result.meanNs);
+    result.stddevNs = ns.size() > 1 ? std::sqrt(result.stddevNs / (ns.size() - 1)) : 0;
+    return result;
+}
+
+// ns with a unit that keeps 3 to 4 significant digits
+static std::string formatNs(double ns) {
+    std::ostringstream out;
+    out << std::fixed;
+    if (ns < 10) out << std::setprecision(2) << ns << " ns";
+    else if (ns < 1e4) out << std::setprecision(1) << ns << " ns";
+    else if (ns < 1e7) out << std::setprecision(1) << ns / 1e3 << " us";
+    else out << std::setprecision(1) << ns / 1e6 << " ms";
+    return out.str();
+}
+
+static bool loadBaseline(const std::string& path, std::map<std::string, double>& medians) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Could not open baseline '" << path << "'." << std::endl;
+        return false;
+    }
+    try {
+        nlohmann::json baseline = nlohmann::json::parse(file);
+        if (baseline.value("version", 0) != BASELINE_VERSION) {
+            std::cerr << "Baseline '" << path << "' is from another version of pome-bench." << std::endl;
+            return false;
+        }
+        for (auto& [name, entry] : baseline.at("benchmarks").items()) medians[name] = entry.at("median_ns");
+    } catch (const nlohmann::json::exception& e) {
+        std::cerr << "Could not read baseline '" << path << "': " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool saveResults(const std::string& path, const std::vector<Result>& results, int reps) {
+    nlohmann::json saved;
+    saved["version"] = BASELINE_VERSION;
+    saved["reps"] = reps;
+    nlohmann::json& entries = saved["benchmarks"];
+    for (const Result& result : results) {
+        entries[result.name] = {{"unit", result.unit},
+                                {"median_ns", result.medianNs},
+                                {"mean_ns", result.meanNs},
+                                {"stddev_ns", result.stddevNs},
+                                {"min_ns", result.minNs}};
+    }
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Could not write '" << path << "'." << std::endl;
+        return false;
+    }
+    file << saved.dump(2) << std::endl;
+    return true;
+}
+
+static void usage() {
+    std::cerr << "Usage: pome-bench [--list] [--filter text] [--reps N] [--save file.json]\n"
+                 "                  [--baseline file.json] [--threshold percent]"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter, savePath, baselinePath;
+    int reps = DEFAULT_REPS;
+    double threshold = DEFAULT_THRESHOLD;
+    bool listOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--list") listOnly = true;
+        else if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--reps" && hasValue) reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--save" && hasValue) savePath = argv[++i];
+        else if (arg == "--baseline" && hasValue) baselinePath = argv[++i];
+        else if (arg == "--threshold" && hasValue) threshold = std::atof(argv[++i]);
+        else {
+            usage();
+            return 64;
+        }
+    }
+
+    std::vector<Benchmark> selected;
+    for (Benchmark& benchmark : benchmarks()) {
+        if (filter.empty() || benchmark.name.find(filter) != std::string::npos) selected.push_back(benchmark);
+    }
+    if (listOnly) {
+        for (const Benchmark& benchmark : selected) std::cout << benchmark.name << std::endl;
+        return 0;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !loadBaseline(baselinePath, baseline)) return 66;
+
+    std::cout << std::left << std::setw(20) << "benchmark" << std::right << std::setw(12) << "median" << std::setw(8)
+              << "+/-" << std::setw(12) << "best" << "  " << std::left << std::setw(10) << "per" << std::right;
+    if (!baseline.empty()) std::cout << std::setw(10) << "baseline";
+    std::cout << std::endl;
+
+    std::vector<Result> results;
+    std::vector<std::string> regressions;
+    for (const Benchmark& benchmark : selected) {
+        Result result = measure(benchmark, reps);
+        results.push_back(result);
+        std::ostringstream spread;
+        spread << std::fixed << std::setprecision(1) << (result.meanNs > 0 ? result.stddevNs / result.meanNs * 100 : 0)
+               << "%";
+        std::cout << std::left << std::setw(20) << result.name << std::right << std::setw(12)
+                  << formatNs(result.medianNs) << std::setw(8) << spread.str() << std::setw(12)
+                  << formatNs(result.minNs) << "  " << std::left << std::setw(10) << result.unit << std::right;
+        auto base = baseline.find(result.name);
+        if (base != baseline.end() && base->second > 0) {
+            double change = (result.medianNs / base->second - 1) * 100;
+            std::ostringstream delta;
+            delta << std::showpos << std::fixed << std::setprecision(1) << change << "%";
+            std::cout << std::setw(10) << delta.str();
+            if (change > threshold) {
+                std::cout << "  REGRESSED";
+                regressions.push_back(result.name);
+            }
+        } else if (!baseline.empty()) {
+            std::cout << std::setw(10) << "new";
+        }
+        std::cout << std::endl;
+    }
+
+    if (!savePath.empty() && !saveResults(savePath, results, reps)) return 73;
+    if (!regressions.empty()) {
+        std::cout << regressions.size() << " benchmark(s) more than " << threshold << "% slower than the baseline:";
+        for (const std::string& name : regressions) std::cout << " " << name;
+        std::cout << std::endl;
+        return 1;
+    }
+    return 0;
+}
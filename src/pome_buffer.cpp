@@ -0,0 +1,74 @@
+#include "../include/pome_value.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Pome {
+
+    BufferStorage::~BufferStorage() {
+        if (!bytes) return;
+        if (mapped) munmap(bytes, length);
+        else free(bytes);
+    }
+
+    std::shared_ptr<BufferStorage> BufferStorage::allocate(size_t length) {
+        // calloc hands large requests fresh zero pages, so an untouched buffer costs no memory
+        uint8_t* bytes = static_cast<uint8_t*>(calloc(length ? length : 1, 1));
+        if (!bytes) return nullptr;
+        return std::make_shared<BufferStorage>(bytes, length, false, true);
+    }
+
+    std::shared_ptr<BufferStorage> BufferStorage::map(const std::string& path, bool writable) {
+        int fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return nullptr;
+        }
+        size_t length = static_cast<size_t>(info.st_size);
+        if (length == 0) {
+            // mmap rejects empty ranges; an empty file is an empty buffer
+            close(fd);
+            return std::make_shared<BufferStorage>(nullptr, 0, true, writable);
+        }
+        void* bytes = mmap(nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        int saved = errno;
+        close(fd); // The mapping keeps the file open
+        if (bytes == MAP_FAILED) {
+            errno = saved;
+            return nullptr;
+        }
+        // Scans are the common case; let the kernel read ahead aggressively
+        madvise(bytes, length, MADV_SEQUENTIAL);
+        return std::make_shared<BufferStorage>(static_cast<uint8_t*>(bytes), length, true, writable);
+    }
+
+    const char* PomeBuffer::typeName(BufferType type) {
+        switch (type) {
+            case BufferType::U8: return "u8";
+            case BufferType::I32: return "i32";
+            case BufferType::F64: return "f64";
+        }
+        return "u8";
+    }
+
+    bool PomeBuffer::parseType(std::string_view name, BufferType& type) {
+        if (name == "u8") type = BufferType::U8;
+        else if (name == "i32") type = BufferType::I32;
+        else if (name == "f64") type = BufferType::F64;
+        else return false;
+        return true;
+    }
+
+    std::string PomeBuffer::toString() const {
+        return "<buffer " + std::string(typeName(elementType)) + "[" + std::to_string(count) + "]>";
+    }
+
+} // namespace Pome
@@ -0,0 +1,369 @@
+#include "pome_bytecode_cache.h"
+#include "pome_gc.h"
+#include "pome_value.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace Pome {
+
+    namespace {
+
+        // Tag of each serialized constant
+        enum class ConstantKind : uint8_t { NIL, BOOL_FALSE, BOOL_TRUE, NUMBER, STRING, FUNCTION, CLASS, OBJECT_REF };
+
+        uint64_t fnv1a(const std::string& text) {
+            uint64_t hash = 14695981039346656037ULL;
+            for (unsigned char c : text) {
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        class Writer {
+        public:
+            explicit Writer(std::vector<uint8_t>& out) : out(out) {}
+
+            template <typename T>
+            void raw(T value) {
+                const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+                out.insert(out.end(), bytes, bytes + sizeof(T));
+            }
+
+            void string(const std::string& s) {
+                raw<uint32_t>(static_cast<uint32_t>(s.size()));
+                out.insert(out.end(), s.begin(), s.end());
+            }
+
+            bool chunk(const Chunk& chunk) {
+                raw<uint32_t>(static_cast<uint32_t>(chunk.maxRegisters));
+                raw<uint32_t>(static_cast<uint32_t>(chunk.code.size()));
+                for (size_t i = 0; i < chunk.code.size(); ++i) {
+                    raw<uint32_t>(chunk.code[i]);
+                    raw<int32_t>(chunk.lines[i]);
+                }
+                raw<uint32_t>(static_cast<uint32_t>(chunk.constants.size()));
+                for (const PomeValue& constant : chunk.constants) {
+                    if (!value(constant)) return false;
+                }
+                raw<uint32_t>(static_cast<uint32_t>(chunk.handlers.size()));
+                for (const ExceptionRange& range : chunk.handlers) {
+                    raw<uint32_t>(range.start);
+                    raw<uint32_t>(range.end);
+                    raw<uint32_t>(range.target);
+                }
+                raw<uint32_t>(static_cast<uint32_t>(chunk.inlinedCalls.size()));
+                for (const InlinedCall& call : chunk.inlinedCalls) {
+                    raw<uint32_t>(call.start);
+                    raw<uint32_t>(call.end);
+                    raw<int32_t>(call.callLine);
+                    string(call.name);
+                }
+                return true;
+            }
+
+        private:
+            std::vector<uint8_t>& out;
+            std::unordered_map<PomeObject*, uint32_t> written; // Functions and classes, by definition order
+
+            // Writes a reference if obj was already defined; otherwise assigns its index
+            bool reference(PomeObject* obj) {
+                auto it = written.find(obj);
+                if (it != written.end()) {
+                    raw<uint8_t>(static_cast<uint8_t>(ConstantKind::OBJECT_REF));
+                    raw<uint32_t>(it->second);
+                    return true;
+                }
+                uint32_t index = static_cast<uint32_t>(written.size());
+                written[obj] = index;
+                return false;
+            }
+
+            bool value(PomeValue v) {
+                if (v.isNil()) {
+                    raw<uint8_t>(static_cast<uint8_t>(ConstantKind::NIL));
+                } else if (v.isBool()) {
+                    raw<uint8_t>(static_cast<uint8_t>(v.isTrue() ? ConstantKind::BOOL_TRUE : ConstantKind::BOOL_FALSE));
+                } else if (v.isNumber()) {
+                    raw<uint8_t>(static_cast<uint8_t>(ConstantKind::NUMBER));
+                    raw<double>(v.asNumber());
+                } else if (v.isString()) {
+                    raw<uint8_t>(static_cast<uint8_t>(ConstantKind::STRING));
+                    string(v.asString());
+                } else if (v.isPomeFunction()) {
+                    PomeFunction* func = v.asPomeFunction();
+                    if (reference(func)) return true;
+                    raw<uint8_t>(static_cast<uint8_t>(ConstantKind::FUNCTION));
+                    string(func->name);
+                    raw<uint32_t>(static_cast<uint32_t>(func->parameters.size()));
+                    for (const std::string& param : func->parameters) string(param);
+                    raw<uint8_t>(func->isAsync ? 1 : 0);
+                    raw<uint16_t>(func->upvalueCount);
+                    if (!value(func->klass ? PomeValue(func->klass) : PomeValue())) return false;
+                    return chunk(*func->chunk);
+                } else if (v.isClass()) {
+                    PomeClass* klass = v.asClass();
+                    if (reference(klass)) return true;
+                    // Superclasses and shapes are linked at run time; a prototype has neither yet
+                    if (klass->superclass || klass->classShape) return false;
+                    raw<uint8_t>(static_cast<uint8_t>(ConstantKind::CLASS));
+                    string(klass->name);
+                    raw<uint32_t>(static_cast<uint32_t>(klass->methods.size()));
+                    for (const auto& [name, method] : klass->methods) {
+                        string(name);
+                        if (!value(PomeValue(method))) return false;
+                    }
+                    raw<uint32_t>(static_cast<uint32_t>(klass->fieldNames.size()));
+                    for (const auto& [name, slot] : klass->fieldNames) {
+                        string(name);
+                        raw<uint8_t>(slot);
+                    }
+                } else {
+                    return false;
+                }
+                return true;
+            }
+        };
+
+        class Reader {
+        public:
+            Reader(GarbageCollector& gc, const uint8_t* data, size_t size) : gc(gc), at(data), end(data + size) {}
+
+            ~Reader() {
+                for (auto it = rooted.rbegin(); it != rooted.rend(); ++it) gc.removeTemporaryRoot(*it);
+            }
+
+            Reader(const Reader&) = delete;
+            Reader& operator=(const Reader&) = delete;
+
+            template <typename T>
+            T raw() {
+                if (static_cast<size_t>(end - at) < sizeof(T)) throw std::runtime_error("truncated cache file");
+                T value;
+                std::memcpy(&value, at, sizeof(T));
+                at += sizeof(T);
+                return value;
+            }
+
+            std::string string() {
+                uint32_t size = raw<uint32_t>();
+                if (static_cast<size_t>(end - at) < size) throw std::runtime_error("truncated cache file");
+                std::string s(reinterpret_cast<const char*>(at), size);
+                at += size;
+                return s;
+            }
+
+            void chunk(Chunk& chunk) {
+                chunk.maxRegisters = static_cast<int>(raw<uint32_t>());
+                uint32_t codeSize = count(sizeof(uint32_t) * 2);
+                chunk.code.reserve(codeSize);
+                chunk.lines.reserve(codeSize);
+                for (uint32_t i = 0; i < codeSize; ++i) {
+                    Instruction instruction = raw<uint32_t>();
+                    if (Chunk::getOpCode(instruction) >= OpCode::OP_COUNT) throw std::runtime_error("bad opcode");
+                    chunk.write(instruction, raw<int32_t>());
+                }
+                uint32_t constantCount = count(1);
+                chunk.constants.reserve(constantCount);
+                for (uint32_t i = 0; i < constantCount; ++i) chunk.constants.push_back(value());
+                uint32_t handlerCount = count(sizeof(uint32_t) * 3);
+                for (uint32_t i = 0; i < handlerCount; ++i) {
+                    ExceptionRange range;
+                    range.start = raw<uint32_t>();
+                    range.end = raw<uint32_t>();
+                    range.target = raw<uint32_t>();
+                    chunk.handlers.push_back(range);
+                }
+                uint32_t inlinedCount = count(sizeof(uint32_t) * 4);
+                for (uint32_t i = 0; i < inlinedCount; ++i) {
+                    InlinedCall call;
+                    call.start = raw<uint32_t>();
+                    call.end = raw<uint32_t>();
+                    call.callLine = raw<int32_t>();
+                    call.name = string();
+                    chunk.inlinedCalls.push_back(std::move(call));
+                }
+            }
+
+        private:
+            GarbageCollector& gc;
+            const uint8_t* at;
+            const uint8_t* end;
+            std::vector<PomeObject*> objects; // Functions and classes, by definition order
+            std::vector<PomeObject*> rooted;  // Everything allocated so far; the chunk is not reachable yet
+
+            // An element count, checked against the bytes left so a corrupt file cannot ask for huge vectors
+            uint32_t count(size_t minElementSize) {
+                uint32_t n = raw<uint32_t>();
+                if (n > static_cast<size_t>(end - at) / minElementSize) throw std::runtime_error("bad count");
+                return n;
+            }
+
+            PomeObject* root(PomeObject* obj) {
+                gc.addTemporaryRoot(obj);
+                rooted.push_back(obj);
+                return obj;
+            }
+
+            void define(PomeObject* obj) {
+                objects.push_back(root(obj));
+            }
+
+            PomeValue value() {
+                switch (static_cast<ConstantKind>(raw<uint8_t>())) {
+                    case ConstantKind::NIL: return PomeValue();
+                    case ConstantKind::BOOL_FALSE: return PomeValue(false);
+                    case ConstantKind::BOOL_TRUE: return PomeValue(true);
+                    case ConstantKind::NUMBER: return PomeValue(raw<double>());
+                    case ConstantKind::STRING: return PomeValue(root(gc.allocateString(string())));
+                    case ConstantKind::OBJECT_REF: {
+                        uint32_t index = raw<uint32_t>();
+                        if (index >= objects.size()) throw std::runtime_error("bad object reference");
+                        return PomeValue(objects[index]);
+                    }
+                    case ConstantKind::FUNCTION: {
+                        PomeFunction* func = gc.allocate<PomeFunction>();
+                        define(func);
+                        func->name = string();
+                        uint32_t paramCount = count(sizeof(uint32_t));
+                        for (uint32_t i = 0; i < paramCount; ++i) func->parameters.push_back(string());
+                        func->isAsync = raw<uint8_t>() != 0;
+                        func->upvalueCount = raw<uint16_t>();
+                        PomeValue klass = value();
+                        if (!klass.isNil() && !klass.isClass()) throw std::runtime_error("bad method class");
+                        func->klass = klass.isNil() ? nullptr : klass.asClass();
+                        chunk(*func->chunk);
+                        return PomeValue(func);
+                    }
+                    case ConstantKind::CLASS: {
+                        PomeClass* klass = gc.allocate<PomeClass>(std::string());
+                        define(klass);
+                        klass->name = string();
+                        uint32_t methodCount = count(sizeof(uint32_t) + 1);
+                        for (uint32_t i = 0; i < methodCount; ++i) {
+                            std::string name = string();
+                            PomeValue method = value();
+                            if (!method.isPomeFunction()) throw std::runtime_error("bad method");
+                            klass->methods[name] = method.asPomeFunction();
+                        }
+                        uint32_t fieldCount = count(sizeof(uint32_t) + 1);
+                        for (uint32_t i = 0; i < fieldCount; ++i) {
+                            std::string name = string();
+                            klass->fieldNames[name] = raw<uint8_t>();
+                        }
+                        return PomeValue(klass);
+                    }
+                }
+                throw std::runtime_error("bad constant tag");
+            }
+        };
+
+        void writeHeader(Writer& writer, const CacheKey& key) {
+            writer.raw<uint32_t>(BytecodeCache::MAGIC);
+            writer.raw<uint32_t>(BytecodeCache::FORMAT_VERSION);
+            writer.raw<uint32_t>(static_cast<uint32_t>(OpCode::OP_COUNT));
+            writer.raw<uint32_t>(key.optLevel);
+            writer.raw<uint64_t>(key.sourceSize);
+            writer.raw<int64_t>(key.sourceMtime);
+            writer.raw<uint64_t>(key.sourceHash);
+        }
+
+        bool headerMatches(Reader& reader, const CacheKey& key) {
+            return reader.raw<uint32_t>() == BytecodeCache::MAGIC &&
+                   reader.raw<uint32_t>() == BytecodeCache::FORMAT_VERSION &&
+                   reader.raw<uint32_t>() == static_cast<uint32_t>(OpCode::OP_COUNT) &&
+                   reader.raw<uint32_t>() == key.optLevel &&
+                   reader.raw<uint64_t>() == key.sourceSize &&
+                   reader.raw<int64_t>() == key.sourceMtime &&
+                   reader.raw<uint64_t>() == key.sourceHash;
+        }
+
+    }
+
+    std::string BytecodeCache::cachePath(const std::string& sourcePath) {
+        const char* dir = std::getenv("POME_CACHE_DIR");
+        if (!dir || !*dir) return sourcePath + "c";
+        // One flat directory: the source path, with separators escaped, names the file
+        std::string name;
+        for (char c : sourcePath) {
+            if (c == '/' || c == '\\') name += "%2F";
+            else if (c == '%') name += "%25";
+            else name += c;
+        }
+        return std::string(dir) + "/" + name + "c";
+    }
+
+    bool BytecodeCache::keyFor(const std::string& sourcePath, const std::string& source, int optLevel, CacheKey& key) {
+        struct stat info;
+        if (stat(sourcePath.c_str(), &info) != 0) return false;
+        key.sourceSize = static_cast<uint64_t>(info.st_size);
+        key.sourceMtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        key.sourceHash = fnv1a(source);
+        key.optLevel = static_cast<uint32_t>(optLevel);
+        return key.sourceSize == source.size();
+    }
+
+    bool BytecodeCache::serialize(const Chunk& chunk, const CacheKey& key, std::vector<uint8_t>& out) {
+        out.clear();
+        Writer writer(out);
+        writeHeader(writer, key);
+        return writer.chunk(chunk);
+    }
+
+    std::unique_ptr<Chunk> BytecodeCache::deserialize(GarbageCollector& gc, const uint8_t* data, size_t size,
+                                                      const CacheKey& key) {
+        try {
+            Reader reader(gc, data, size);
+            if (!headerMatches(reader, key)) return nullptr;
+            auto chunk = std::make_unique<Chunk>();
+            reader.chunk(*chunk);
+            return chunk;
+        } catch (const std::runtime_error&) {
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<Chunk> BytecodeCache::load(GarbageCollector& gc, const std::string& sourcePath,
+                                               const CacheKey& key) {
+        int fd = open(cachePath(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            return nullptr;
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) return nullptr;
+        auto chunk = deserialize(gc, static_cast<const uint8_t*>(data), size, key);
+        munmap(data, size);
+        return chunk;
+    }
+
+    bool BytecodeCache::store(const Chunk& chunk, const std::string& sourcePath, const CacheKey& key) {
+        std::vector<uint8_t> bytes;
+        return serialize(chunk, key, bytes) && writeFile(bytes, sourcePath);
+    }
+
+    bool BytecodeCache::writeFile(const std::vector<uint8_t>& bytes, const std::string& sourcePath) {
+        // Write a sibling and rename it over the old file, so a reader never sees half a cache
+        std::string path = cachePath(sourcePath);
+        std::string temp = path + ".tmp" + std::to_string(getpid());
+        FILE* file = std::fopen(temp.c_str(), "wb");
+        if (!file) return false;
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (ok) ok = std::rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok) std::remove(temp.c_str());
+        return ok;
+    }
+
+}
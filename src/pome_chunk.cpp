@@ -1,6 +1,7 @@
 #include "pome_chunk.h"
 #include "pome_opcode.h"
 #include "pome_value.h"
+#include "pome_shape.h"
 #include <iostream>
 #include <iomanip>
 
@@ -9,12 +10,54 @@ namespace Pome {
     void disassembleChunk(Chunk& chunk, const char* name);
     int disassembleInstruction(Chunk& chunk, int offset);
 
+    void Chunk::markCaches(GarbageCollector& gc) {
+        // Links another VM owns are its to mark, and may be changing under it
+        bool ownsLinks = globalOwner.load(std::memory_order_relaxed) == gc.getHeapId();
+        for (auto& meta : inlineCaches) {
+            if (meta.objectCache) gc.markObject(meta.objectCache);
+            if (ownsLinks && meta.global.module) gc.markObject(meta.global.module);
+            if (meta.klassCache) gc.markObject(meta.klassCache);
+            for (int i = 0; i < meta.fieldCount; ++i) {
+                const FieldCacheEntry& entry = meta.fields[i];
+                if (entry.shape) gc.markObject(entry.shape);
+                if (entry.klass) gc.markObject(entry.klass);
+                if (entry.method) gc.markObject(entry.method);
+            }
+        }
+    }
+
+    static const char* const OPCODE_NAMES[] = {
+        "MOVE", "LOADK", "LOADBOOL", "LOADNIL", "ADD", "SUB", "MUL", "DIV", "MOD",
+        "POW", "UNM", "NOT", "LEN", "CONCAT", "JMP", "EQ", "LT", "LE", "TEST",
+        "TESTSET", "CALL", "TAILCALL", "RETURN", "GETGLOBAL", "SETGLOBAL", "GETUPVAL",
+        "SETUPVAL", "CLOSURE", "NEWLIST", "NEWTABLE", "GETTABLE", "SETTABLE", "SELF",
+        "FORLOOP", "FORPREP", "TFORCALL", "TFORLOOP", "IMPORT", "EXPORT", "INHERIT",
+        "GETSUPER", "GETITER", "AND", "OR", "SLICE", "PRINT", "TRY", "THROW", "CATCH",
+        "ASYNC", "AWAIT", "GETFIELD", "SETFIELD", "ADD_NN", "SUB_NN", "MUL_NN",
+        "DIV_NN", "MOD_NN", "LT_NN", "LE_NN", "GETGLOBAL_CACHE", "GETTABLE_CACHE",
+        "SETTABLE_CACHE", "GETFIELD_CACHE", "SETFIELD_CACHE", "LIST_ADD_SCALAR",
+        "LIST_SUM", "GETLIST_N", "SETLIST_N", "GETLIST_D", "SETLIST_D", "GETLIST_I",
+        "SETLIST_I",
+        "LT_JMP", "LE_JMP", "LOADK_ADD", "LOADK_SUB", "LOADK_MUL", "LOADK_ADD_JMP", "MOVE2",
+        "GETTABLE_ADD_SET", "CHECKMETHOD"
+    };
+    static_assert(sizeof(OPCODE_NAMES) / sizeof(OPCODE_NAMES[0]) == static_cast<size_t>(OpCode::OP_COUNT),
+                  "OPCODE_NAMES must list every opcode");
+
+    const char* opcodeName(OpCode op) {
+        size_t index = static_cast<size_t>(op);
+        return index < static_cast<size_t>(OpCode::OP_COUNT) ? OPCODE_NAMES[index] : "UNKNOWN";
+    }
+
     void disassembleChunk(Chunk& chunk, const char* name) {
         std::cout << "== " << name << " ==" << std::endl;
 
         for (int offset = 0; offset < (int)chunk.code.size(); ) {
             offset = disassembleInstruction(chunk, offset);
         }
+        for (const ExceptionRange& range : chunk.handlers) {
+            std::cout << "  try [" << range.start << ", " << range.end << ") -> " << range.target << std::endl;
+        }
 
         // Also disassemble nested functions and classes in constants
         for (auto& val : chunk.constants) {
@@ -115,7 +158,6 @@ namespace Pome {
             case OpCode::OR:        std::cout << "OR        R" << a << " R" << b << " R" << c << std::endl; break;
             case OpCode::SLICE:     std::cout << "SLICE     R" << a << " R" << b << " R" << c << std::endl; break;
             case OpCode::PRINT:     std::cout << "PRINT     R" << a << " " << b << std::endl; break;
-            case OpCode::TRY:       std::cout << "TRY       " << sbx << " (Target: " << (offset + 1 + sbx) << ")" << std::endl; break;
             case OpCode::THROW:     std::cout << "THROW     R" << a << std::endl; break;
             case OpCode::CATCH:     std::cout << "CATCH     R" << a << std::endl; break;
             case OpCode::ASYNC:     std::cout << "ASYNC     R" << a << " R" << b << std::endl; break;
@@ -138,6 +180,15 @@ namespace Pome {
             case OpCode::SETLIST_D:        std::cout << "SETLIST_D R" << a << " R" << b << " R" << c << " (Specialized)" << std::endl; break;
             case OpCode::GETLIST_I:        std::cout << "GETLIST_I R" << a << " R" << b << " R" << c << " (Specialized)" << std::endl; break;
             case OpCode::SETLIST_I:        std::cout << "SETLIST_I R" << a << " R" << b << " R" << c << " (Specialized)" << std::endl; break;
+            case OpCode::LT_JMP:           std::cout << "LT_JMP    R" << a << " R" << b << " R" << c << " (Fused)" << std::endl; break;
+            case OpCode::LE_JMP:           std::cout << "LE_JMP    R" << a << " R" << b << " R" << c << " (Fused)" << std::endl; break;
+            case OpCode::LOADK_ADD:        std::cout << "LOADK_ADD R" << a << " K" << bx << " (Fused)" << std::endl; break;
+            case OpCode::LOADK_SUB:        std::cout << "LOADK_SUB R" << a << " K" << bx << " (Fused)" << std::endl; break;
+            case OpCode::LOADK_MUL:        std::cout << "LOADK_MUL R" << a << " K" << bx << " (Fused)" << std::endl; break;
+            case OpCode::LOADK_ADD_JMP:    std::cout << "LOADK_ADD_JMP R" << a << " K" << bx << " (Fused)" << std::endl; break;
+            case OpCode::MOVE2:            std::cout << "MOVE2     R" << a << " R" << b << " (Fused)" << std::endl; break;
+            case OpCode::GETTABLE_ADD_SET: std::cout << "GETTABLE_ADD_SET R" << a << " R" << b << " R" << c << " (Fused)" << std::endl; break;
+            case OpCode::CHECKMETHOD:      std::cout << "CHECKMETHOD R" << a << " K" << bx << " (" << chunk.constants[bx].toString() << ")" << std::endl; break;
             default:
                 std::cout << "Unknown opcode " << (int)op << " at offset " << offset << std::endl;
                 break;
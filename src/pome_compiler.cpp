@@ -1,5 +1,7 @@
 #include "../include/pome_compiler.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 namespace Pome {
 
@@ -8,17 +10,48 @@ namespace Pome {
     std::unique_ptr<Chunk> Compiler::compile(Program& program) {
         auto scriptChunk = std::make_unique<Chunk>();
         currentChunk = scriptChunk.get();
+        topLevelChunk = currentChunk;
         freeReg = 0;
         locals.clear();
         upvalues.clear();
         scopeDepth = 0;
+        beginFunction(program.getStatements());
         
         program.accept(*this);
         
         emit(Chunk::makeABC(OpCode::RETURN, 0, 1, 0), 0); 
+        finishChunk(*scriptChunk);
         return scriptChunk;
     }
 
+    void Compiler::beginFunction(const std::vector<std::unique_ptr<Statement>>& body) {
+        lastJumpTarget = -1;
+        reboundNames.clear();
+        if (optLevel >= 2) reboundNames = Optimizer::reboundNames(body);
+        plan = RegisterPlan();
+        plan.liveness = Optimizer::liveness(body);
+    }
+
+    void Compiler::emitSpillTable(int line) {
+        if (freeReg + plan.liveness.declarations < SPILL_THRESHOLD) return;
+        plan.spillReg = allocReg();
+        locals.push_back({spillTableName(), 0, plan.spillReg});
+        emit(Chunk::makeABC(OpCode::NEWTABLE, plan.spillReg, 0, 0), line);
+    }
+
+    std::string Compiler::spillTableName() const {
+        // Not an identifier, and distinct from every enclosing function's, so closures reach the right one
+        int depth = 0;
+        for (const Compiler* c = parent; c; c = c->parent) depth++;
+        return "(spill " + std::to_string(depth) + ")";
+    }
+
+    void Compiler::finishChunk(Chunk& chunk) {
+        if (optLevel < 1) return;
+        Optimizer::removeUnreachable(chunk);
+        fuseSuperinstructions(chunk);
+    }
+
     void Compiler::emit(Instruction instruction, int line) {
         currentChunk->write(instruction, line);
     }
@@ -27,17 +60,242 @@ namespace Pome {
         return currentChunk->addConstant(value);
     }
 
+    void Compiler::compileBlock(const std::vector<std::unique_ptr<Statement>>& statements) {
+        bool reachable = true;
+        for (const auto& s : statements) {
+            if (!reachable) {
+                // Never runs, but the name stays a local so later code resolves it the same way
+                if (auto decl = dynamic_cast<VarDeclStmt*>(s.get())) {
+                    const Local* existing = findLocal(decl->getName());
+                    if (!existing || existing->depth < scopeDepth) {
+                        locals.push_back({decl->getName(), scopeDepth, allocReg()});
+                    }
+                }
+                continue;
+            }
+            s->accept(*this);
+            releaseDeadLocals(s.get());
+            resetFreeReg();
+            ASTNode::NodeType type = s->getType();
+            if (optLevel >= 1 && (type == ASTNode::RETURN_STMT || type == ASTNode::BREAK_STMT ||
+                                  type == ASTNode::CONTINUE_STMT || type == ASTNode::THROW_STMT)) {
+                reachable = false;
+            }
+        }
+    }
+
+    bool Compiler::evaluateConstant(Expression* expr, PomeValue& value) {
+        if (optLevel < 1 || !expr) return false;
+        switch (expr->getType()) {
+            case ASTNode::NUMBER_EXPR:
+                value = PomeValue(static_cast<NumberExpr*>(expr)->getValue());
+                return true;
+            case ASTNode::STRING_EXPR:
+                value = PomeValue(gc.allocateString(static_cast<StringExpr*>(expr)->getValue()));
+                return true;
+            case ASTNode::BOOLEAN_EXPR:
+                value = PomeValue(static_cast<BooleanExpr*>(expr)->getValue());
+                return true;
+            case ASTNode::NIL_EXPR:
+                value = PomeValue();
+                return true;
+            case ASTNode::IDENTIFIER_EXPR: {
+                const Local* local = findLocal(static_cast<IdentifierExpr*>(expr)->getName());
+                if (!local || !local->hasConstant) return false;
+                value = local->constant;
+                return true;
+            }
+            case ASTNode::UNARY_EXPR: {
+                auto* unary = static_cast<UnaryExpr*>(expr);
+                PomeValue operand;
+                return evaluateConstant(unary->getOperand(), operand) &&
+                       Optimizer::foldUnary(unary->getOperator(), operand, value);
+            }
+            case ASTNode::BINARY_EXPR: {
+                auto* binary = static_cast<BinaryExpr*>(expr);
+                const std::string& op = binary->getOperator();
+                if (op == "=") return false;
+                PomeValue left, right;
+                if (!evaluateConstant(binary->getLeft(), left)) return false;
+                if (op == "and" || op == "or") {
+                    // The result is one of the operands, as at run time
+                    if (left.asBool() == (op == "or")) {
+                        value = left;
+                        return true;
+                    }
+                    return evaluateConstant(binary->getRight(), value);
+                }
+                return evaluateConstant(binary->getRight(), right) &&
+                       Optimizer::foldBinary(gc, op, left, right, value);
+            }
+            case ASTNode::TERNARY_EXPR: {
+                auto* ternary = static_cast<TernaryExpr*>(expr);
+                PomeValue condition;
+                if (!evaluateConstant(ternary->getCondition(), condition)) return false;
+                return evaluateConstant(condition.asBool() ? ternary->getThenExpr() : ternary->getElseExpr(), value);
+            }
+            default:
+                return false;
+        }
+    }
+
+    void Compiler::emitLoad(PomeValue value, int reg, int line) {
+        if (value.isNil()) {
+            emit(Chunk::makeABC(OpCode::LOADNIL, reg, 0, 0), line);
+        } else if (value.isBool()) {
+            emit(Chunk::makeABC(OpCode::LOADBOOL, reg, value.asBool() ? 1 : 0, 0), line);
+        } else {
+            emit(Chunk::makeABx(OpCode::LOADK, reg, addConstant(value)), line);
+        }
+    }
+
+    bool Compiler::emitConstant(Expression* expr) {
+        PomeValue value;
+        if (!evaluateConstant(expr, value)) return false;
+        RootGuard valueGuard(gc, value.isObject() ? value.asObject() : nullptr);
+        int reg = allocReg();
+        emitLoad(value, reg, expr->getLine());
+        lastResultReg = reg;
+        freeReg = lastResultReg + 1;
+        return true;
+    }
+
+    int Compiler::compileOperand(Expression* expr) {
+        if (optLevel >= 1) {
+            if (auto ident = dynamic_cast<IdentifierExpr*>(expr)) {
+                const Local* local = findLocal(ident->getName());
+                if (local && !local->spilled && !local->hasConstant) return local->reg;
+            }
+        }
+        expr->accept(*this);
+        return lastResultReg;
+    }
+
+    // Opcodes whose only effect on registers is writing R(A) from their other operands
+    static bool writesOnlyA(Instruction ins) {
+        switch (Chunk::getOpCode(ins)) {
+            case OpCode::MOVE: case OpCode::LOADK: case OpCode::GETGLOBAL: case OpCode::GETUPVAL:
+            case OpCode::ADD: case OpCode::SUB: case OpCode::MUL: case OpCode::DIV: case OpCode::MOD:
+            case OpCode::POW: case OpCode::UNM: case OpCode::NOT: case OpCode::LEN:
+            case OpCode::EQ: case OpCode::LT: case OpCode::LE:
+            case OpCode::GETTABLE: case OpCode::GETFIELD: case OpCode::NEWLIST: case OpCode::NEWTABLE:
+                return true;
+            case OpCode::LOADBOOL:
+                return Chunk::getC(ins) == 0;
+            case OpCode::LOADNIL:
+                return Chunk::getB(ins) == 0;
+            default:
+                return false;
+        }
+    }
+
+    void Compiler::emitMoveTo(int dest, int src, int tempBase, int line) {
+        if (dest == src) return;
+        auto& code = currentChunk->code;
+        // Safe only if src is a temporary nothing else reads, and no jump joins after its producer
+        if (optLevel >= 1 && src >= tempBase && !code.empty() && lastJumpTarget < (int)code.size() &&
+            writesOnlyA(code.back()) && Chunk::getA(code.back()) == src) {
+            Instruction& last = code.back();
+            last = (last & ~(static_cast<Instruction>(Chunk::MAXARG_A) << Chunk::POS_A)) |
+                   (static_cast<Instruction>(dest) << Chunk::POS_A);
+            return;
+        }
+        emit(Chunk::makeABC(OpCode::MOVE, dest, src, 0), line);
+    }
+
     int Compiler::emitJump(OpCode op) {
         emit(Chunk::makeAsBx(op, 0, 0), 0);
         return currentChunk->code.size() - 1;
     }
 
+    void Compiler::fuseSuperinstructions(Chunk& chunk) {
+        // Pairs picked from `pome --profile` on the loop benchmarks. Only the
+        // first word of a sequence is rewritten, so a jump that lands inside
+        // one still runs the original instructions from there.
+        auto& code = chunk.code;
+        auto opAt = [&](size_t i) { return i < code.size() ? Chunk::getOpCode(code[i]) : OpCode::OP_COUNT; };
+        // A throw is matched to its try block by pc, so a fused sequence must not straddle one's edge
+        auto crossesTry = [&](size_t i, size_t n) {
+            for (const ExceptionRange& range : chunk.handlers) {
+                if ((range.start > i && range.start < i + n) || (range.end > i && range.end < i + n)) return true;
+            }
+            return false;
+        };
+        size_t i = 0;
+        while (i < code.size()) {
+            Instruction ins = code[i];
+            OpCode op = Chunk::getOpCode(ins);
+            int a = Chunk::getA(ins);
+
+            if (op == OpCode::CLOSURE) {
+                // Upvalue descriptors follow as pseudo-instructions; they are data, not code
+                PomeValue proto = chunk.constants[Chunk::getBx(ins)];
+                i += 1 + proto.asPomeFunction()->upvalueCount;
+                continue;
+            }
+
+            if ((op == OpCode::LT || op == OpCode::LE) && opAt(i + 1) == OpCode::TEST &&
+                Chunk::getA(code[i + 1]) == a && opAt(i + 2) == OpCode::JMP && !crossesTry(i, 3)) {
+                code[i] = Chunk::makeABC(op == OpCode::LT ? OpCode::LT_JMP : OpCode::LE_JMP,
+                                         a, Chunk::getB(ins), Chunk::getC(ins));
+                i += 3;
+                continue;
+            }
+
+            if (op == OpCode::LOADK && chunk.constants[Chunk::getBx(ins)].isNumber()) {
+                OpCode next = opAt(i + 1);
+                bool usesK = next != OpCode::OP_COUNT &&
+                             (Chunk::getB(code[i + 1]) == a || Chunk::getC(code[i + 1]) == a);
+                if (usesK && next == OpCode::ADD && opAt(i + 2) == OpCode::JMP && !crossesTry(i, 3)) {
+                    code[i] = Chunk::makeABx(OpCode::LOADK_ADD_JMP, a, Chunk::getBx(ins));
+                    i += 3;
+                    continue;
+                }
+                if (usesK && (next == OpCode::ADD || next == OpCode::SUB || next == OpCode::MUL) && !crossesTry(i, 2)) {
+                    OpCode fused = next == OpCode::ADD ? OpCode::LOADK_ADD
+                                 : next == OpCode::SUB ? OpCode::LOADK_SUB : OpCode::LOADK_MUL;
+                    code[i] = Chunk::makeABx(fused, a, Chunk::getBx(ins));
+                    i += 2;
+                    continue;
+                }
+            }
+
+            if (op == OpCode::GETTABLE && opAt(i + 1) == OpCode::ADD && opAt(i + 2) == OpCode::SETTABLE &&
+                !crossesTry(i, 3)) {
+                // GETTABLE t l k; ADD t t v; SETTABLE l k t -- the shape of `l[k] += v`
+                int l = Chunk::getB(ins), k = Chunk::getC(ins);
+                Instruction add = code[i + 1], set = code[i + 2];
+                bool isRmw = a != l && a != k &&
+                             Chunk::getA(add) == a && (Chunk::getB(add) == a) != (Chunk::getC(add) == a) &&
+                             Chunk::getA(set) == l && Chunk::getB(set) == k && Chunk::getC(set) == a;
+                if (isRmw) {
+                    code[i] = Chunk::makeABC(OpCode::GETTABLE_ADD_SET, a, l, k);
+                    i += 3;
+                    continue;
+                }
+            }
+
+            if (op == OpCode::MOVE && opAt(i + 1) == OpCode::MOVE && !crossesTry(i, 2)) {
+                code[i] = Chunk::makeABC(OpCode::MOVE2, a, Chunk::getB(ins), 0);
+                i += 2;
+                continue;
+            }
+
+            i++;
+        }
+    }
+
     void Compiler::patchJump(int instructionIndex) {
-        int offset = currentChunk->code.size() - instructionIndex - 1;
+        patchJumpTo(instructionIndex, currentChunk->code.size());
+    }
+
+    void Compiler::patchJumpTo(int instructionIndex, int target) {
+        int offset = target - instructionIndex - 1;
         Instruction& instr = currentChunk->code[instructionIndex];
         OpCode op = Chunk::getOpCode(instr);
         int a = Chunk::getA(instr);
         instr = Chunk::makeAsBx(op, a, offset);
+        if (target > lastJumpTarget) lastJumpTarget = target;
     }
 
     int Compiler::resolveUpvalue(const std::string& name) {
@@ -84,6 +342,8 @@ namespace Pome {
         Compiler innerCompiler(gc, this);
         innerCompiler.currentChunk = func->chunk.get();
         innerCompiler.strictMode = strictMode;
+        innerCompiler.optLevel = optLevel;
+        innerCompiler.beginFunction(stmt.getBody());
         
         // R0 is reserved for the function itself
         innerCompiler.allocReg(); 
@@ -95,13 +355,18 @@ namespace Pome {
         for (const auto& param : func->parameters) {
             innerCompiler.locals.push_back({param, 0, innerCompiler.allocReg()});
         }
+        innerCompiler.emitSpillTable(stmt.getLine());
         
-        for (const auto& s : stmt.getBody()) {
-            s->accept(innerCompiler);
-            innerCompiler.resetFreeReg();
-        }
+        innerCompiler.compileBlock(stmt.getBody());
         
         innerCompiler.emit(Chunk::makeABC(OpCode::RETURN, 0, 0, 0), stmt.getLine());
+        innerCompiler.finishChunk(*func->chunk);
+
+        // Calls after a top-level declaration whose name is never rebound always reach it
+        if (optLevel >= 2 && scriptFunctions.count(&stmt) && innerCompiler.upvalues.empty() &&
+            stmt.getName() != "print") {
+            registerInlineTarget(stmt, nullptr);
+        }
         
         func->upvalueCount = (uint16_t)innerCompiler.upvalues.size();
 
@@ -119,90 +384,160 @@ namespace Pome {
         lastResultReg = reg;
     }
 
-    int Compiler::resolveLocal(const std::string& name) {
+    const Compiler::Local* Compiler::findLocal(const std::string& name) const {
         for (int i = (int)locals.size() - 1; i >= 0; i--) {
             if (locals[i].name == name) {
-                return locals[i].reg;
+                return &locals[i];
             }
         }
-        return -1;
+        return nullptr;
+    }
+
+    int Compiler::resolveLocal(const std::string& name) {
+        const Local* local = findLocal(name);
+        return local && !local->spilled ? local->reg : -1;
+    }
+
+    bool Compiler::isSpilled(const std::string& name) const {
+        for (const Compiler* c = this; c; c = c->parent) {
+            if (const Local* local = c->findLocal(name)) return local->spilled;
+        }
+        return false;
     }
 
     void Compiler::resetFreeReg() {
-        int maxReg = -1;
+        int maxReg = plan.reservedReg;
         for (const auto& local : locals) {
-            if (local.reg > maxReg) maxReg = local.reg;
+            if (!local.spilled && local.reg > maxReg) maxReg = local.reg;
         }
         freeReg = maxReg + 1;
+        // Holes the top of the locals has dropped below are ordinary temporaries again
+        auto& holes = plan.holes;
+        holes.erase(std::remove_if(holes.begin(), holes.end(), [&](int reg) { return reg >= freeReg; }), holes.end());
+    }
+
+    void Compiler::releaseDeadLocals(const Statement* stmt) {
+        auto end = plan.liveness.statementEnds.find(stmt);
+        if (end == plan.liveness.statementEnds.end()) return;
+        for (int i = (int)locals.size() - 1; i >= 0; i--) {
+            const Local& local = locals[i];
+            if (!local.reusable || local.isCaptured || local.spilled || local.loops < (int)loops.size()) continue;
+            auto last = plan.liveness.lastUses.find(local.name);
+            if (last != plan.liveness.lastUses.end() && last->second > end->second) continue;
+            plan.holes.push_back(local.reg);
+            locals.erase(locals.begin() + i);
+        }
+    }
+
+    void Compiler::endScope() {
+        while (!locals.empty() && locals.back().depth == scopeDepth) {
+            const Local& local = locals.back();
+            if (!local.spilled && local.isCaptured) {
+                plan.reservedReg = std::max(plan.reservedReg, local.reg);
+            } else if (!local.spilled) {
+                plan.holes.push_back(local.reg);
+            }
+            locals.pop_back();
+        }
+        scopeDepth--;
+    }
+
+    int Compiler::declareReg() {
+        auto& holes = plan.holes;
+        if (holes.empty()) return allocReg();
+        auto lowest = std::min_element(holes.begin(), holes.end());
+        int reg = *lowest;
+        holes.erase(lowest);
+        return reg;
     }
 
     // --- Visitors ---
     
     void Compiler::visit(Program &program) {
         strictMode = program.isStrict;
-        for (const auto &stmt : program.getStatements()) {
-            stmt->accept(*this);
+        if (optLevel >= 2) {
+            auto bindings = Optimizer::bindingCounts(program.getStatements());
+            for (const auto& s : program.getStatements()) {
+                if (s->getType() != ASTNode::FUNCTION_DECL_STMT) continue;
+                auto* decl = static_cast<FunctionDeclStmt*>(s.get());
+                if (bindings[decl->getName()] == 1) scriptFunctions.insert(decl);
+            }
         }
+        compileBlock(program.getStatements());
     }
     
+    // Branch bodies share the enclosing scope, so a branch that declares a variable is kept
+    static bool declaresLocals(const std::vector<std::unique_ptr<Statement>>& statements) {
+        for (const auto& s : statements) {
+            if (s->getType() == ASTNode::VAR_DECL_STMT) return true;
+        }
+        return false;
+    }
+
     void Compiler::visit(IfStmt &stmt) {
-        stmt.getCondition()->accept(*this);
-        int condReg = lastResultReg;
+        PomeValue condition;
+        if (evaluateConstant(stmt.getCondition(), condition)) {
+            const auto& taken = condition.asBool() ? stmt.getThenBranch() : stmt.getElseBranch();
+            const auto& dropped = condition.asBool() ? stmt.getElseBranch() : stmt.getThenBranch();
+            if (!declaresLocals(dropped)) {
+                compileBlock(taken);
+                return;
+            }
+        }
+
+        int condReg = compileOperand(stmt.getCondition());
         
         // Skip next JMP if truthy
         emit(Chunk::makeABC(OpCode::TEST, condReg, 0, 1), stmt.getLine());
         
         int jumpToElse = emitJump(OpCode::JMP);
         
-        for (const auto& s : stmt.getThenBranch()) {
-            s->accept(*this);
-            resetFreeReg();
-        }
+        compileBlock(stmt.getThenBranch());
         
         int jumpToEnd = emitJump(OpCode::JMP);
         
         patchJump(jumpToElse);
-        for (const auto& s : stmt.getElseBranch()) {
-            s->accept(*this);
-            resetFreeReg();
-        }
+        compileBlock(stmt.getElseBranch());
         
         patchJump(jumpToEnd);
     }
     
     void Compiler::visit(WhileStmt &stmt) {
+        PomeValue condition;
+        bool constant = evaluateConstant(stmt.getCondition(), condition);
+        if (constant && !condition.asBool() && !declaresLocals(stmt.getBody())) return;
+
         int loopStart = currentChunk->code.size();
         
         loops.push_back({loopStart, {}, {}});
 
-        stmt.getCondition()->accept(*this);
-        int condReg = lastResultReg;
-        
-        // Skip next JMP if truthy
-        emit(Chunk::makeABC(OpCode::TEST, condReg, 0, 1), stmt.getLine());
-        int jumpToEnd = emitJump(OpCode::JMP);
-        
-        for (const auto& s : stmt.getBody()) {
-            s->accept(*this);
-            resetFreeReg();
+        int jumpToEnd = -1;
+        if (!constant || !condition.asBool()) {
+            int condReg = compileOperand(stmt.getCondition());
+            
+            // Skip next JMP if truthy
+            emit(Chunk::makeABC(OpCode::TEST, condReg, 0, 1), stmt.getLine());
+            jumpToEnd = emitJump(OpCode::JMP);
         }
         
+        compileBlock(stmt.getBody());
+        
         // Handle continue jumps: they point back to loopStart (condition check)
         for (int jump : loops.back().continueJumps) {
-            int offset = loopStart - jump - 1;
-            currentChunk->code[jump] = Chunk::makeAsBx(OpCode::JMP, 0, offset);
+            patchJumpTo(jump, loopStart);
         }
 
         int offset = loopStart - (int)currentChunk->code.size() - 1;
         emit(Chunk::makeAsBx(OpCode::JMP, 0, offset), stmt.getLine());
         
-        patchJump(jumpToEnd);
+        if (jumpToEnd != -1) {
+            patchJump(jumpToEnd);
+        }
 
         // Handle break jumps: they point to the instruction after the final jump
         int breakTarget = currentChunk->code.size();
         for (int jump : loops.back().breakJumps) {
-            int breakOffset = breakTarget - jump - 1;
-            currentChunk->code[jump] = Chunk::makeAsBx(OpCode::JMP, 0, breakOffset);
+            patchJumpTo(jump, breakTarget);
         }
 
         loops.pop_back();
@@ -236,6 +571,8 @@ namespace Pome {
     }
 
     void Compiler::visit(IdentifierExpr &expr) {
+        if (emitConstant(&expr)) return;
+
         int reg = resolveLocal(expr.getName());
         if (reg != -1) {
             int dest = allocReg();
@@ -245,6 +582,14 @@ namespace Pome {
             return;
         }
 
+        if (isSpilled(expr.getName())) {
+            int dest = allocReg();
+            emitSpilledLoad(expr.getName(), dest, expr.getLine());
+            lastResultReg = dest;
+            freeReg = lastResultReg + 1;
+            return;
+        }
+
         if ((reg = resolveUpvalue(expr.getName())) != -1) {
             int dest = allocReg();
             emit(Chunk::makeABC(OpCode::GETUPVAL, dest, reg, 0), expr.getLine());
@@ -266,6 +611,7 @@ namespace Pome {
 
     void Compiler::visit(BinaryExpr &expr) {
         std::string oper = expr.getOperator();
+        if (oper != "=" && emitConstant(&expr)) return;
         
         if (oper == "and") {
             expr.getLeft()->accept(*this);
@@ -312,23 +658,25 @@ namespace Pome {
             if (auto ident = dynamic_cast<IdentifierExpr*>(expr.getLeft())) {
                 // Optimized LHS lookup for assignment
                 int localReg = resolveLocal(ident->getName());
+                bool spilled = isSpilled(ident->getName());
                 
                 // Evaluate RHS first
+                int tempBase = freeReg;
                 expr.getRight()->accept(*this);
                 int valReg = lastResultReg;
                 
                 if (localReg != -1) {
-                    if (valReg != localReg) {
-                        emit(Chunk::makeABC(OpCode::MOVE, localReg, valReg, 0), expr.getLine());
-                    }
+                    emitMoveTo(localReg, valReg, tempBase, expr.getLine());
                     lastResultReg = localReg;
+                } else if (spilled) {
+                    emitSpilledWrite(ident->getName(), valReg, expr.getLine());
+                    lastResultReg = valReg;
                 } else if ((localReg = resolveUpvalue(ident->getName())) != -1) {
                     emit(Chunk::makeABC(OpCode::SETUPVAL, valReg, localReg, 0), expr.getLine());
                     lastResultReg = valReg;
                 } else {
                     if (strictMode) {
-                        std::cerr << "Compiler Error: Undefined variable '" << ident->getName() << "' in strict mode." << std::endl;
-                        exit(1);
+                        error("Undefined variable '" + ident->getName() + "' in strict mode.");
                     }
                     // Global assignment
                     PomeString* nameStr = gc.allocateString(ident->getName()); RootGuard nameStrGuard(gc, nameStr);
@@ -367,14 +715,14 @@ namespace Pome {
                 emit(Chunk::makeABC(OpCode::SETTABLE, objSafe, keySafe, valReg), expr.getLine());
                 lastResultReg = valReg;
             } else {
-                std::cerr << "Compiler Error: Invalid assignment target." << std::endl;
-                exit(1);
+                error("Invalid assignment target.");
             }
             freeReg = lastResultReg + 1;
             return;
         }
 
         // Optimization: Check if left/right are local variables
+        int tempBase = freeReg;
         int leftReg = -1;
         bool leftIsLocal = false;
         if (auto ident = dynamic_cast<IdentifierExpr*>(expr.getLeft())) {
@@ -432,6 +780,8 @@ namespace Pome {
         else if (oper == "==") op = OpCode::EQ;
         else if (oper == "!=") { op = OpCode::EQ; invert = true; }
         
+        // The operands' temporaries die as the instruction reads them, so the result takes the first
+        freeReg = tempBase;
         int resReg = allocReg();
         emit(Chunk::makeABC(op, resReg, leftReg, rightReg), expr.getLine());
         
@@ -443,32 +793,111 @@ namespace Pome {
         freeReg = lastResultReg + 1;
     }
 
+    void Compiler::emitSpilledStore(VarDeclStmt &stmt, const Local& local) {
+        if (stmt.getInitializer()) {
+            stmt.getInitializer()->accept(*this);
+        } else {
+            lastResultReg = allocReg();
+            emit(Chunk::makeABC(OpCode::LOADNIL, lastResultReg, 0, 0), stmt.getLine());
+        }
+        emitSpillAccess(*this, local, lastResultReg, true, stmt.getLine());
+    }
+
+    void Compiler::emitSpillAccess(const Compiler& owner, const Local& local, int reg, bool store, int line) {
+        freeReg = std::max(freeReg, reg + 1);
+        if (local.spillSlot < 0) {
+            PomeString* nameStr = gc.allocateString(local.name); RootGuard nameStrGuard(gc, nameStr);
+            int nameIdx = addConstant(PomeValue(nameStr));
+            emit(Chunk::makeABx(store ? OpCode::SETGLOBAL : OpCode::GETGLOBAL, reg, nameIdx), line);
+            return;
+        }
+        int tableReg = plan.spillReg;
+        if (&owner != this) {
+            tableReg = allocReg();
+            emit(Chunk::makeABC(OpCode::GETUPVAL, tableReg, resolveUpvalue(owner.spillTableName()), 0), line);
+        }
+        int keyReg = allocReg();
+        emitLoad(PomeValue((double)local.spillSlot), keyReg, line);
+        if (store) {
+            emit(Chunk::makeABC(OpCode::SETTABLE, tableReg, keyReg, reg), line);
+        } else {
+            emit(Chunk::makeABC(OpCode::GETTABLE, reg, tableReg, keyReg), line);
+        }
+    }
+
+    void Compiler::emitSpilledLoad(const std::string& name, int dest, int line) {
+        for (const Compiler* c = this; c; c = c->parent) {
+            if (const Local* local = c->findLocal(name)) {
+                emitSpillAccess(*c, *local, dest, false, line);
+                return;
+            }
+        }
+    }
+
+    void Compiler::emitSpilledWrite(const std::string& name, int src, int line) {
+        for (const Compiler* c = this; c; c = c->parent) {
+            if (const Local* local = c->findLocal(name)) {
+                emitSpillAccess(*c, *local, src, true, line);
+                return;
+            }
+        }
+    }
+
     void Compiler::visit(VarDeclStmt &stmt) {
         // Check if it already exists in THIS scope (e.g. inside a loop)
         for (int i = (int)locals.size() - 1; i >= 0; i--) {
             if (locals[i].depth < scopeDepth) break; 
             if (locals[i].name == stmt.getName()) {
+                if (locals[i].spilled) {
+                    emitSpilledStore(stmt, locals[i]);
+                    return;
+                }
                 // Re-initialize existing local
+                int reg = locals[i].reg;
                 if (stmt.getInitializer()) {
+                    int tempBase = freeReg;
                     stmt.getInitializer()->accept(*this);
-                    emit(Chunk::makeABC(OpCode::MOVE, locals[i].reg, lastResultReg, 0), stmt.getLine());
+                    emitMoveTo(reg, lastResultReg, tempBase, stmt.getLine());
                 } else {
-                    emit(Chunk::makeABC(OpCode::LOADNIL, locals[i].reg, 0, 0), stmt.getLine());
+                    emit(Chunk::makeABC(OpCode::LOADNIL, reg, 0, 0), stmt.getLine());
                 }
-                lastResultReg = locals[i].reg;
+                // A redeclared name is in reboundNames, so it never held a constant
+                lastResultReg = reg;
                 return;
             }
         }
 
-        int reg = allocReg();
+        // Past the register budget, script-level variables live in the module's globals instead, and
+        // function locals in the spill table
+        bool topLevel = currentChunk == topLevelChunk && scopeDepth == 0;
+        if (plan.holes.empty() && freeReg >= SPILL_THRESHOLD && (topLevel || plan.spillReg >= 0)) {
+            Local local{stmt.getName(), scopeDepth, -1};
+            local.spilled = true;
+            if (!topLevel) local.spillSlot = plan.spillSlots++;
+            emitSpilledStore(stmt, local);
+            locals.push_back(local);
+            return;
+        }
+
+        int reg = declareReg();
         if (stmt.getInitializer()) {
+            int tempBase = freeReg;
             stmt.getInitializer()->accept(*this);
-            emit(Chunk::makeABC(OpCode::MOVE, reg, lastResultReg, 0), stmt.getLine());
+            emitMoveTo(reg, lastResultReg, tempBase, stmt.getLine());
         } else {
             emit(Chunk::makeABC(OpCode::LOADNIL, reg, 0, 0), stmt.getLine());
         }
         
-        locals.push_back({stmt.getName(), scopeDepth, reg});
+        Local local{stmt.getName(), scopeDepth, reg};
+        local.reusable = !topLevel; // Script variables are the module's state and stay for its whole run
+        local.loops = (int)loops.size();
+        PomeValue value;
+        if (optLevel >= 2 && stmt.getInitializer() && !reboundNames.count(stmt.getName()) &&
+            evaluateConstant(stmt.getInitializer(), value)) {
+            local.hasConstant = true;
+            local.constant = value;
+        }
+        locals.push_back(local);
         lastResultReg = reg;
     }
     
@@ -478,6 +907,7 @@ namespace Pome {
         // 2. Resolve target and potentially fetch current value for compound ops
         if (auto ident = dynamic_cast<IdentifierExpr*>(stmt.getTarget())) {
             int localReg = resolveLocal(ident->getName());
+            bool spilled = isSpilled(ident->getName());
             
             // Optimization: If RHS is a local, avoid calling accept() which would MOVE it to a temporary.
             int rhsReg = -1;
@@ -489,6 +919,7 @@ namespace Pome {
                 }
             }
 
+            int tempBase = freeReg;
             if (!rhsIsLocal) {
                 stmt.getValue()->accept(*this);
                 rhsReg = lastResultReg;
@@ -507,11 +938,26 @@ namespace Pome {
                     else if (op == "%") opcode = OpCode::MOD;
                     emit(Chunk::makeABC(opcode, localReg, localReg, rhsReg), stmt.getLine());
                 } else {
-                    if (localReg != rhsReg) {
-                        emit(Chunk::makeABC(OpCode::MOVE, localReg, rhsReg, 0), stmt.getLine());
-                    }
+                    emitMoveTo(localReg, rhsReg, tempBase, stmt.getLine());
                 }
                 lastResultReg = localReg;
+            } else if (spilled) {
+                if (!op.empty()) {
+                    int currentValReg = allocReg();
+                    emitSpilledLoad(ident->getName(), currentValReg, stmt.getLine());
+                    OpCode opcode = OpCode::ADD;
+                    if (op == "+") opcode = OpCode::ADD;
+                    else if (op == "-") opcode = OpCode::SUB;
+                    else if (op == "*") opcode = OpCode::MUL;
+                    else if (op == "/") opcode = OpCode::DIV;
+                    else if (op == "%") opcode = OpCode::MOD;
+                    emit(Chunk::makeABC(opcode, currentValReg, currentValReg, rhsReg), stmt.getLine());
+                    emitSpilledWrite(ident->getName(), currentValReg, stmt.getLine());
+                    lastResultReg = currentValReg;
+                } else {
+                    emitSpilledWrite(ident->getName(), rhsReg, stmt.getLine());
+                    lastResultReg = rhsReg;
+                }
             } else if ((upvalIdx = resolveUpvalue(ident->getName())) != -1) {
                 if (!op.empty()) {
                     int currentValReg = allocReg();
@@ -531,8 +977,7 @@ namespace Pome {
                 }
             } else {
                 if (strictMode) {
-                    std::cerr << "Compiler Error: Undefined variable '" << ident->getName() << "' in strict mode." << std::endl;
-                    exit(1);
+                    error("Undefined variable '" + ident->getName() + "' in strict mode.");
                 }
                 // Global
                 PomeString* nameStr = gc.allocateString(ident->getName()); RootGuard nameStrGuard(gc, nameStr);
@@ -618,7 +1063,8 @@ namespace Pome {
                 lastResultReg = rhsReg;
             }
         }
-        freeReg = lastResultReg + 1;
+        // lastResultReg may be a local below other live locals; never hand those out as temps
+        resetFreeReg();
     }
 
     void Compiler::visit(ExpressionStmt &stmt) {
@@ -627,8 +1073,7 @@ namespace Pome {
     }
 
     void Compiler::visit(MemberAccessExpr &expr) {
-        expr.getObject()->accept(*this);
-        int objReg = lastResultReg;
+        int objReg = compileOperand(expr.getObject());
 
         PomeString* memberStr = gc.allocateString(expr.getMember()); RootGuard memberStrGuard(gc, memberStr);
         int memberIdx = addConstant(PomeValue(memberStr));
@@ -663,8 +1108,7 @@ namespace Pome {
         if (auto super = dynamic_cast<SuperExpr*>(expr.getCallee())) {
             int thisReg = resolveLocal("this");
             if (thisReg == -1) {
-                std::cerr << "Compiler Error: 'super' used outside of class method." << std::endl;
-                exit(1);
+                error("'super' used outside of class method.");
             }
             
             int calleeReg = allocReg(); // R(A)
@@ -694,30 +1138,12 @@ namespace Pome {
         if (auto member = dynamic_cast<MemberAccessExpr*>(expr.getCallee())) {
             member->getObject()->accept(*this);
             int objReg = lastResultReg;
-            
-            int calleeReg = allocReg();
-            int argCount = expr.getArgs().size();
-            // Reserve: R(A+1) for 'this', R(A+2...) for args
-            for (int i = 0; i < argCount + 1; ++i) allocReg();
-            
-            PomeString* keyStr = gc.allocateString(member->getMember()); RootGuard keyStrGuard(gc, keyStr);
-            int keyIdx = addConstant(PomeValue(keyStr));
-            
-            emit(Chunk::makeABC(OpCode::GETFIELD, calleeReg, objReg, keyIdx), expr.getLine());
-            emit(Chunk::makeABC(OpCode::MOVE, calleeReg + 1, objReg, 0), expr.getLine());
-            
-            for (int i = 0; i < argCount; ++i) {
-                expr.getArgs()[i]->accept(*this);
-                emit(Chunk::makeABC(OpCode::MOVE, calleeReg + 2 + i, lastResultReg, 0), expr.getLine());
-                freeReg = calleeReg + 3 + i; // Prevent args from clobbering each other
-            }
-            
-            emit(Chunk::makeABC(OpCode::CALL, calleeReg, argCount + 2, 1), expr.getLine());
-            lastResultReg = calleeReg;
-            freeReg = lastResultReg + 1;
+            if (!inlineMethodCall(expr, member, objReg)) emitMethodCall(expr, member, objReg);
             return;
         }
 
+        if (inlineCall(expr)) return;
+
         expr.getCallee()->accept(*this);
         int calleeValReg = lastResultReg;
         
@@ -739,6 +1165,155 @@ namespace Pome {
         freeReg = lastResultReg + 1;
     }
 
+    void Compiler::emitMethodCall(CallExpr& expr, MemberAccessExpr* member, int objReg) {
+        int calleeReg = allocReg();
+        int argCount = expr.getArgs().size();
+        // Reserve: R(A+1) for 'this', R(A+2...) for args
+        for (int i = 0; i < argCount + 1; ++i) allocReg();
+        
+        PomeString* keyStr = gc.allocateString(member->getMember()); RootGuard keyStrGuard(gc, keyStr);
+        int keyIdx = addConstant(PomeValue(keyStr));
+        
+        emit(Chunk::makeABC(OpCode::GETFIELD, calleeReg, objReg, keyIdx), expr.getLine());
+        emit(Chunk::makeABC(OpCode::MOVE, calleeReg + 1, objReg, 0), expr.getLine());
+        
+        for (int i = 0; i < argCount; ++i) {
+            expr.getArgs()[i]->accept(*this);
+            emit(Chunk::makeABC(OpCode::MOVE, calleeReg + 2 + i, lastResultReg, 0), expr.getLine());
+            freeReg = calleeReg + 3 + i; // Prevent args from clobbering each other
+        }
+        
+        emit(Chunk::makeABC(OpCode::CALL, calleeReg, argCount + 2, 1), expr.getLine());
+        lastResultReg = calleeReg;
+        freeReg = lastResultReg + 1;
+    }
+
+    Compiler& Compiler::root() {
+        Compiler* c = this;
+        while (c->parent) c = c->parent;
+        return *c;
+    }
+
+    void Compiler::error(const std::string& message) {
+        if (root().errorsThrow) throw std::runtime_error("Compiler Error: " + message);
+        std::cerr << "Compiler Error: " << message << std::endl;
+        exit(1);
+    }
+
+    bool Compiler::bindsLocally(const std::string& name) const {
+        for (const Compiler* c = this; c; c = c->parent) {
+            if (const Local* local = c->findLocal(name)) return !local->spilled || local->spillSlot >= 0;
+        }
+        return false;
+    }
+
+    bool Compiler::canInline(const InlineTarget& target, size_t argCount) const {
+        if (optLevel < 2 || !target.body || target.decl->getParams().size() != argCount) return false;
+        if ((int)inlineStack.size() >= Optimizer::MAX_INLINE_DEPTH) return false;
+        for (const FunctionDeclStmt* active : inlineStack) {
+            if (active == target.decl) return false;
+        }
+        // The body's free names were globals where it was declared; they must still be here
+        for (const std::string& name : target.freeNames) {
+            if (bindsLocally(name)) return false;
+        }
+        return true;
+    }
+
+    void Compiler::registerInlineTarget(const FunctionDeclStmt& decl, PomeFunction* method) {
+        InlineTarget target;
+        target.decl = &decl;
+        target.method = method;
+        target.body = Optimizer::inlineBody(decl, method != nullptr, target.freeNames);
+        if (!method) {
+            inlineFunctions[decl.getName()] = std::move(target);
+            return;
+        }
+        // A name several classes define is left to the call; the guard would miss too often
+        auto [it, inserted] = inlineMethods.emplace(decl.getName(), std::move(target));
+        if (!inserted) it->second.body = nullptr;
+    }
+
+    bool Compiler::inlineCall(CallExpr& expr) {
+        auto ident = dynamic_cast<IdentifierExpr*>(expr.getCallee());
+        if (!ident || optLevel < 2) return false;
+        Compiler& top = root();
+        auto it = top.inlineFunctions.find(ident->getName());
+        if (it == top.inlineFunctions.end() || bindsLocally(ident->getName())) return false;
+        if (!canInline(it->second, expr.getArgs().size())) return false;
+
+        int resultReg = allocReg();
+        emitInlinedBody(expr, it->second, resultReg, -1);
+        return true;
+    }
+
+    bool Compiler::inlineMethodCall(CallExpr& expr, MemberAccessExpr* member, int objReg) {
+        if (optLevel < 2) return false;
+        Compiler& top = root();
+        auto it = top.inlineMethods.find(member->getMember());
+        if (it == top.inlineMethods.end() || !canInline(it->second, expr.getArgs().size())) return false;
+        const InlineTarget& target = it->second;
+
+        // CHECKMETHOD skips the jump to the real call when R(obj).name is still this method
+        int resultReg = allocReg();
+        emit(Chunk::makeABx(OpCode::CHECKMETHOD, objReg, addConstant(PomeValue(target.method))), expr.getLine());
+        int jumpToCall = emitJump(OpCode::JMP);
+        emitInlinedBody(expr, target, resultReg, objReg);
+        int jumpToEnd = emitJump(OpCode::JMP);
+
+        patchJump(jumpToCall);
+        freeReg = resultReg;
+        emitMethodCall(expr, member, objReg);
+        patchJump(jumpToEnd);
+        lastResultReg = resultReg;
+        freeReg = lastResultReg + 1;
+        return true;
+    }
+
+    void Compiler::emitInlinedBody(CallExpr& expr, const InlineTarget& target, int resultReg, int thisReg) {
+        const auto& params = target.decl->getParams();
+        const auto& args = expr.getArgs();
+
+        // Arguments are evaluated in the caller's scope, each into the register of its parameter
+        std::vector<Local> bound;
+        for (size_t i = 0; i < args.size(); ++i) {
+            int reg = allocReg();
+            int tempBase = freeReg;
+            args[i]->accept(*this);
+            emitMoveTo(reg, lastResultReg, tempBase, expr.getLine());
+            freeReg = reg + 1;
+
+            Local param{params[i], scopeDepth + 1, reg};
+            PomeValue value;
+            if (evaluateConstant(args[i].get(), value)) {
+                param.hasConstant = true;
+                param.constant = value;
+            }
+            bound.push_back(param);
+        }
+
+        scopeDepth++;
+        if (thisReg >= 0) locals.push_back({"this", scopeDepth, thisReg});
+        for (const Local& param : bound) locals.push_back(param);
+
+        uint32_t start = static_cast<uint32_t>(currentChunk->code.size());
+        inlineStack.push_back(target.decl);
+        int tempBase = freeReg;
+        target.body->accept(*this);
+        emitMoveTo(resultReg, lastResultReg, tempBase, expr.getLine());
+        inlineStack.pop_back();
+        // Nested inlined calls finish first, so they precede this one
+        currentChunk->inlinedCalls.push_back({start, static_cast<uint32_t>(currentChunk->code.size()),
+                                              expr.getLine(), target.decl->getName()});
+
+        while (!locals.empty() && locals.back().depth == scopeDepth) {
+            locals.pop_back();
+        }
+        scopeDepth--;
+        lastResultReg = resultReg;
+        freeReg = lastResultReg + 1;
+    }
+
     void Compiler::visit(ClassDeclStmt &stmt) {
         PomeClass* klass = gc.allocate<PomeClass>(stmt.getName()); RootGuard klassGuard(gc, klass);
 
@@ -750,10 +1325,14 @@ namespace Pome {
             Chunk* prevChunk = currentChunk;
             int prevFreeReg = freeReg;
             auto prevLocals = locals;
+            auto prevReboundNames = std::move(reboundNames);
+            RegisterPlan prevPlan = std::move(plan);
+            int prevJumpTarget = lastJumpTarget;
 
             currentChunk = func->chunk.get();
             freeReg = 0;
             locals.clear();
+            beginFunction(method->getBody());
 
             // Methods: R0 = Function, R1 = 'this', R2... = Params
             allocReg(); // Skip R0
@@ -761,11 +1340,9 @@ namespace Pome {
             for (const auto& param : func->parameters) {
                 locals.push_back({param, 0, allocReg()});
             }
+            emitSpillTable(method->getLine());
 
-            for (const auto& s : method->getBody()) {
-                s->accept(*this);
-                resetFreeReg();
-            }
+            compileBlock(method->getBody());
             if (func->name == "init") {
                 // Instant Init Optimization: Detect simple field-to-param assignments
                 // e.g. this.item = item; this.left = left; this.right = right;
@@ -805,10 +1382,17 @@ namespace Pome {
             } else {
                 emit(Chunk::makeABC(OpCode::RETURN, 0, 0, 0), method->getLine());
             }
+            finishChunk(*func->chunk);
+            if (optLevel >= 2 && parent == nullptr && func->name != "init") {
+                registerInlineTarget(*method, func);
+            }
 
             currentChunk = prevChunk;
             freeReg = prevFreeReg;
             locals = prevLocals;
+            reboundNames = std::move(prevReboundNames);
+            plan = std::move(prevPlan);
+            lastJumpTarget = prevJumpTarget;
 
             func->klass = klass; // Set parent class
             klass->methods[func->name] = func;
@@ -844,15 +1428,13 @@ namespace Pome {
             emit(Chunk::makeABC(OpCode::MOVE, dest, reg, 0), expr.getLine());
             lastResultReg = dest;
         } else {
-            std::cerr << "Compiler Error: Cannot use 'this' outside of a class method." << std::endl;
-            exit(1);
+            error("Cannot use 'this' outside of a class method.");
         }
     }
 
     void Compiler::visit(ReturnStmt &stmt) {
         if (stmt.getValue()) {
-            stmt.getValue()->accept(*this);
-            int valReg = lastResultReg;
+            int valReg = compileOperand(stmt.getValue());
             emit(Chunk::makeABC(OpCode::RETURN, valReg, 2, 0), stmt.getLine());
         } else {
             emit(Chunk::makeABC(OpCode::RETURN, 0, 1, 0), stmt.getLine());
@@ -870,24 +1452,21 @@ namespace Pome {
         loops.push_back({loopStart, {}, {}});
 
         int jumpToEnd = -1;
-        if (stmt.getCondition()) {
-            stmt.getCondition()->accept(*this);
-            int condReg = lastResultReg;
+        PomeValue condition;
+        if (stmt.getCondition() &&
+            !(evaluateConstant(stmt.getCondition(), condition) && condition.asBool())) {
+            int condReg = compileOperand(stmt.getCondition());
             // Skip next JMP if truthy
             emit(Chunk::makeABC(OpCode::TEST, condReg, 0, 1), stmt.getLine());
             jumpToEnd = emitJump(OpCode::JMP);
         }
         
-        for (const auto& s : stmt.getBody()) {
-            s->accept(*this);
-            resetFreeReg();
-        }
+        compileBlock(stmt.getBody());
         
         // Target for continue: the increment part
         int incrementStart = currentChunk->code.size();
         for (int jump : loops.back().continueJumps) {
-            int offset = incrementStart - jump - 1;
-            currentChunk->code[jump] = Chunk::makeAsBx(OpCode::JMP, 0, offset);
+            patchJumpTo(jump, incrementStart);
         }
 
         if (stmt.getIncrement()) {
@@ -904,22 +1483,17 @@ namespace Pome {
         // Target for break
         int breakTarget = currentChunk->code.size();
         for (int jump : loops.back().breakJumps) {
-            int breakOffset = breakTarget - jump - 1;
-            currentChunk->code[jump] = Chunk::makeAsBx(OpCode::JMP, 0, breakOffset);
+            patchJumpTo(jump, breakTarget);
         }
 
-        // Pop locals from this scope
-        while (!locals.empty() && locals.back().depth == scopeDepth) {
-            locals.pop_back();
-        }
-        scopeDepth--;
+        endScope();
         resetFreeReg();
         loops.pop_back();
     }
 
     void Compiler::visit(UnaryExpr &expr) {
-        expr.getOperand()->accept(*this);
-        int operandReg = lastResultReg;
+        if (emitConstant(&expr)) return;
+        int operandReg = compileOperand(expr.getOperand());
         
         int dest = allocReg();
         OpCode op = OpCode::UNM;
@@ -969,6 +1543,19 @@ namespace Pome {
         freeReg = lastResultReg + 1;
     }
     void Compiler::visit(IndexExpr &expr) {
+        ASTNode::NodeType indexType = expr.getIndex()->getType();
+        if (optLevel >= 1 && (indexType == ASTNode::IDENTIFIER_EXPR || indexType == ASTNode::NUMBER_EXPR ||
+                              indexType == ASTNode::STRING_EXPR)) {
+            // Evaluating a simple key cannot change the object, so neither needs a copy
+            int objReg = compileOperand(expr.getObject());
+            int keyReg = compileOperand(expr.getIndex());
+            int dest = allocReg();
+            emit(Chunk::makeABC(OpCode::GETTABLE, dest, objReg, keyReg), expr.getLine());
+            lastResultReg = dest;
+            freeReg = lastResultReg + 1;
+            return;
+        }
+
         expr.getObject()->accept(*this);
         int objReg = lastResultReg;
         int objSafe = allocReg();
@@ -1012,8 +1599,15 @@ namespace Pome {
     }
 
     void Compiler::visit(TernaryExpr &expr) {
-        expr.getCondition()->accept(*this);
-        int condReg = lastResultReg;
+        if (emitConstant(&expr)) return;
+
+        PomeValue condition;
+        if (evaluateConstant(expr.getCondition(), condition)) {
+            (condition.asBool() ? expr.getThenExpr() : expr.getElseExpr())->accept(*this);
+            return;
+        }
+
+        int condReg = compileOperand(expr.getCondition());
         
         emit(Chunk::makeABC(OpCode::TEST, condReg, 0, 1), expr.getLine());
         int jumpToFalse = emitJump(OpCode::JMP);
@@ -1042,6 +1636,8 @@ namespace Pome {
         Compiler innerCompiler(gc, this);
         innerCompiler.currentChunk = func->chunk.get();
         innerCompiler.strictMode = strictMode;
+        innerCompiler.optLevel = optLevel;
+        innerCompiler.beginFunction(expr.getBody());
 
         // R0
         innerCompiler.allocReg(); 
@@ -1051,13 +1647,12 @@ namespace Pome {
         for (const auto& param : func->parameters) {
             innerCompiler.locals.push_back({param, 0, innerCompiler.allocReg()});
         }
+        innerCompiler.emitSpillTable(expr.getLine());
         
-        for (const auto& s : expr.getBody()) {
-            s->accept(innerCompiler);
-            innerCompiler.resetFreeReg();
-        }
+        innerCompiler.compileBlock(expr.getBody());
         
         innerCompiler.emit(Chunk::makeABC(OpCode::RETURN, 0, 0, 0), expr.getLine());
+        innerCompiler.finishChunk(*func->chunk);
         
         func->upvalueCount = (uint16_t)innerCompiler.upvalues.size();
 
@@ -1200,16 +1795,12 @@ namespace Pome {
         locals.push_back({stmt.getVarName(), scopeDepth, userKeyReg});
         emit(Chunk::makeABC(OpCode::MOVE, userKeyReg, baseReg + 2, 0), stmt.getLine());
         
-        for (const auto& s : stmt.getBody()) {
-            s->accept(*this);
-            resetFreeReg();
-        }
+        compileBlock(stmt.getBody());
         
         // Target for continue
         int continueTarget = currentChunk->code.size();
         for (int jump : loops.back().continueJumps) {
-            int offset = continueTarget - jump - 1;
-            currentChunk->code[jump] = Chunk::makeAsBx(OpCode::JMP, 0, offset);
+            patchJumpTo(jump, continueTarget);
         }
 
         // Jump back to TFORCALL
@@ -1220,22 +1811,17 @@ namespace Pome {
         
         int breakTarget = currentChunk->code.size();
         for (int jump : loops.back().breakJumps) {
-            int breakOffset = breakTarget - jump - 1;
-            currentChunk->code[jump] = Chunk::makeAsBx(OpCode::JMP, 0, breakOffset);
+            patchJumpTo(jump, breakTarget);
         }
 
-        while (!locals.empty() && locals.back().depth == scopeDepth) {
-            locals.pop_back();
-        }
-        scopeDepth--;
+        endScope();
         resetFreeReg();
         loops.pop_back();
     }
 
     void Compiler::visit(BreakStmt &stmt) {
         if (loops.empty()) {
-            std::cerr << "Compiler Error: 'break' outside of loop at line " << stmt.getLine() << std::endl;
-            exit(1);
+            error("'break' outside of loop at line " + std::to_string(stmt.getLine()));
         }
         int jump = emitJump(OpCode::JMP);
         loops.back().breakJumps.push_back(jump);
@@ -1243,34 +1829,30 @@ namespace Pome {
 
     void Compiler::visit(ContinueStmt &stmt) {
         if (loops.empty()) {
-            std::cerr << "Compiler Error: 'continue' outside of loop at line " << stmt.getLine() << std::endl;
-            exit(1);
+            error("'continue' outside of loop at line " + std::to_string(stmt.getLine()));
         }
         int jump = emitJump(OpCode::JMP);
         loops.back().continueJumps.push_back(jump);
     }
 
     void Compiler::visit(ThrowStmt &stmt) {
-        stmt.getValue()->accept(*this);
-        int valReg = lastResultReg;
+        int valReg = compileOperand(stmt.getValue());
         emit(Chunk::makeABC(OpCode::THROW, valReg, 0, 0), stmt.getLine());
     }
 
     void Compiler::visit(TryCatchStmt &stmt) {
-        // Emit TRY. Jump to catch block if exception occurs.
-        int tryJump = emitJump(OpCode::TRY); // Dummy offset for now
+        // No instruction enters the try block; a throw finds it in the chunk's handler table
+        uint32_t tryStart = static_cast<uint32_t>(currentChunk->code.size());
 
         // Compile try block
-        for (const auto& s : stmt.getTryBlock()) {
-            s->accept(*this);
-            resetFreeReg();
-        }
+        compileBlock(stmt.getTryBlock());
+        uint32_t tryEnd = static_cast<uint32_t>(currentChunk->code.size());
 
         // Successfully finished try block, skip catch block
         int skipCatch = emitJump(OpCode::JMP);
 
-        // Patch TRY jump to land at start of catch block
-        patchJump(tryJump);
+        // Nested try blocks finish first, so they precede this one in the table
+        currentChunk->handlers.push_back({tryStart, tryEnd, static_cast<uint32_t>(currentChunk->code.size())});
 
         // Catch: Retrieve pending exception and bind to variable
         int catchReg = allocReg();
@@ -1281,16 +1863,10 @@ namespace Pome {
         locals.push_back({stmt.getCatchVar(), scopeDepth, catchReg});
 
         // Compile catch block
-        for (const auto& s : stmt.getCatchBlock()) {
-            s->accept(*this);
-            resetFreeReg();
-        }
+        compileBlock(stmt.getCatchBlock());
 
         // Pop catch variable
-        while (!locals.empty() && locals.back().depth == scopeDepth) {
-            locals.pop_back();
-        }
-        scopeDepth--;
+        endScope();
 
         // Patch skip JMP
         patchJump(skipCatch);
@@ -1309,8 +1885,7 @@ namespace Pome {
         // Find 'this'
         int thisReg = resolveLocal("this");
         if (thisReg == -1) {
-            std::cerr << "Compiler Error: 'super' used outside of class method at line " << expr.getLine() << std::endl;
-            exit(1);
+            error("'super' used outside of class method at line " + std::to_string(expr.getLine()));
         }
         
         int dest = allocReg();
@@ -1324,15 +1899,8 @@ namespace Pome {
 
     void Compiler::visit(BlockStmt &stmt) {
         scopeDepth++;
-        for (const auto& s : stmt.getStatements()) {
-            s->accept(*this);
-            resetFreeReg();
-        }
-        
-        while (!locals.empty() && locals.back().depth == scopeDepth) {
-            locals.pop_back();
-        }
-        scopeDepth--;
+        compileBlock(stmt.getStatements());
+        endScope();
     }
 
 }
@@ -0,0 +1,318 @@
+#include "../include/pome_ffi.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+
+namespace Pome {
+
+    static constexpr size_t LOCAL_SCRATCH = 256; // Bytes of arguments and result a call keeps on the stack
+    static constexpr size_t LOCAL_VALUES = 16;
+
+    static size_t alignUp(size_t offset, size_t alignment) {
+        return alignment > 1 ? (offset + alignment - 1) / alignment * alignment : offset;
+    }
+
+    static void skipSpace(const std::string& text, size_t& pos) {
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+    }
+
+    bool FfiSignature::isTypeName(const std::string& name) {
+        Type type;
+        std::string error;
+        return parseName(name, type, error);
+    }
+
+    bool FfiSignature::parseName(const std::string& name, Type& type, std::string& error) {
+        if (name == "void") type = {Kind::VOID, &ffi_type_void};
+        else if (name == "int") type = {Kind::INT, &ffi_type_sint32};
+        else if (name == "int64") type = {Kind::INT64, &ffi_type_sint64};
+        else if (name == "float") type = {Kind::FLOAT, &ffi_type_float};
+        else if (name == "double") type = {Kind::DOUBLE, &ffi_type_double};
+        else if (name == "ptr" || name == "buffer") type = {Kind::PTR, &ffi_type_pointer};
+        else if (name == "string") type = {Kind::STRING, &ffi_type_pointer};
+        else {
+            error = "Unknown FFI type '" + name + "'.";
+            return false;
+        }
+        return true;
+    }
+
+    bool FfiSignature::parseType(const std::string& text, size_t& pos, Type& type, std::string& error) {
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == '{') {
+            ++pos;
+            type = {Kind::STRUCT, nullptr};
+            while (true) {
+                Type field;
+                if (!parseType(text, pos, field, error)) return false;
+                if (field.kind == Kind::VOID) {
+                    error = "A struct field cannot be void.";
+                    return false;
+                }
+                type.fields.push_back(std::move(field));
+                skipSpace(text, pos);
+                if (pos < text.size() && text[pos] == ',') {
+                    ++pos;
+                    continue;
+                }
+                if (pos < text.size() && text[pos] == '}') {
+                    ++pos;
+                    return true;
+                }
+                error = "Expected ',' or '}' in a struct type.";
+                return false;
+            }
+        }
+        size_t start = pos;
+        while (pos < text.size() && (isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_')) ++pos;
+        if (pos == start) {
+            error = "Expected a type at position " + std::to_string(start) + ".";
+            return false;
+        }
+        return parseName(text.substr(start, pos - start), type, error);
+    }
+
+    std::unique_ptr<FfiSignature> FfiSignature::parse(const std::string& text, std::string& error) {
+        std::unique_ptr<FfiSignature> signature(new FfiSignature());
+        size_t pos = 0;
+        if (!signature->parseType(text, pos, signature->result_, error)) return nullptr;
+        skipSpace(text, pos);
+        if (pos >= text.size() || text[pos] != '(') {
+            error = "Expected '(' after the result type.";
+            return nullptr;
+        }
+        ++pos;
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == ')') {
+            ++pos;
+        } else {
+            while (true) {
+                Type arg;
+                if (!signature->parseType(text, pos, arg, error)) return nullptr;
+                signature->args_.push_back(std::move(arg));
+                skipSpace(text, pos);
+                if (pos < text.size() && text[pos] == ',') {
+                    ++pos;
+                    continue;
+                }
+                if (pos < text.size() && text[pos] == ')') {
+                    ++pos;
+                    break;
+                }
+                error = "Expected ',' or ')' in the argument list.";
+                return nullptr;
+            }
+        }
+        skipSpace(text, pos);
+        if (pos != text.size()) {
+            error = "Unexpected text after the argument list.";
+            return nullptr;
+        }
+        // "int(void)" takes nothing
+        if (signature->args_.size() == 1 && signature->args_[0].kind == Kind::VOID) signature->args_.clear();
+        if (!signature->prepare(error)) return nullptr;
+        return signature;
+    }
+
+    std::unique_ptr<FfiSignature> FfiSignature::fromNames(const std::string& result, const std::vector<std::string>& args,
+                                                          std::string& error) {
+        std::unique_ptr<FfiSignature> signature(new FfiSignature());
+        if (!signature->parseName(result, signature->result_, error)) return nullptr;
+        for (const std::string& name : args) {
+            Type arg;
+            if (!signature->parseName(name, arg, error)) return nullptr;
+            signature->args_.push_back(std::move(arg));
+        }
+        if (!signature->prepare(error)) return nullptr;
+        return signature;
+    }
+
+    bool FfiSignature::prepare(std::string& error) {
+        // Struct types first, innermost out, so every field's size is known
+        std::function<bool(Type&)> build = [&](Type& type) {
+            if (type.kind != Kind::STRUCT) return true;
+            auto layout = std::make_unique<StructType>();
+            for (Type& field : type.fields) {
+                if (!build(field)) return false;
+                layout->elements.push_back(field.ffi);
+            }
+            layout->elements.push_back(nullptr);
+            layout->type.size = 0;
+            layout->type.alignment = 0;
+            layout->type.type = FFI_TYPE_STRUCT;
+            layout->type.elements = layout->elements.data();
+            std::vector<size_t> offsets(type.fields.size());
+            if (ffi_get_struct_offsets(FFI_DEFAULT_ABI, &layout->type, offsets.data()) != FFI_OK) {
+                error = "libffi cannot lay out a struct of this signature.";
+                return false;
+            }
+            for (size_t i = 0; i < type.fields.size(); ++i) type.fields[i].offset = offsets[i];
+            type.ffi = &layout->type;
+            structs_.push_back(std::move(layout));
+            return true;
+        };
+
+        if (!build(result_)) return false;
+        size_t offset = 0;
+        for (Type& arg : args_) {
+            if (arg.kind == Kind::VOID) {
+                error = "Only the result can be void.";
+                return false;
+            }
+            if (!build(arg)) return false;
+            offset = alignUp(offset, arg.ffi->alignment);
+            arg.offset = offset;
+            offset += arg.ffi->size;
+            argTypes_.push_back(arg.ffi);
+        }
+        // libffi widens small results to a whole ffi_arg
+        resultOffset_ = alignUp(offset, 16);
+        scratchSize_ = resultOffset_ + std::max(result_.ffi->size, sizeof(ffi_arg));
+
+        if (ffi_prep_cif(&cif_, FFI_DEFAULT_ABI, static_cast<unsigned>(args_.size()), result_.ffi,
+                         argTypes_.data()) != FFI_OK) {
+            error = "libffi cannot prepare a call with this signature.";
+            return false;
+        }
+        return true;
+    }
+
+    bool FfiSignature::store(const Type& type, const PomeValue& value, unsigned char* at) {
+        switch (type.kind) {
+        case Kind::INT:
+        case Kind::INT64: {
+            double number;
+            if (value.isNumber()) number = value.asNumber();
+            else if (value.isBool()) number = value.isTrue() ? 1 : 0;
+            else return false;
+            int64_t wide = static_cast<int64_t>(number);
+            if (type.kind == Kind::INT) {
+                int32_t narrow = static_cast<int32_t>(wide);
+                memcpy(at, &narrow, sizeof(narrow));
+            } else {
+                memcpy(at, &wide, sizeof(wide));
+            }
+            return true;
+        }
+        case Kind::FLOAT: {
+            if (!value.isNumber()) return false;
+            float number = static_cast<float>(value.asNumber());
+            memcpy(at, &number, sizeof(number));
+            return true;
+        }
+        case Kind::DOUBLE: {
+            if (!value.isNumber()) return false;
+            double number = value.asNumber();
+            memcpy(at, &number, sizeof(number));
+            return true;
+        }
+        case Kind::PTR:
+        case Kind::STRING: {
+            const void* pointer;
+            if (value.isNil()) pointer = nullptr;
+            else if (value.isString()) pointer = value.asString().c_str();
+            else if (type.kind == Kind::STRING) return false;
+            else if (value.isBuffer()) pointer = value.asBuffer()->data(); // The callee reads and writes it in place
+            else if (value.isObject() && value.asObject()->type() == ObjectType::NATIVE_OBJECT)
+                pointer = static_cast<PomeNativeObject*>(value.asObject())->ptr;
+            else return false;
+            memcpy(at, &pointer, sizeof(pointer));
+            return true;
+        }
+        case Kind::STRUCT: {
+            if (!value.isList()) return false;
+            PomeList* fields = value.asList();
+            if (fields->size() < type.fields.size()) return false;
+            for (size_t i = 0; i < type.fields.size(); ++i) {
+                if (!store(type.fields[i], fields->at(i), at + type.fields[i].offset)) return false;
+            }
+            return true;
+        }
+        case Kind::VOID:
+            break;
+        }
+        return false;
+    }
+
+    PomeValue FfiSignature::load(GarbageCollector& gc, const Type& type, const unsigned char* at) {
+        switch (type.kind) {
+        case Kind::VOID:
+            return PomeValue();
+        case Kind::INT: {
+            int32_t number;
+            memcpy(&number, at, sizeof(number));
+            return PomeValue(static_cast<double>(number));
+        }
+        case Kind::INT64: {
+            int64_t number;
+            memcpy(&number, at, sizeof(number));
+            return PomeValue(static_cast<double>(number));
+        }
+        case Kind::FLOAT: {
+            float number;
+            memcpy(&number, at, sizeof(number));
+            return PomeValue(static_cast<double>(number));
+        }
+        case Kind::DOUBLE: {
+            double number;
+            memcpy(&number, at, sizeof(number));
+            return PomeValue(number);
+        }
+        case Kind::PTR:
+        case Kind::STRING: {
+            void* pointer;
+            memcpy(&pointer, at, sizeof(pointer));
+            if (!pointer) return PomeValue();
+            if (type.kind == Kind::STRING) return PomeValue(gc.allocateString(static_cast<const char*>(pointer)));
+            return PomeValue(gc.allocate<PomeNativeObject>(pointer, "ptr"));
+        }
+        case Kind::STRUCT: {
+            PomeList* fields = gc.allocateList();
+            RootGuard fieldsGuard(gc, fields);
+            for (const Type& field : type.fields) {
+                PomeValue value = load(gc, field, at + field.offset);
+                fields->push(gc, value);
+                gc.writeBarrier(fields, value);
+            }
+            return PomeValue(fields);
+        }
+        }
+        return PomeValue();
+    }
+
+    PomeValue FfiSignature::call(GarbageCollector& gc, void* function, const PomeValue* args) const {
+        alignas(16) unsigned char localScratch[LOCAL_SCRATCH];
+        void* localValues[LOCAL_VALUES];
+        std::unique_ptr<unsigned char[]> heapScratch;
+        std::unique_ptr<void*[]> heapValues;
+        unsigned char* scratch = localScratch;
+        void** values = localValues;
+        if (scratchSize_ > LOCAL_SCRATCH) {
+            heapScratch.reset(new unsigned char[scratchSize_]);
+            scratch = heapScratch.get();
+        }
+        if (args_.size() > LOCAL_VALUES) {
+            heapValues.reset(new void*[args_.size()]);
+            values = heapValues.get();
+        }
+
+        for (size_t i = 0; i < args_.size(); ++i) {
+            unsigned char* at = scratch + args_[i].offset;
+            if (!store(args_[i], args[i], at)) return PomeValue();
+            values[i] = at;
+        }
+        unsigned char* result = scratch + resultOffset_;
+        ffi_call(const_cast<ffi_cif*>(&cif_), FFI_FN(function), result, values);
+
+        if (result_.kind == Kind::INT) {
+            // Returned widened to an ffi_arg
+            ffi_sarg widened;
+            memcpy(&widened, result, sizeof(widened));
+            return PomeValue(static_cast<double>(static_cast<int32_t>(widened)));
+        }
+        return load(gc, result_, result);
+    }
+
+} // namespace Pome
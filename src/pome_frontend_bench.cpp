@@ -0,0 +1,100 @@
+// Front-end throughput: how fast the Lexer and Parser get through source text.
+//
+//   pome-frontend-bench [file.pome ...]
+//
+// With no files, a synthetic script of about 8 MB is generated. Each phase runs
+// a few times and the best time is reported.
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pome_lexer.h"
+#include "pome_parser.h"
+
+using namespace Pome;
+
+static constexpr int RUNS = 5;
+static constexpr size_t SYNTHETIC_BYTES = 8 * 1024 * 1024;
+
+// Functions, classes, loops and literals in the proportions of a typical generated script
+static std::string syntheticSource() {
+    std::string source;
+    for (int i = 0; source.size() < SYNTHETIC_BYTES; ++i) {
+        std::string n = std::to_string(i);
+        source += "fun compute_" + n + "(a, b) {\n"
+                  "    var total = 0;\n"
+                  "    for (var i = 0; i < a; i = i + 1) {\n"
+                  "        if (i % 3 == 0 and b > 2) { total = total + i * b; } else { total = total - 1.5; }\n"
+                  "    }\n"
+                  "    return total > 100 ? \"big_" + n + "\" : [total, a, b, {\"key\": \"value\\n\"}];\n"
+                  "}\n"
+                  "class Shape_" + n + " {\n"
+                  "    fun init(w, h) { this.w = w; this.h = h; }\n"
+                  "    fun area() { return this.w * this.h; }\n"
+                  "}\n"
+                  "var shape_" + n + " = Shape_" + n + "(" + n + ", 2);\n"
+                  "print(compute_" + n + "(shape_" + n + ".area(), " + n + "));\n";
+    }
+    return source;
+}
+
+template <typename Fn>
+static double bestSeconds(Fn fn) {
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+static void report(const char* phase, size_t bytes, double seconds) {
+    std::cout << "  " << std::left << std::setw(14) << phase << std::right << std::fixed << std::setprecision(2)
+              << std::setw(9) << seconds * 1000 << " ms  " << std::setw(9) << bytes / (1024.0 * 1024.0) / seconds
+              << " MB/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string source = argc < 2 ? syntheticSource() : std::string();
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream file(argv[i]);
+        if (!file.is_open()) {
+            std::cerr << "Could not open file '" << argv[i] << "'." << std::endl;
+            return 74;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        source += buffer.str();
+        source += "\n";
+    }
+
+    size_t tokens = 0;
+    double lexSeconds = bestSeconds([&] {
+        Lexer lexer(source);
+        tokens = 0;
+        while (lexer.getNextToken().type != TokenType::END_OF_FILE) ++tokens;
+    });
+
+    size_t statements = 0;
+    size_t arenaBytes = 0;
+    double parseSeconds = bestSeconds([&] {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        auto program = parser.parseProgram();
+        statements = program->getStatements().size();
+        arenaBytes = program->getArena() ? program->getArena()->bytesReserved() : 0;
+    });
+
+    std::cout << "Front end: " << source.size() << " bytes, " << tokens << " tokens, " << statements
+              << " top-level statements, " << arenaBytes / 1024 << " KB of AST arena" << std::endl;
+    report("lex", source.size(), lexSeconds);
+    report("lex + parse", source.size(), parseSeconds);
+    return 0;
+}
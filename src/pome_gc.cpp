@@ -1,14 +1,91 @@
 #include "../include/pome_gc.h"
 #include "../include/pome_vm.h"
 #include "../include/pome_value.h"
+#include "../include/pome_shape.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <cstdio>
 #include <sstream>
 #include <fstream>
+#include <thread>
 #include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace Pome {
 
-GarbageCollector::GarbageCollector() {}
+// The queue of the mark worker running on this thread, while parallelMarking_ is set
+static thread_local MarkQueue* workerQueue = nullptr;
+
+static size_t defaultThreadCount(size_t configured) {
+    if (configured > 0) return configured;
+    size_t cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+GarbageCollector::GarbageCollector()
+    : heapId_(nextHeapId_.fetch_add(1, std::memory_order_relaxed)), pauseTargetMs_(defaultPauseTargetMs_),
+      gcThreads_(defaultThreadCount(defaultGcThreads_)), trace_(defaultTrace_) {}
+
+GarbageCollector::~GarbageCollector() {
+    // Other heaps may still use an isolate's objects (its functions, say), but nothing outlives a transfer heap
+    if (!transfer_) return;
+    PomeObject* obj = youngObjects_;
+    while (obj) {
+        PomeObject* next = obj->next;
+        delete obj;
+        obj = next;
+    }
+}
+
+std::unique_ptr<GarbageCollector> GarbageCollector::createTransferHeap() {
+    auto heap = std::make_unique<GarbageCollector>();
+    heap->transfer_ = true;
+    heap->deferrals_ = 1; // For good: nothing roots what it holds
+    heap->gcThreads_ = 1;
+    return heap;
+}
+
+void GarbageCollector::adopt(GarbageCollector& transfer) {
+    // Never collected, so every object is young, heap-allocated and unmarked
+    PomeObject* last = nullptr;
+    for (PomeObject* obj = transfer.youngObjects_; obj; obj = obj->next) {
+        obj->heapId = heapId_;
+        // Our intern pool has its own copy of the value; this one compares by contents
+        if (obj->type() == ObjectType::STRING) static_cast<PomeString*>(obj)->interned = false;
+        last = obj;
+    }
+    if (last) {
+        last->next = youngObjects_;
+        youngObjects_ = transfer.youngObjects_;
+        transfer.youngObjects_ = nullptr;
+    }
+    transfer.stringPool_.eraseIf([](PomeString*) { return true; });
+    zct_.insert(zct_.end(), transfer.zct_.begin(), transfer.zct_.end());
+    transfer.zct_.clear();
+
+    bytesAllocated_ += transfer.bytesAllocated_;
+    youngBytesAllocated_ += transfer.bytesAllocated_;
+    transfer.bytesAllocated_ = 0;
+    transfer.youngBytesAllocated_ = 0;
+
+    for (FrozenReference& ref : transfer.frozenHeaps_) retainFrozen(ref.heap);
+    transfer.frozenHeaps_.clear();
+    if (isCollectionDue()) pendingGC = true;
+}
+
+size_t GarbageCollector::getRSS() {
+    // statm holds page counts, the second being the resident set
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    unsigned long size = 0, resident = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    return fields == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+}
 
 void GarbageCollector::setVM(VM* vm) {
     vm_ = vm;
@@ -19,24 +96,29 @@ PomeShape* GarbageCollector::getRootShape() const {
     return nullptr;
 }
 
-PomeString* GarbageCollector::allocateString(const std::string& value) {
-    auto it = stringPool_.find(value);
-    if (it != stringPool_.end()) {
-        return it->second;
+PomeString* GarbageCollector::allocateString(std::string_view value) {
+    size_t hash = std::hash<std::string_view>{}(value);
+    if (PomeString* pooled = stringPool_.find(value, hash)) {
+        return pooled;
     }
 
-    if (youngBytesAllocated_ > nextMinorGC_) collect(true);
-    if (bytesAllocated_ > nextGC_) collect(false);
+    if (isCollectionDue()) collectIfDue();
 
     PomeString* str = nullptr;
     try {
-        str = new PomeString(value);
+        if (transfer_) {
+            str = new PomeString(std::string(value), hash);
+        } else {
+            str = new (nursery_) PomeString(std::string(value), hash);
+            str->slotSize = Nursery::slotSize(sizeof(PomeString));
+        }
     } catch (const std::bad_alloc& e) {
         collect(false);
-        str = new PomeString(value);
+        str = new PomeString(std::string(value), hash);
     }
 
     str->gcSize = sizeof(PomeString) + str->extraSize();
+    str->heapId = heapId_;
 
     str->generation = 0;
     str->age = 0;
@@ -44,23 +126,62 @@ PomeString* GarbageCollector::allocateString(const std::string& value) {
     str->inZCT = true;
     zct_.push_back(str);
 
-    str->isMarked = false;
+    str->setMarked(false);
     str->next = youngObjects_;
     youngObjects_ = str;
 
     bytesAllocated_ += str->gcSize;
     youngBytesAllocated_ += str->gcSize;
 
-    stringPool_[str->getValue()] = str;
+    str->interned = true;
+    stringPool_.insert(str);
     return str;
 }
 
+PomeString* GarbageCollector::concatStrings(const PomeString* left, const std::string& right) {
+    size_t length = left->length() + right.size();
+    if (left->length() < BUILDER_MIN_LENGTH) {
+        std::string value;
+        value.reserve(length);
+        left->appendTo(value);
+        value.append(right);
+        return allocateString(value);
+    }
+
+    // Builders are not interned until flattened, and then only compared by contents
+    std::shared_ptr<std::string> buffer = left->extensibleBuffer();
+    size_t offset = left->bufferOffset();
+    size_t appended = right.size();
+    if (!buffer) {
+        buffer = std::make_shared<std::string>();
+        buffer->reserve(length * 2);
+        left->appendTo(*buffer);
+        offset = 0;
+        appended = length;
+    }
+    buffer->append(right);
+    return allocate<PomeString>(std::move(buffer), offset, length, appended);
+}
+
+PomeString* GarbageCollector::sliceString(const PomeString* str, size_t start, size_t length) {
+    size_t size = str->length();
+    if (start > size) start = size;
+    if (length > size - start) length = size - start;
+    if (start == 0 && length == size && str->interned) return const_cast<PomeString*>(str);
+
+    // Short slices are cheaper to copy, and small ones of a large string would keep all of it alive
+    if (length < SLICE_MIN_LENGTH || length * SLICE_MAX_PIN < str->backingLength()) {
+        return allocateString(str->view().substr(start, length));
+    }
+    return allocate<PomeString>(str, start, length);
+}
+
 PomeList* GarbageCollector::allocateList() {
-    if (youngBytesAllocated_ > nextMinorGC_) collect(true);
-    if (bytesAllocated_ > nextGC_) collect(false);
+    if (isCollectionDue()) collectIfDue();
 
     PomeList* list = nullptr;
     if (!listPool_.empty()) {
+        stats_.listPoolHits++;
         list = static_cast<PomeList*>(listPool_.back());
         listPool_.pop_back();
         list->listType = ListType::MIXED;
@@ -72,18 +193,25 @@ PomeList* GarbageCollector::allocateList() {
         }
         list->gcSize = sizeof(PomeList) + list->extraSize();
     } else {
-        list = new PomeList();
+        stats_.listPoolMisses++;
+        if (transfer_) {
+            list = new PomeList();
+        } else {
+            list = new (nursery_) PomeList();
+            list->slotSize = Nursery::slotSize(sizeof(PomeList));
+        }
         list->listType = ListType::MIXED;
         list->gcSize = sizeof(PomeList);
     }
 
+    list->heapId = heapId_;
     list->generation = 0;
     list->age = 0;
     list->refCount = 0;
     list->inZCT = true;
     zct_.push_back(list);
 
-    list->isMarked = false;
+    list->setMarked(false);
     list->next = youngObjects_;
     youngObjects_ = list;
 
@@ -97,12 +225,8 @@ void GarbageCollector::updateSize(PomeObject* obj, size_t oldSize, size_t newSiz
     if (newSize > oldSize) {
         size_t diff = newSize - oldSize;
         bytesAllocated_ += diff;
-        if (obj->generation == 0) {
-            youngBytesAllocated_ += diff;
-            if (youngBytesAllocated_ > nextMinorGC_) pendingGC = true;
-        } else {
-            if (bytesAllocated_ > nextGC_) pendingGC = true;
-        }
+        if (obj->generation == 0) youngBytesAllocated_ += diff;
+        if (isCollectionDue()) pendingGC = true;
         obj->gcSize = newSize;
         // std::cout << "[GC_ALLOC] Grow obj type " << (int)obj->type() << " " << oldSize << " -> " << newSize << " Total=" << bytesAllocated_/1024 << "KB" << std::endl;
     } else if (oldSize > newSize) {
@@ -119,25 +243,130 @@ void GarbageCollector::updateSize(PomeObject* obj, size_t oldSize, size_t newSiz
 }
 
 void GarbageCollector::collect(bool minor) {
+    PauseStart start = beginPause();
+    Pause::Kind kind = minor ? Pause::Kind::MINOR : Pause::Kind::MAJOR;
+    if (phase_ == Phase::MARKING) {
+        // A minor collection would trip over the major marks; finishing the cycle collects the young generation too
+        finishMarking();
+        if (!minor) finishSweeping();
+        endPause(kind, start);
+        return;
+    }
+    if (phase_ == Phase::SWEEPING) {
+        // Live objects not yet swept are still marked, and a minor collection would not trace through them
+        finishSweeping();
+        if (!minor) {
+            endPause(kind, start);
+            return;
+        }
+    }
     gcCount_++;
-    size_t before = bytesAllocated_;
     mark(minor);
+    if (!minor) releaseUnreachedFrozen();
     sweep(minor);
-    // std::cout << "[GC_EVENT] " << (minor ? "Minor" : "Major") << " freed=" << (before - bytesAllocated_)/1024 << "KB remaining=" << bytesAllocated_/1024 << "KB RSS=" << getRSS() << "KB" << std::endl;
+    endPause(kind, start);
 }
 
-void GarbageCollector::writeBarrier(PomeObject* parent, const PomeValue& child) {
-    if (parent && parent->generation == 1 && child.isObject()) {
-        PomeObject* childObj = child.asObject();
-        if (childObj && childObj->generation == 0) {
-            for (auto* obj : rememberedSet_) {
-                if (obj == parent) return;
+void GarbageCollector::collectIfDue() {
+    if (youngBytesAllocated_ > nextMinorGC_) {
+        // A minor collection now would finish the marking phase in one pause, so the young generation
+        // is left to grow for a while and the slices below get the chance to finish it first
+        if (phase_ != Phase::MARKING || youngBytesAllocated_ > nextMinorGC_ * MINOR_DEFERRAL_FACTOR) collect(true);
+    }
+    if (bytesAllocated_ <= nextStep_) return;
+
+    PauseStart start = beginPause();
+    switch (phase_) {
+        case Phase::IDLE:
+            if (pauseTargetMs_ <= 0) {
+                collect(false);
+                return;
             }
-            rememberedSet_.push_back(parent);
-        }
+            startCycle();
+            endPause(Pause::Kind::MARK_SLICE, start);
+            break;
+        case Phase::MARKING:
+            markSlice();
+            endPause(Pause::Kind::MARK_SLICE, start);
+            break;
+        case Phase::SWEEPING:
+            sweepSlice();
+            endPause(Pause::Kind::SWEEP_SLICE, start);
+            break;
+    }
+}
+
+const char* GarbageCollector::Pause::kindName(Kind kind) {
+    switch (kind) {
+        case Kind::MINOR: return "minor";
+        case Kind::MAJOR: return "major";
+        case Kind::MARK_SLICE: return "mark_slice";
+        case Kind::SWEEP_SLICE: return "sweep_slice";
+    }
+    return "unknown";
+}
+
+void GarbageCollector::endPause(Pause::Kind kind, const PauseStart& start) {
+    Pause pause;
+    pause.kind = kind;
+    pause.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start.time).count();
+    pause.heapBefore = start.heap;
+    pause.heapAfter = bytesAllocated_;
+    pause.promotedBytes = promotedBytes_ - start.promoted;
+
+    size_t k = static_cast<size_t>(kind);
+    stats_.pauseCount[k]++;
+    stats_.pauseTotalMs[k] += pause.milliseconds;
+    stats_.pauseMaxMs[k] = std::max(stats_.pauseMaxMs[k], pause.milliseconds);
+    size_t bucket = 0;
+    while (bucket < Stats::HISTOGRAM_BUCKETS - 1 && pause.milliseconds >= Stats::HISTOGRAM_BOUNDS[bucket]) bucket++;
+    stats_.histogram[bucket]++;
+    stats_.reclaimedBytes += pause.reclaimedBytes();
+    stats_.promotedBytes += pause.promotedBytes;
+    stats_.recent.push_back(pause);
+    if (stats_.recent.size() > Stats::RECENT_PAUSES) stats_.recent.pop_front();
+
+    if (trace_ != TraceFormat::OFF) tracePause(pause);
+}
+
+void GarbageCollector::tracePause(const Pause& pause) const {
+    // One write per line, so isolates tracing at once do not interleave within a line
+    char line[320];
+    if (trace_ == TraceFormat::JSON) {
+        std::snprintf(line, sizeof(line),
+                      "{\"gc\":%zu,\"kind\":\"%s\",\"pause_ms\":%.3f,\"heap_before\":%zu,\"heap_after\":%zu,"
+                      "\"reclaimed\":%zu,\"promoted\":%zu,\"young\":%zu,\"zct\":%zu,\"remembered\":%zu}\n",
+                      gcCount_, Pause::kindName(pause.kind), pause.milliseconds, pause.heapBefore, pause.heapAfter,
+                      pause.reclaimedBytes(), pause.promotedBytes, youngBytesAllocated_, zct_.size(), rememberedSet_.size());
+    } else {
+        static std::once_flag header;
+        std::call_once(header, [] {
+            std::fputs("gc,kind,pause_ms,heap_before,heap_after,reclaimed,promoted,young,zct,remembered\n", stderr);
+        });
+        std::snprintf(line, sizeof(line), "%zu,%s,%.3f,%zu,%zu,%zu,%zu,%zu,%zu,%zu\n",
+                      gcCount_, Pause::kindName(pause.kind), pause.milliseconds, pause.heapBefore, pause.heapAfter,
+                      pause.reclaimedBytes(), pause.promotedBytes, youngBytesAllocated_, zct_.size(), rememberedSet_.size());
+    }
+    std::fputs(line, stderr);
+}
+
+void GarbageCollector::writeBarrier(PomeObject* parent, const PomeValue& child) {
+    if (!child.isObject()) return;
+    PomeObject* childObj = child.asObject();
+    if (!childObj) return;
+    // Dijkstra insertion barrier: nothing stored while marking can hide behind an already scanned object
+    if (phase_ == Phase::MARKING && !childObj->marked()) markObject(childObj);
+    if (parent && parent->generation == 1 && childObj->generation == 0 && !parent->isRemembered) {
+        parent->isRemembered = true;
+        rememberedSet_.push_back(parent);
     }
 }
 
+void GarbageCollector::clearRememberedSet() {
+    for (auto* obj : rememberedSet_) obj->isRemembered = false;
+    rememberedSet_.clear();
+}
+
 void GarbageCollector::rcWriteBarrier(PomeValue* slot, const PomeValue& newValue) {
     if (slot->isObject()) decrementRef(slot->asObject());
     *slot = newValue;
@@ -155,13 +384,17 @@ void GarbageCollector::rcMapSet(std::unordered_map<PomeValue, PomeValue>& map, c
     }
 }
 
-void GarbageCollector::mark(bool minor) {
+void GarbageCollector::markRootSet() {
     if (vm_) {
         vm_->markRoots();
     }
     for (auto* obj : tempRoots_) {
         markObject(obj);
     }
+}
+
+void GarbageCollector::mark(bool minor) {
+    markRootSet();
     if (minor) {
         for (auto* obj : rememberedSet_) {
             markObject(obj);
@@ -171,6 +404,10 @@ void GarbageCollector::mark(bool minor) {
 }
 
 void GarbageCollector::traceReferences(bool minor) {
+    if (useParallel()) {
+        traceParallel(Deadline::max());
+        return;
+    }
     while (!grayStack_.empty()) {
         PomeObject* object = grayStack_.back();
         grayStack_.pop_back();
@@ -179,47 +416,152 @@ void GarbageCollector::traceReferences(bool minor) {
 }
 
 void GarbageCollector::markObject(PomeObject* object) {
-    if (object == nullptr || object->isMarked) return;
-    object->isMarked = true;
+    if (object == nullptr || object->marked()) return;
+    // Isolates run functions owned by the heap that started them; that heap alone marks them
+    if (object->heapId != heapId_) {
+        if (object->frozen) noteFrozen(object->heapId);
+        return;
+    }
+    if (parallelMarking_) {
+        // Two workers can reach the same object; only the one that sets the bit traces it
+        if (object->tryMark()) workerQueue->push(object);
+        return;
+    }
+    object->setMarked(true);
     grayStack_.push_back(object);
 }
 
+void GarbageCollector::retainFrozen(std::shared_ptr<FrozenHeap> heap) {
+    if (!heap) return;
+    // A mark in progress may already have passed where the value is going
+    bool marking = phase_ == Phase::MARKING;
+    for (FrozenReference& ref : frozenHeaps_) {
+        if (ref.heapId == heap->heapId()) {
+            if (marking) ref.reached.store(true, std::memory_order_relaxed);
+            return;
+        }
+    }
+    frozenHeaps_.emplace_back();
+    frozenHeaps_.back().heapId = heap->heapId();
+    frozenHeaps_.back().heap = std::move(heap);
+    frozenHeaps_.back().reached.store(marking, std::memory_order_relaxed);
+}
+
+void GarbageCollector::retainFrozen(const PomeObject* frozen) {
+    if (frozen->heapId == heapId_) return;
+    for (FrozenReference& ref : frozenHeaps_) {
+        if (ref.heapId == frozen->heapId) {
+            if (phase_ == Phase::MARKING) ref.reached.store(true, std::memory_order_relaxed);
+            return;
+        }
+    }
+    retainFrozen(FrozenHeap::find(frozen->heapId));
+}
+
+void GarbageCollector::noteFrozen(uint32_t heapId) {
+    for (FrozenReference& ref : frozenHeaps_) {
+        if (ref.heapId == heapId) {
+            ref.reached.store(true, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+void GarbageCollector::releaseUnreachedFrozen() {
+    // Only a frozen heap retains the heaps its own values point into, and it never marks
+    if (transfer_) return;
+    frozenHeaps_.remove_if([](const FrozenReference& ref) { return !ref.reached.load(std::memory_order_relaxed); });
+    for (FrozenReference& ref : frozenHeaps_) ref.reached.store(false, std::memory_order_relaxed);
+}
+
+bool GarbageCollector::traceParallel(Deadline deadline) {
+    size_t count = gcThreads_; 
+    std::vector<MarkQueue> queues(count);
+    for (size_t i = 0; i < grayStack_.size(); ++i) queues[i % count].push(grayStack_[i]);
+    grayStack_.clear();
+
+    std::atomic<size_t> idle{0};
+    std::atomic<bool> expired{false};
+    parallelMarking_ = true;
+    runGcWorkers(count, [&](size_t id) {
+        MarkQueue& queue = queues[id];
+        workerQueue = &queue;
+        size_t traced = 0;
+        while (!expired.load(std::memory_order_relaxed)) {
+            while (!queue.local.empty()) {
+                if (++traced % CLOCK_CHECK_INTERVAL == 0 &&
+                    (expired.load(std::memory_order_relaxed) || std::chrono::steady_clock::now() >= deadline)) {
+                    expired.store(true, std::memory_order_relaxed);
+                    break;
+                }
+                PomeObject* object = queue.local.back();
+                queue.local.pop_back();
+                object->markChildren(*this);
+                queue.maybeShare();
+            }
+            if (!queue.local.empty()) break;
+
+            bool stole = false;
+            for (size_t i = 0; i < count && !stole; ++i) stole = queue.stealFrom(queues[(id + i) % count]);
+            if (stole) continue;
+
+            // Marking is over once every worker is idle, since only a busy worker can offer more
+            idle.fetch_add(1);
+            bool done = true;
+            while (!expired.load(std::memory_order_relaxed) && idle.load() < count) {
+                bool offered = false;
+                for (auto& other : queues) offered = offered || other.hasOffer();
+                if (offered) {
+                    idle.fetch_sub(1);
+                    done = false;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            if (done) break;
+        }
+        workerQueue = nullptr;
+    });
+    parallelMarking_ = false;
+
+    for (auto& queue : queues) queue.drainInto(grayStack_);
+    return grayStack_.empty();
+}
+
 void GarbageCollector::markValue(const PomeValue& value) {
     value.mark(*this);
 }
 
+// Frozen objects are read by many threads at once, so nothing counts references to them
 void GarbageCollector::incrementRef(PomeObject* obj) {
-    if (obj) obj->refCount++;
+    if (obj && !obj->frozen) obj->refCount++;
 }
 
 void GarbageCollector::decrementRef(PomeObject* obj) {
-    if (obj && obj->refCount > 0) {
+    if (obj && !obj->frozen && obj->refCount > 0) {
         obj->refCount--;
         if (obj->refCount == 0) addToZCT(obj);
     }
 }
 
 void GarbageCollector::addToZCT(PomeObject* obj) {
-    if (obj && !obj->inZCT) {
+    if (obj && !obj->inZCT && !obj->frozen) {
         obj->inZCT = true;
         zct_.push_back(obj);
     }
 }
 
 void GarbageCollector::processZCT() {
-    if (zct_.size() < 1000) return;
+    // Its marks would clobber those of an incremental cycle
+    if (zct_.size() < 1000 || phase_ != Phase::IDLE) return;
     
-    // Scan roots (stack, etc.) to identify referenced objects.
-    if (vm_) {
-        vm_->markRoots();
-    }
-    for (auto* obj : tempRoots_) {
-        markObject(obj);
-    }
+    // Scan roots (stack, etc.) to identify referenced objects. Nothing is traced,
+    // so the gray stack ends up holding exactly the objects marked here.
+    markRootSet();
     
     std::vector<PomeObject*> survivors;
     for (auto* obj : zct_) {
-        if (obj->refCount > 0 || obj->isMarked) {
+        if (obj->refCount > 0 || obj->marked()) {
             obj->inZCT = true;
             survivors.push_back(obj);
         } else {
@@ -228,12 +570,10 @@ void GarbageCollector::processZCT() {
         }
     }
     zct_ = std::move(survivors);
-    
-    // Reset marks
-    PomeObject* obj = youngObjects_;
-    while (obj) { obj->isMarked = false; obj = obj->next; }
-    obj = oldObjects_;
-    while (obj) { obj->isMarked = false; obj = obj->next; }
+
+    // Reset marks without walking the heap
+    for (auto* obj : grayStack_) obj->setMarked(false);
+    grayStack_.clear();
 }
 
 void GarbageCollector::markTable(std::map<PomeValue, PomeValue>& table) {
@@ -243,110 +583,268 @@ void GarbageCollector::markTable(std::map<PomeValue, PomeValue>& table) {
     }
 }
 
-void sweepList(GarbageCollector& gc, PomeObject** listHead, size_t& bytesAllocated, std::vector<PomeObject*>& listPool, bool resetMark) {
-    PomeObject** object = listHead;
-    while (*object) {
-        if ((*object)->isMarked) {
-            if (resetMark) (*object)->isMarked = false;
-            object = &(*object)->next;
-        } else {
-            PomeObject* unreached = *object;
-            *object = unreached->next;
-            bytesAllocated -= unreached->gcSize;
-            
-            // DecRef children of objects being swept to maintain RC consistency
-            // Wait, we only do this for RC-enabled fields.
-            // But markChildren handles exactly the fields we care about.
-            // However, markChildren uses gc.markObject.
-            // We need a way to decRef children instead.
-            
-            if (unreached->type() == ObjectType::LIST && listPool.size() < 1000) {
-                PomeList* lst = static_cast<PomeList*>(unreached);
-                if (!lst->isUnboxed()) {
-                    for (auto& val : lst->elements) val.decRef(gc);
-                }
-                if (lst->unboxedData) free(lst->unboxedData);
-                lst->unboxedData = nullptr;
-                lst->unboxedCount = 0;
-                lst->unboxedCapacity = 0;
-                lst->listType = ListType::MIXED;
-                lst->elements.clear();
-                if (lst->elements.capacity() > 256) lst->elements.shrink_to_fit();
-                listPool.push_back(lst);
-            } else {
-                if (unreached->type() == ObjectType::STRING) {
-                    gc.removeStringFromPool(static_cast<PomeString*>(unreached)->getValue());
-                }
-                delete unreached;
-            }
+void GarbageCollector::release(PomeObject* unreached) {
+    bytesAllocated_ -= unreached->gcSize;
+    // Children are not decRef'd: they may already be gone, and reference counts here only steer the ZCT
+    if (unreached->type() == ObjectType::LIST && listPool_.size() < 1000) {
+        PomeList* lst = static_cast<PomeList*>(unreached);
+        if (lst->unboxedData) free(lst->unboxedData);
+        lst->unboxedData = nullptr;
+        lst->unboxedCount = 0;
+        lst->unboxedCapacity = 0;
+        lst->listType = ListType::MIXED;
+        lst->elements.clear();
+        if (lst->elements.capacity() > 256) lst->elements.shrink_to_fit();
+        listPool_.push_back(lst);
+    } else {
+        if (unreached->type() == ObjectType::STRING) {
+            removeStringFromPool(static_cast<PomeString*>(unreached));
         }
+        freeObject(unreached);
     }
 }
 
+void GarbageCollector::removeStringFromPool(PomeString* str) {
+    if (str->interned) stringPool_.erase(str);
+}
+
 void GarbageCollector::sweep(bool minor) {
-    if (!minor) {
-        sweepList(*this, &oldObjects_, bytesAllocated_, listPool_, true);
+    // Cleared first: a major sweep may free remembered objects
+    clearRememberedSet();
+    if (!minor && useParallel()) {
+        PomeObject* tail = nullptr;
+        oldObjects_ = sweepParallel(oldObjects_, tail);
     } else {
-        PomeObject* obj = oldObjects_;
-        while (obj) {
-            obj->isMarked = false;
-            obj = obj->next;
+        PomeObject** object = &oldObjects_;
+        while (*object) {
+            PomeObject* current = *object;
+            if (current->marked()) {
+                current->setMarked(false);
+                object = &current->next;
+            } else if (minor) {
+                object = &current->next;
+            } else {
+                *object = current->next;
+                release(current);
+            }
         }
     }
+    sweepYoung();
+    nursery_.reclaim();
+    if (!minor) {
+        nextGC_ = bytesAllocated_ * 2;
+        if (nextGC_ < MIN_MAJOR_THRESHOLD) nextGC_ = MIN_MAJOR_THRESHOLD;
+        nextStep_ = nextGC_;
+    }
+}
 
+void GarbageCollector::sweepYoung() {
+    stats_.sweptYoungBytes += youngBytesAllocated_;
     youngBytesAllocated_ = 0;
     PomeObject** object = &youngObjects_;
     while (*object) {
-        if ((*object)->isMarked) {
-            (*object)->isMarked = false;
-            PomeObject* survivor = *object;
-            survivor->age++;
-            if (survivor->age >= 2) {
-                *object = survivor->next;
-                survivor->generation = 1;
-                survivor->next = oldObjects_;
-                oldObjects_ = survivor;
+        PomeObject* current = *object;
+        if (current->marked()) {
+            current->setMarked(false);
+            current->age++;
+            if (current->age >= 2) {
+                *object = current->next;
+                current->generation = 1;
+                promotedBytes_ += current->gcSize;
+                current->next = oldObjects_;
+                oldObjects_ = current;
             } else {
-                youngBytesAllocated_ += survivor->gcSize;
-                object = &survivor->next;
+                youngBytesAllocated_ += current->gcSize;
+                object = &current->next;
             }
         } else {
-            PomeObject* unreached = *object;
-            *object = unreached->next;
-            bytesAllocated_ -= unreached->gcSize;
-
-            // DecRef children for RC consistency
-            if (unreached->type() == ObjectType::LIST) {
-                PomeList* lst = static_cast<PomeList*>(unreached);
-                if (!lst->isUnboxed()) {
-                    for (auto& val : lst->elements) val.decRef(*this);
-                }
-            }
-            // Add more types here if needed, or implement a virtual decRefChildren
-
-            if (unreached->type() == ObjectType::LIST && listPool_.size() < 1000) {
-                PomeList* lst = static_cast<PomeList*>(unreached);
-                if (lst->unboxedData) free(lst->unboxedData);
-                lst->unboxedData = nullptr;
-                lst->unboxedCount = 0;
-                lst->unboxedCapacity = 0;
-                lst->listType = ListType::MIXED;
-                lst->elements.clear();
-                if (lst->elements.capacity() > 256) lst->elements.shrink_to_fit();
-                listPool_.push_back(lst);
-            } else {
-                if (unreached->type() == ObjectType::STRING) {
-                    removeStringFromPool(static_cast<PomeString*>(unreached)->getValue());
+            *object = current->next;
+            release(current);
+        }
+    }
+}
+
+void GarbageCollector::startCycle() {
+    gcCount_++;
+    phase_ = Phase::MARKING;
+    markRootSet();
+    markSlice();
+}
+
+void GarbageCollector::markSlice() {
+    Deadline deadline = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(pauseTargetMs_);
+    if (useParallel() && !traceParallel(deadline)) {
+        nextStep_ = bytesAllocated_ + SLICE_INTERVAL;
+        return;
+    }
+    size_t traced = 0;
+    while (!grayStack_.empty()) {
+        PomeObject* object = grayStack_.back();
+        grayStack_.pop_back();
+        object->markChildren(*this);
+        if (++traced % CLOCK_CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() >= deadline) {
+            nextStep_ = bytesAllocated_ + SLICE_INTERVAL;
+            return;
+        }
+    }
+    finishMarking();
+}
+
+void GarbageCollector::finishMarking() {
+    // Roots and young objects take stores without a barrier, so they are scanned again
+    markRootSet();
+    for (PomeObject* obj = youngObjects_; obj; obj = obj->next) {
+        if (obj->marked()) grayStack_.push_back(obj);
+    }
+    traceReferences(false);
+
+    // Nothing unmarked can be reached again, but the intern pool could still hand it out
+    stringPool_.eraseIf([](PomeString* str) { return !str->marked(); });
+    clearRememberedSet();
+    releaseUnreachedFrozen();
+
+    // Old objects are swept in slices from here; survivors and newly promoted objects collect in oldObjects_
+    unsweptObjects_ = oldObjects_;
+    oldObjects_ = nullptr;
+    phase_ = Phase::SWEEPING;
+    sweepYoung();
+    nursery_.reclaim();
+    nextStep_ = bytesAllocated_ + SLICE_INTERVAL;
+}
+
+void GarbageCollector::sweepSlice() {
+    Deadline deadline = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(pauseTargetMs_);
+    size_t swept = 0;
+    while (unsweptObjects_) {
+        PomeObject* current = unsweptObjects_;
+        unsweptObjects_ = current->next;
+        if (current->marked()) {
+            current->setMarked(false);
+            current->next = oldObjects_;
+            oldObjects_ = current;
+        } else {
+            release(current);
+        }
+        if (++swept % CLOCK_CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() >= deadline) {
+            nextStep_ = bytesAllocated_ + SLICE_INTERVAL;
+            return;
+        }
+    }
+    finishCycle();
+}
+
+void GarbageCollector::finishCycle() {
+    phase_ = Phase::IDLE;
+    nursery_.reclaim();
+    nextGC_ = bytesAllocated_ * 2;
+    if (nextGC_ < MIN_MAJOR_THRESHOLD) nextGC_ = MIN_MAJOR_THRESHOLD;
+    nextStep_ = nextGC_;
+}
+
+void GarbageCollector::finishSweeping() {
+    if (phase_ == Phase::SWEEPING && useParallel()) {
+        PomeObject* tail = nullptr;
+        PomeObject* survivors = sweepParallel(unsweptObjects_, tail);
+        unsweptObjects_ = nullptr;
+        if (tail) {
+            tail->next = oldObjects_;
+            oldObjects_ = survivors;
+        }
+        finishCycle();
+        return;
+    }
+    double target = pauseTargetMs_;
+    pauseTargetMs_ = std::numeric_limits<double>::infinity();
+    while (phase_ == Phase::SWEEPING) sweepSlice();
+    pauseTargetMs_ = target;
+}
+
+PomeObject* GarbageCollector::sweepParallel(PomeObject* list, PomeObject*& tail) {
+    // Cutting the list into segments is one serial walk over the next pointers
+    std::vector<PomeObject*> starts;
+    size_t position = 0;
+    for (PomeObject* obj = list; obj; obj = obj->next) {
+        if (position++ % SWEEP_SEGMENT == 0) starts.push_back(obj);
+    }
+
+    struct Segment {
+        PomeObject* head = nullptr;
+        PomeObject* tail = nullptr;
+    };
+    struct Freed {
+        std::vector<PomeObject*> deferred;              // Released on this thread afterwards
+        std::vector<std::pair<void*, size_t>> slots;    // Destroyed; their nursery slots still to recycle
+        size_t bytes = 0;
+    };
+    std::vector<Segment> segments(starts.size());
+    std::vector<Freed> freed(gcThreads_);
+    std::atomic<size_t> nextSegment{0};
+
+    runGcWorkers(gcThreads_, [&](size_t id) {
+        Freed& out = freed[id];
+        for (size_t s; (s = nextSegment.fetch_add(1)) < starts.size();) {
+            PomeObject* end = s + 1 < starts.size() ? starts[s + 1] : nullptr;
+            Segment& segment = segments[s];
+            for (PomeObject* obj = starts[s]; obj != end;) {
+                PomeObject* next = obj->next;
+                if (obj->marked()) {
+                    obj->setMarked(false);
+                    if (segment.tail) segment.tail->next = obj;
+                    else segment.head = obj;
+                    segment.tail = obj;
+                } else {
+                    switch (obj->type()) {
+                        // The pools, thread handles, tasks and foreign deleters are not safe off this collector's thread
+                        case ObjectType::LIST:
+                        case ObjectType::STRING:
+                        case ObjectType::THREAD:
+                        case ObjectType::TASK:
+                        case ObjectType::NATIVE_OBJECT:
+                            out.deferred.push_back(obj);
+                            break;
+                        default: {
+                            out.bytes += obj->gcSize;
+                            size_t slot = obj->slotSize;
+                            if (slot == 0) {
+                                delete obj;
+                            } else {
+                                obj->~PomeObject();
+                                out.slots.emplace_back(obj, slot);
+                            }
+                        }
+                    }
                 }
-                delete unreached;
+                obj = next;
             }
         }
+    });
+
+    PomeObject* head = nullptr;
+    tail = nullptr;
+    for (auto& segment : segments) {
+        if (!segment.head) continue;
+        if (tail) tail->next = segment.head;
+        else head = segment.head;
+        tail = segment.tail;
     }
-    rememberedSet_.clear();
-    if (!minor) {
-        nextGC_ = bytesAllocated_ * 2;
-        if (nextGC_ < 16 * 1024 * 1024) nextGC_ = 16 * 1024 * 1024;
+    if (tail) tail->next = nullptr;
+
+    for (auto& out : freed) {
+        bytesAllocated_ -= out.bytes;
+        for (auto& [ptr, slot] : out.slots) nursery_.recycle(ptr, slot);
+        for (PomeObject* obj : out.deferred) release(obj);
+    }
+    return head;
+}
+
+void GarbageCollector::freeObject(PomeObject* obj) {
+    size_t slot = obj->slotSize;
+    if (slot == 0) {
+        delete obj;
+        return;
     }
+    obj->~PomeObject();
+    nursery_.recycle(obj, slot);
 }
 
 void GarbageCollector::addTemporaryRoot(PomeObject* obj) {
@@ -371,6 +869,8 @@ size_t GarbageCollector::getObjectCount() const {
     while (obj) { count++; obj = obj->next; }
     obj = oldObjects_;
     while (obj) { count++; obj = obj->next; }
+    obj = unsweptObjects_;
+    while (obj) { count++; obj = obj->next; }
     return count;
 }
 
@@ -378,10 +878,28 @@ std::string GarbageCollector::getInfo() const {
     std::stringstream ss;
     ss << "Total: " << (bytesAllocated_ / 1024) << "KB, ";
     ss << "Young: " << (youngBytesAllocated_ / 1024) << "KB, ";
+    Nursery::Stats nursery = nursery_.stats();
+    ss << "Nursery: " << (nursery.reservedBytes / 1024) << "KB, ";
+    ss << "Slot reuse: " << static_cast<int>(nursery.reuseRate() * 100) << "%, ";
+    ss << "Fragmentation: " << static_cast<int>(nursery.fragmentation() * 100) << "%, ";
+    ss << "Pause target: " << pauseTargetMs_ << "ms" << (phase_ != Phase::IDLE ? " (cycle in progress)" : "") << ", ";
+    ss << "GC threads: " << gcThreads_ << ", ";
     ss << "Count: " << gcCount_;
     return ss.str();
 }
 
+std::map<ObjectType, GarbageCollector::TypeUsage> GarbageCollector::getUsageByType() const {
+    std::map<ObjectType, TypeUsage> usage;
+    for (PomeObject* head : {youngObjects_, oldObjects_, unsweptObjects_}) {
+        for (PomeObject* obj = head; obj; obj = obj->next) {
+            TypeUsage& entry = usage[obj->type()];
+            entry.objects++;
+            entry.bytes += obj->gcSize;
+        }
+    }
+    return usage;
+}
+
 void GarbageCollector::dumpHeap() const {
     std::map<ObjectType, int> youngCounts;
     std::map<ObjectType, int> oldCount;
@@ -397,6 +915,7 @@ void GarbageCollector::dumpHeap() const {
     };
     scan(youngObjects_, youngCounts, youngBytes);
     scan(oldObjects_, oldCount, oldBytes);
+    scan(unsweptObjects_, oldCount, oldBytes);
     std::cout << "--- HEAP DUMP --- RSS=" << getRSS() << "KB" << std::endl;
     std::cout << "Young Objects: " << youngBytes / 1024 << " KB" << std::endl;
     for (auto const& [type, count] : youngCounts) std::cout << "  - Type " << (int)type << ": " << count << std::endl;
@@ -404,7 +923,81 @@ void GarbageCollector::dumpHeap() const {
     for (auto const& [type, count] : oldCount) std::cout << "  - Type " << (int)type << ": " << count << std::endl;
     std::cout << "Total Managed: " << bytesAllocated_ / 1024 << " KB" << std::endl;
     std::cout << "List Pool Size: " << listPool_.size() << std::endl;
+    Nursery::Stats nursery = nursery_.stats();
+    std::cout << "Nursery Blocks: " << nursery_.blockCount() << " (" << nursery.reservedBytes / 1024 << " KB)" << std::endl;
+    std::cout << "  Live: " << nursery.liveBytes / 1024 << " KB, Free Slots: " << nursery.cachedBytes / 1024
+              << " KB, Fragmentation: " << static_cast<int>(nursery.fragmentation() * 100) << "%" << std::endl;
+    std::cout << "  Allocations: " << nursery.bumpAllocations << " bumped, " << nursery.slotReuses << " from free slots ("
+              << static_cast<int>(nursery.reuseRate() * 100) << "%)" << std::endl;
     std::cout << "-----------------" << std::endl;
 }
 
+// Frozen heaps by heap id, so a frozen object found in a value leads to the heap that keeps it alive
+static std::mutex frozenRegistryLock;
+static std::unordered_map<uint32_t, std::weak_ptr<FrozenHeap>> frozenRegistry;
+
+// Strings, lists and tables, all the way down; frozen values are already shared, whatever they hold
+static bool isFreezable(const PomeValue& value, std::unordered_set<const PomeObject*>& seen) {
+    if (!value.isObject()) return true;
+    const PomeObject* obj = value.asObject();
+    if (obj->frozen || !seen.insert(obj).second) return true;
+    if (value.isString()) return true;
+    if (value.isList()) {
+        const PomeList* list = value.asList();
+        if (list->isUnboxed()) return true;
+        for (const PomeValue& element : list->elements) {
+            if (!isFreezable(element, seen)) return false;
+        }
+        return true;
+    }
+    if (value.isTable()) {
+        const PomeTable* table = value.asTable();
+        for (const PomeValue& property : table->properties) {
+            if (!isFreezable(property, seen)) return false;
+        }
+        for (const PomeValue& element : table->array) {
+            if (!isFreezable(element, seen)) return false;
+        }
+        for (const auto& [key, element] : table->backfill) {
+            if (!isFreezable(key, seen) || !isFreezable(element, seen)) return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+std::shared_ptr<FrozenHeap> FrozenHeap::freeze(const PomeValue& value) {
+    std::unordered_set<const PomeObject*> seen;
+    if (!isFreezable(value, seen)) return nullptr;
+
+    std::shared_ptr<FrozenHeap> frozen(new FrozenHeap());
+    frozen->heap_ = GarbageCollector::createTransferHeap();
+    GarbageCollector& heap = *frozen->heap_;
+    frozen->heapId_ = heap.heapId_;
+    std::map<PomeObject*, PomeObject*> copiedObjects;
+    frozen->value_ = value.deepCopy(heap, copiedObjects);
+    for (PomeObject* obj = heap.youngObjects_; obj; obj = obj->next) {
+        // Settled once, as no one may change the representation afterwards
+        if (obj->type() == ObjectType::LIST) static_cast<PomeList*>(obj)->tryUnbox();
+        // getIndex would build it lazily, from every isolate reading the value at once
+        if (obj->type() == ObjectType::SHAPE) static_cast<PomeShape*>(obj)->ensureIndex();
+        obj->frozen = true;
+    }
+
+    std::lock_guard<std::mutex> guard(frozenRegistryLock);
+    frozenRegistry[frozen->heapId_] = frozen;
+    return frozen;
+}
+
+std::shared_ptr<FrozenHeap> FrozenHeap::find(uint32_t heapId) {
+    std::lock_guard<std::mutex> guard(frozenRegistryLock);
+    auto it = frozenRegistry.find(heapId);
+    return it != frozenRegistry.end() ? it->second.lock() : nullptr;
+}
+
+FrozenHeap::~FrozenHeap() {
+    std::lock_guard<std::mutex> guard(frozenRegistryLock);
+    frozenRegistry.erase(heapId_);
+}
+
 } // namespace Pome
@@ -0,0 +1,82 @@
+// Collector bookkeeping costs that should not grow with the heap.
+//
+//   pome-gc-bench
+//
+// barrier: stores a fresh object into each of N old lists, so every store puts
+//          a new parent in the remembered set. The cost per store should stay flat as N grows.
+// zct:     reconciles a ZCT of ZCT_BATCH fresh objects while H old objects sit in
+//          the heap. The cost per pass should not depend on H.
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "pome_gc.h"
+#include "pome_value.h"
+
+using namespace Pome;
+
+static constexpr int RUNS = 5;
+static constexpr size_t ZCT_BATCH = 2000;
+static constexpr int ZCT_PASSES = 50;
+
+// A rooted list of count lists, promoted to the old generation
+static PomeList* oldLists(GarbageCollector& gc, size_t count) {
+    PomeList* outer = gc.allocateList();
+    gc.addTemporaryRoot(outer);
+    for (size_t i = 0; i < count; ++i) {
+        PomeList* inner = gc.allocateList();
+        outer->elements.push_back(PomeValue(inner));
+    }
+    gc.collect(true);
+    gc.collect(true);
+    return outer;
+}
+
+static void report(const char* name, size_t size, double seconds, size_t operations, const char* unit) {
+    std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(9) << size << "  "
+              << std::fixed << std::setprecision(1) << std::setw(9) << seconds * 1e9 / operations << " ns/" << unit
+              << std::endl;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    std::cout << "Write barrier (old parent, young child), per store:" << std::endl;
+    for (size_t count : {10000, 100000, 400000}) {
+        double best = 0;
+        for (int run = 0; run < RUNS; ++run) {
+            GarbageCollector gc;
+            PomeList* outer = oldLists(gc, count);
+            std::vector<PomeList*> children;
+            for (size_t i = 0; i < count; ++i) children.push_back(gc.allocateList());
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; ++i) {
+                PomeList* parent = outer->elements[i].asList();
+                parent->elements.push_back(PomeValue(children[i]));
+                gc.writeBarrier(parent, PomeValue(children[i]));
+            }
+            double seconds = secondsSince(start);
+            if (run == 0 || seconds < best) best = seconds;
+        }
+        report("barrier", count, best, count, "store");
+    }
+
+    std::cout << "ZCT reconciliation of " << ZCT_BATCH << " entries, per pass:" << std::endl;
+    for (size_t heap : {10000, 100000, 1000000}) {
+        GarbageCollector gc;
+        oldLists(gc, heap);
+        gc.processZCT();
+        double total = 0;
+        for (int pass = 0; pass < ZCT_PASSES; ++pass) {
+            for (size_t i = 0; i < ZCT_BATCH; ++i) gc.allocateList();
+            auto start = std::chrono::steady_clock::now();
+            gc.processZCT();
+            total += secondsSince(start);
+        }
+        report("zct", heap, total, ZCT_PASSES, "pass");
+    }
+    return 0;
+}
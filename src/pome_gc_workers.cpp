@@ -0,0 +1,46 @@
+#include "../include/pome_gc_workers.h"
+
+#include <thread>
+
+namespace Pome {
+
+    void MarkQueue::maybeShare() {
+        if (local.size() <= SHARE_THRESHOLD || offered_.load(std::memory_order_relaxed) > 0) return;
+        // The bottom of the stack is the oldest work, usually the largest subgraphs left
+        size_t half = local.size() / 2;
+        std::lock_guard<std::mutex> guard(lock_);
+        shared_.insert(shared_.end(), local.begin(), local.begin() + half);
+        local.erase(local.begin(), local.begin() + half);
+        offered_.store(shared_.size(), std::memory_order_release);
+    }
+
+    bool MarkQueue::stealFrom(MarkQueue& victim) {
+        if (!victim.hasOffer()) return false;
+        std::lock_guard<std::mutex> guard(victim.lock_);
+        size_t available = victim.shared_.size();
+        if (available == 0) return false;
+        size_t take = (available + 1) / 2;
+        local.insert(local.end(), victim.shared_.end() - take, victim.shared_.end());
+        victim.shared_.resize(available - take);
+        victim.offered_.store(victim.shared_.size(), std::memory_order_release);
+        return true;
+    }
+
+    void MarkQueue::drainInto(std::vector<PomeObject*>& out) {
+        out.insert(out.end(), local.begin(), local.end());
+        local.clear();
+        std::lock_guard<std::mutex> guard(lock_);
+        out.insert(out.end(), shared_.begin(), shared_.end());
+        shared_.clear();
+        offered_.store(0, std::memory_order_release);
+    }
+
+    void runGcWorkers(size_t count, const std::function<void(size_t)>& body) {
+        std::vector<std::thread> threads;
+        threads.reserve(count > 0 ? count - 1 : 0);
+        for (size_t i = 1; i < count; ++i) threads.emplace_back(body, i);
+        body(0);
+        for (auto& thread : threads) thread.join();
+    }
+
+} // namespace Pome
@@ -0,0 +1,157 @@
+#include "pome_import_prescan.h"
+#include "pome_compiler.h"
+#include "pome_file_utils.hpp"
+#include "pome_gc.h"
+#include "pome_lexer.h"
+#include "pome_parser.h"
+#include "pome_value.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace Pome {
+
+    ImportPrescan::ImportPrescan(const ModuleResolver& resolver, std::unordered_set<std::string> builtinModules,
+                                 int optLevel, bool useCache)
+        : resolver(resolver), builtinModules(std::move(builtinModules)), optLevel(optLevel), useCache(useCache) {}
+
+    ImportPrescan::~ImportPrescan() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    void ImportPrescan::start(const Chunk& chunk, const std::string& scriptPath) {
+        std::lock_guard<std::mutex> lock(mutex);
+        enqueue(importsOf(chunk), scriptPath);
+    }
+
+    std::unique_ptr<Chunk> ImportPrescan::take(GarbageCollector& gc, const std::string& path) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = modules.find(path);
+        if (it == modules.end()) return nullptr;
+        Module* module = &it->second; // Stays put while other entries are added
+        moduleDone.wait(lock, [module] { return module->done; });
+        if (!module->compiled) return nullptr;
+
+        // Each file is executed once per VM; a second import of the same path compiles normally
+        std::vector<uint8_t> bytes = std::move(module->bytes);
+        CacheKey key = module->key;
+        module->compiled = false;
+        lock.unlock();
+        return BytecodeCache::deserialize(gc, bytes.data(), bytes.size(), key);
+    }
+
+    std::vector<std::string> ImportPrescan::importsOf(const Chunk& chunk) {
+        std::vector<std::string> names;
+        std::vector<const Chunk*> pending = {&chunk};
+        std::unordered_set<const Chunk*> seen = {&chunk};
+        auto visit = [&](const Chunk* nested) {
+            if (seen.insert(nested).second) pending.push_back(nested);
+        };
+        while (!pending.empty()) {
+            const Chunk* current = pending.back();
+            pending.pop_back();
+            for (Instruction instruction : current->code) {
+                if (Chunk::getOpCode(instruction) != OpCode::IMPORT) continue;
+                const PomeValue& name = current->constants[Chunk::getBx(instruction)];
+                if (name.isString()) names.push_back(name.asString());
+            }
+            for (const PomeValue& constant : current->constants) {
+                if (constant.isPomeFunction()) {
+                    visit(constant.asPomeFunction()->chunk.get());
+                } else if (constant.isClass()) {
+                    for (const auto& [name, method] : constant.asClass()->methods) visit(method->chunk.get());
+                }
+            }
+        }
+        return names;
+    }
+
+    void ImportPrescan::enqueue(const std::vector<std::string>& names, const std::string& importerPath) {
+        // The loader resolves against the importing file's directory; so does the prescan
+        std::string origin = FileUtils::getDirectory(importerPath);
+        for (const std::string& name : names) {
+            if (builtinModules.count(name)) continue;
+            ResolutionResult result = resolver.resolve(name, origin);
+            std::string path = result.path;
+            if (result.type == ModuleType::POME_PACKAGE_DIR) {
+                path += "/__init__.pome";
+            } else if (result.type != ModuleType::POME_SCRIPT_FILE) {
+                continue;
+            }
+            if (!modules.emplace(path, Module()).second) continue;
+            queue.push_back(path);
+        }
+        if (queue.empty()) return;
+
+        unsigned limit = std::max(1u, std::min(MAX_WORKERS, std::thread::hardware_concurrency()));
+        while (workers.size() < limit && workers.size() < queue.size()) {
+            workers.emplace_back(&ImportPrescan::work, this);
+        }
+        workAvailable.notify_all();
+    }
+
+    void ImportPrescan::work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            std::string path = std::move(queue.front());
+            queue.pop_front();
+
+            lock.unlock();
+            Module result;
+            std::vector<std::string> imports = compile(path, result);
+            lock.lock();
+
+            result.done = true;
+            modules[path] = std::move(result);
+            enqueue(imports, path);
+            moduleDone.notify_all();
+        }
+    }
+
+    std::vector<std::string> ImportPrescan::compile(const std::string& path, Module& module) const {
+        std::ifstream file(path);
+        if (!file.is_open()) return {};
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string source = buffer.str();
+
+        CacheKey key;
+        if (!BytecodeCache::keyFor(path, source, optLevel, key)) return {};
+
+        // Constants go to a heap of this worker's own; take() copies them into the VM's
+        GarbageCollector gc;
+        if (useCache) {
+            // The loader maps the same fresh cache itself; only the imports are needed here
+            if (auto cached = BytecodeCache::load(gc, path, key)) return importsOf(*cached);
+        }
+
+        std::unique_ptr<Chunk> chunk;
+        try {
+            Lexer lexer(source);
+            Parser parser(lexer);
+            std::unique_ptr<Program> program = parser.parseProgram();
+            if (!program) return {};
+            Compiler compiler(gc);
+            compiler.setOptimizationLevel(optLevel);
+            compiler.setErrorsThrow(true);
+            chunk = compiler.compile(*program);
+        } catch (const std::exception&) {
+            return {}; // The loader compiles it again and reports the error when the import runs
+        }
+
+        if (BytecodeCache::serialize(*chunk, key, module.bytes)) {
+            module.compiled = true;
+            module.key = key;
+            if (useCache) BytecodeCache::writeFile(module.bytes, path);
+        }
+        return importsOf(*chunk);
+    }
+
+}
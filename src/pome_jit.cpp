@@ -0,0 +1,732 @@
+#include "pome_jit.h"
+#include "pome_vm.h"
+#include "pome_shape.h"
+#include <cstring>
+#include <map>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define POME_JIT_X64 1
+#include <sys/mman.h>
+#endif
+
+namespace Pome {
+
+    JitCode::JitCode(void* memory, size_t size, std::vector<uint32_t> entries)
+        : memory(memory), codeSize(size), entries(std::move(entries)) {}
+
+    JitCode::~JitCode() {
+#ifdef POME_JIT_X64
+        munmap(memory, codeSize);
+#endif
+    }
+
+    // --- Helpers ---
+    // Fast paths of the matching interpreter handlers. A miss exits so the
+    // interpreter can fill caches, deopt, raise errors or call back into Pome.
+
+    uint32_t Jit::getTable(JitFrame* f, uint32_t pc) noexcept {
+        Instruction ins = f->chunk->code[pc];
+        PomeValue* R = f->R;
+        int a = Chunk::getA(ins), b = Chunk::getB(ins), c = Chunk::getC(ins);
+        PomeValue obj = R[b];
+        PomeValue key = R[c];
+        if (obj.isList() && key.isNumber()) {
+            PomeList* list = obj.asList();
+            int idx = (int)key.asNumber();
+            if (list->listType == ListType::DOUBLE) {
+                if (idx >= 0 && (size_t)idx < list->unboxedCount) {
+                    R[a] = PomeValue(list->asDouble()[idx]);
+                    return 0;
+                }
+            } else if (list->listType == ListType::INT32) {
+                if (idx >= 0 && (size_t)idx < list->unboxedCount) {
+                    R[a] = PomeValue((double)list->asInt32()[idx]);
+                    return 0;
+                }
+            } else if (list->listType == ListType::BOOL) {
+                if (idx >= 0 && (size_t)idx < list->unboxedCount) {
+                    R[a] = PomeValue(list->asBool()[idx] != 0);
+                    return 0;
+                }
+            } else if (idx >= 0 && (size_t)idx < list->elements.size()) {
+                R[a] = list->elements[idx];
+                return 0;
+            }
+        } else if (obj.isTable()) {
+            PomeTable* tbl = obj.asTable();
+            PomeValue* slot = tbl->arraySlot(key);
+            R[a] = slot ? *slot : tbl->get(key);
+            return 0;
+        } else if (obj.isBuffer()) {
+            PomeBuffer* buffer = obj.asBuffer();
+            size_t i;
+            if (PomeTable::arrayIndex(key, i) && i < buffer->count) {
+                R[a] = buffer->get(i);
+                return 0;
+            }
+        }
+        return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+    }
+
+    uint32_t Jit::setTable(JitFrame* f, uint32_t pc) noexcept {
+        Instruction ins = f->chunk->code[pc];
+        PomeValue* R = f->R;
+        GarbageCollector& gc = f->vm->gc;
+        PomeValue obj = R[Chunk::getA(ins)];
+        PomeValue key = R[Chunk::getB(ins)];
+        PomeValue val = R[Chunk::getC(ins)];
+        // Stores into frozen values raise in the interpreter
+        if (obj.isList() && key.isNumber() && !obj.asList()->frozen) {
+            PomeList* list = obj.asList();
+            int idx = (int)key.asNumber();
+            if (list->listType == ListType::DOUBLE) {
+                if (val.isNumber() && idx >= 0 && (size_t)idx < list->unboxedCount) {
+                    list->asDouble()[idx] = val.asNumber();
+                    return 0;
+                }
+            } else if (list->listType == ListType::INT32) {
+                // Non-integers make the interpreter widen the list first
+                if (val.isNumber() && val.asNumber() == (int32_t)val.asNumber() &&
+                    idx >= 0 && (size_t)idx < list->unboxedCount) {
+                    list->asInt32()[idx] = (int32_t)val.asNumber();
+                    return 0;
+                }
+            } else if (list->listType == ListType::BOOL) {
+                if (val.isBool() && idx >= 0 && (size_t)idx < list->unboxedCount) {
+                    list->asBool()[idx] = val.isTrue();
+                    return 0;
+                }
+            } else if (idx >= 0 && (size_t)idx < list->elements.size()) {
+                gc.rcWriteBarrier(&list->elements[idx], val);
+                gc.writeBarrier(list, val);
+                return 0;
+            }
+        } else if (obj.isTable() && !obj.asTable()->frozen) {
+            PomeTable* tbl = obj.asTable();
+            PomeValue* slot = tbl->arraySlot(key);
+            if (slot && !slot->isNil() && !val.isNil()) {
+                gc.rcWriteBarrier(slot, val);
+                gc.writeBarrier(tbl, val);
+                return 0;
+            }
+        } else if (obj.isBuffer() && val.isNumber()) {
+            PomeBuffer* buffer = obj.asBuffer();
+            size_t i;
+            if (PomeTable::arrayIndex(key, i) && i < buffer->count && buffer->writable()) {
+                buffer->set(i, val.asNumber());
+                return 0;
+            }
+        }
+        return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+    }
+
+    uint32_t Jit::getField(JitFrame* f, uint32_t pc) noexcept {
+        Chunk* chunk = f->chunk;
+        Instruction ins = chunk->code[pc];
+        PomeValue* R = f->R;
+        int a = Chunk::getA(ins);
+        PomeValue obj = R[Chunk::getB(ins)];
+        if (obj.isInstance()) {
+            PomeInstance* inst = obj.asInstance();
+            const InstructionMetadata& meta = chunk->cacheFor(&chunk->code[pc]);
+            for (int i = 0; i < meta.fieldCount; ++i) {
+                const FieldCacheEntry& entry = meta.fields[i];
+                if (entry.shape != inst->shape || (entry.method && entry.klass != inst->klass)) continue;
+                if (entry.method) {
+                    R[a] = PomeValue(entry.method);
+                    return 0;
+                }
+                if (entry.index < (int)inst->properties.size()) {
+                    R[a] = inst->properties[entry.index];
+                    return 0;
+                }
+                break;
+            }
+        } else if (obj.isModule()) {
+            PomeModule* mod = obj.asModule();
+            const PomeValue& key = chunk->constants[Chunk::getC(ins)];
+            auto it = mod->exports.find(key);
+            if (it != mod->exports.end()) {
+                R[a] = it->second;
+                return 0;
+            }
+        }
+        return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+    }
+
+    uint32_t Jit::setField(JitFrame* f, uint32_t pc) noexcept {
+        Chunk* chunk = f->chunk;
+        Instruction ins = chunk->code[pc];
+        PomeValue* R = f->R;
+        PomeValue obj = R[Chunk::getA(ins)];
+        if (obj.isInstance()) {
+            PomeInstance* inst = obj.asInstance();
+            const InstructionMetadata& meta = chunk->cacheFor(&chunk->code[pc]);
+            for (int i = 0; i < meta.fieldCount; ++i) {
+                const FieldCacheEntry& entry = meta.fields[i];
+                if (entry.shape != inst->shape) continue;
+                if (entry.index >= 0 && entry.index < (int)inst->properties.size()) {
+                    PomeValue val = R[Chunk::getB(ins)];
+                    GarbageCollector& gc = f->vm->gc;
+                    gc.rcWriteBarrier(&inst->properties[entry.index], val);
+                    gc.writeBarrier(inst, val);
+                    return 0;
+                }
+                break;
+            }
+        }
+        return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+    }
+
+    uint32_t Jit::getGlobal(JitFrame* f, uint32_t pc) noexcept {
+        Chunk* chunk = f->chunk;
+        const GlobalLink& link = f->vm->globalLink(*chunk, &chunk->code[pc]);
+        if (!f->vm->globalLinked(link)) return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+        f->R[Chunk::getA(chunk->code[pc])] =
+            (link.moduleCell && link.moduleCell->defined) ? link.moduleCell->value : link.globalCell->value;
+        return 0;
+    }
+
+    uint32_t Jit::getUpvalue(JitFrame* f, uint32_t pc) noexcept {
+        Instruction ins = f->chunk->code[pc];
+        f->R[Chunk::getA(ins)] = *f->frame->function->upvalues[Chunk::getB(ins)]->location;
+        return 0;
+    }
+
+    uint32_t Jit::setUpvalue(JitFrame* f, uint32_t pc) noexcept {
+        Instruction ins = f->chunk->code[pc];
+        PomeUpvalue* upvalue = f->frame->function->upvalues[Chunk::getB(ins)];
+        *upvalue->location = f->R[Chunk::getA(ins)];
+        f->vm->gc.writeBarrier(upvalue, f->R[Chunk::getA(ins)]);
+        return 0;
+    }
+
+    // Only the cached class and shape pass here; the interpreter does the full lookup
+    uint32_t Jit::checkMethod(JitFrame* f, uint32_t pc) noexcept {
+        Chunk* chunk = f->chunk;
+        PomeValue obj = f->R[Chunk::getA(chunk->code[pc])];
+        if (obj.isInstance()) {
+            const InstructionMetadata& meta = chunk->cacheFor(&chunk->code[pc]);
+            PomeInstance* inst = obj.asInstance();
+            if (inst->klass == meta.klassCache && inst->shape == meta.objectCache) return 0;
+        }
+        return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+    }
+
+    // Reached for two objects with different bits, which are equal only as strings with the same contents
+    uint32_t Jit::equal(JitFrame* f, uint32_t pc) noexcept {
+        Instruction ins = f->chunk->code[pc];
+        PomeValue* R = f->R;
+        R[Chunk::getA(ins)] = PomeValue(R[Chunk::getB(ins)] == R[Chunk::getC(ins)]);
+        return 0;
+    }
+
+    uint32_t Jit::callNative(JitFrame* f, uint32_t pc) noexcept {
+        Instruction ins = f->chunk->code[pc];
+        PomeValue* R = f->R;
+        int a = Chunk::getA(ins);
+        int argCount = Chunk::getB(ins) - 1;
+        PomeValue callee = R[a];
+        // Pome functions need a frame; the interpreter pushes it and re-enters at the callee
+        if (!callee.isNativeFunction()) return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+
+        NativeFunction* native = callee.asNativeFunction();
+        int startIdx = (argCount > 0 && R[a + 1].isModule()) ? 2 : 1;
+        int nativeArgc = argCount - (startIdx - 1);
+        GarbageCollector& gc = f->vm->gc;
+
+        if (native->intrinsic() == NativeIntrinsic::LEN && nativeArgc >= 1) {
+            PomeValue v = R[a + startIdx];
+            if (v.isList()) R[a] = PomeValue((double)(v.asList()->isUnboxed() ? v.asList()->unboxedCount : v.asList()->elements.size()));
+            else if (v.isString()) R[a] = PomeValue((double)v.asPomeString()->length());
+            else if (v.isTable()) R[a] = PomeValue((double)v.asTable()->count());
+            else if (v.isBuffer()) R[a] = PomeValue((double)v.asBuffer()->count);
+            else R[a] = PomeValue();
+            return 0;
+        }
+        if (native->intrinsic() == NativeIntrinsic::PUSH && nativeArgc >= 2 && R[a + startIdx].isList() &&
+            !R[a + startIdx].asList()->frozen) {
+            PomeList* lst = R[a + startIdx].asList();
+            PomeValue val = R[a + startIdx + 1];
+            size_t oldExtra = lst->extraSize();
+            lst->push(gc, val);
+            gc.updateSize(lst, sizeof(PomeList) + oldExtra, sizeof(PomeList) + lst->extraSize());
+            gc.writeBarrier(lst, val);
+            R[a] = val;
+            return 0;
+        }
+
+        // Only the fast ABI is safe here: it never re-enters the interpreter
+        FastNativeFn fast = native->fast();
+        if (!fast || nativeArgc < native->arity()) return JitCode::exitCode(JitCode::EXIT_INTERPRET, pc);
+        f->frame->ip = f->chunk->code.data() + pc + 1;
+        try {
+            NativeContext ctx{f->vm, gc, native};
+            PomeValue res = fast(ctx, &R[a + startIdx], nativeArgc);
+            R[a] = res;
+            return 0;
+        } catch (...) {
+            // Unwinding cannot cross machine code; VM::runJit rethrows it instead
+            f->error = std::current_exception();
+            return JitCode::exitCode(JitCode::EXIT_THROW, pc);
+        }
+    }
+
+#ifdef POME_JIT_X64
+
+    namespace {
+
+        enum Reg { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+                   R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+        enum Cond : uint8_t { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7,
+                              CC_P = 0xA, CC_NP = 0xB };
+
+        // Just the x86-64 encodings the templates need. Memory operands are
+        // always [base + disp32].
+        class Assembler {
+        public:
+            std::vector<uint8_t> code;
+
+            int newLabel() {
+                labels.push_back(-1);
+                return (int)labels.size() - 1;
+            }
+            void bind(int label) { labels[label] = (int64_t)code.size(); }
+            int64_t offsetOf(int label) const { return labels[label]; }
+
+            void load(int dst, int base, int32_t disp) { rex(true, dst, base); byte(0x8B); mem(dst, base, disp); }
+            void store(int base, int32_t disp, int src) { rex(true, src, base); byte(0x89); mem(src, base, disp); }
+            void movImm64(int dst, uint64_t imm) { rex(true, 0, dst); byte(0xB8 | (dst & 7)); u64(imm); }
+            void movImm32(int dst, uint32_t imm) { rex(false, 0, dst); byte(0xB8 | (dst & 7)); u32(imm); }
+            void mov(int dst, int src) { rex(true, src, dst); byte(0x89); direct(src, dst); }
+            void andq(int dst, int src) { rex(true, src, dst); byte(0x21); direct(src, dst); }
+            void addq(int dst, int src) { rex(true, src, dst); byte(0x01); direct(src, dst); }
+            void cmpq(int lhs, int rhs) { rex(true, rhs, lhs); byte(0x39); direct(rhs, lhs); }
+            void testl(int lhs, int rhs) { rex(false, rhs, lhs); byte(0x85); direct(rhs, lhs); }
+            void btc63(int reg) { rex(true, 0, reg); byte(0x0F); byte(0xBA); direct(7, reg); byte(63); }
+            // setcc into al/cl/dl, then zero-extend to 32 bits
+            void setcc(Cond cc, int reg) {
+                byte(0x0F); byte(0x90 | cc); direct(0, reg);
+                byte(0x0F); byte(0xB6); direct(reg, reg);
+            }
+
+            void movqToXmm(int xmm, int reg) { byte(0x66); rex(true, xmm, reg); byte(0x0F); byte(0x6E); direct(xmm, reg); }
+            void movqFromXmm(int reg, int xmm) { byte(0x66); rex(true, xmm, reg); byte(0x0F); byte(0x7E); direct(xmm, reg); }
+            void sse(uint8_t prefix, uint8_t op, int dst, int src) { byte(prefix); byte(0x0F); byte(op); direct(dst, src); }
+            void addsd(int dst, int src) { sse(0xF2, 0x58, dst, src); }
+            void subsd(int dst, int src) { sse(0xF2, 0x5C, dst, src); }
+            void mulsd(int dst, int src) { sse(0xF2, 0x59, dst, src); }
+            void divsd(int dst, int src) { sse(0xF2, 0x5E, dst, src); }
+            void ucomisd(int lhs, int rhs) { sse(0x66, 0x2E, lhs, rhs); }
+            void xorpd(int dst, int src) { sse(0x66, 0x57, dst, src); }
+
+            void jcc(Cond cc, int label) { byte(0x0F); byte(0x80 | cc); fixup(label); }
+            void jmp(int label) { byte(0xE9); fixup(label); }
+            void jmpReg(int reg) { rex(false, 0, reg); byte(0xFF); direct(4, reg); }
+            void callReg(int reg) { rex(false, 0, reg); byte(0xFF); direct(2, reg); }
+            void push(int reg) { rex(false, 0, reg); byte(0x50 | (reg & 7)); }
+            void pop(int reg) { rex(false, 0, reg); byte(0x58 | (reg & 7)); }
+            void ret() { byte(0xC3); }
+
+            // Patches every rel32 once all labels are bound
+            bool resolve() {
+                for (const auto& [at, label] : fixups) {
+                    if (labels[label] < 0) return false;
+                    int32_t rel = (int32_t)(labels[label] - (int64_t)(at + 4));
+                    std::memcpy(&code[at], &rel, sizeof(rel));
+                }
+                return true;
+            }
+
+        private:
+            std::vector<int64_t> labels;
+            std::vector<std::pair<size_t, int>> fixups;
+
+            void byte(uint8_t b) { code.push_back(b); }
+            void u32(uint32_t v) { for (int i = 0; i < 4; ++i) byte((uint8_t)(v >> (8 * i))); }
+            void u64(uint64_t v) { for (int i = 0; i < 8; ++i) byte((uint8_t)(v >> (8 * i))); }
+            void rex(bool wide, int reg, int rm) {
+                uint8_t prefix = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+                if (prefix != 0x40) byte(prefix);
+            }
+            void direct(int reg, int rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+            void mem(int reg, int base, int32_t disp) {
+                byte(0x80 | ((reg & 7) << 3) | (base & 7));
+                if ((base & 7) == RSP) byte(0x24); // rsp/r12 need a SIB byte
+                u32((uint32_t)disp);
+            }
+            void fixup(int label) {
+                fixups.push_back({code.size(), label});
+                u32(0);
+            }
+        };
+
+        bool isFusedCompare(OpCode op) {
+            switch (op) {
+                case OpCode::LT: case OpCode::LT_NN: case OpCode::LT_JMP:
+                case OpCode::LE: case OpCode::LE_NN: case OpCode::LE_JMP:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+    }
+
+    // Register use: rbx = register window R, r12 = JitFrame*, r14 = NaN-box tag mask.
+    // rax, rcx, rdx and xmm0/xmm1 are scratch; nothing lives in them across instructions.
+    class Jit::Codegen {
+    public:
+        explicit Codegen(const Chunk& chunk) : chunk(chunk), size((uint32_t)chunk.code.size()) {
+            for (uint32_t i = 0; i < size; ++i) pcLabels.push_back(as.newLabel());
+            epilogue = as.newLabel();
+        }
+
+        std::shared_ptr<JitCode> run() {
+            if (size == 0 || size > JitCode::PC_MASK) return nullptr;
+
+            // Entry: (JitFrame* frame, const void* target)
+            as.push(RBX); as.push(R12); as.push(R13); as.push(R14); as.push(R15);
+            as.mov(R12, RDI);
+            as.load(RBX, RDI, 0);
+            as.movImm64(R14, NUMBER_MASK);
+            as.jmpReg(RSI);
+
+            as.bind(epilogue);
+            as.pop(R15); as.pop(R14); as.pop(R13); as.pop(R12); as.pop(RBX);
+            as.ret();
+
+            uint32_t pc = 0;
+            while (pc < size) {
+                as.bind(pcLabels[pc]);
+                Instruction ins = chunk.code[pc];
+                if (Chunk::getOpCode(ins) == OpCode::CLOSURE) {
+                    // Upvalue descriptors that follow are data; give them exits so every pc has an entry
+                    exitHere(pc);
+                    uint32_t words = chunk.constants[Chunk::getBx(ins)].asPomeFunction()->upvalueCount;
+                    for (uint32_t i = 1; i <= words && pc + i < size; ++i) {
+                        as.bind(pcLabels[pc + i]);
+                        exitHere(pc + i);
+                    }
+                    pc += 1 + words;
+                    continue;
+                }
+                emit(pc, ins);
+                pc++;
+            }
+
+            for (const auto& [exit, label] : stubs) {
+                as.bind(label);
+                as.movImm32(RAX, exit);
+                as.jmp(epilogue);
+            }
+            if (!as.resolve()) return nullptr;
+
+            size_t bytes = as.code.size();
+            void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) return nullptr;
+            std::memcpy(memory, as.code.data(), bytes);
+            // Never writable and executable at once
+            if (mprotect(memory, bytes, PROT_READ | PROT_EXEC) != 0) {
+                munmap(memory, bytes);
+                return nullptr;
+            }
+
+            std::vector<uint32_t> entries(size);
+            for (uint32_t i = 0; i < size; ++i) entries[i] = (uint32_t)as.offsetOf(pcLabels[i]);
+            return std::make_shared<JitCode>(memory, bytes, std::move(entries));
+        }
+
+    private:
+        const Chunk& chunk;
+        uint32_t size;
+        Assembler as;
+        std::vector<int> pcLabels;
+        std::map<uint32_t, int> stubs; // Out-of-line exits by exit code
+        int epilogue;
+
+        static int32_t slot(int reg) { return reg * (int32_t)sizeof(PomeValue); }
+
+        // Label for pc, or an exit if pc falls outside the chunk
+        int target(int64_t pc) {
+            if (pc >= 0 && pc < size) return pcLabels[pc];
+            int label = as.newLabel();
+            int skip = as.newLabel();
+            as.jmp(skip);
+            as.bind(label);
+            as.movImm32(RAX, JitCode::exitCode(JitCode::EXIT_INTERPRET, (uint32_t)(pc < 0 ? 0 : size - 1)));
+            as.jmp(epilogue);
+            as.bind(skip);
+            return label;
+        }
+
+        void exitHere(uint32_t pc) {
+            as.movImm32(RAX, JitCode::exitCode(JitCode::EXIT_INTERPRET, pc));
+            as.jmp(epilogue);
+        }
+
+        int stub(JitCode::Exit reason, uint32_t pc) {
+            uint32_t exit = JitCode::exitCode(reason, pc);
+            auto it = stubs.find(exit);
+            if (it != stubs.end()) return it->second;
+            int label = as.newLabel();
+            stubs[exit] = label;
+            return label;
+        }
+
+        int guard(uint32_t pc) { return stub(JitCode::EXIT_GUARD, pc); }
+
+        // Exits with EXIT_GUARD unless reg holds a number (clobbers rdx)
+        void guardNumber(int reg, uint32_t pc) {
+            as.mov(RDX, reg);
+            as.andq(RDX, R14);
+            as.cmpq(RDX, R14);
+            as.jcc(CC_E, guard(pc));
+        }
+
+        // Loads R(b) and R(c) into xmm0/xmm1, both guarded as numbers
+        void loadNumbers(uint32_t pc, int b, int c) {
+            as.load(RAX, RBX, slot(b));
+            guardNumber(RAX, pc);
+            as.load(RCX, RBX, slot(c));
+            guardNumber(RCX, pc);
+            as.movqToXmm(0, RAX);
+            as.movqToXmm(1, RCX);
+        }
+
+        // Stores xmm0 as a number, canonicalising NaN like PomeValue(double)
+        void storeNumber(int a) {
+            int ordered = as.newLabel();
+            as.ucomisd(0, 0);
+            as.jcc(CC_NP, ordered);
+            as.movImm64(RAX, CANONICAL_NAN);
+            as.movqToXmm(0, RAX);
+            as.bind(ordered);
+            as.movqFromXmm(RAX, 0);
+            as.store(RBX, slot(a), RAX);
+        }
+
+        // Stores the 0/1 in rdx as a bool (clobbers rax)
+        void storeBool(int a) {
+            as.movImm64(RAX, FALSE_BITS);
+            as.addq(RAX, RDX);
+            as.store(RBX, slot(a), RAX);
+        }
+
+        // Branches on PomeValue::asBool() of rax
+        void truthy(int whenTrue, int whenFalse) {
+            as.movImm64(RCX, TRUE_BITS);
+            as.cmpq(RAX, RCX);
+            as.jcc(CC_E, whenTrue);
+            as.movImm64(RCX, FALSE_BITS);
+            as.cmpq(RAX, RCX);
+            as.jcc(CC_E, whenFalse);
+            as.movImm64(RCX, NIL_BITS);
+            as.cmpq(RAX, RCX);
+            as.jcc(CC_E, whenFalse);
+            as.mov(RDX, RAX);
+            as.andq(RDX, R14);
+            as.cmpq(RDX, R14);
+            as.jcc(CC_E, whenTrue); // Objects are truthy
+            as.movqToXmm(0, RAX);
+            as.xorpd(1, 1);
+            as.ucomisd(0, 1);
+            as.jcc(CC_NE, whenTrue);
+            as.jcc(CC_P, whenTrue); // NaN != 0.0
+            as.jmp(whenFalse);
+        }
+
+        void callHelper(uint32_t (*helper)(JitFrame*, uint32_t) noexcept, uint32_t pc) {
+            as.mov(RDI, R12);
+            as.movImm32(RSI, pc);
+            as.movImm64(RAX, reinterpret_cast<uint64_t>(helper));
+            as.callReg(RAX);
+            as.testl(RAX, RAX);
+            as.jcc(CC_NE, epilogue); // eax already holds the exit code
+        }
+
+        void arith(uint32_t pc, int a, int b, int c, void (Assembler::*op)(int, int)) {
+            loadNumbers(pc, b, c);
+            (as.*op)(0, 1);
+            storeNumber(a);
+        }
+
+        void emit(uint32_t pc, Instruction ins) {
+            OpCode op = Chunk::getOpCode(ins);
+            int a = Chunk::getA(ins), b = Chunk::getB(ins), c = Chunk::getC(ins);
+            int bx = Chunk::getBx(ins), sbx = Chunk::getSBx(ins);
+
+            // LT/LE; TEST; JMP (fused in the bytecode or not) branches on the flags directly
+            if (isFusedCompare(op) && pc + 2 < size &&
+                Chunk::getOpCode(chunk.code[pc + 1]) == OpCode::TEST && Chunk::getA(chunk.code[pc + 1]) == a &&
+                Chunk::getOpCode(chunk.code[pc + 2]) == OpCode::JMP) {
+                bool isLess = op == OpCode::LT || op == OpCode::LT_NN || op == OpCode::LT_JMP;
+                bool skipWhen = Chunk::getC(chunk.code[pc + 1]) != 0;
+                int jumpLabel = target((int64_t)pc + 3 + Chunk::getSBx(chunk.code[pc + 2]));
+                int nextLabel = target((int64_t)pc + 3);
+                loadNumbers(pc, b, c);
+                as.ucomisd(1, 0);
+                as.setcc(isLess ? CC_A : CC_AE, RDX);
+                storeBool(a);
+                as.testl(RDX, RDX);
+                as.jcc(CC_NE, skipWhen ? nextLabel : jumpLabel);
+                as.jmp(skipWhen ? jumpLabel : nextLabel);
+                return;
+            }
+
+            switch (op) {
+                case OpCode::MOVE:
+                case OpCode::MOVE2: // The second MOVE keeps its own word
+                    as.load(RAX, RBX, slot(b));
+                    as.store(RBX, slot(a), RAX);
+                    return;
+                case OpCode::LOADK:
+                case OpCode::LOADK_ADD:
+                case OpCode::LOADK_SUB:
+                case OpCode::LOADK_MUL:
+                case OpCode::LOADK_ADD_JMP: {
+                    PomeValue k = chunk.constants[bx];
+                    if (k.isClass()) break; // The interpreter binds classes to the running module
+                    as.movImm64(RAX, k.getRaw());
+                    as.store(RBX, slot(a), RAX);
+                    return;
+                }
+                case OpCode::LOADBOOL:
+                    as.movImm64(RAX, b != 0 ? TRUE_BITS : FALSE_BITS);
+                    as.store(RBX, slot(a), RAX);
+                    if (c != 0) as.jmp(target((int64_t)pc + 2));
+                    return;
+                case OpCode::LOADNIL:
+                    as.movImm64(RAX, NIL_BITS);
+                    for (int i = 0; i <= b; ++i) as.store(RBX, slot(a + i), RAX);
+                    return;
+                case OpCode::ADD: case OpCode::ADD_NN: arith(pc, a, b, c, &Assembler::addsd); return;
+                case OpCode::SUB: case OpCode::SUB_NN: arith(pc, a, b, c, &Assembler::subsd); return;
+                case OpCode::MUL: case OpCode::MUL_NN: arith(pc, a, b, c, &Assembler::mulsd); return;
+                case OpCode::DIV: case OpCode::DIV_NN:
+                    // A zero divisor is left to the interpreter, which decides whether it is an error
+                    loadNumbers(pc, b, c);
+                    as.xorpd(2, 2);
+                    as.ucomisd(1, 2);
+                    as.jcc(CC_E, stub(JitCode::EXIT_INTERPRET, pc));
+                    as.divsd(0, 1);
+                    storeNumber(a);
+                    return;
+                case OpCode::UNM:
+                    as.load(RAX, RBX, slot(b));
+                    guardNumber(RAX, pc);
+                    as.btc63(RAX);
+                    as.movqToXmm(0, RAX);
+                    storeNumber(a);
+                    return;
+                case OpCode::LT: case OpCode::LT_NN: case OpCode::LT_JMP:
+                case OpCode::LE: case OpCode::LE_NN: case OpCode::LE_JMP: {
+                    bool isLess = op == OpCode::LT || op == OpCode::LT_NN || op == OpCode::LT_JMP;
+                    loadNumbers(pc, b, c);
+                    as.ucomisd(1, 0);
+                    as.setcc(isLess ? CC_A : CC_AE, RDX);
+                    storeBool(a);
+                    if (op == OpCode::LT_JMP || op == OpCode::LE_JMP) {
+                        // Its TEST/JMP words were not a match above; run them as written
+                        as.jmp(target((int64_t)pc + 1));
+                    }
+                    return;
+                }
+                case OpCode::EQ: {
+                    // PomeValue::operator== is bit equality, except that strings outside
+                    // the intern pool compare contents, so two objects go to the helper
+                    int decided = as.newLabel(), done = as.newLabel();
+                    as.load(RAX, RBX, slot(b));
+                    as.load(RCX, RBX, slot(c));
+                    as.cmpq(RAX, RCX);
+                    as.setcc(CC_E, RDX);
+                    as.jcc(CC_E, decided);
+                    as.andq(RAX, RCX);
+                    as.movImm64(RCX, OBJECT_BITS);
+                    as.andq(RAX, RCX);
+                    as.cmpq(RAX, RCX);
+                    as.jcc(CC_NE, decided);
+                    callHelper(&Jit::equal, pc);
+                    as.jmp(done);
+                    as.bind(decided);
+                    storeBool(a);
+                    as.bind(done);
+                    return;
+                }
+                case OpCode::NOT: {
+                    int isTrue = as.newLabel(), isFalse = as.newLabel(), done = as.newLabel();
+                    as.load(RAX, RBX, slot(b));
+                    truthy(isTrue, isFalse);
+                    as.bind(isTrue);
+                    as.movImm64(RAX, FALSE_BITS);
+                    as.jmp(done);
+                    as.bind(isFalse);
+                    as.movImm64(RAX, TRUE_BITS);
+                    as.bind(done);
+                    as.store(RBX, slot(a), RAX);
+                    return;
+                }
+                case OpCode::TEST: {
+                    int next = target((int64_t)pc + 1);
+                    int skip = target((int64_t)pc + 2);
+                    as.load(RAX, RBX, slot(a));
+                    if (c != 0) truthy(skip, next);
+                    else truthy(next, skip);
+                    return;
+                }
+                case OpCode::JMP:
+                    as.jmp(target((int64_t)pc + 1 + sbx));
+                    return;
+                case OpCode::GETTABLE: case OpCode::GETTABLE_CACHE: case OpCode::GETTABLE_ADD_SET:
+                case OpCode::GETLIST_N: case OpCode::GETLIST_D: case OpCode::GETLIST_I:
+                    callHelper(&Jit::getTable, pc);
+                    return;
+                case OpCode::SETTABLE: case OpCode::SETTABLE_CACHE:
+                case OpCode::SETLIST_N: case OpCode::SETLIST_D: case OpCode::SETLIST_I:
+                    callHelper(&Jit::setTable, pc);
+                    return;
+                case OpCode::GETFIELD: case OpCode::GETFIELD_CACHE:
+                    callHelper(&Jit::getField, pc);
+                    return;
+                case OpCode::SETFIELD: case OpCode::SETFIELD_CACHE:
+                    callHelper(&Jit::setField, pc);
+                    return;
+                case OpCode::GETGLOBAL: case OpCode::GETGLOBAL_CACHE:
+                    callHelper(&Jit::getGlobal, pc);
+                    return;
+                case OpCode::GETUPVAL:
+                    callHelper(&Jit::getUpvalue, pc);
+                    return;
+                case OpCode::SETUPVAL:
+                    callHelper(&Jit::setUpvalue, pc);
+                    return;
+                case OpCode::CALL:
+                    callHelper(&Jit::callNative, pc);
+                    return;
+                case OpCode::CHECKMETHOD:
+                    callHelper(&Jit::checkMethod, pc);
+                    as.jmp(target((int64_t)pc + 2));
+                    return;
+                default:
+                    break;
+            }
+            exitHere(pc);
+        }
+    };
+
+    bool Jit::supported() { return true; }
+
+    std::shared_ptr<JitCode> Jit::compile(const Chunk& chunk) {
+        return Codegen(chunk).run();
+    }
+
+#else
+
+    bool Jit::supported() { return false; }
+
+    std::shared_ptr<JitCode> Jit::compile(const Chunk&) { return nullptr; }
+
+#endif
+
+}
@@ -0,0 +1,504 @@
+#include "../include/pome_json.h"
+#include "../include/pome_gc.h"
+#include "../include/pome_shape.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace Pome {
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    static void appendUtf8(std::string& out, uint32_t codepoint) {
+        if (codepoint < 0x80) {
+            out += static_cast<char>(codepoint);
+        } else if (codepoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codepoint >> 6));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codepoint >> 12));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codepoint >> 18));
+            out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        }
+    }
+
+    // ---- JsonParser ----
+
+    bool JsonParser::parse(const PomeString* source, PomeValue& result) {
+        // Everything allocated here ends up in the result, so a collection could only find it live
+        CollectionDeferral deferral(gc_);
+        std::string_view text = source->view();
+        source_ = source;
+        begin_ = pos_ = text.data();
+        end_ = text.data() + text.size();
+        stack_.clear();
+        hints_.clear();
+        error_.clear();
+
+        skipSpace();
+        if (!parseValue(result, 0)) return false;
+        skipSpace();
+        if (pos_ != end_) return fail("Unexpected text after the value");
+        return true;
+    }
+
+    bool JsonParser::fail(const std::string& message) {
+        error_ = message + " at offset " + std::to_string(pos_ - begin_) + ".";
+        return false;
+    }
+
+    void JsonParser::skipSpace() {
+        while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) ++pos_;
+    }
+
+    bool JsonParser::parseValue(PomeValue& out, int depth) {
+        if (pos_ >= end_) return fail("Unexpected end of input");
+        switch (*pos_) {
+        case '{':
+            return parseObject(out, depth);
+        case '[':
+            return parseArray(out, depth);
+        case '"': {
+            std::string_view text;
+            bool escaped;
+            if (!parseString(text, escaped)) return false;
+            // Long values without escapes can share the source's bytes
+            out = escaped ? PomeValue(gc_.allocateString(text))
+                          : PomeValue(gc_.sliceString(source_, text.data() - begin_, text.size()));
+            return true;
+        }
+        case 't':
+            return parseLiteral("true", PomeValue(true), out);
+        case 'f':
+            return parseLiteral("false", PomeValue(false), out);
+        case 'n':
+            return parseLiteral("null", PomeValue(), out);
+        default:
+            if (*pos_ == '-' || isDigit(*pos_)) return parseNumber(out);
+            return fail(std::string("Unexpected character '") + *pos_ + "'");
+        }
+    }
+
+    bool JsonParser::parseLiteral(const char* word, PomeValue value, PomeValue& out) {
+        size_t length = strlen(word);
+        if (static_cast<size_t>(end_ - pos_) < length || memcmp(pos_, word, length) != 0) {
+            return fail("Unexpected character '" + std::string(1, *pos_) + "'");
+        }
+        pos_ += length;
+        out = value;
+        return true;
+    }
+
+    PomeValue JsonParser::makeKey(std::string_view text, const ShapeHint* hint, size_t slot) {
+        // The key the last object at this depth had in this position saves a pool lookup
+        if (hint && slot < hint->keys.size() && hint->keys[slot].asPomeString()->view() == text) {
+            return hint->keys[slot];
+        }
+        return PomeValue(gc_.allocateString(text));
+    }
+
+    bool JsonParser::parseObject(PomeValue& out, int depth) {
+        if (depth >= MAX_DEPTH) return fail("Nesting too deep");
+        ++pos_;
+        if (hints_.size() <= static_cast<size_t>(depth)) hints_.resize(depth + 1);
+        size_t base = stack_.size();
+
+        skipSpace();
+        if (pos_ < end_ && *pos_ == '}') {
+            ++pos_;
+        } else {
+            while (true) {
+                skipSpace();
+                if (pos_ >= end_ || *pos_ != '"') return fail("Expected a string key");
+                std::string_view text;
+                bool escaped;
+                if (!parseString(text, escaped)) return false;
+                // Deeper objects may grow hints_, so the hint is looked up afresh for every key
+                const ShapeHint* hint = hints_[depth].shape ? &hints_[depth] : nullptr;
+                stack_.push_back(makeKey(text, hint, (stack_.size() - base) / 2));
+                skipSpace();
+                if (pos_ >= end_ || *pos_ != ':') return fail("Expected ':'");
+                ++pos_;
+                skipSpace();
+                PomeValue value;
+                if (!parseValue(value, depth + 1)) return false;
+                stack_.push_back(value);
+                skipSpace();
+                if (pos_ < end_ && *pos_ == ',') {
+                    ++pos_;
+                    continue;
+                }
+                if (pos_ < end_ && *pos_ == '}') {
+                    ++pos_;
+                    break;
+                }
+                return fail("Expected ',' or '}'");
+            }
+        }
+
+        size_t count = (stack_.size() - base) / 2;
+        PomeTable* table = gc_.allocate<PomeTable>(gc_.getRootShape());
+        ShapeHint& hint = hints_[depth];
+        bool sameKeys = hint.shape && hint.keys.size() == count;
+        for (size_t i = 0; sameKeys && i < count; ++i) sameKeys = stack_[base + 2 * i] == hint.keys[i];
+
+        if (sameKeys) {
+            table->shape = hint.shape;
+            table->properties.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                PomeValue value = stack_[base + 2 * i + 1];
+                table->properties.push_back(value);
+                value.incRef();
+                gc_.writeBarrier(table, value);
+            }
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                PomeValue value = stack_[base + 2 * i + 1];
+                table->setField(gc_, stack_[base + 2 * i], value);
+                gc_.writeBarrier(table, value);
+            }
+            // Repeated keys and tables past the shape limits make poor hints
+            if (count > 0 && !table->isDictionary && table->properties.size() == count) {
+                hint.shape = table->shape;
+                hint.keys.resize(count);
+                for (size_t i = 0; i < count; ++i) hint.keys[i] = stack_[base + 2 * i];
+            }
+        }
+        stack_.resize(base);
+        out = PomeValue(table);
+        return true;
+    }
+
+    bool JsonParser::parseArray(PomeValue& out, int depth) {
+        if (depth >= MAX_DEPTH) return fail("Nesting too deep");
+        ++pos_;
+        size_t base = stack_.size();
+
+        skipSpace();
+        if (pos_ < end_ && *pos_ == ']') {
+            ++pos_;
+        } else {
+            while (true) {
+                skipSpace();
+                PomeValue value;
+                if (!parseValue(value, depth + 1)) return false;
+                stack_.push_back(value);
+                skipSpace();
+                if (pos_ < end_ && *pos_ == ',') {
+                    ++pos_;
+                    continue;
+                }
+                if (pos_ < end_ && *pos_ == ']') {
+                    ++pos_;
+                    break;
+                }
+                return fail("Expected ',' or ']'");
+            }
+        }
+
+        size_t count = stack_.size() - base;
+        bool allBool = count > 0, allNumber = count > 0, allInt32 = count > 0;
+        for (size_t i = base; i < stack_.size(); ++i) {
+            const PomeValue& value = stack_[i];
+            allBool = allBool && value.isBool();
+            allNumber = allNumber && value.isNumber();
+            if (allInt32) {
+                allInt32 = value.isNumber() && value.asNumber() >= INT32_MIN && value.asNumber() <= INT32_MAX &&
+                           value.asNumber() == static_cast<int32_t>(value.asNumber());
+            }
+        }
+
+        PomeList* list = gc_.allocateList();
+        size_t oldExtra = list->extraSize();
+        if (allBool || allNumber) {
+            list->listType = allBool ? ListType::BOOL : allInt32 ? ListType::INT32 : ListType::DOUBLE;
+            list->ensureCapacity(count);
+            list->unboxedCount = count;
+            for (size_t i = 0; i < count; ++i) {
+                const PomeValue& value = stack_[base + i];
+                if (allBool) list->asBool()[i] = value.isTrue();
+                else if (allInt32) list->asInt32()[i] = static_cast<int32_t>(value.asNumber());
+                else list->asDouble()[i] = value.asNumber();
+            }
+        } else {
+            list->elements.reserve(count);
+            for (size_t i = base; i < stack_.size(); ++i) {
+                PomeValue value = stack_[i];
+                list->elements.push_back(value);
+                value.incRef();
+                gc_.writeBarrier(list, value);
+            }
+        }
+        gc_.updateSize(list, sizeof(PomeList) + oldExtra, sizeof(PomeList) + list->extraSize());
+        stack_.resize(base);
+        out = PomeValue(list);
+        return true;
+    }
+
+    bool JsonParser::parseString(std::string_view& text, bool& escaped) {
+        const char* start = ++pos_;
+        while (pos_ < end_ && *pos_ != '"' && *pos_ != '\\' && static_cast<unsigned char>(*pos_) >= 0x20) ++pos_;
+        if (pos_ < end_ && *pos_ == '"') {
+            text = std::string_view(start, pos_ - start);
+            escaped = false;
+            ++pos_;
+            return true;
+        }
+
+        scratch_.assign(start, pos_);
+        while (true) {
+            if (pos_ >= end_) return fail("Unterminated string");
+            char c = *pos_++;
+            if (c == '"') break;
+            if (static_cast<unsigned char>(c) < 0x20) {
+                --pos_;
+                return fail("Control character in string");
+            }
+            if (c != '\\') {
+                scratch_ += c;
+                continue;
+            }
+            if (pos_ >= end_) return fail("Unterminated string");
+            switch (*pos_++) {
+            case '"': scratch_ += '"'; break;
+            case '\\': scratch_ += '\\'; break;
+            case '/': scratch_ += '/'; break;
+            case 'b': scratch_ += '\b'; break;
+            case 'f': scratch_ += '\f'; break;
+            case 'n': scratch_ += '\n'; break;
+            case 'r': scratch_ += '\r'; break;
+            case 't': scratch_ += '\t'; break;
+            case 'u': {
+                auto hex4 = [this](uint32_t& unit) {
+                    if (end_ - pos_ < 4) return false;
+                    auto [next, ec] = std::from_chars(pos_, pos_ + 4, unit, 16);
+                    if (ec != std::errc() || next != pos_ + 4) return false;
+                    pos_ = next;
+                    return true;
+                };
+                uint32_t unit;
+                if (!hex4(unit)) return fail("Invalid \\u escape");
+                if (unit >= 0xD800 && unit < 0xDC00) {
+                    // A high surrogate pairs with the low one after it; alone it has no code point
+                    uint32_t low;
+                    const char* mark = pos_;
+                    if (end_ - pos_ >= 2 && pos_[0] == '\\' && pos_[1] == 'u' && (pos_ += 2, hex4(low)) &&
+                        low >= 0xDC00 && low < 0xE000) {
+                        unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                    } else {
+                        pos_ = mark;
+                        unit = 0xFFFD;
+                    }
+                } else if (unit >= 0xDC00 && unit < 0xE000) {
+                    unit = 0xFFFD;
+                }
+                appendUtf8(scratch_, unit);
+                break;
+            }
+            default:
+                --pos_;
+                return fail("Invalid escape");
+            }
+        }
+        text = scratch_;
+        escaped = true;
+        return true;
+    }
+
+    bool JsonParser::parseNumber(PomeValue& out) {
+        const char* start = pos_;
+        bool negative = *pos_ == '-';
+        if (negative) ++pos_;
+        if (pos_ < end_ && *pos_ == '0') {
+            ++pos_;
+        } else if (pos_ < end_ && isDigit(*pos_)) {
+            while (pos_ < end_ && isDigit(*pos_)) ++pos_;
+        } else {
+            return fail("Invalid number");
+        }
+        const char* integerEnd = pos_;
+        bool integral = true;
+        if (pos_ < end_ && *pos_ == '.') {
+            integral = false;
+            ++pos_;
+            if (pos_ >= end_ || !isDigit(*pos_)) return fail("Invalid number");
+            while (pos_ < end_ && isDigit(*pos_)) ++pos_;
+        }
+        if (pos_ < end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+            integral = false;
+            ++pos_;
+            if (pos_ < end_ && (*pos_ == '+' || *pos_ == '-')) ++pos_;
+            if (pos_ >= end_ || !isDigit(*pos_)) return fail("Invalid number");
+            while (pos_ < end_ && isDigit(*pos_)) ++pos_;
+        }
+
+        // Integers of up to 15 digits are exact as doubles and need no general conversion
+        const char* digits = start + (negative ? 1 : 0);
+        if (integral && integerEnd - digits <= 15) {
+            int64_t value = 0;
+            for (const char* p = digits; p < integerEnd; ++p) value = value * 10 + (*p - '0');
+            out = PomeValue(static_cast<double>(negative ? -value : value));
+            if (negative && value == 0) out = PomeValue(-0.0);
+            return true;
+        }
+        double value;
+        auto [next, ec] = std::from_chars(start, pos_, value);
+        if (ec == std::errc::result_out_of_range) {
+            value = strtod(std::string(start, pos_).c_str(), nullptr);
+        } else if (ec != std::errc() || next != pos_) {
+            return fail("Invalid number");
+        }
+        out = PomeValue(value);
+        return true;
+    }
+
+    // ---- JsonWriter ----
+
+    void JsonWriter::clear() {
+        if (out_.capacity() > RETAIN_BYTES) std::string().swap(out_);
+        else out_.clear();
+    }
+
+    bool JsonWriter::write(const PomeValue& value, int indent) {
+        indent_ = indent > 0 ? indent : 0;
+        chain_.clear();
+        return writeValue(value, 0);
+    }
+
+    void JsonWriter::newline(int depth) {
+        if (indent_ == 0) return;
+        out_ += '\n';
+        out_.append(static_cast<size_t>(depth) * indent_, ' ');
+    }
+
+    void JsonWriter::writeNumber(double number) {
+        if (!std::isfinite(number)) {
+            out_ += "null";
+            return;
+        }
+        char text[32];
+        std::to_chars_result end;
+        if (number == std::trunc(number) && std::fabs(number) < 1e15) {
+            end = std::to_chars(text, text + sizeof(text), static_cast<int64_t>(number));
+        } else {
+            end = std::to_chars(text, text + sizeof(text), number);
+        }
+        out_.append(text, end.ptr);
+    }
+
+    void JsonWriter::writeString(std::string_view text) {
+        static const char HEX[] = "0123456789abcdef";
+        out_ += '"';
+        size_t run = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            out_.append(text.data() + run, i - run);
+            run = i + 1;
+            switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            case '\b': out_ += "\\b"; break;
+            case '\f': out_ += "\\f"; break;
+            default:
+                out_ += "\\u00";
+                out_ += HEX[c >> 4];
+                out_ += HEX[c & 0xF];
+            }
+        }
+        out_.append(text.data() + run, text.size() - run);
+        out_ += '"';
+    }
+
+    bool JsonWriter::writeKey(const PomeValue& key) {
+        if (key.isString()) {
+            writeString(key.asPomeString()->view());
+        } else if (key.isNumber()) {
+            out_ += '"';
+            writeNumber(key.asNumber());
+            out_ += '"';
+        } else if (key.isBool()) {
+            out_ += key.isTrue() ? "\"true\"" : "\"false\"";
+        } else {
+            return false;
+        }
+        out_ += indent_ ? ": " : ":";
+        return true;
+    }
+
+    bool JsonWriter::writeValue(const PomeValue& value, int depth) {
+        if (value.isNil()) {
+            out_ += "null";
+        } else if (value.isBool()) {
+            out_ += value.isTrue() ? "true" : "false";
+        } else if (value.isNumber()) {
+            writeNumber(value.asNumber());
+        } else if (value.isString()) {
+            writeString(value.asPomeString()->view());
+        } else if (value.isList()) {
+            if (depth >= MAX_DEPTH) return false;
+            PomeList* list = value.asList();
+            size_t count = list->size();
+            out_ += '[';
+            for (size_t i = 0; i < count; ++i) {
+                if (i > 0) out_ += ',';
+                newline(depth + 1);
+                if (list->listType == ListType::DOUBLE) writeNumber(list->asDouble()[i]);
+                else if (list->listType == ListType::INT32) writeNumber(list->asInt32()[i]);
+                else if (!writeValue(list->at(i), depth + 1)) return false;
+            }
+            if (count > 0) newline(depth);
+            out_ += ']';
+        } else if (value.isTable()) {
+            if (depth >= MAX_DEPTH) return false;
+            PomeTable* table = value.asTable();
+            bool first = true;
+            auto member = [&](const PomeValue& key, const PomeValue& field) {
+                if (!first) out_ += ',';
+                first = false;
+                newline(depth + 1);
+                return writeKey(key) && writeValue(field, depth + 1);
+            };
+
+            out_ += '{';
+            for (size_t i = 0; i < table->array.size(); ++i) {
+                if (table->array[i].isNil()) continue;
+                if (!member(PomeValue(static_cast<double>(i)), table->array[i])) return false;
+            }
+            // Shaped keys in the order they were added: the chain runs from the newest.
+            // Nested tables push theirs above this one's, so it is read by index.
+            size_t base = chain_.size();
+            for (PomeShape* s = table->shape; s && s->parent; s = s->parent) chain_.push_back(s);
+            for (size_t i = chain_.size(); i > base; --i) {
+                PomeShape* shape = chain_[i - 1];
+                size_t slot = static_cast<size_t>(shape->propertyIndex);
+                if (slot >= table->properties.size()) continue;
+                if (!member(shape->propertyKey, table->properties[slot])) {
+                    chain_.resize(base);
+                    return false;
+                }
+            }
+            chain_.resize(base);
+            for (const auto& [key, field] : table->backfill) {
+                if (!member(key, field)) return false;
+            }
+            if (!first) newline(depth);
+            out_ += '}';
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+} // namespace Pome
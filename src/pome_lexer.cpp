@@ -68,12 +68,18 @@ namespace Pome
      */
     std::string Token::debugString() const
     {
-        return "Type: " + Token::toString(type) + ", Value: '" + value + "', Line: " + std::to_string(line) + ", Col: " + std::to_string(column);
+        return "Type: " + Token::toString(type) + ", Value: '" + text() + "', Line: " + std::to_string(line) + ", Col: " + std::to_string(column);
     }
 
-    Lexer::Lexer(const std::string &source)
+    Lexer::Lexer(std::string_view source)
         : source(source), currentPos(0), currentLine(1), currentCol(1) {}
 
+    std::string_view Lexer::keep(std::string text)
+    {
+        ownedText.push_back(std::move(text));
+        return ownedText.back();
+    }
+
     char Lexer::peek()
     {
         if (currentPos >= source.length())
@@ -169,12 +175,12 @@ namespace Pome
         {
             advance();
         }
-        std::string value = source.substr(start, currentPos - start);
+        std::string_view value = source.substr(start, currentPos - start);
 
         /**
          * Check for keywords
          */
-        static const std::map<std::string, TokenType> keywords = {
+        static const std::map<std::string_view, TokenType> keywords = {
             {"fun", TokenType::FUNCTION}, {"if", TokenType::IF}, {"else", TokenType::ELSE}, {"while", TokenType::WHILE}, {"for", TokenType::FOR}, {"return", TokenType::RETURN}, {"true", TokenType::TRUE}, {"false", TokenType::FALSE}, {"nil", TokenType::NIL}, {"import", TokenType::IMPORT}, {"from", TokenType::FROM}, {"export", TokenType::EXPORT}, {"var", TokenType::VAR}, {"class", TokenType::CLASS}, {"extends", TokenType::EXTENDS}, {"this", TokenType::THIS},
             {"break", TokenType::BREAK}, {"continue", TokenType::CONTINUE}, {"try", TokenType::TRY}, {"catch", TokenType::CATCH}, {"throw", TokenType::THROW}, {"super", TokenType::SUPER},
             {"async", TokenType::ASYNC}, {"await", TokenType::AWAIT},
@@ -230,8 +236,7 @@ namespace Pome
                 // Leave it to std::stod to handle invalid format, but consume the 'e'/'E' and optional sign.
             }
         }
-        std::string value = source.substr(start, currentPos - start);
-        return makeToken(TokenType::NUMBER, value);
+        return makeToken(TokenType::NUMBER, source.substr(start, currentPos - start));
     }
 
     Token Lexer::readString()
@@ -240,7 +245,8 @@ namespace Pome
          * Assume opening quote has already been consumed
          */
         size_t start = currentPos;
-        std::string raw_value; // To build the string with processed escapes
+        bool escaped = false;
+        std::string raw_value; // Only built once an escape sequence turns up
 
         while (peek() != '"' && peek() != '\0')
         {
@@ -251,6 +257,11 @@ namespace Pome
 
             if (peek() == '\\')
             {              // Handle escape sequences
+                if (!escaped)
+                {
+                    raw_value = std::string(source.substr(start, currentPos - start));
+                    escaped = true;
+                }
                 advance(); // Consume '\\'
                 char escapedChar = peek();
                 switch (escapedChar)
@@ -281,7 +292,7 @@ namespace Pome
             }
             else
             {
-                raw_value += peek();
+                if (escaped) raw_value += peek();
                 advance(); // Consume regular character
             }
         }
@@ -291,12 +302,13 @@ namespace Pome
             throw std::runtime_error("Unterminated string literal (EOF)");
         }
 
+        std::string_view value = escaped ? keep(std::move(raw_value)) : source.substr(start, currentPos - start);
         // Consume the closing quote
         advance();
-        return makeToken(TokenType::STRING, raw_value);
+        return makeToken(TokenType::STRING, value);
     }
 
-    Token Lexer::makeToken(TokenType type, const std::string &value)
+    Token Lexer::makeToken(TokenType type, std::string_view value)
     {
         /**
          * Adjust currentCol for the length of the token value for accurate reporting.
@@ -342,7 +354,7 @@ namespace Pome
                 /**
                  * For now, re-throw or return an error token
                  */
-                token = makeToken(TokenType::UNKNOWN, e.what()); // Or handle more gracefully
+                token = makeToken(TokenType::UNKNOWN, keep(e.what())); // Or handle more gracefully
             }
         }
 
@@ -516,8 +528,8 @@ namespace Pome
                 break;
             }
             default:
-                std::string unknownChar(1, advance());
-                token = makeToken(TokenType::UNKNOWN, unknownChar);
+                advance();
+                token = makeToken(TokenType::UNKNOWN, source.substr(currentPos - 1, 1));
                 break;
             }
         return token;
@@ -86,7 +86,7 @@ namespace Pome {
 #endif
     }
 
-    bool ModuleResolver::isNativeModule(const std::string& pkgRoot, const std::string& moduleName) {
+    bool ModuleResolver::isNativeModule(const std::string& pkgRoot, const std::string& moduleName) const {
         std::string pkgJsonPath = pkgRoot + "/pome_pkg.json";
         if (FileUtils::exists(pkgJsonPath)) {
             try {
@@ -141,7 +141,7 @@ namespace Pome {
         return false;
     }
 
-    ResolutionResult ModuleResolver::resolve(const std::string& logicalPath, const std::string& originPath) {
+    ResolutionResult ModuleResolver::resolve(const std::string& logicalPath, const std::string& originPath) const {
         std::string pathSegment = logicalPath;
         bool isRelative = false;
 
@@ -0,0 +1,160 @@
+#include "../include/pome_nursery.h"
+
+#include <iterator>
+#include <new>
+
+namespace Pome {
+
+    namespace {
+        constexpr std::align_val_t BLOCK_ALIGN{Nursery::BLOCK_SIZE};
+    }
+
+    Nursery::~Nursery() {
+        for (size_t i = 0; i < std::size(freeSlots_); ++i) {
+            for (void* ptr : freeSlots_[i]) release(ptr);
+        }
+        // Blocks that still hold objects are left alone: an isolate's heap can outlive its collector
+        auto dispose = [](Block* block) {
+            if (block->liveBytes.load(std::memory_order_acquire) == 0) ::operator delete(block, BLOCK_ALIGN);
+        };
+        if (current_) dispose(current_);
+        for (Block* block : full_) dispose(block);
+        for (Block* block : recyclable_) dispose(block);
+        for (Block* block : free_) ::operator delete(block, BLOCK_ALIGN);
+    }
+
+    Nursery::Block* Nursery::newBlock() const {
+        // Aligned, so a slot header can hold its block's address and still have bits to spare
+        Block* block = new (::operator new(BLOCK_SIZE, BLOCK_ALIGN)) Block();
+        block->owner = this;
+        rewind(block);
+        return block;
+    }
+
+    void Nursery::rewind(Block* block) {
+        block->next = block->top = block->scan = blockStart(block);
+        block->end = blockEnd(block);
+    }
+
+    size_t Nursery::freeBytes(const Block* block) {
+        return BLOCK_SIZE - sizeof(Block) - block->liveBytes.load(std::memory_order_acquire);
+    }
+
+    void Nursery::closeRun() {
+        Block* block = current_;
+        if (block->end == blockEnd(block)) {
+            // Nothing below has been searched since this run started
+            block->top = block->scan = block->next;
+        } else if (block->next != block->end) {
+            header(block->next).store(reinterpret_cast<uintptr_t>(block) | FREE | (block->end - block->next) / ALIGN,
+                                      std::memory_order_relaxed);
+        }
+        block->next = block->end;
+    }
+
+    bool Nursery::findRun(Block* block, size_t slot) {
+        char* p = block->scan;
+        while (p < block->top) {
+            uintptr_t word = header(p).load(std::memory_order_relaxed);
+            if (!(word & FREE)) {
+                p += (word & SLOT_UNITS) * ALIGN;
+                continue;
+            }
+            // Coalesce the free slots that follow; a run reaching the top takes in the untouched tail
+            char* start = p;
+            while (p < block->top && (header(p).load(std::memory_order_relaxed) & FREE)) {
+                p += (header(p).load(std::memory_order_relaxed) & SLOT_UNITS) * ALIGN;
+            }
+            if (p == block->top) {
+                block->top = start;
+                break;
+            }
+            if (static_cast<size_t>(p - start) >= slot) {
+                block->next = start;
+                block->end = block->scan = p;
+                return true;
+            }
+            // Too small for now; merged, so the next search steps over it at once
+            header(start).store(reinterpret_cast<uintptr_t>(block) | FREE | (p - start) / ALIGN,
+                                std::memory_order_relaxed);
+        }
+        block->scan = block->top;
+        if (static_cast<size_t>(blockEnd(block) - block->top) < slot) return false;
+        block->next = block->top;
+        block->end = blockEnd(block);
+        return true;
+    }
+
+    void Nursery::nextRun(size_t slot) {
+        if (current_) {
+            closeRun();
+            if (findRun(current_, slot)) return;
+            full_.push_back(current_);
+        }
+        while (!recyclable_.empty()) {
+            current_ = recyclable_.back();
+            recyclable_.pop_back();
+            if (findRun(current_, slot)) {
+                ++recycledBlocks_;
+                return;
+            }
+            full_.push_back(current_);
+        }
+        if (!free_.empty()) {
+            current_ = free_.back();
+            free_.pop_back();
+        } else {
+            current_ = newBlock();
+        }
+    }
+
+    void Nursery::reclaim() {
+        if (current_ && current_->liveBytes.load(std::memory_order_acquire) == 0) rewind(current_);
+
+        std::vector<Block*> retired;
+        retired.swap(full_);
+        retired.insert(retired.end(), recyclable_.begin(), recyclable_.end());
+        recyclable_.clear();
+        for (Block* block : retired) {
+            if (block->liveBytes.load(std::memory_order_acquire) == 0) {
+                if (free_.size() < MAX_FREE_BLOCKS) {
+                    rewind(block);
+                    free_.push_back(block);
+                } else {
+                    ::operator delete(block, BLOCK_ALIGN);
+                }
+            } else if (freeBytes(block) >= RECYCLE_MIN_FREE) {
+                block->scan = blockStart(block);
+                recyclable_.push_back(block);
+            } else {
+                full_.push_back(block);
+            }
+        }
+    }
+
+    Nursery::Stats Nursery::stats() const {
+        Stats stats;
+        stats.bumpAllocations = bumpAllocations_;
+        stats.slotReuses = slotReuses_;
+        stats.reservedBytes = bytesReserved();
+        stats.cachedBytes = cachedBytes_;
+        stats.recycledBlocks = recycledBlocks_;
+        auto count = [&stats](const Block* block, const char* top, bool reusable) {
+            size_t used = top - reinterpret_cast<const char*>(block + 1);
+            size_t live = block->liveBytes.load(std::memory_order_relaxed);
+            stats.usedBytes += used;
+            stats.liveBytes += live;
+            if (reusable && used > live) stats.recycledBytes += used - live;
+        };
+        if (current_) {
+            // While the current block runs through its tail, top has not caught up with the bump pointer
+            count(current_, current_->end == blockEnd(current_) ? current_->next : current_->top, true);
+        }
+        for (const Block* block : full_) count(block, block->top, false);
+        for (const Block* block : recyclable_) count(block, block->top, true);
+        // liveBytes counts cached slots too, since their blocks have not got them back
+        stats.liveBytes -= stats.cachedBytes;
+        return stats;
+    }
+
+}
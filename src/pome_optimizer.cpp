@@ -0,0 +1,485 @@
+#include "../include/pome_optimizer.h"
+#include "../include/pome_gc.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace Pome {
+
+    // --- Constant folding ---
+
+    bool Optimizer::foldUnary(const std::string& op, PomeValue operand, PomeValue& result) {
+        // The compiler emits NOT for "!" and UNM for everything else
+        if (op == "!") {
+            result = PomeValue(!operand.asBool());
+            return true;
+        }
+        if (!operand.isNumber()) return false;
+        result = PomeValue(-operand.asNumber());
+        return true;
+    }
+
+    bool Optimizer::foldBinary(GarbageCollector& gc, const std::string& op, PomeValue left, PomeValue right,
+                               PomeValue& result) {
+        if (op == "==" || op == "!=") {
+            result = PomeValue((left == right) == (op == "=="));
+            return true;
+        }
+        if (op == "+" && !left.isNumber() && (left.isString() || right.isString())) {
+            result = PomeValue(gc.allocateString(left.toString() + right.toString()));
+            return true;
+        }
+        if (!left.isNumber() || !right.isNumber()) return false;
+
+        double l = left.asNumber(), r = right.asNumber();
+        if (op == "+") result = PomeValue(l + r);
+        else if (op == "-") result = PomeValue(l - r);
+        else if (op == "*") result = PomeValue(l * r);
+        else if (op == "/") {
+            if (r == 0.0) return false; // Raises "Division by zero." at run time
+            result = PomeValue(l / r);
+        }
+        else if (op == "%") result = PomeValue(std::fmod(l, r));
+        else if (op == "^") result = PomeValue(std::pow(l, r));
+        else if (op == "<") result = PomeValue(l < r);
+        else if (op == "<=") result = PomeValue(l <= r);
+        else if (op == ">") result = PomeValue(l > r);
+        else if (op == ">=") result = PomeValue(l >= r);
+        else return false;
+        return true;
+    }
+
+    // --- Rebinding and liveness scan ---
+
+    namespace {
+
+        struct BindingScan {
+            std::unordered_map<std::string, int> declarations;
+            std::unordered_map<std::string, int> bindings; // Every declaration and write
+            std::unordered_set<std::string> rebound;
+            Optimizer::Liveness liveness;
+            int position = 0;
+            int functionDepth = 0;
+
+            void use(const std::string& name) {
+                liveness.lastUses[name] = ++position;
+            }
+
+            void declare(const std::string& name) {
+                ++bindings[name];
+                if (++declarations[name] > 1) rebound.insert(name);
+                if (functionDepth == 0) ++liveness.declarations;
+                use(name);
+            }
+
+            void bind(const std::string& name) {
+                ++bindings[name];
+                rebound.insert(name);
+                use(name);
+            }
+
+            void function(const std::vector<std::unique_ptr<Statement>>& statements) {
+                ++functionDepth;
+                body(statements);
+                --functionDepth;
+            }
+
+            void body(const std::vector<std::unique_ptr<Statement>>& statements) {
+                for (const auto& s : statements) statement(s.get());
+            }
+
+            void statement(Statement* stmt) {
+                if (!stmt) return;
+                switch (stmt->getType()) {
+                    case ASTNode::VAR_DECL_STMT: {
+                        auto* s = static_cast<VarDeclStmt*>(stmt);
+                        declare(s->getName());
+                        expression(s->getInitializer());
+                        break;
+                    }
+                    case ASTNode::ASSIGN_STMT: {
+                        auto* s = static_cast<AssignStmt*>(stmt);
+                        target(s->getTarget());
+                        expression(s->getValue());
+                        break;
+                    }
+                    case ASTNode::IF_STMT: {
+                        auto* s = static_cast<IfStmt*>(stmt);
+                        expression(s->getCondition());
+                        body(s->getThenBranch());
+                        body(s->getElseBranch());
+                        break;
+                    }
+                    case ASTNode::WHILE_STMT: {
+                        auto* s = static_cast<WhileStmt*>(stmt);
+                        expression(s->getCondition());
+                        body(s->getBody());
+                        break;
+                    }
+                    case ASTNode::FOR_STMT: {
+                        // In the order the compiler emits them: the increment follows the body
+                        auto* s = static_cast<ForStmt*>(stmt);
+                        statement(s->getInitializer());
+                        expression(s->getCondition());
+                        body(s->getBody());
+                        statement(s->getIncrement());
+                        break;
+                    }
+                    case ASTNode::FOR_EACH_STMT: {
+                        auto* s = static_cast<ForEachStmt*>(stmt);
+                        bind(s->getVarName());
+                        expression(s->getIterable());
+                        body(s->getBody());
+                        break;
+                    }
+                    case ASTNode::THROW_STMT:
+                        expression(static_cast<ThrowStmt*>(stmt)->getValue());
+                        break;
+                    case ASTNode::TRY_CATCH_STMT: {
+                        auto* s = static_cast<TryCatchStmt*>(stmt);
+                        body(s->getTryBlock());
+                        bind(s->getCatchVar());
+                        body(s->getCatchBlock());
+                        break;
+                    }
+                    case ASTNode::BLOCK_STMT:
+                        body(static_cast<BlockStmt*>(stmt)->getStatements());
+                        break;
+                    case ASTNode::RETURN_STMT:
+                        expression(static_cast<ReturnStmt*>(stmt)->getValue());
+                        break;
+                    case ASTNode::EXPRESSION_STMT:
+                        expression(static_cast<ExpressionStmt*>(stmt)->getExpression());
+                        break;
+                    case ASTNode::FUNCTION_DECL_STMT: {
+                        auto* s = static_cast<FunctionDeclStmt*>(stmt);
+                        bind(s->getName());
+                        function(s->getBody());
+                        break;
+                    }
+                    case ASTNode::CLASS_DECL_STMT: {
+                        auto* s = static_cast<ClassDeclStmt*>(stmt);
+                        bind(s->getName());
+                        if (!s->getSuperclassName().empty()) use(s->getSuperclassName());
+                        for (const auto& method : s->getMethods()) function(method->getBody());
+                        break;
+                    }
+                    case ASTNode::FROM_IMPORT_STMT:
+                        for (const auto& symbol : static_cast<FromImportStmt*>(stmt)->getSymbols()) bind(symbol);
+                        break;
+                    case ASTNode::IMPORT_STMT:
+                        bind(static_cast<ImportStmt*>(stmt)->getModuleName());
+                        break;
+                    case ASTNode::EXPORT_STMT:
+                        statement(static_cast<ExportStmt*>(stmt)->getStmt());
+                        break;
+                    case ASTNode::EXPORT_EXPRESSION_STMT:
+                        expression(static_cast<ExportExpressionStmt*>(stmt)->getExpression());
+                        break;
+                    default:
+                        break;
+                }
+                liveness.statementEnds[stmt] = position;
+            }
+
+            void target(Expression* expr) {
+                if (expr && expr->getType() == ASTNode::IDENTIFIER_EXPR) {
+                    bind(static_cast<IdentifierExpr*>(expr)->getName());
+                } else {
+                    expression(expr);
+                }
+            }
+
+            void expression(Expression* expr) {
+                if (!expr) return;
+                switch (expr->getType()) {
+                    case ASTNode::IDENTIFIER_EXPR:
+                        use(static_cast<IdentifierExpr*>(expr)->getName());
+                        break;
+                    case ASTNode::THIS_EXPR:
+                    case ASTNode::SUPER_EXPR:
+                        use("this");
+                        break;
+                    case ASTNode::BINARY_EXPR: {
+                        auto* e = static_cast<BinaryExpr*>(expr);
+                        if (e->getOperator() == "=") target(e->getLeft());
+                        else expression(e->getLeft());
+                        expression(e->getRight());
+                        break;
+                    }
+                    case ASTNode::UNARY_EXPR:
+                        expression(static_cast<UnaryExpr*>(expr)->getOperand());
+                        break;
+                    case ASTNode::CALL_EXPR: {
+                        auto* e = static_cast<CallExpr*>(expr);
+                        expression(e->getCallee());
+                        for (const auto& arg : e->getArgs()) expression(arg.get());
+                        break;
+                    }
+                    case ASTNode::MEMBER_ACCESS_EXPR:
+                        expression(static_cast<MemberAccessExpr*>(expr)->getObject());
+                        break;
+                    case ASTNode::LIST_EXPR:
+                        for (const auto& element : static_cast<ListExpr*>(expr)->getElements()) expression(element.get());
+                        break;
+                    case ASTNode::TABLE_EXPR:
+                        for (const auto& entry : static_cast<TableExpr*>(expr)->getEntries()) {
+                            expression(entry.first.get());
+                            expression(entry.second.get());
+                        }
+                        break;
+                    case ASTNode::INDEX_EXPR: {
+                        auto* e = static_cast<IndexExpr*>(expr);
+                        expression(e->getObject());
+                        expression(e->getIndex());
+                        break;
+                    }
+                    case ASTNode::SLICE_EXPR: {
+                        auto* e = static_cast<SliceExpr*>(expr);
+                        expression(e->getObject());
+                        expression(e->getStart());
+                        expression(e->getEnd());
+                        break;
+                    }
+                    case ASTNode::TERNARY_EXPR: {
+                        auto* e = static_cast<TernaryExpr*>(expr);
+                        expression(e->getCondition());
+                        expression(e->getThenExpr());
+                        expression(e->getElseExpr());
+                        break;
+                    }
+                    case ASTNode::FUNCTION_EXPR:
+                        function(static_cast<FunctionExpr*>(expr)->getBody());
+                        break;
+                    case ASTNode::AWAIT_EXPR:
+                        expression(static_cast<AwaitExpr*>(expr)->getValue());
+                        break;
+                    default:
+                        break;
+                }
+            }
+        };
+
+    }
+
+    std::unordered_set<std::string> Optimizer::reboundNames(const std::vector<std::unique_ptr<Statement>>& body) {
+        BindingScan scan;
+        scan.body(body);
+        return std::move(scan.rebound);
+    }
+
+    std::unordered_map<std::string, int> Optimizer::bindingCounts(const std::vector<std::unique_ptr<Statement>>& body) {
+        BindingScan scan;
+        scan.body(body);
+        return std::move(scan.bindings);
+    }
+
+    Optimizer::Liveness Optimizer::liveness(const std::vector<std::unique_ptr<Statement>>& body) {
+        BindingScan scan;
+        scan.body(body);
+        return std::move(scan.liveness);
+    }
+
+    // --- Inlining ---
+
+    namespace {
+
+        // Checks that an expression only reads, and collects what it reads besides parameters
+        struct InlineScan {
+            const FunctionDeclStmt& fn;
+            bool allowThis;
+            std::vector<std::string>& freeNames;
+            int nodes = 0;
+
+            bool expression(Expression* expr) {
+                if (!expr) return true;
+                if (++nodes > Optimizer::MAX_INLINE_NODES) return false;
+                switch (expr->getType()) {
+                    case ASTNode::NUMBER_EXPR:
+                    case ASTNode::STRING_EXPR:
+                    case ASTNode::BOOLEAN_EXPR:
+                    case ASTNode::NIL_EXPR:
+                        return true;
+                    case ASTNode::THIS_EXPR:
+                        return allowThis;
+                    case ASTNode::IDENTIFIER_EXPR: {
+                        const std::string& name = static_cast<IdentifierExpr*>(expr)->getName();
+                        const auto& params = fn.getParams();
+                        if (std::find(params.begin(), params.end(), name) != params.end()) return true;
+                        // A top-level function reaches itself through the global of its name
+                        if (!allowThis && name == fn.getName()) return false;
+                        if (name == "this" || name == "super") return false;
+                        if (std::find(freeNames.begin(), freeNames.end(), name) == freeNames.end()) {
+                            freeNames.push_back(name);
+                        }
+                        return true;
+                    }
+                    case ASTNode::BINARY_EXPR: {
+                        auto* e = static_cast<BinaryExpr*>(expr);
+                        return e->getOperator() != "=" && expression(e->getLeft()) && expression(e->getRight());
+                    }
+                    case ASTNode::UNARY_EXPR:
+                        return expression(static_cast<UnaryExpr*>(expr)->getOperand());
+                    case ASTNode::CALL_EXPR: {
+                        auto* e = static_cast<CallExpr*>(expr);
+                        if (e->getCallee()->getType() == ASTNode::SUPER_EXPR || !expression(e->getCallee())) return false;
+                        for (const auto& arg : e->getArgs()) {
+                            if (!expression(arg.get())) return false;
+                        }
+                        return true;
+                    }
+                    case ASTNode::MEMBER_ACCESS_EXPR:
+                        return expression(static_cast<MemberAccessExpr*>(expr)->getObject());
+                    case ASTNode::LIST_EXPR:
+                        for (const auto& element : static_cast<ListExpr*>(expr)->getElements()) {
+                            if (!expression(element.get())) return false;
+                        }
+                        return true;
+                    case ASTNode::INDEX_EXPR: {
+                        auto* e = static_cast<IndexExpr*>(expr);
+                        return expression(e->getObject()) && expression(e->getIndex());
+                    }
+                    case ASTNode::TERNARY_EXPR: {
+                        auto* e = static_cast<TernaryExpr*>(expr);
+                        return expression(e->getCondition()) && expression(e->getThenExpr()) &&
+                               expression(e->getElseExpr());
+                    }
+                    default:
+                        // Closures, await, super, slices and tables stay calls
+                        return false;
+                }
+            }
+        };
+
+    }
+
+    Expression* Optimizer::inlineBody(const FunctionDeclStmt& fn, bool isMethod, std::vector<std::string>& freeNames) {
+        const auto& body = fn.getBody();
+        if (fn.isAsync() || body.size() != 1 || body[0]->getType() != ASTNode::RETURN_STMT) return nullptr;
+        Expression* value = static_cast<ReturnStmt*>(body[0].get())->getValue();
+        if (!value) return nullptr;
+        for (size_t i = 0; i < fn.getParams().size(); ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                if (fn.getParams()[i] == fn.getParams()[j]) return nullptr;
+            }
+        }
+        freeNames.clear();
+        InlineScan scan{fn, isMethod, freeNames};
+        return scan.expression(value) ? value : nullptr;
+    }
+
+    // --- Unreachable code ---
+
+    // Instructions after pc that execution may continue at
+    template <typename Visit>
+    static void forEachSuccessor(const Chunk& chunk, size_t pc, Visit visit) {
+        Instruction ins = chunk.code[pc];
+        switch (Chunk::getOpCode(ins)) {
+            case OpCode::JMP:
+                visit(pc + 1 + Chunk::getSBx(ins));
+                break;
+            case OpCode::LOADBOOL:
+                visit(pc + 1);
+                // The skipped instruction is kept so the skip still lands on the right one
+                if (Chunk::getC(ins)) visit(pc + 2);
+                break;
+            case OpCode::TEST:
+            case OpCode::TESTSET:
+            case OpCode::CHECKMETHOD:
+                visit(pc + 1);
+                visit(pc + 2);
+                break;
+            case OpCode::RETURN:
+            case OpCode::THROW:
+                break;
+            case OpCode::CLOSURE:
+                visit(pc + 1 + chunk.constants[Chunk::getBx(ins)].asPomeFunction()->upvalueCount);
+                break;
+            default:
+                visit(pc + 1);
+                break;
+        }
+    }
+
+    static bool skipsNext(OpCode op) {
+        return op == OpCode::TEST || op == OpCode::TESTSET || op == OpCode::LOADBOOL || op == OpCode::CHECKMETHOD;
+    }
+
+    void Optimizer::removeUnreachable(Chunk& chunk) {
+        auto& code = chunk.code;
+        const size_t n = code.size();
+        if (n == 0) return;
+
+        // Jumps to jumps go straight to the final target (bounded, in case of a cycle)
+        for (size_t pc = 0; pc < n; ++pc) {
+            if (Chunk::getOpCode(code[pc]) != OpCode::JMP) continue;
+            size_t target = pc + 1 + Chunk::getSBx(code[pc]);
+            for (int hops = 0; hops < 8 && target < n && Chunk::getOpCode(code[target]) == OpCode::JMP; ++hops) {
+                target = target + 1 + Chunk::getSBx(code[target]);
+            }
+            code[pc] = Chunk::makeAsBx(OpCode::JMP, 0, (int)target - (int)pc - 1);
+        }
+
+        // Reachability from the entry point and every catch block
+        std::vector<bool> live(n, false);
+        std::vector<size_t> work{0};
+        for (const ExceptionRange& range : chunk.handlers) work.push_back(range.target);
+        while (!work.empty()) {
+            size_t pc = work.back();
+            work.pop_back();
+            if (pc >= n || live[pc]) continue;
+            live[pc] = true;
+            if (Chunk::getOpCode(code[pc]) == OpCode::CLOSURE) {
+                // Upvalue descriptors are data that travel with their CLOSURE
+                PomeFunction* proto = chunk.constants[Chunk::getBx(code[pc])].asPomeFunction();
+                for (size_t i = 1; i <= proto->upvalueCount && pc + i < n; ++i) live[pc + i] = true;
+            }
+            forEachSuccessor(chunk, pc, [&](size_t next) { work.push_back(next); });
+        }
+
+        // A jump to the next instruction does nothing, unless something skips over it
+        for (size_t pc = 0; pc < n; ++pc) {
+            if (!live[pc] || Chunk::getOpCode(code[pc]) != OpCode::JMP || Chunk::getSBx(code[pc]) != 0) continue;
+            if (pc > 0 && live[pc - 1] && skipsNext(Chunk::getOpCode(code[pc - 1]))) continue;
+            live[pc] = false;
+        }
+
+        // newIndex[pc]: where pc ends up, or where the next kept instruction does
+        std::vector<uint32_t> newIndex(n + 1);
+        uint32_t kept = 0;
+        for (size_t pc = 0; pc < n; ++pc) {
+            newIndex[pc] = kept;
+            if (live[pc]) ++kept;
+        }
+        newIndex[n] = kept;
+        if (kept == n) return;
+
+        size_t out = 0;
+        for (size_t pc = 0; pc < n; ++pc) {
+            if (!live[pc]) continue;
+            Instruction ins = code[pc];
+            if (Chunk::getOpCode(ins) == OpCode::JMP) {
+                size_t target = pc + 1 + Chunk::getSBx(ins);
+                ins = Chunk::makeAsBx(OpCode::JMP, 0, (int)newIndex[target] - (int)out - 1);
+            }
+            code[out] = ins;
+            chunk.lines[out] = chunk.lines[pc];
+            chunk.cacheSlots[out] = chunk.cacheSlots[pc];
+            ++out;
+        }
+        code.resize(out);
+        chunk.lines.resize(out);
+        chunk.cacheSlots.resize(out);
+
+        for (ExceptionRange& range : chunk.handlers) {
+            range.start = newIndex[range.start];
+            range.end = newIndex[range.end];
+            range.target = newIndex[range.target];
+        }
+        for (InlinedCall& call : chunk.inlinedCalls) {
+            call.start = newIndex[call.start];
+            call.end = newIndex[call.end];
+        }
+    }
+
+}
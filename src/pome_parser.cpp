@@ -86,7 +86,10 @@ namespace Pome
      */
     std::unique_ptr<Program> Parser::parseProgram()
     {
+        // The Program itself stays on the heap: it owns the arena its statements live in
+        auto arena = std::make_unique<AstArena>();
         auto program = std::make_unique<Program>();
+        AstArena::Scope arenaScope(*arena);
         
         // strict pome;
         if (currentToken_.type == TokenType::STRICT) {
@@ -117,6 +120,7 @@ namespace Pome
                 nextToken();
             }
         }
+        program->adoptArena(std::move(arena));
         return program;
     }
 
@@ -177,7 +181,7 @@ namespace Pome
         {
         case TokenType::IDENTIFIER:
         {
-            auto identifier = std::make_unique<IdentifierExpr>(currentToken_.value, line, col);
+            auto identifier = std::make_unique<IdentifierExpr>(currentToken_.text(), line, col);
 
             return identifier;
         }
@@ -200,7 +204,7 @@ namespace Pome
                 return nullptr;
             }
             nextToken(); // current is member identifier
-            std::string member = currentToken_.value;
+            std::string member = currentToken_.text();
             // DO NOT nextToken() here, as parseExpression loop uses peekToken_
             return std::make_unique<SuperExpr>(member, line, col);
         }
@@ -208,19 +212,19 @@ namespace Pome
         {
             try
             {
-                auto number = std::make_unique<NumberExpr>(std::stod(currentToken_.value), line, col);
+                auto number = std::make_unique<NumberExpr>(std::stod(currentToken_.text()), line, col);
 
                 return number;
             }
             catch (const std::exception &e)
             {
-                error("Invalid number literal: " + currentToken_.value);
+                error("Invalid number literal: " + currentToken_.text());
                 return nullptr;
             }
         }
         case TokenType::STRING:
         {
-            auto str = std::make_unique<StringExpr>(currentToken_.value, line, col);
+            auto str = std::make_unique<StringExpr>(currentToken_.text(), line, col);
 
             return str;
         }
@@ -321,7 +325,7 @@ namespace Pome
          */
         if (currentToken_.type == TokenType::MINUS || currentToken_.type == TokenType::NOT)
         {
-            std::string op = currentToken_.value;
+            std::string op = currentToken_.text();
             nextToken();                          // Consume unary operator
             auto right = parseExpression(PREFIX); // Unary operators typically have higher precedence
             if (!right)
@@ -340,7 +344,7 @@ namespace Pome
         int line = currentToken_.line;
         int col = currentToken_.column;
         TokenType operatorType = currentToken_.type;
-        std::string op = currentToken_.value;
+        std::string op = currentToken_.text();
         Precedence precedence = getPrecedence(operatorType);
         nextToken(); // Consume operator
 
@@ -365,7 +369,7 @@ namespace Pome
             error("Expected identifier after '.' operator, got " + currentToken_.debugString());
             return nullptr;
         }
-        std::string memberName = currentToken_.value;
+        std::string memberName = currentToken_.text();
         /**
          * currentToken_ is now the member name.
          */
@@ -484,7 +488,7 @@ namespace Pome
         std::string funcName = "";
         if (currentToken_.type == TokenType::IDENTIFIER)
         {
-            funcName = currentToken_.value;
+            funcName = currentToken_.text();
             nextToken(); // Consume name
         }
 
@@ -505,7 +509,7 @@ namespace Pome
                     error("Expected parameter name, got " + currentToken_.debugString());
                     return nullptr;
                 }
-                params.push_back(currentToken_.value);
+                params.push_back(currentToken_.text());
                 nextToken(); // Consume parameter name
             } while (currentToken_.type == TokenType::COMMA && (nextToken(), true));
         }
@@ -584,15 +588,15 @@ namespace Pome
                 {
                     if (currentToken_.type == TokenType::STRING)
                     {
-                        key = std::make_unique<StringExpr>(currentToken_.value, currentToken_.line, currentToken_.column);
+                        key = std::make_unique<StringExpr>(currentToken_.text(), currentToken_.line, currentToken_.column);
                     }
                     else if (currentToken_.type == TokenType::NUMBER)
                     {
-                        key = std::make_unique<NumberExpr>(std::stod(currentToken_.value), currentToken_.line, currentToken_.column);
+                        key = std::make_unique<NumberExpr>(std::stod(currentToken_.text()), currentToken_.line, currentToken_.column);
                     }
                     else
                     { // IDENTIFIER
-                        key = std::make_unique<StringExpr>(currentToken_.value, currentToken_.line, currentToken_.column);
+                        key = std::make_unique<StringExpr>(currentToken_.text(), currentToken_.line, currentToken_.column);
                     }
                     nextToken(); // Consume the key token. currentToken_ is now COLON, peekToken_ is value.
                 }
@@ -710,7 +714,7 @@ namespace Pome
             error("Expected identifier after 'var' keyword, got " + currentToken_.debugString());
             return nullptr;
         }
-        std::string varName = currentToken_.value;
+        std::string varName = currentToken_.text();
         nextToken(); // Consume IDENTIFIER ('x' or 'z'). currentToken_ is now ASSIGN ('=') or SEMICOLON (';')
 
         std::unique_ptr<Expression> initializer = nullptr;
@@ -928,7 +932,7 @@ namespace Pome
                 error("Expected identifier after 'var'.");
                 return nullptr;
             }
-            std::string varName = currentToken_.value;
+            std::string varName = currentToken_.text();
             nextToken(); // Consume name. currentToken_ is now IN or ASSIGN or SEMICOLON.
 
             if (currentToken_.type == TokenType::IDENTIFIER && currentToken_.value == "in")
@@ -1239,7 +1243,7 @@ namespace Pome
             error("Expected function name, got " + currentToken_.debugString());
             return nullptr;
         }
-        std::string funcName = currentToken_.value;
+        std::string funcName = currentToken_.text();
         nextToken(); // Consume function name
 
         if (currentToken_.type != TokenType::LPAREN)
@@ -1259,7 +1263,7 @@ namespace Pome
                     error("Expected parameter name, got " + currentToken_.debugString());
                     return nullptr;
                 }
-                params.push_back(currentToken_.value);
+                params.push_back(currentToken_.text());
                 nextToken(); // Consume parameter name
             } while (currentToken_.type == TokenType::COMMA && (nextToken(), true));
         }
@@ -1304,13 +1308,13 @@ namespace Pome
             error("Expected class name.");
             return nullptr;
         }
-        std::string className = currentToken_.value;
+        std::string className = currentToken_.text();
         std::string superclassName = "";
 
         if (peekToken_.type == TokenType::EXTENDS) {
             nextToken(); // Consume className, current is EXTENDS
             if (!expect(TokenType::IDENTIFIER)) return nullptr; // current is superclass name
-            superclassName = currentToken_.value;
+            superclassName = currentToken_.text();
         }
 
         if (!expect(TokenType::LBRACE))
@@ -1463,7 +1467,7 @@ namespace Pome
                 error("Expected symbol name in import list, got " + currentToken_.debugString());
                 return nullptr;
             }
-            symbols.push_back(currentToken_.value);
+            symbols.push_back(currentToken_.text());
             nextToken(); // Consume symbol name
         } while (currentToken_.type == TokenType::COMMA && (nextToken(), true));
 
@@ -1498,7 +1502,7 @@ namespace Pome
                 }
                 
                 // Create IdentifierExpr
-                auto identExpr = std::make_unique<IdentifierExpr>(currentToken_.value, currentToken_.line, currentToken_.column);
+                auto identExpr = std::make_unique<IdentifierExpr>(currentToken_.text(), currentToken_.line, currentToken_.column);
                 nextToken(); // Consume identifier
                 
                 // Wrap in ExportExpressionStmt
@@ -1628,7 +1632,7 @@ namespace Pome
             error("Expected identifier for catch variable.");
             return nullptr;
         }
-        std::string catchVar = currentToken_.value;
+        std::string catchVar = currentToken_.text();
         nextToken(); // Consume identifier
 
         if (currentToken_.type != TokenType::RPAREN) {
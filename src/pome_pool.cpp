@@ -0,0 +1,288 @@
+#include "../include/pome_pool.h"
+#include "../include/pome_stdlib.h"
+#include "../include/pome_vm.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <unistd.h>
+
+namespace Pome {
+
+    // Index of the pool worker running on this thread, or NOT_A_WORKER
+    static constexpr size_t NOT_A_WORKER = static_cast<size_t>(-1);
+    static thread_local size_t workerIndex = NOT_A_WORKER;
+
+    static void append(GarbageCollector& gc, PomeList* list, PomeValue value) {
+        size_t oldExtra = list->extraSize();
+        list->push(gc, value);
+        gc.updateSize(list, sizeof(PomeList) + oldExtra, sizeof(PomeList) + list->extraSize());
+        gc.writeBarrier(list, value);
+    }
+
+    std::shared_ptr<PoolJob> PoolJob::create(Kind kind, PomeFunction* function, const PomeValue* args, size_t count) {
+        auto job = std::make_shared<PoolJob>();
+        job->kind = kind;
+        job->function = function;
+        job->inbox = GarbageCollector::createTransferHeap();
+        std::map<PomeObject*, PomeObject*> copiedObjects;
+        for (size_t i = 0; i < count; ++i) job->args.push_back(args[i].deepCopy(*job->inbox, copiedObjects));
+        return job;
+    }
+
+    std::shared_ptr<PoolJob> PoolJob::createMap(PomeFunction* function, PomeList* list, size_t begin, size_t end) {
+        auto job = std::make_shared<PoolJob>();
+        job->kind = Kind::MAP;
+        job->function = function;
+        job->inbox = GarbageCollector::createTransferHeap();
+        GarbageCollector& inbox = *job->inbox;
+        std::map<PomeObject*, PomeObject*> copiedObjects;
+        PomeList* part = inbox.allocateList();
+        part->ensureCapacity(end - begin);
+        for (size_t i = begin; i < end; ++i) append(inbox, part, list->at(i).deepCopy(inbox, copiedObjects));
+        job->args.push_back(PomeValue(part));
+        return job;
+    }
+
+    PomeValue PoolJob::takeResult(GarbageCollector& gc) {
+        PomeValue value = result;
+        result = PomeValue();
+        if (outbox) gc.adopt(*outbox);
+        outbox.reset();
+        return value;
+    }
+
+    IsolatePool& IsolatePool::instance() {
+        static IsolatePool pool(defaultWorkers_ > 0 ? defaultWorkers_ : std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+    IsolatePool::IsolatePool(size_t count) {
+        for (size_t i = 0; i < count; ++i) workers_.push_back(std::make_unique<Worker>());
+        for (size_t i = 0; i < count; ++i) workers_[i]->thread = std::thread([this, i] { workerLoop(i); });
+    }
+
+    IsolatePool::~IsolatePool() {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker->thread.joinable()) worker->thread.join();
+        }
+    }
+
+    void IsolatePool::submit(std::shared_ptr<PoolJob> job) {
+        // A worker keeps what it submits, which is what it is most likely to wait on
+        size_t index = workerIndex != NOT_A_WORKER ? workerIndex
+                                                   : nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        {
+            std::lock_guard<std::mutex> guard(workers_[index]->lock);
+            workers_[index]->jobs.push_back(std::move(job));
+        }
+        {
+            std::lock_guard<std::mutex> guard(sleepLock_);
+            queued_.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake_.notify_one();
+        finished_.notify_all(); // Workers waiting on their own jobs take new ones too
+    }
+
+    std::shared_ptr<PoolJob> IsolatePool::take(size_t index) {
+        {
+            Worker& own = *workers_[index];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.jobs.empty()) {
+                std::shared_ptr<PoolJob> job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+        for (size_t step = 1; step < workers_.size(); ++step) {
+            Worker& victim = *workers_[(index + step) % workers_.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                std::shared_ptr<PoolJob> job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    void IsolatePool::waitForCompletion(uint64_t seen) {
+        if (workerIndex != NOT_A_WORKER) {
+            // Blocking here could leave every worker waiting on jobs none of them runs
+            while (completedCount() == seen) {
+                std::shared_ptr<PoolJob> job = take(workerIndex);
+                if (job) {
+                    run(*workers_[workerIndex], *job);
+                    continue;
+                }
+                std::unique_lock<std::mutex> guard(sleepLock_);
+                finished_.wait(guard, [&] {
+                    return completedCount() != seen || queued_.load(std::memory_order_relaxed) > 0;
+                });
+            }
+            return;
+        }
+        std::unique_lock<std::mutex> guard(sleepLock_);
+        finished_.wait(guard, [&] { return completedCount() != seen; });
+    }
+
+    void IsolatePool::workerLoop(size_t index) {
+        workerIndex = index;
+        Worker& worker = *workers_[index];
+        // Created here so each heap's allocations start on the thread that uses them
+        worker.gc = std::make_unique<GarbageCollector>();
+        worker.gc->setGcThreads(1); // The pool already has a thread per core
+        worker.vm = std::make_unique<VM>(*worker.gc, [](const std::string&) { return PomeValue(); });
+        worker.gc->setVM(worker.vm.get());
+        // Functions share their chunks with the submitting VM, and tier-up is not synchronised
+        worker.vm->setJitEnabled(false);
+        StdLib::registerBuiltins(*worker.vm);
+
+        while (true) {
+            std::shared_ptr<PoolJob> job = take(index);
+            if (job) {
+                run(worker, *job);
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(sleepLock_);
+            wake_.wait(guard, [&] { return stopping_ || queued_.load(std::memory_order_relaxed) > 0; });
+            if (stopping_ && queued_.load(std::memory_order_relaxed) == 0) break;
+        }
+
+        worker.vm.reset();
+        worker.gc.reset();
+    }
+
+    void IsolatePool::run(Worker& worker, PoolJob& job) {
+        GarbageCollector& gc = *worker.gc;
+        VM& vm = *worker.vm;
+
+        PomeList* inputs = gc.allocateList();
+        RootGuard inputsGuard(gc, inputs);
+        {
+            // The arguments are ours once adopted, but unrooted until they are in inputs
+            CollectionDeferral deferral(gc);
+            gc.adopt(*job.inbox);
+            for (const PomeValue& arg : job.args) append(gc, inputs, arg);
+        }
+        job.args.clear();
+        job.inbox.reset();
+
+        PomeValue result;
+        bool failed = false;
+        try {
+            if (job.kind == PoolJob::Kind::CALL) {
+                std::vector<PomeValue> args;
+                for (size_t i = 0; i < inputs->size(); ++i) args.push_back(inputs->at(i));
+                result = vm.call(job.function, args);
+            } else {
+                PomeList* part = inputs->at(0).asList();
+                PomeList* mapped = gc.allocateList();
+                RootGuard mappedGuard(gc, mapped);
+                mapped->ensureCapacity(part->size());
+                std::vector<PomeValue> args(1);
+                for (size_t i = 0; i < part->size(); ++i) {
+                    args[0] = part->at(i);
+                    append(gc, mapped, vm.call(job.function, args));
+                }
+                result = PomeValue(mapped);
+            }
+            // Tasks the job started but never awaited still finish, as they do at the end of a script
+            RootGuard resultGuard(gc, result.isObject() ? result.asObject() : nullptr);
+            vm.runEventLoop();
+        } catch (VMException& e) {
+            result = e.value;
+            failed = true;
+        } catch (const std::exception& e) {
+            std::cerr << "[Pool] Fatal error in isolate: " << e.what() << std::endl;
+            failed = true;
+        }
+
+        if (result.isObject()) {
+            job.outbox = GarbageCollector::createTransferHeap();
+            std::map<PomeObject*, PomeObject*> copiedObjects;
+            job.result = result.deepCopy(*job.outbox, copiedObjects);
+        } else {
+            job.result = result;
+        }
+        job.failed = failed;
+        job.done.store(true, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> guard(sleepLock_);
+            completed_.fetch_add(1, std::memory_order_acq_rel);
+        }
+        finished_.notify_all();
+        std::lock_guard<std::mutex> guard(completionFdsLock_);
+        for (int fd : completionFds_) {
+            uint64_t one = 1;
+            ssize_t written = ::write(fd, &one, sizeof(one));
+            (void)written; // A full counter already wakes the reader
+        }
+    }
+
+    void IsolatePool::addCompletionFd(int fd) {
+        std::lock_guard<std::mutex> guard(completionFdsLock_);
+        completionFds_.push_back(fd);
+    }
+
+    void IsolatePool::removeCompletionFd(int fd) {
+        std::lock_guard<std::mutex> guard(completionFdsLock_);
+        completionFds_.erase(std::remove(completionFds_.begin(), completionFds_.end(), fd), completionFds_.end());
+    }
+
+    bool Channel::send(const PomeValue& value) {
+        Message message;
+        message.value = value;
+        if (value.isObject()) {
+            PomeObject* obj = value.asObject();
+            if (obj->frozen) {
+                message.frozen = FrozenHeap::find(obj->heapId);
+            } else {
+                // Copied before taking the lock, so a large message holds up no one else
+                message.heap = GarbageCollector::createTransferHeap();
+                std::map<PomeObject*, PomeObject*> copiedObjects;
+                message.value = value.deepCopy(*message.heap, copiedObjects);
+            }
+        }
+
+        std::unique_lock<std::mutex> guard(lock_);
+        while (!closed_ && messages_.size() >= capacity_) changed_.wait(guard);
+        if (closed_) return false;
+        messages_.push_back(std::move(message));
+        guard.unlock();
+        changed_.notify_all();
+        return true;
+    }
+
+    bool Channel::receive(GarbageCollector& gc, PomeValue& value) {
+        std::unique_lock<std::mutex> guard(lock_);
+        while (!closed_ && messages_.empty()) changed_.wait(guard);
+        if (messages_.empty()) return false;
+        Message message = std::move(messages_.front());
+        messages_.pop_front();
+        guard.unlock();
+        changed_.notify_all();
+
+        if (message.heap) gc.adopt(*message.heap);
+        if (message.frozen) gc.retainFrozen(std::move(message.frozen));
+        value = message.value;
+        return true;
+    }
+
+    void Channel::close() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            closed_ = true;
+        }
+        changed_.notify_all();
+    }
+
+} // namespace Pome
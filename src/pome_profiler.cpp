@@ -0,0 +1,144 @@
+#include "pome_profiler.h"
+#include "pome_vm.h"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+#include <sys/time.h>
+
+namespace Pome {
+
+    volatile std::sig_atomic_t Profiler::samplePending = 0;
+    Profiler* Profiler::running = nullptr;
+
+    Profiler::Profiler(int sampleIntervalUs) : intervalUs(std::max(sampleIntervalUs, 100)) {}
+
+    Profiler::~Profiler() {
+        if (running == this) stop();
+    }
+
+    void Profiler::onSignal(int) {
+        samplePending = 1;
+    }
+
+    void Profiler::start() {
+        if (running) throw std::runtime_error("Another profiler is already running.");
+        running = this;
+        samplePending = 0;
+
+        struct sigaction action {};
+        action.sa_handler = &Profiler::onSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+
+        struct itimerval timer {};
+        timer.it_interval.tv_sec = intervalUs / 1000000;
+        timer.it_interval.tv_usec = intervalUs % 1000000;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+    }
+
+    void Profiler::stop() {
+        if (running != this) return;
+        struct itimerval timer {};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        signal(SIGPROF, SIG_IGN);
+        running = nullptr;
+        samplePending = 0;
+    }
+
+    static int lineAt(const Chunk* chunk, const uint32_t* pc) {
+        if (!chunk || chunk->code.empty()) return 0;
+        ptrdiff_t offset = pc - chunk->code.data();
+        if (offset < 0 || offset >= (ptrdiff_t)chunk->lines.size()) return 0;
+        // Prologue instructions carry no line; attribute them to the first real one
+        for (ptrdiff_t i = offset; i < (ptrdiff_t)chunk->lines.size(); ++i) {
+            if (chunk->lines[i] > 0) return chunk->lines[i];
+        }
+        return chunk->lines[offset];
+    }
+
+    void Profiler::takeSample(const uint32_t* pc, const CallFrame* frames, int frameCount) {
+        samplePending = 0;
+        std::string key;
+        for (int i = 0; i < frameCount; ++i) {
+            const CallFrame& frame = frames[i];
+            // Saved ips point past the CALL; the top frame is at the instruction being dispatched
+            const uint32_t* at = (i == frameCount - 1) ? pc : frame.ip - 1;
+            // Inlined bodies are frames of their own, reported innermost first
+            std::vector<std::pair<const InlinedCall*, int>> inlined;
+            int line = lineAt(frame.chunk, at);
+            if (frame.chunk && !frame.chunk->inlinedCalls.empty()) {
+                frame.chunk->forEachInlinedCall(static_cast<uint32_t>(at - frame.chunk->code.data()),
+                                                [&](const InlinedCall& call, int) {
+                    inlined.push_back({&call, line});
+                    line = call.callLine;
+                });
+            }
+            if (!key.empty()) key += ';';
+            key += frame.function ? frame.function->name : "<script>";
+            key += ':';
+            key += std::to_string(line);
+            for (auto it = inlined.rbegin(); it != inlined.rend(); ++it) {
+                key += ';' + it->first->name + ':' + std::to_string(it->second);
+            }
+        }
+        ++stacks[key];
+        ++sampleCount;
+    }
+
+    void Profiler::writeFolded(std::ostream& out) const {
+        std::vector<std::pair<std::string, uint64_t>> sorted(stacks.begin(), stacks.end());
+        std::sort(sorted.begin(), sorted.end());
+        for (const auto& [stack, count] : sorted) {
+            out << stack << " " << count << "\n";
+        }
+    }
+
+    static constexpr size_t TOP_PAIRS = 20;
+
+    void Profiler::writeSummary(std::ostream& out) const {
+        uint64_t total = 0;
+        std::vector<std::pair<uint64_t, int>> ops;
+        for (int op = 0; op < (int)opCounts.size(); ++op) {
+            if (opCounts[op] == 0) continue;
+            total += opCounts[op];
+            ops.push_back({opCounts[op], op});
+        }
+        std::sort(ops.rbegin(), ops.rend());
+
+        out << "Profile: " << total << " instructions, " << sampleCount << " samples" << std::endl;
+        out << "  Opcode              Count        %" << std::endl;
+        for (const auto& [count, op] : ops) {
+            out << "  " << std::left << std::setw(16) << opcodeName(static_cast<OpCode>(op))
+                << std::right << std::setw(12) << count << "  "
+                << std::fixed << std::setprecision(2) << std::setw(6) << (100.0 * count / total) << std::endl;
+        }
+
+        std::vector<std::pair<uint64_t, int>> pairs;
+        for (int pair = 0; pair < (int)pairCounts.size(); ++pair) {
+            if (pairCounts[pair] > 0) pairs.push_back({pairCounts[pair], pair});
+        }
+        std::sort(pairs.rbegin(), pairs.rend());
+        if (pairs.size() > TOP_PAIRS) pairs.resize(TOP_PAIRS);
+        if (!pairs.empty()) {
+            out << "  Hottest pairs" << std::endl;
+            for (const auto& [count, pair] : pairs) {
+                out << "  " << std::left << std::setw(16) << opcodeName(static_cast<OpCode>(pair >> 8))
+                    << " + " << std::setw(16) << opcodeName(static_cast<OpCode>(pair & 0xFF))
+                    << std::right << std::setw(12) << count << std::endl;
+            }
+        }
+
+        if (transitions.empty()) return;
+        out << "  Rewrites (quickening / deopt)" << std::endl;
+        for (const auto& [edge, count] : transitions) {
+            out << "  " << std::left << std::setw(16) << opcodeName(static_cast<OpCode>(edge.first))
+                << " -> " << std::setw(16) << opcodeName(static_cast<OpCode>(edge.second))
+                << std::right << std::setw(10) << count << std::endl;
+        }
+        out << std::defaultfloat;
+    }
+
+}
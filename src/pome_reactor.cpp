@@ -0,0 +1,493 @@
+#include "../include/pome_reactor.h"
+#include "../include/pome_pool.h"
+#include "../include/pome_value.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace Pome {
+
+    // epoll tags for the reactor's own descriptors; anything else is a socket
+    static constexpr uint64_t TIMER_TAG = ~0ull;
+    static constexpr uint64_t WAKE_TAG = ~0ull - 1;
+    static constexpr uint64_t RING_TAG = ~0ull - 2;
+
+    static constexpr unsigned RING_ENTRIES = 64;
+    static constexpr size_t FILE_CHUNK = 64 * 1024; // First read of a file that reports no size
+
+    static int64_t monotonicNow() {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    }
+
+    struct Reactor::Op {
+        uint64_t id;
+        PomeTask* task;
+        Kind kind;
+        int fd;
+        std::string data; // Bytes read so far, or the bytes to write
+        size_t max = 0;   // READ: most to read; READ_FILE: size of the next read
+        size_t done = 0;  // Bytes moved so far
+        iovec iov{};      // The ring's view of data while a file operation is in flight
+    };
+
+    /**
+     * A minimal io_uring: one submission per call, completions reaped when the
+     * ring's descriptor turns readable in epoll.
+     */
+    struct Reactor::Ring {
+        int fd = -1;
+        unsigned entries = 0;
+        unsigned inFlight = 0;
+        void* sqMap = MAP_FAILED;
+        size_t sqMapSize = 0;
+        void* cqMap = MAP_FAILED;
+        size_t cqMapSize = 0;
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t sqesSize = 0;
+        unsigned *sqTail, *sqMask, *sqArray;
+        unsigned *cqHead, *cqTail, *cqMask;
+        io_uring_cqe* cqes;
+
+        // Null when the kernel has no io_uring or does not let us use it
+        static std::unique_ptr<Ring> open() {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            int fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+            if (fd < 0) return nullptr;
+            auto ring = std::make_unique<Ring>();
+            ring->fd = fd;
+            ring->entries = params.sq_entries;
+
+            ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single) ring->sqMapSize = ring->cqMapSize = std::max(ring->sqMapSize, ring->cqMapSize);
+            ring->sqMap = mmap(nullptr, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               fd, IORING_OFF_SQ_RING);
+            if (ring->sqMap == MAP_FAILED) return nullptr;
+            if (single) {
+                ring->cqMap = ring->sqMap;
+            } else {
+                ring->cqMap = mmap(nullptr, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                   fd, IORING_OFF_CQ_RING);
+                if (ring->cqMap == MAP_FAILED) return nullptr;
+            }
+            ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE,
+                                                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+            if (ring->sqes == MAP_FAILED) return nullptr;
+
+            char* sq = static_cast<char*>(ring->sqMap);
+            ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            char* cq = static_cast<char*>(ring->cqMap);
+            ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            return ring;
+        }
+
+        ~Ring() {
+            if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+            if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapSize);
+            if (sqMap != MAP_FAILED) munmap(sqMap, sqMapSize);
+            if (fd >= 0) ::close(fd);
+        }
+
+        // Every submission is entered at once, so the queue never holds more than one
+        bool full() const { return inFlight >= entries; }
+
+        bool submit(uint8_t opcode, int target, const iovec* iov, uint64_t offset, uint64_t userData) {
+            unsigned tail = *sqTail;
+            unsigned index = tail & *sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = opcode;
+            sqe.fd = target;
+            sqe.addr = reinterpret_cast<uint64_t>(iov);
+            sqe.len = 1;
+            sqe.off = offset;
+            sqe.user_data = userData;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            int submitted;
+            do {
+                submitted = static_cast<int>(syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0));
+            } while (submitted < 0 && errno == EINTR);
+            if (submitted < 1) {
+                // The kernel did not take the entry, so it can be withdrawn
+                __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+                return false;
+            }
+            ++inFlight;
+            return true;
+        }
+
+        // Blocks until at least one operation completes
+        void waitForCompletion() {
+            while (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                   errno == EINTR) {}
+        }
+    };
+
+    Reactor::Reactor() {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        timer_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = TIMER_TAG;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, timer_, &event);
+        event.data.u64 = WAKE_TAG;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &event);
+        ring_ = Ring::open();
+        if (ring_) {
+            event.data.u64 = RING_TAG;
+            if (epoll_ctl(epoll_, EPOLL_CTL_ADD, ring_->fd, &event) != 0) ring_.reset();
+        }
+        IsolatePool::addCompletionFd(wake_);
+    }
+
+    Reactor::~Reactor() {
+        IsolatePool::removeCompletionFd(wake_);
+        // The kernel may still be writing into buffers the operations own
+        while (ring_ && ring_->inFlight > 0) {
+            ring_->waitForCompletion();
+            reapRing();
+        }
+        for (auto& entry : ops_) {
+            Op& op = *entry.second;
+            if (op.kind == Kind::READ_FILE || op.kind == Kind::WRITE_FILE) ::close(op.fd);
+        }
+        ring_.reset();
+        ::close(wake_);
+        ::close(timer_);
+        ::close(epoll_);
+    }
+
+    Reactor::Op* Reactor::start(PomeTask* task, Kind kind, int fd) {
+        auto op = std::make_unique<Op>();
+        op->id = nextId_++;
+        op->task = task;
+        op->kind = kind;
+        op->fd = fd;
+        Op* raw = op.get();
+        ops_.emplace(raw->id, std::move(op));
+        return raw;
+    }
+
+    void Reactor::finish(Op* op, bool failed, std::string data, int64_t count) {
+        if (op->kind == Kind::READ_FILE || op->kind == Kind::WRITE_FILE) ::close(op->fd);
+        Completion completion{op->task, op->kind, failed, std::move(data), count};
+        ready_.push_back(std::move(completion));
+        ops_.erase(op->id);
+    }
+
+    void Reactor::fail(Op* op, int error) {
+        finish(op, true, strerror(error));
+    }
+
+    void Reactor::sleep(PomeTask* task, double seconds) {
+        Op* op = start(task, Kind::SLEEP, -1);
+        if (!(seconds > 0)) {
+            finish(op, false, std::string());
+            return;
+        }
+        // About thirty years at most, which keeps the nanosecond count in range
+        int64_t at = monotonicNow() + static_cast<int64_t>(std::min(seconds, 1e9) * 1e9);
+        deadlines_.push({at, op->id});
+        armTimer();
+    }
+
+    void Reactor::read(PomeTask* task, int fd, size_t max) {
+        Op* op = start(task, Kind::READ, fd);
+        op->max = max;
+        watch(fd, op, false);
+    }
+
+    void Reactor::write(PomeTask* task, int fd, std::string data) {
+        Op* op = start(task, Kind::WRITE, fd);
+        op->data = std::move(data);
+        watch(fd, op, true);
+    }
+
+    void Reactor::accept(PomeTask* task, int fd) {
+        watch(fd, start(task, Kind::ACCEPT, fd), false);
+    }
+
+    void Reactor::connect(PomeTask* task, int fd) {
+        watch(fd, start(task, Kind::CONNECT, fd), true);
+    }
+
+    void Reactor::readFile(PomeTask* task, int fd) {
+        Op* op = start(task, Kind::READ_FILE, fd);
+        struct stat info;
+        // One byte past the size, so a read that comes up short shows the end was reached
+        op->max = (fstat(fd, &info) == 0 && info.st_size > 0) ? static_cast<size_t>(info.st_size) + 1 : FILE_CHUNK;
+        submitFile(op);
+    }
+
+    void Reactor::writeFile(PomeTask* task, int fd, std::string data) {
+        Op* op = start(task, Kind::WRITE_FILE, fd);
+        op->data = std::move(data);
+        submitFile(op);
+    }
+
+    void Reactor::cancel(int fd, const std::string& reason) {
+        auto it = watches_.find(fd);
+        if (it == watches_.end()) return;
+        Watch& w = it->second;
+        for (Op* op : w.readers) finish(op, true, reason);
+        for (Op* op : w.writers) finish(op, true, reason);
+        if (w.events) epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        watches_.erase(it);
+    }
+
+    void Reactor::watch(int fd, Op* op, bool writer) {
+        Watch& w = watches_[fd];
+        (writer ? w.writers : w.readers).push_back(op);
+        drive(fd, 0);
+    }
+
+    void Reactor::drive(int fd, uint32_t events) {
+        auto it = watches_.find(fd);
+        if (it == watches_.end()) return;
+        Watch& w = it->second;
+        while (!w.readers.empty() && attempt(w.readers.front(), events)) w.readers.pop_front();
+        while (!w.writers.empty() && attempt(w.writers.front(), events)) w.writers.pop_front();
+        updateWatch(fd);
+    }
+
+    bool Reactor::attempt(Op* op, uint32_t events) {
+        switch (op->kind) {
+        case Kind::READ: {
+            op->data.resize(op->max);
+            ssize_t got;
+            do {
+                got = ::read(op->fd, op->data.data(), op->max);
+            } while (got < 0 && errno == EINTR);
+            if (got < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+                fail(op, errno);
+                return true;
+            }
+            op->data.resize(static_cast<size_t>(got));
+            finish(op, false, std::move(op->data));
+            return true;
+        }
+        case Kind::WRITE:
+            while (op->done < op->data.size()) {
+                ssize_t sent = send(op->fd, op->data.data() + op->done, op->data.size() - op->done, MSG_NOSIGNAL);
+                if (sent < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+                    fail(op, errno);
+                    return true;
+                }
+                op->done += static_cast<size_t>(sent);
+            }
+            finish(op, false, std::string(), static_cast<int64_t>(op->done));
+            return true;
+        case Kind::ACCEPT:
+            while (true) {
+                int connection = accept4(op->fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (connection >= 0) {
+                    finish(op, false, std::string(), connection);
+                    return true;
+                }
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+                fail(op, errno);
+                return true;
+            }
+        case Kind::CONNECT: {
+            // Until epoll reports the socket, the connection may still be under way
+            if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return false;
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(op->fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0) error = errno;
+            if (error) fail(op, error);
+            else finish(op, false, std::string());
+            return true;
+        }
+        default:
+            return true;
+        }
+    }
+
+    void Reactor::updateWatch(int fd) {
+        auto it = watches_.find(fd);
+        Watch& w = it->second;
+        uint32_t wanted = (w.readers.empty() ? 0 : EPOLLIN) | (w.writers.empty() ? 0 : EPOLLOUT);
+        if (wanted == w.events) {
+            if (!wanted) watches_.erase(it);
+            return;
+        }
+        if (!wanted) {
+            epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+            watches_.erase(it);
+            return;
+        }
+        epoll_event event{};
+        event.events = wanted;
+        event.data.u64 = static_cast<uint64_t>(fd);
+        if (epoll_ctl(epoll_, w.events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0) {
+            // Not something epoll can wait on; nothing would ever wake these
+            int error = errno;
+            for (Op* op : w.readers) fail(op, error);
+            for (Op* op : w.writers) fail(op, error);
+            if (w.events) epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+            watches_.erase(it);
+            return;
+        }
+        w.events = wanted;
+    }
+
+    void Reactor::armTimer() {
+        int64_t next = deadlines_.empty() ? 0 : deadlines_.top().at;
+        if (next == armedAt_) return;
+        itimerspec spec{};
+        spec.it_value.tv_sec = next / 1000000000;
+        spec.it_value.tv_nsec = next % 1000000000;
+        timerfd_settime(timer_, TFD_TIMER_ABSTIME, &spec, nullptr);
+        armedAt_ = next;
+    }
+
+    void Reactor::expireTimers() {
+        if (deadlines_.empty()) return;
+        int64_t now = monotonicNow();
+        while (!deadlines_.empty() && deadlines_.top().at <= now) {
+            auto it = ops_.find(deadlines_.top().id);
+            deadlines_.pop();
+            if (it != ops_.end()) finish(it->second.get(), false, std::string());
+        }
+        armTimer();
+    }
+
+    void Reactor::submitFile(Op* op) {
+        if (!ring_ || ring_->full()) {
+            runFileSync(op);
+            return;
+        }
+        uint8_t opcode;
+        if (op->kind == Kind::READ_FILE) {
+            op->data.resize(op->done + op->max);
+            op->iov = {op->data.data() + op->done, op->max};
+            opcode = IORING_OP_READV;
+        } else {
+            op->iov = {op->data.data() + op->done, op->data.size() - op->done};
+            opcode = IORING_OP_WRITEV;
+        }
+        if (!ring_->submit(opcode, op->fd, &op->iov, op->done, op->id)) runFileSync(op);
+    }
+
+    void Reactor::runFileSync(Op* op) {
+        if (op->kind == Kind::READ_FILE) {
+            while (true) {
+                op->data.resize(op->done + op->max);
+                ssize_t got = pread(op->fd, op->data.data() + op->done, op->max, static_cast<off_t>(op->done));
+                if (got < 0 && errno == EINTR) continue;
+                if (got < 0) {
+                    fail(op, errno);
+                    return;
+                }
+                op->done += static_cast<size_t>(got);
+                if (static_cast<size_t>(got) < op->max) break;
+                op->max = std::max(op->max, FILE_CHUNK);
+            }
+            op->data.resize(op->done);
+            finish(op, false, std::move(op->data));
+            return;
+        }
+        while (op->done < op->data.size()) {
+            ssize_t put = pwrite(op->fd, op->data.data() + op->done, op->data.size() - op->done,
+                                 static_cast<off_t>(op->done));
+            if (put < 0 && errno == EINTR) continue;
+            if (put < 0) {
+                fail(op, errno);
+                return;
+            }
+            op->done += static_cast<size_t>(put);
+        }
+        finish(op, false, std::string(), static_cast<int64_t>(op->done));
+    }
+
+    void Reactor::reapRing() {
+        unsigned head = *ring_->cqHead;
+        while (head != __atomic_load_n(ring_->cqTail, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = ring_->cqes[head & *ring_->cqMask];
+            uint64_t id = cqe.user_data;
+            int res = cqe.res;
+            ++head;
+            __atomic_store_n(ring_->cqHead, head, __ATOMIC_RELEASE);
+            --ring_->inFlight;
+
+            auto it = ops_.find(id);
+            if (it == ops_.end()) continue;
+            Op* op = it->second.get();
+            if (res < 0) {
+                fail(op, -res);
+                continue;
+            }
+            size_t moved = static_cast<size_t>(res);
+            op->done += moved;
+            if (op->kind == Kind::READ_FILE) {
+                if (moved < op->max) {
+                    op->data.resize(op->done);
+                    finish(op, false, std::move(op->data));
+                } else {
+                    op->max = std::max(op->max, FILE_CHUNK);
+                    submitFile(op);
+                }
+            } else if (op->done < op->data.size() && moved > 0) {
+                submitFile(op);
+            } else {
+                finish(op, false, std::string(), static_cast<int64_t>(op->done));
+            }
+        }
+    }
+
+    void Reactor::poll(bool block, std::vector<Completion>& done) {
+        epoll_event events[64];
+        int count = epoll_wait(epoll_, events, 64, (block && ready_.empty()) ? -1 : 0);
+        for (int i = 0; i < count; ++i) {
+            uint64_t tag = events[i].data.u64;
+            uint64_t drained;
+            if (tag == TIMER_TAG) {
+                while (::read(timer_, &drained, sizeof(drained)) > 0) {}
+                armedAt_ = 0; // Expired, so armTimer sets it again even for the same deadline
+            } else if (tag == WAKE_TAG) {
+                while (::read(wake_, &drained, sizeof(drained)) > 0) {}
+            } else if (tag == RING_TAG) {
+                reapRing();
+            } else {
+                drive(static_cast<int>(tag), events[i].events);
+            }
+        }
+        expireTimers();
+        for (Completion& completion : ready_) done.push_back(std::move(completion));
+        ready_.clear();
+    }
+
+    void Reactor::markTasks(GarbageCollector& gc) const {
+        for (const auto& entry : ops_) gc.markObject(entry.second->task);
+        for (const Completion& completion : ready_) gc.markObject(completion.task);
+    }
+
+} // namespace Pome
@@ -0,0 +1,419 @@
+#include "../include/pome_simd.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__)
+#define POME_SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define POME_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace Pome {
+namespace Simd {
+
+    namespace {
+
+        // --- Scalar fallbacks ---
+
+        double sumScalar(const double* data, size_t count) {
+            double total = 0;
+            for (size_t i = 0; i < count; ++i) total += data[i];
+            return total;
+        }
+
+        double sumScalar(const int32_t* data, size_t count) {
+            int64_t total = 0;
+            for (size_t i = 0; i < count; ++i) total += data[i];
+            return (double)total;
+        }
+
+        void addScalarScalar(double* data, size_t count, double scalar) {
+            for (size_t i = 0; i < count; ++i) data[i] += scalar;
+        }
+
+        void addScalarScalar(int32_t* data, size_t count, int32_t scalar) {
+            for (size_t i = 0; i < count; ++i) data[i] = (int32_t)((uint32_t)data[i] + (uint32_t)scalar);
+        }
+
+        void scaleScalar(double* data, size_t count, double factor) {
+            for (size_t i = 0; i < count; ++i) data[i] *= factor;
+        }
+
+        void addScalar2(double* out, const double* a, const double* b, size_t count) {
+            for (size_t i = 0; i < count; ++i) out[i] = a[i] + b[i];
+        }
+
+        void mulScalar(double* out, const double* a, const double* b, size_t count) {
+            for (size_t i = 0; i < count; ++i) out[i] = a[i] * b[i];
+        }
+
+        double dotScalar(const double* a, const double* b, size_t count) {
+            double total = 0;
+            for (size_t i = 0; i < count; ++i) total += a[i] * b[i];
+            return total;
+        }
+
+        void widenScalar(double* out, const int32_t* data, size_t count) {
+            for (size_t i = 0; i < count; ++i) out[i] = data[i];
+        }
+
+        double minScalar(const double* data, size_t count) {
+            double best = data[0];
+            for (size_t i = 1; i < count; ++i) best = data[i] < best ? data[i] : best;
+            return best;
+        }
+
+        double maxScalar(const double* data, size_t count) {
+            double best = data[0];
+            for (size_t i = 1; i < count; ++i) best = data[i] > best ? data[i] : best;
+            return best;
+        }
+
+        int32_t minScalar(const int32_t* data, size_t count) {
+            return *std::min_element(data, data + count);
+        }
+
+        int32_t maxScalar(const int32_t* data, size_t count) {
+            return *std::max_element(data, data + count);
+        }
+
+#ifdef POME_SIMD_AVX2
+
+        // --- AVX2 (chosen at run time, so the rest of the binary needs no -mavx2) ---
+
+        __attribute__((target("avx2"))) double hsum(__m256d v) {
+            __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+        }
+
+        __attribute__((target("avx2"))) double sumAvx2(const double* data, size_t count) {
+            __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(data + i));
+                acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(data + i + 4));
+            }
+            double total = hsum(_mm256_add_pd(acc0, acc1));
+            for (; i < count; ++i) total += data[i];
+            return total;
+        }
+
+        __attribute__((target("avx2"))) double sumAvx2(const int32_t* data, size_t count) {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128i four = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(four));
+            }
+            alignas(32) int64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            int64_t total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            for (; i < count; ++i) total += data[i];
+            return (double)total;
+        }
+
+        __attribute__((target("avx2"))) void addScalarAvx2(double* data, size_t count, double scalar) {
+            __m256d s = _mm256_set1_pd(scalar);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) _mm256_storeu_pd(data + i, _mm256_add_pd(_mm256_loadu_pd(data + i), s));
+            for (; i < count; ++i) data[i] += scalar;
+        }
+
+        __attribute__((target("avx2"))) void addScalarAvx2(int32_t* data, size_t count, int32_t scalar) {
+            __m256i s = _mm256_set1_epi32(scalar);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i* p = reinterpret_cast<__m256i*>(data + i);
+                _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), s));
+            }
+            addScalarScalar(data + i, count - i, scalar);
+        }
+
+        __attribute__((target("avx2"))) void scaleAvx2(double* data, size_t count, double factor) {
+            __m256d f = _mm256_set1_pd(factor);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) _mm256_storeu_pd(data + i, _mm256_mul_pd(_mm256_loadu_pd(data + i), f));
+            for (; i < count; ++i) data[i] *= factor;
+        }
+
+        __attribute__((target("avx2"))) void addAvx2(double* out, const double* a, const double* b, size_t count) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+            for (; i < count; ++i) out[i] = a[i] + b[i];
+        }
+
+        __attribute__((target("avx2"))) void mulAvx2(double* out, const double* a, const double* b, size_t count) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+            for (; i < count; ++i) out[i] = a[i] * b[i];
+        }
+
+        __attribute__((target("avx2"))) double dotAvx2(const double* a, const double* b, size_t count) {
+            __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+                acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+            }
+            double total = hsum(_mm256_add_pd(acc0, acc1));
+            for (; i < count; ++i) total += a[i] * b[i];
+            return total;
+        }
+
+        __attribute__((target("avx2"))) void widenAvx2(double* out, const int32_t* data, size_t count) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128i four = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                _mm256_storeu_pd(out + i, _mm256_cvtepi32_pd(four));
+            }
+            for (; i < count; ++i) out[i] = data[i];
+        }
+
+        __attribute__((target("avx2"))) double minAvx2(const double* data, size_t count) {
+            if (count < 4) return minScalar(data, count);
+            __m256d best = _mm256_loadu_pd(data);
+            size_t i = 4;
+            for (; i + 4 <= count; i += 4) best = _mm256_min_pd(best, _mm256_loadu_pd(data + i));
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, best);
+            double result = minScalar(lanes, 4);
+            for (; i < count; ++i) result = data[i] < result ? data[i] : result;
+            return result;
+        }
+
+        __attribute__((target("avx2"))) double maxAvx2(const double* data, size_t count) {
+            if (count < 4) return maxScalar(data, count);
+            __m256d best = _mm256_loadu_pd(data);
+            size_t i = 4;
+            for (; i + 4 <= count; i += 4) best = _mm256_max_pd(best, _mm256_loadu_pd(data + i));
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, best);
+            double result = maxScalar(lanes, 4);
+            for (; i < count; ++i) result = data[i] > result ? data[i] : result;
+            return result;
+        }
+
+        __attribute__((target("avx2"))) int32_t minAvx2(const int32_t* data, size_t count) {
+            if (count < 8) return minScalar(data, count);
+            __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            size_t i = 8;
+            for (; i + 8 <= count; i += 8) best = _mm256_min_epi32(best, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+            alignas(32) int32_t lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+            int32_t result = minScalar(lanes, 8);
+            for (; i < count; ++i) result = std::min(result, data[i]);
+            return result;
+        }
+
+        __attribute__((target("avx2"))) int32_t maxAvx2(const int32_t* data, size_t count) {
+            if (count < 8) return maxScalar(data, count);
+            __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            size_t i = 8;
+            for (; i + 8 <= count; i += 8) best = _mm256_max_epi32(best, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+            alignas(32) int32_t lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+            int32_t result = maxScalar(lanes, 8);
+            for (; i < count; ++i) result = std::max(result, data[i]);
+            return result;
+        }
+
+#endif // POME_SIMD_AVX2
+
+#ifdef POME_SIMD_NEON
+
+        // --- NEON (always present on AArch64) ---
+
+        double sumNeon(const double* data, size_t count) {
+            float64x2_t acc0 = vdupq_n_f64(0), acc1 = vdupq_n_f64(0);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                acc0 = vaddq_f64(acc0, vld1q_f64(data + i));
+                acc1 = vaddq_f64(acc1, vld1q_f64(data + i + 2));
+            }
+            double total = vaddvq_f64(vaddq_f64(acc0, acc1));
+            for (; i < count; ++i) total += data[i];
+            return total;
+        }
+
+        double sumNeon(const int32_t* data, size_t count) {
+            int64x2_t acc = vdupq_n_s64(0);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) acc = vpadalq_s32(acc, vld1q_s32(data + i));
+            int64_t total = vaddvq_s64(acc);
+            for (; i < count; ++i) total += data[i];
+            return (double)total;
+        }
+
+        void addScalarNeon(double* data, size_t count, double scalar) {
+            float64x2_t s = vdupq_n_f64(scalar);
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) vst1q_f64(data + i, vaddq_f64(vld1q_f64(data + i), s));
+            for (; i < count; ++i) data[i] += scalar;
+        }
+
+        void addScalarNeon(int32_t* data, size_t count, int32_t scalar) {
+            int32x4_t s = vdupq_n_s32(scalar);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) vst1q_s32(data + i, vaddq_s32(vld1q_s32(data + i), s));
+            addScalarScalar(data + i, count - i, scalar);
+        }
+
+        void scaleNeon(double* data, size_t count, double factor) {
+            float64x2_t f = vdupq_n_f64(factor);
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) vst1q_f64(data + i, vmulq_f64(vld1q_f64(data + i), f));
+            for (; i < count; ++i) data[i] *= factor;
+        }
+
+        void addNeon(double* out, const double* a, const double* b, size_t count) {
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) vst1q_f64(out + i, vaddq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+            for (; i < count; ++i) out[i] = a[i] + b[i];
+        }
+
+        void mulNeon(double* out, const double* a, const double* b, size_t count) {
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) vst1q_f64(out + i, vmulq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+            for (; i < count; ++i) out[i] = a[i] * b[i];
+        }
+
+        double dotNeon(const double* a, const double* b, size_t count) {
+            float64x2_t acc0 = vdupq_n_f64(0), acc1 = vdupq_n_f64(0);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                acc0 = vaddq_f64(acc0, vmulq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+                acc1 = vaddq_f64(acc1, vmulq_f64(vld1q_f64(a + i + 2), vld1q_f64(b + i + 2)));
+            }
+            double total = vaddvq_f64(vaddq_f64(acc0, acc1));
+            for (; i < count; ++i) total += a[i] * b[i];
+            return total;
+        }
+
+        void widenNeon(double* out, const int32_t* data, size_t count) {
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) vst1q_f64(out + i, vcvtq_f64_s64(vmovl_s32(vld1_s32(data + i))));
+            for (; i < count; ++i) out[i] = data[i];
+        }
+
+        double minNeon(const double* data, size_t count) {
+            if (count < 2) return data[0];
+            float64x2_t best = vld1q_f64(data);
+            size_t i = 2;
+            for (; i + 2 <= count; i += 2) best = vminq_f64(best, vld1q_f64(data + i));
+            double result = vminvq_f64(best);
+            for (; i < count; ++i) result = data[i] < result ? data[i] : result;
+            return result;
+        }
+
+        double maxNeon(const double* data, size_t count) {
+            if (count < 2) return data[0];
+            float64x2_t best = vld1q_f64(data);
+            size_t i = 2;
+            for (; i + 2 <= count; i += 2) best = vmaxq_f64(best, vld1q_f64(data + i));
+            double result = vmaxvq_f64(best);
+            for (; i < count; ++i) result = data[i] > result ? data[i] : result;
+            return result;
+        }
+
+        int32_t minNeon(const int32_t* data, size_t count) {
+            if (count < 4) return minScalar(data, count);
+            int32x4_t best = vld1q_s32(data);
+            size_t i = 4;
+            for (; i + 4 <= count; i += 4) best = vminq_s32(best, vld1q_s32(data + i));
+            int32_t result = vminvq_s32(best);
+            for (; i < count; ++i) result = std::min(result, data[i]);
+            return result;
+        }
+
+        int32_t maxNeon(const int32_t* data, size_t count) {
+            if (count < 4) return maxScalar(data, count);
+            int32x4_t best = vld1q_s32(data);
+            size_t i = 4;
+            for (; i + 4 <= count; i += 4) best = vmaxq_s32(best, vld1q_s32(data + i));
+            int32_t result = vmaxvq_s32(best);
+            for (; i < count; ++i) result = std::max(result, data[i]);
+            return result;
+        }
+
+#endif // POME_SIMD_NEON
+
+        struct Kernels {
+            const char* isa;
+            double (*sumD)(const double*, size_t);
+            double (*sumI)(const int32_t*, size_t);
+            void (*addScalarD)(double*, size_t, double);
+            void (*addScalarI)(int32_t*, size_t, int32_t);
+            void (*scaleD)(double*, size_t, double);
+            void (*addD)(double*, const double*, const double*, size_t);
+            void (*mulD)(double*, const double*, const double*, size_t);
+            double (*dotD)(const double*, const double*, size_t);
+            void (*widenI)(double*, const int32_t*, size_t);
+            double (*minD)(const double*, size_t);
+            double (*maxD)(const double*, size_t);
+            int32_t (*minI)(const int32_t*, size_t);
+            int32_t (*maxI)(const int32_t*, size_t);
+        };
+
+        Kernels select() {
+#if defined(POME_SIMD_AVX2)
+            if (__builtin_cpu_supports("avx2")) {
+                return {"avx2", sumAvx2, sumAvx2, addScalarAvx2, addScalarAvx2, scaleAvx2, addAvx2, mulAvx2,
+                        dotAvx2, widenAvx2, minAvx2, maxAvx2, minAvx2, maxAvx2};
+            }
+#elif defined(POME_SIMD_NEON)
+            return {"neon", sumNeon, sumNeon, addScalarNeon, addScalarNeon, scaleNeon, addNeon, mulNeon,
+                    dotNeon, widenNeon, minNeon, maxNeon, minNeon, maxNeon};
+#endif
+            return {"scalar", sumScalar, sumScalar, addScalarScalar, addScalarScalar, scaleScalar, addScalar2, mulScalar,
+                    dotScalar, widenScalar, minScalar, maxScalar, minScalar, maxScalar};
+        }
+
+        const Kernels& kernels() {
+            static const Kernels selected = select();
+            return selected;
+        }
+
+    } // namespace
+
+    const char* isa() { return kernels().isa; }
+
+    double sum(const double* data, size_t count) { return kernels().sumD(data, count); }
+    double sum(const int32_t* data, size_t count) { return kernels().sumI(data, count); }
+    void addScalar(double* data, size_t count, double scalar) { kernels().addScalarD(data, count, scalar); }
+    void addScalar(int32_t* data, size_t count, int32_t scalar) { kernels().addScalarI(data, count, scalar); }
+    void scale(double* data, size_t count, double factor) { kernels().scaleD(data, count, factor); }
+    void add(double* out, const double* a, const double* b, size_t count) { kernels().addD(out, a, b, count); }
+    void mul(double* out, const double* a, const double* b, size_t count) { kernels().mulD(out, a, b, count); }
+    double dot(const double* a, const double* b, size_t count) { return kernels().dotD(a, b, count); }
+    void widen(double* out, const int32_t* data, size_t count) { kernels().widenI(out, data, count); }
+    double min(const double* data, size_t count) { return kernels().minD(data, count); }
+    double max(const double* data, size_t count) { return kernels().maxD(data, count); }
+    int32_t min(const int32_t* data, size_t count) { return kernels().minI(data, count); }
+    int32_t max(const int32_t* data, size_t count) { return kernels().maxI(data, count); }
+
+    // std::fill compiles to vector stores on every target already
+    void fill(double* data, size_t count, double value) { std::fill(data, data + count, value); }
+    void fill(int32_t* data, size_t count, int32_t value) { std::fill(data, data + count, value); }
+
+    size_t argmax(const double* data, size_t count) {
+        double best = max(data, count);
+        for (size_t i = 0; i < count; ++i) {
+            if (data[i] == best) return i;
+        }
+        // Only a NaN maximum gets here: fall back to the first strictly largest element
+        size_t index = 0;
+        for (size_t i = 1; i < count; ++i) {
+            if (data[i] > data[index]) index = i;
+        }
+        return index;
+    }
+
+    size_t argmax(const int32_t* data, size_t count) {
+        int32_t best = max(data, count);
+        return std::find(data, data + count, best) - data;
+    }
+
+} // namespace Simd
+} // namespace Pome
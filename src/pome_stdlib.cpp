@@ -1,7 +1,16 @@
 #include "../include/pome_stdlib.h"
 #include "../include/pome_vm.h"
+#include "../include/pome_simd.h"
+#include "../include/pome_pool.h"
+#include "../include/pome_reactor.h"
+#include "../include/pome_ffi.h"
+#include "../include/pome_json.h"
+#include <algorithm>
+#include <cerrno>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
 #include <fstream>
@@ -12,6 +21,11 @@
 
 #include <dlfcn.h>
 #include <ffi.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace Pome
 {
@@ -34,6 +48,99 @@ namespace Pome
             gc.rcMapSet(module->exports, PomeValue(keyStr), PomeValue(funcObj));
         }
 
+        void printLine(const PomeValue* values, size_t count)
+        {
+            std::string line;
+            for (size_t i = 0; i < count; ++i) {
+                if (i > 0) line += ' ';
+                line += values[i].toString();
+            }
+            line += '\n';
+            fwrite(line.data(), 1, line.size(), stdout);
+        }
+
+        void flushOutput()
+        {
+            fflush(stdout);
+        }
+
+        void registerBuiltins(VM &vm)
+        {
+            vm.registerGlobal("PI", PomeValue(3.141592653589793));
+            
+            vm.registerFastNative("print", [](NativeContext&, const PomeValue* args, int argc) {
+                printLine(args, argc);
+                return PomeValue(std::monostate{});
+            }, -1);
+
+            // Core builtins predate the arity check: called short they answer nil (len 0) rather than raise
+            vm.registerFastNative("len", [](NativeContext&, const PomeValue* args, int argc) {
+                if (argc < 1) return PomeValue(0.0);
+                if (args[0].isString()) return PomeValue((double)args[0].asPomeString()->length());
+                if (args[0].isList()) {
+                    PomeList* lst = args[0].asList();
+                    return PomeValue((double)(lst->isUnboxed() ? lst->unboxedCount : lst->elements.size()));
+                }
+                if (args[0].isTable()) return PomeValue((double)args[0].asTable()->count());
+                if (args[0].isBuffer()) return PomeValue((double)args[0].asBuffer()->count);
+                return PomeValue(0.0);
+            }, -1, NativeIntrinsic::LEN);
+
+            vm.registerFastNative("push", [](NativeContext& ctx, const PomeValue* args, int argc) {
+                if (argc < 2 || !args[0].isList()) return PomeValue(std::monostate{});
+                PomeList* lst = args[0].asList();
+                if (lst->frozen) ctx.vm->runtimeError("Cannot modify a frozen value.");
+                PomeValue val = args[1];
+                size_t oldSize = lst->extraSize();
+                lst->push(ctx.gc, val);
+                ctx.gc.updateSize(lst, sizeof(PomeList) + oldSize, sizeof(PomeList) + lst->extraSize());
+                ctx.gc.writeBarrier(lst, val);
+                return PomeValue(std::monostate{});
+            }, -1, NativeIntrinsic::PUSH);
+
+            vm.registerFastNative("tonumber", [](NativeContext&, const PomeValue* args, int argc) {
+                if (argc < 1 || !args[0].isString()) return PomeValue(std::monostate{});
+                try {
+                    return PomeValue(std::stod(args[0].asString()));
+                } catch (...) {
+                    return PomeValue(std::monostate{});
+                }
+            }, -1);
+
+            vm.registerFastNative("type", [](NativeContext& ctx, const PomeValue* args, int argc) {
+                if (argc < 1) return PomeValue(std::monostate{});
+                const char* name = "unknown";
+                if (args[0].isNil()) name = "nil";
+                else if (args[0].isBool()) name = "boolean";
+                else if (args[0].isNumber()) name = "number";
+                else if (args[0].isString()) name = "string";
+                else if (args[0].isList()) name = "list";
+                else if (args[0].isTable()) name = "table";
+                else if (args[0].isBuffer()) name = "buffer";
+                else if (args[0].isFile()) name = "file";
+                else if (args[0].isObject() && args[0].asObject()->type() == ObjectType::SOCKET) name = "socket";
+                else if (args[0].isClass()) name = "class";
+                else if (args[0].isInstance()) name = "instance";
+                else if (args[0].isFunction()) name = "function";
+                return PomeValue(ctx.gc.allocateString(name));
+            }, -1);
+        }
+
+        /**
+         * Helper to register a fast native (register-window ABI) into a module.
+         * arity is the minimum argument count the VM guarantees, or -1 for variadic.
+         */
+        static void registerFastNative(GarbageCollector &gc, PomeModule *module,
+                                       const std::string &name, FastNativeFn fn, int arity)
+        {
+            NativeFunction *funcObj = gc.allocate<NativeFunction>(name, fn, arity);
+            RootGuard funcGuard(gc, funcObj);
+
+            PomeString *keyStr = gc.allocateString(name);
+
+            gc.rcMapSet(module->exports, PomeValue(keyStr), PomeValue(funcObj));
+        }
+
         /**
          * --- Math Module ---
          */
@@ -42,51 +149,26 @@ namespace Pome
         {
             PomeModule *module = gc.allocate<PomeModule>();
 
-            auto getNumberArg = [](const std::vector<PomeValue>& args, size_t index) -> std::optional<double> {
-                size_t realIndex = index;
-                if (!args.empty() && args[0].isModule()) realIndex++;
-                if (realIndex < args.size() && args[realIndex].isNumber()) return args[realIndex].asNumber();
-                return std::nullopt;
-            };
-
-            registerNative(gc, module, "sin", [getNumberArg](const std::vector<PomeValue> &args)
-                           {
-        auto val = getNumberArg(args, 0);
-        if (!val) return PomeValue(std::monostate{});
-        return PomeValue(std::sin(*val)); });
+            registerFastNative(gc, module, "sin", [](NativeContext &, const PomeValue *args, int argc)
+                               { return argc > 0 && args[0].isNumber() ? PomeValue(std::sin(args[0].asNumber())) : PomeValue(); }, -1);
 
-            registerNative(gc, module, "cos", [getNumberArg](const std::vector<PomeValue> &args)
-                           {
-        auto val = getNumberArg(args, 0);
-        if (!val) return PomeValue(std::monostate{});
-        return PomeValue(std::cos(*val)); });
+            registerFastNative(gc, module, "cos", [](NativeContext &, const PomeValue *args, int argc)
+                               { return argc > 0 && args[0].isNumber() ? PomeValue(std::cos(args[0].asNumber())) : PomeValue(); }, -1);
 
-            registerNative(gc, module, "sqrt", [getNumberArg](const std::vector<PomeValue> &args)
-                           {
-        auto val = getNumberArg(args, 0);
-        if (!val) return PomeValue(std::monostate{});
-        return PomeValue(std::sqrt(*val)); });
+            registerFastNative(gc, module, "sqrt", [](NativeContext &, const PomeValue *args, int argc)
+                               { return argc > 0 && args[0].isNumber() ? PomeValue(std::sqrt(args[0].asNumber())) : PomeValue(); }, -1);
 
-            registerNative(gc, module, "abs", [getNumberArg](const std::vector<PomeValue> &args)
-                           {
-        auto val = getNumberArg(args, 0);
-        if (!val) return PomeValue(std::monostate{});
-        return PomeValue(std::abs(*val)); });
+            registerFastNative(gc, module, "abs", [](NativeContext &, const PomeValue *args, int argc)
+                               { return argc > 0 && args[0].isNumber() ? PomeValue(std::abs(args[0].asNumber())) : PomeValue(); }, -1);
 
-            registerNative(gc, module, "floor", [getNumberArg](const std::vector<PomeValue> &args)
-                           {
-        auto val = getNumberArg(args, 0);
-        if (!val) return PomeValue(std::monostate{});
-        return PomeValue(std::floor(*val)); });
+            registerFastNative(gc, module, "floor", [](NativeContext &, const PomeValue *args, int argc)
+                               { return argc > 0 && args[0].isNumber() ? PomeValue(std::floor(args[0].asNumber())) : PomeValue(); }, -1);
 
-            registerNative(gc, module, "ceil", [getNumberArg](const std::vector<PomeValue> &args)
-                           {
-        auto val = getNumberArg(args, 0);
-        if (!val) return PomeValue(std::monostate{});
-        return PomeValue(std::ceil(*val)); });
+            registerFastNative(gc, module, "ceil", [](NativeContext &, const PomeValue *args, int argc)
+                               { return argc > 0 && args[0].isNumber() ? PomeValue(std::ceil(args[0].asNumber())) : PomeValue(); }, -1);
 
-            registerNative(gc, module, "random", [](const std::vector<PomeValue> &args)
-                           { return PomeValue(static_cast<double>(std::rand()) / RAND_MAX); });
+            registerFastNative(gc, module, "random", [](NativeContext &, const PomeValue *, int)
+                               { return PomeValue(static_cast<double>(std::rand()) / RAND_MAX); }, 0);
 
             /**
              * Constants
@@ -97,6 +179,128 @@ namespace Pome
             return module;
         }
 
+        static const char *objectTypeName(ObjectType type)
+        {
+            switch (type)
+            {
+            case ObjectType::STRING: return "string";
+            case ObjectType::FUNCTION: return "function";
+            case ObjectType::NATIVE_FUNCTION: return "native_function";
+            case ObjectType::LIST: return "list";
+            case ObjectType::TABLE: return "table";
+            case ObjectType::CLASS: return "class";
+            case ObjectType::INSTANCE: return "instance";
+            case ObjectType::MODULE: return "module";
+            case ObjectType::THREAD: return "thread";
+            case ObjectType::TASK: return "task";
+            case ObjectType::UPVALUE: return "upvalue";
+            case ObjectType::SHAPE: return "shape";
+            case ObjectType::NATIVE_OBJECT: return "native_object";
+            case ObjectType::BUFFER: return "buffer";
+            case ObjectType::FILE: return "file";
+            case ObjectType::CHANNEL: return "channel";
+            case ObjectType::SOCKET: return "socket";
+            }
+            return "unknown";
+        }
+
+        /**
+         * Builds the table system.gc_stats() returns
+         */
+        static PomeValue gcStatsTable(GarbageCollector &gc)
+        {
+            using Pause = GarbageCollector::Pause;
+            using Stats = GarbageCollector::Stats;
+            const Stats &stats = gc.getStats();
+
+            // Every new object is stored before the next allocation can collect it
+            auto newTable = [&gc]() { return gc.allocate<PomeTable>(gc.getRootShape()); };
+            auto put = [&gc](PomeTable *table, const char *name, PomeValue value)
+            {
+                RootGuard valueGuard(gc, value.isObject() ? value.asObject() : nullptr);
+                PomeString *key = gc.allocateString(name);
+                RootGuard keyGuard(gc, key);
+                table->setField(gc, PomeValue(key), value);
+                gc.writeBarrier(table, value);
+            };
+            auto append = [&gc](PomeList *list, PomeValue value)
+            {
+                list->push(gc, value);
+                gc.writeBarrier(list, value);
+            };
+
+            PomeTable *result = newTable();
+            RootGuard resultGuard(gc, result);
+            put(result, "heap_bytes", PomeValue((double)gc.getHeapBytes()));
+            put(result, "young_bytes", PomeValue((double)gc.getYoungBytes()));
+            put(result, "rss_kb", PomeValue((double)GarbageCollector::getRSS()));
+            put(result, "collections", PomeValue((double)gc.getGCCount()));
+            put(result, "zct_size", PomeValue((double)gc.getZCTSize()));
+            put(result, "remembered_set_size", PomeValue((double)gc.getRememberedSetSize()));
+            put(result, "frozen_heaps", PomeValue((double)gc.getFrozenHeapCount()));
+            put(result, "reclaimed_bytes", PomeValue((double)stats.reclaimedBytes));
+            put(result, "promoted_bytes", PomeValue((double)stats.promotedBytes));
+            put(result, "promotion_rate", PomeValue(stats.promotionRate()));
+            put(result, "list_pool_hit_rate", PomeValue(stats.listPoolHitRate()));
+
+            Nursery::Stats nurseryStats = gc.getNurseryStats();
+            PomeTable *nursery = newTable();
+            put(result, "nursery", PomeValue(nursery));
+            put(nursery, "reserved_bytes", PomeValue((double)nurseryStats.reservedBytes));
+            put(nursery, "used_bytes", PomeValue((double)nurseryStats.usedBytes));
+            put(nursery, "live_bytes", PomeValue((double)nurseryStats.liveBytes));
+            put(nursery, "free_slot_bytes", PomeValue((double)nurseryStats.cachedBytes));
+            put(nursery, "recycled_bytes", PomeValue((double)nurseryStats.recycledBytes));
+            put(nursery, "recycled_blocks", PomeValue((double)nurseryStats.recycledBlocks));
+            put(nursery, "slot_reuse_rate", PomeValue(nurseryStats.reuseRate()));
+            put(nursery, "fragmentation", PomeValue(nurseryStats.fragmentation()));
+
+            // Per pause kind: {count, total_ms, max_ms}
+            PomeTable *pauses = newTable();
+            put(result, "pauses", PomeValue(pauses));
+            for (size_t k = 0; k < Pause::KINDS; ++k)
+            {
+                PomeTable *kind = newTable();
+                put(pauses, Pause::kindName(static_cast<Pause::Kind>(k)), PomeValue(kind));
+                put(kind, "count", PomeValue((double)stats.pauseCount[k]));
+                put(kind, "total_ms", PomeValue(stats.pauseTotalMs[k]));
+                put(kind, "max_ms", PomeValue(stats.pauseMaxMs[k]));
+            }
+
+            // histogram[i] counts pauses below histogram_bounds_ms[i]; the last bucket has no bound
+            PomeList *bounds = gc.allocateList();
+            put(result, "histogram_bounds_ms", PomeValue(bounds));
+            for (double bound : Stats::HISTOGRAM_BOUNDS) append(bounds, PomeValue(bound));
+            PomeList *histogram = gc.allocateList();
+            put(result, "histogram", PomeValue(histogram));
+            for (uint64_t count : stats.histogram) append(histogram, PomeValue((double)count));
+
+            PomeList *recent = gc.allocateList();
+            put(result, "recent", PomeValue(recent));
+            for (const Pause &pause : stats.recent)
+            {
+                PomeTable *entry = newTable();
+                append(recent, PomeValue(entry));
+                put(entry, "kind", PomeValue(gc.allocateString(Pause::kindName(pause.kind))));
+                put(entry, "pause_ms", PomeValue(pause.milliseconds));
+                put(entry, "reclaimed", PomeValue((double)pause.reclaimedBytes()));
+                put(entry, "promoted", PomeValue((double)pause.promotedBytes));
+                put(entry, "heap_after", PomeValue((double)pause.heapAfter));
+            }
+
+            // Objects and bytes per type still on the heap, including dead ones a sweep has yet to reach
+            PomeTable *types = newTable();
+            put(result, "types", PomeValue(types));
+            for (auto const &[type, usage] : gc.getUsageByType())
+            {
+                PomeTable *entry = newTable();
+                put(types, objectTypeName(type), PomeValue(entry));
+                put(entry, "objects", PomeValue((double)usage.objects));
+                put(entry, "bytes", PomeValue((double)usage.bytes));
+            }
+            return PomeValue(result);
+        }
+
         /**
          * --- System Module ---
          */
@@ -121,6 +325,33 @@ namespace Pome
                 return PomeValue(gc.allocateString(gc.getInfo()));
             });
 
+            registerNative(gc, module, "gc_stats", [&gc](const std::vector<PomeValue> &args)
+            {
+                return gcStatsTable(gc);
+            });
+
+            // gc_pause(ms) sets this isolate's major GC slice length; either way the current one is returned
+            registerNative(gc, module, "gc_pause", [&gc](const std::vector<PomeValue> &args)
+            {
+                if (!args.empty() && args[0].isNumber() && args[0].asNumber() >= 0) gc.setPauseTarget(args[0].asNumber());
+                return PomeValue(gc.getPauseTarget());
+            });
+
+            // gc_threads(n) sets how many threads mark and sweep this isolate's large heaps; returns the current count
+            registerNative(gc, module, "gc_threads", [&gc](const std::vector<PomeValue> &args)
+            {
+                if (!args.empty() && args[0].isNumber() && args[0].asNumber() >= 1) gc.setGcThreads((size_t)args[0].asNumber());
+                return PomeValue((double)gc.getGcThreads());
+            });
+
+            // max_frames(n) sets how deep this isolate's calls may nest before "Stack overflow"; returns the current limit
+            registerFastNative(gc, module, "max_frames", [](NativeContext &ctx, const PomeValue *args, int argc)
+            {
+                if (argc > 0 && args[0].isNumber() && args[0].asNumber() >= 1)
+                    ctx.vm->setMaxFrames((int)std::min(args[0].asNumber(), (double)INT32_MAX));
+                return PomeValue((double)ctx.vm->getMaxFrames());
+            }, -1);
+
             return module;
         }
 
@@ -143,12 +374,23 @@ namespace Pome
                            {
         auto path = getStringArg(args, 0);
         if (!path) return PomeValue(std::monostate{});
-        std::ifstream file(*path);
+        std::ifstream file(*path, std::ios::binary | std::ios::ate);
         if (!file.is_open()) return PomeValue(std::monostate{}); 
-        std::stringstream buffer;
-        buffer << file.rdbuf();
+        // Sized up front and read in one call; buffer.map avoids even this copy for large files
+        std::string contents;
+        std::streamoff size = file.tellg();
+        if (size > 0) {
+            contents.resize(static_cast<size_t>(size));
+            file.seekg(0);
+            file.read(contents.data(), size);
+            contents.resize(static_cast<size_t>(file.gcount()));
+        } else {
+            // Pipes and /proc files report no size
+            file.seekg(0);
+            contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
         
-        PomeString* s = gc.allocateString(buffer.str());
+        PomeString* s = gc.allocateString(contents);
         return PomeValue(s); });
 
             registerNative(gc, module, "writeFile", [getStringArg](const std::vector<PomeValue> &args)
@@ -166,6 +408,7 @@ namespace Pome
         size_t idx = 0;
         if (!args.empty() && args[0].isModule()) idx++;
         if (args.size() > idx) std::cout << args[idx].toString(); 
+        flushOutput();
         std::string line;
         if (std::getline(std::cin, line)) {
             PomeString* s = gc.allocateString(line);
@@ -173,6 +416,115 @@ namespace Pome
         }
         return PomeValue(std::monostate{}); });
 
+            // readFileAsync(path): a task that settles with the file's contents; nil if it cannot be opened
+            registerFastNative(gc, module, "readFileAsync", [](NativeContext &ctx, const PomeValue *args, int)
+                               {
+        if (!args[0].isString()) return PomeValue(std::monostate{});
+        int fd = ::open(args[0].asString().c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return PomeValue(std::monostate{});
+        PomeTask* task = ctx.gc.allocate<PomeTask>(nullptr);
+        ctx.vm->getReactor().readFile(task, fd);
+        return PomeValue(task); }, 1);
+
+            // writeFileAsync(path, content): a task that settles with the bytes written; nil if it cannot be opened
+            registerFastNative(gc, module, "writeFileAsync", [](NativeContext &ctx, const PomeValue *args, int)
+                               {
+        if (!args[0].isString() || !args[1].isString()) return PomeValue(std::monostate{});
+        int fd = ::open(args[0].asString().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return PomeValue(std::monostate{});
+        PomeTask* task = ctx.gc.allocate<PomeTask>(nullptr);
+        ctx.vm->getReactor().writeFile(task, fd, args[1].asString());
+        return PomeValue(task); }, 2);
+
+            /**
+             * Streams: files read and written in chunks through a stdio buffer
+             */
+            auto fileArg = [](const std::vector<PomeValue>& args, size_t index) -> PomeFile* {
+                size_t realIndex = index;
+                if (!args.empty() && args[0].isModule()) realIndex++;
+                if (realIndex < args.size() && args[realIndex].isFile()) return args[realIndex].asFile();
+                return nullptr;
+            };
+
+            registerNative(gc, module, "open", [&gc, getStringArg](const std::vector<PomeValue> &args)
+                           {
+        auto path = getStringArg(args, 0);
+        if (!path) return PomeValue(std::monostate{});
+        std::string mode = getStringArg(args, 1).value_or("r");
+        if (mode != "r" && mode != "w" && mode != "a" && mode != "r+" && mode != "w+" && mode != "a+")
+            return PomeValue(std::monostate{});
+        FILE* handle = fopen(path->c_str(), (mode + "b").c_str());
+        if (!handle) return PomeValue(std::monostate{});
+        return PomeValue(gc.allocate<PomeFile>(handle, *path)); });
+
+            registerNative(gc, module, "lines", [&gc, getStringArg, fileArg](const std::vector<PomeValue> &args)
+                           {
+        if (PomeFile* file = fileArg(args, 0)) return PomeValue(file);
+        auto path = getStringArg(args, 0);
+        if (!path) return PomeValue(std::monostate{});
+        FILE* handle = fopen(path->c_str(), "rb");
+        if (!handle) return PomeValue(std::monostate{});
+        return PomeValue(gc.allocate<PomeFile>(handle, *path, true)); });
+
+            registerNative(gc, module, "readLine", [&gc, fileArg](const std::vector<PomeValue> &args)
+                           {
+        PomeFile* file = fileArg(args, 0);
+        std::string_view line;
+        if (!file || !file->readLine(line)) return PomeValue(std::monostate{});
+        return PomeValue(gc.allocateString(line)); });
+
+            registerNative(gc, module, "read", [&gc, fileArg](const std::vector<PomeValue> &args)
+                           {
+        PomeFile* file = fileArg(args, 0);
+        if (!file || !file->isOpen()) return PomeValue(std::monostate{});
+        size_t idx = (!args.empty() && args[0].isModule()) ? 2 : 1;
+        std::string chunk;
+        if (idx < args.size() && args[idx].isNumber()) {
+            double n = args[idx].asNumber();
+            if (n < 0) return PomeValue(std::monostate{});
+            chunk.resize(static_cast<size_t>(n));
+            chunk.resize(fread(chunk.data(), 1, chunk.size(), file->handle()));
+            if (chunk.empty() && n > 0) return PomeValue(std::monostate{});
+        } else {
+            // The rest of the file
+            size_t used = 0, got;
+            do {
+                chunk.resize(used + PomeFile::BUFFER_SIZE);
+                got = fread(chunk.data() + used, 1, PomeFile::BUFFER_SIZE, file->handle());
+                used += got;
+            } while (got == PomeFile::BUFFER_SIZE);
+            chunk.resize(used);
+            if (chunk.empty() && feof(file->handle())) return PomeValue(std::monostate{});
+        }
+        return PomeValue(gc.allocateString(chunk)); });
+
+            registerNative(gc, module, "write", [fileArg](const std::vector<PomeValue> &args)
+                           {
+        PomeFile* file = fileArg(args, 0);
+        if (!file || !file->isOpen()) return PomeValue(false);
+        size_t idx = (!args.empty() && args[0].isModule()) ? 2 : 1;
+        for (; idx < args.size(); ++idx) {
+            std::string text = args[idx].toString();
+            if (fwrite(text.data(), 1, text.size(), file->handle()) != text.size()) return PomeValue(false);
+        }
+        return PomeValue(true); });
+
+            registerNative(gc, module, "flush", [fileArg](const std::vector<PomeValue> &args)
+                           {
+        PomeFile* file = fileArg(args, 0);
+        if (!file) {
+            flushOutput();
+            return PomeValue(true);
+        }
+        return PomeValue(file->isOpen() && fflush(file->handle()) == 0); });
+
+            registerNative(gc, module, "close", [fileArg](const std::vector<PomeValue> &args)
+                           {
+        PomeFile* file = fileArg(args, 0);
+        if (!file || !file->isOpen()) return PomeValue(false);
+        file->close();
+        return PomeValue(true); });
+
             return module;
         }
 
@@ -190,15 +542,14 @@ namespace Pome
         if (!args.empty() && args[0].isModule()) idx++;
 
         if (args.size() <= idx || !args[idx].isString()) return PomeValue(std::monostate{});
-        std::string s = args[idx].asString();
+        PomeString* s = args[idx].asPomeString();
         
         if (args.size() < idx + 2 || !args[idx + 1].isNumber()) {
-             PomeString* newS = gc.allocateString(s);
-             return PomeValue(newS); 
+             return PomeValue(gc.sliceString(s, 0, s->length())); 
         }
         
         size_t start = static_cast<size_t>(args[idx + 1].asNumber());
-        if (start >= s.length()) {
+        if (start >= s->length()) {
              PomeString* empty = gc.allocateString("");
              return PomeValue(empty);
         }
@@ -208,7 +559,7 @@ namespace Pome
             len = static_cast<size_t>(args[idx + 2].asNumber());
         }
         
-        PomeString* sub = gc.allocateString(s.substr(start, len));
+        PomeString* sub = gc.sliceString(s, start, len);
         return PomeValue(sub); });
 
             registerNative(gc, module, "lower", [&gc](const std::vector<PomeValue> &args)
@@ -231,6 +582,35 @@ namespace Pome
                 return PomeValue(gc.allocateString(s));
             });
 
+            // join(list, separator = ""): one copy of every piece, however many there are
+            registerNative(gc, module, "join", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() <= idx || !args[idx].isList()) return PomeValue(std::monostate{});
+                PomeList* list = args[idx].asList();
+                std::string separator = args.size() > idx + 1 && args[idx + 1].isString() ? args[idx + 1].asString() : "";
+
+                std::string result;
+                auto appendPiece = [&](size_t i, const PomeValue &value)
+                {
+                    if (i > 0) result.append(separator);
+                    if (value.isString()) value.asPomeString()->appendTo(result);
+                    else result.append(value.toString());
+                };
+                if (list->isUnboxed()) {
+                    for (size_t i = 0; i < list->unboxedCount; ++i) appendPiece(i, list->at(i));
+                } else {
+                    size_t length = list->elements.size() > 0 ? separator.size() * (list->elements.size() - 1) : 0;
+                    for (auto &val : list->elements) {
+                        if (val.isString()) length += val.asPomeString()->length();
+                    }
+                    result.reserve(length);
+                    for (size_t i = 0; i < list->elements.size(); ++i) appendPiece(i, list->elements[i]);
+                }
+                return PomeValue(gc.allocateString(result));
+            });
+
             return module;
         }
 
@@ -239,6 +619,65 @@ namespace Pome
         // For now, let's put them in a global scope in main.cpp or a 'list' module.
         // Let's add a List module.
         
+        /**
+         * Helpers for the list module's vector operations
+         */
+        static void resizeList(GarbageCollector &gc, PomeList *list, size_t oldExtra)
+        {
+            gc.updateSize(list, sizeof(PomeList) + oldExtra, sizeof(PomeList) + list->extraSize());
+        }
+
+        // Tries to give list unboxed storage; true when it holds only numbers (and is not empty)
+        static bool unboxNumeric(GarbageCollector &gc, PomeList *list)
+        {
+            size_t oldExtra = list->extraSize();
+            list->tryUnbox();
+            resizeList(gc, list, oldExtra);
+            return list->size() > 0 && (list->listType == ListType::DOUBLE || list->listType == ListType::INT32);
+        }
+
+        // An unboxed list of count elements, left uninitialised
+        static PomeList *newUnboxedList(GarbageCollector &gc, ListType type, size_t count)
+        {
+            PomeList *list = gc.allocateList();
+            size_t oldExtra = list->extraSize();
+            list->listType = type;
+            list->ensureCapacity(count);
+            list->unboxedCount = count;
+            resizeList(gc, list, oldExtra);
+            return list;
+        }
+
+        // list's elements as doubles: its own storage for a DOUBLE list, a widened copy in scratch otherwise
+        static const double *doubleData(PomeList *list, std::vector<double> &scratch)
+        {
+            if (list->listType == ListType::DOUBLE) return list->asDouble();
+            scratch.resize(list->unboxedCount);
+            Simd::widen(scratch.data(), list->asInt32(), list->unboxedCount);
+            return scratch.data();
+        }
+
+        // Element-wise kernel over two numeric lists of the same length, into a new DOUBLE list
+        static PomeValue elementwise(GarbageCollector &gc, const std::vector<PomeValue> &args,
+                                     void (*kernel)(double *, const double *, const double *, size_t))
+        {
+            size_t idx = 0;
+            if (!args.empty() && args[0].isModule()) idx++;
+            if (args.size() < idx + 2 || !args[idx].isList() || !args[idx + 1].isList()) return PomeValue();
+            PomeList *a = args[idx].asList();
+            PomeList *b = args[idx + 1].asList();
+            if (a->size() != b->size()) return PomeValue();
+            if (a->size() == 0) return PomeValue(gc.allocateList());
+            if (!unboxNumeric(gc, a) || !unboxNumeric(gc, b)) return PomeValue();
+
+            std::vector<double> scratchA, scratchB;
+            const double *x = doubleData(a, scratchA);
+            const double *y = doubleData(b, scratchB);
+            PomeList *result = newUnboxedList(gc, ListType::DOUBLE, a->size());
+            kernel(result->asDouble(), x, y, a->size());
+            return PomeValue(result);
+        }
+
         PomeModule *createListModule(GarbageCollector &gc)
         {
             PomeModule *module = gc.allocate<PomeModule>();
@@ -247,7 +686,7 @@ namespace Pome
             {
                 size_t idx = 0;
                 if (!args.empty() && args[0].isModule()) idx++;
-                if (args.size() < idx + 2 || !args[idx].isList()) return PomeValue(std::monostate{});
+                if (args.size() < idx + 2 || !args[idx].isList() || args[idx].asList()->frozen) return PomeValue(std::monostate{});
                 PomeList* list = args[idx].asList();
                 size_t oldSize = list->extraSize();
                 list->push(gc, args[idx + 1]);
@@ -260,17 +699,13 @@ namespace Pome
             {
                 size_t idx = 0;
                 if (!args.empty() && args[0].isModule()) idx++;
-                if (args.size() <= idx || !args[idx].isList()) return PomeValue(std::monostate{});
+                if (args.size() <= idx || !args[idx].isList() || args[idx].asList()->frozen) return PomeValue(std::monostate{});
                 PomeList* list = args[idx].asList();
                 size_t oldExtra = list->extraSize();
                 PomeValue val;
                 if (list->isUnboxed()) {
                     if (list->unboxedCount == 0) return PomeValue(std::monostate{});
-                    if (list->listType == ListType::DOUBLE) {
-                        val = PomeValue(list->asDouble()[--list->unboxedCount]);
-                    } else {
-                        val = PomeValue((double)list->asInt32()[--list->unboxedCount]);
-                    }
+                    val = list->at(--list->unboxedCount);
                 } else {
                     auto& elements = list->elements;
                     if (elements.empty()) return PomeValue(std::monostate{});
@@ -296,20 +731,7 @@ namespace Pome
                 size_t idx = 0;
                 if (!args.empty() && args[0].isModule()) idx++;
                 if (args.size() <= idx || !args[idx].isList()) return PomeValue(0.0);
-                PomeList* list = args[idx].asList();
-                double sum = 0;
-                if (list->listType == ListType::DOUBLE) {
-                    double* data = list->asDouble();
-                    for (size_t i = 0; i < list->unboxedCount; ++i) sum += data[i];
-                } else if (list->listType == ListType::INT32) {
-                    int32_t* data = list->asInt32();
-                    for (size_t i = 0; i < list->unboxedCount; ++i) sum += data[i];
-                } else {
-                    for (auto& val : list->elements) {
-                        if (val.isNumber()) sum += val.asNumber();
-                    }
-                }
-                return PomeValue(sum);
+                return PomeValue(args[idx].asList()->sum());
             });
 
             registerNative(gc, module, "add_scalar", [](const std::vector<PomeValue> &args)
@@ -317,28 +739,130 @@ namespace Pome
                 size_t idx = 0;
                 if (!args.empty() && args[0].isModule()) idx++;
                 if (args.size() < idx + 2 || !args[idx].isList() || !args[idx + 1].isNumber()) return PomeValue();
-                PomeList* list = args[idx].asList();
-                double scalar = args[idx + 1].asNumber();
-                if (list->listType == ListType::DOUBLE) {
-                    double* data = list->asDouble();
-                    for (size_t i = 0; i < list->unboxedCount; ++i) data[i] += scalar;
-                } else if (list->listType == ListType::INT32) {
-                    if (scalar == (int32_t)scalar) {
-                        int32_t* data = list->asInt32();
-                        int32_t iscalar = (int32_t)scalar;
-                        for (size_t i = 0; i < list->unboxedCount; ++i) data[i] += iscalar;
-                    } else {
-                        list->switchTo(ListType::DOUBLE);
-                        double* data = list->asDouble();
-                        for (size_t i = 0; i < list->unboxedCount; ++i) data[i] += scalar;
-                    }
-                } else {
-                    for (auto& val : list->elements) {
-                        if (val.isNumber()) val = PomeValue(val.asNumber() + scalar);
+                if (args[idx].asList()->frozen) return PomeValue();
+                args[idx].asList()->addScalar(args[idx + 1].asNumber());
+                return args[idx];
+            });
+
+            registerNative(gc, module, "add", [&gc](const std::vector<PomeValue> &args)
+            {
+                return elementwise(gc, args, Simd::add);
+            });
+
+            registerNative(gc, module, "mul", [&gc](const std::vector<PomeValue> &args)
+            {
+                return elementwise(gc, args, Simd::mul);
+            });
+
+            registerNative(gc, module, "dot", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() < idx + 2 || !args[idx].isList() || !args[idx + 1].isList()) return PomeValue();
+                PomeList *a = args[idx].asList();
+                PomeList *b = args[idx + 1].asList();
+                if (a->size() != b->size()) return PomeValue();
+                if (a->size() == 0) return PomeValue(0.0);
+                if (!unboxNumeric(gc, a) || !unboxNumeric(gc, b)) return PomeValue();
+                std::vector<double> scratchA, scratchB;
+                return PomeValue(Simd::dot(doubleData(a, scratchA), doubleData(b, scratchB), a->size()));
+            });
+
+            // min, max and argmax return nil for an empty or non-numeric list
+            registerNative(gc, module, "min", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() <= idx || !args[idx].isList() || !unboxNumeric(gc, args[idx].asList())) return PomeValue();
+                PomeList *list = args[idx].asList();
+                if (list->listType == ListType::INT32) return PomeValue((double)Simd::min(list->asInt32(), list->unboxedCount));
+                return PomeValue(Simd::min(list->asDouble(), list->unboxedCount));
+            });
+
+            registerNative(gc, module, "max", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() <= idx || !args[idx].isList() || !unboxNumeric(gc, args[idx].asList())) return PomeValue();
+                PomeList *list = args[idx].asList();
+                if (list->listType == ListType::INT32) return PomeValue((double)Simd::max(list->asInt32(), list->unboxedCount));
+                return PomeValue(Simd::max(list->asDouble(), list->unboxedCount));
+            });
+
+            registerNative(gc, module, "argmax", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() <= idx || !args[idx].isList() || !unboxNumeric(gc, args[idx].asList())) return PomeValue();
+                PomeList *list = args[idx].asList();
+                if (list->listType == ListType::INT32) return PomeValue((double)Simd::argmax(list->asInt32(), list->unboxedCount));
+                return PomeValue((double)Simd::argmax(list->asDouble(), list->unboxedCount));
+            });
+
+            // Multiplies every element in place; int32 lists become double lists
+            registerNative(gc, module, "scale", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() < idx + 2 || !args[idx].isList() || !args[idx + 1].isNumber()) return PomeValue();
+                PomeList *list = args[idx].asList();
+                if (list->frozen) return PomeValue();
+                if (list->size() == 0) return args[idx];
+                if (!unboxNumeric(gc, list)) return PomeValue();
+                size_t oldExtra = list->extraSize();
+                list->switchTo(ListType::DOUBLE);
+                resizeList(gc, list, oldExtra);
+                Simd::scale(list->asDouble(), list->unboxedCount, args[idx + 1].asNumber());
+                return args[idx];
+            });
+
+            // fill(list, value) overwrites every element in place; fill(count, value) returns a new list
+            registerNative(gc, module, "fill", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() < idx + 2) return PomeValue();
+                PomeValue value = args[idx + 1];
+                ListType type = ListType::MIXED;
+                if (value.isBool()) type = ListType::BOOL;
+                else if (value.isNumber()) type = value.asNumber() == (int32_t)value.asNumber() ? ListType::INT32 : ListType::DOUBLE;
+
+                PomeList *list;
+                if (args[idx].isNumber() && args[idx].asNumber() >= 0) {
+                    size_t count = (size_t)args[idx].asNumber();
+                    if (type == ListType::MIXED) {
+                        list = gc.allocateList();
+                        size_t oldExtra = list->extraSize();
+                        list->ensureCapacity(count);
+                        for (size_t i = 0; i < count; ++i) list->push(gc, value);
+                        resizeList(gc, list, oldExtra);
+                        gc.writeBarrier(list, value);
+                        return PomeValue(list);
                     }
+                    list = newUnboxedList(gc, type, count);
+                } else if (args[idx].isList() && !args[idx].asList()->frozen) {
+                    list = args[idx].asList();
+                    size_t oldExtra = list->extraSize();
                     list->tryUnbox();
+                    // Widening int32 storage is enough for a double; any other change of type boxes
+                    if (list->listType == ListType::INT32 && type == ListType::DOUBLE) list->switchTo(ListType::DOUBLE);
+                    if (list->listType == ListType::DOUBLE && type == ListType::INT32) type = ListType::DOUBLE;
+                    if (list->isUnboxed() && list->listType != type) list->box();
+                    resizeList(gc, list, oldExtra);
+                    if (!list->isUnboxed()) {
+                        for (auto &element : list->elements) gc.rcWriteBarrier(&element, value);
+                        gc.writeBarrier(list, value);
+                        return args[idx];
+                    }
+                    type = list->listType;
+                } else {
+                    return PomeValue();
                 }
-                return args[idx];
+
+                if (type == ListType::DOUBLE) Simd::fill(list->asDouble(), list->unboxedCount, value.asNumber());
+                else if (type == ListType::INT32) Simd::fill(list->asInt32(), list->unboxedCount, (int32_t)value.asNumber());
+                else std::fill(list->asBool(), list->asBool() + list->unboxedCount, (uint8_t)value.isTrue());
+                return args[idx].isList() ? args[idx] : PomeValue(list);
             });
 
             return module;
@@ -346,6 +870,12 @@ namespace Pome
 /**
  * --- Threading Module ---
  */
+static Channel *channelOf(const PomeValue &value)
+{
+    if (!value.isObject() || value.asObject()->type() != ObjectType::CHANNEL) return nullptr;
+    return static_cast<PomeChannel *>(value.asObject())->channel.get();
+}
+
 PomeModule *createThreadingModule(GarbageCollector &gc, ModuleLoader loader)
 {
     PomeModule *module = gc.allocate<PomeModule>();
@@ -367,6 +897,9 @@ PomeModule *createThreadingModule(GarbageCollector &gc, ModuleLoader loader)
         threadObj->handle = std::thread([originalFn, originalArgs, loader, threadObj]() {
             auto threadGC = std::make_unique<GarbageCollector>();
             VM threadVM(*threadGC, loader);
+            threadGC->setVM(&threadVM);
+            // The cloned function shares its chunks with the spawning VM, and tier-up is not synchronised
+            threadVM.setJitEnabled(false);
 
             std::map<PomeObject*, PomeObject*> copiedObjects;
             PomeFunction* clonedFn = (PomeFunction*)PomeValue(originalFn).deepCopy(*threadGC, copiedObjects).asObject();
@@ -377,17 +910,12 @@ PomeModule *createThreadingModule(GarbageCollector &gc, ModuleLoader loader)
             }
 
             // Register standard globals for the new isolate
-            threadVM.registerGlobal("PI", PomeValue(3.141592653589793));
-            threadVM.registerNative("print", [](const std::vector<PomeValue>& args) {
-                for (size_t i = 0; i < args.size(); ++i) {
-                    std::cout << args[i].toString() << (i == args.size() - 1 ? "" : " ");
-                }
-                std::cout << std::endl;
-                return PomeValue(std::monostate{});
-            });
+            registerBuiltins(threadVM);
 
             try {
-                threadObj->result = threadVM.interpret(clonedFn->chunk.get(), clonedFn->module);
+                threadObj->result = threadVM.call(clonedFn, threadArgs);
+            } catch (const VMException&) {
+                // The isolate has printed the error; join returns nil
             } catch (const std::exception& e) {
                 std::cerr << "[Thread] Fatal error in isolate: " << e.what() << std::endl;
             } catch (...) {
@@ -419,6 +947,117 @@ PomeModule *createThreadingModule(GarbageCollector &gc, ModuleLoader loader)
         return result;
     });
 
+    // submit(fn, args...): runs fn on a pool worker; returns a task to await for its result
+    registerFastNative(gc, module, "submit", [](NativeContext &ctx, const PomeValue *args, int argc)
+    {
+        if (!args[0].isPomeFunction()) return PomeValue();
+        PomeFunction* function = args[0].asPomeFunction();
+        auto job = PoolJob::create(PoolJob::Kind::CALL, function, args + 1, argc - 1);
+        PomeTask* task = ctx.gc.allocate<PomeTask>(function);
+        task->job = job;
+        ctx.vm->addJobTask(task);
+        IsolatePool::instance().submit(std::move(job));
+        return PomeValue(task);
+    }, 1);
+
+    // parallel_map(fn, list, chunkSize): [fn(x) for x in list], computed in chunks on the pool
+    registerFastNative(gc, module, "parallel_map", [](NativeContext &ctx, const PomeValue *args, int argc)
+    {
+        if (!args[0].isPomeFunction() || !args[1].isList()) return PomeValue();
+        PomeFunction* function = args[0].asPomeFunction();
+        PomeList* list = args[1].asList();
+        IsolatePool& pool = IsolatePool::instance();
+        size_t count = list->size();
+        // By default four chunks per worker, so a slow chunk leaves the others something to steal
+        size_t chunk = std::max<size_t>(1, (count + pool.workerCount() * 4 - 1) / (pool.workerCount() * 4));
+        if (argc > 2 && args[2].isNumber() && args[2].asNumber() >= 1) chunk = (size_t)args[2].asNumber();
+
+        std::vector<std::shared_ptr<PoolJob>> jobs;
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            jobs.push_back(PoolJob::createMap(function, list, begin, std::min(count, begin + chunk)));
+            pool.submit(jobs.back());
+        }
+        for (auto& job : jobs) {
+            while (true) {
+                uint64_t seen = pool.completedCount();
+                if (job->done.load(std::memory_order_acquire)) break;
+                pool.waitForCompletion(seen);
+            }
+        }
+
+        PomeList* results = ctx.gc.allocateList();
+        RootGuard resultsGuard(ctx.gc, results);
+        CollectionDeferral deferral(ctx.gc); // Nothing roots each chunk's copy until it is in results
+        size_t oldExtra = results->extraSize();
+        results->ensureCapacity(count);
+        for (auto& job : jobs) {
+            // The worker has already reported the error
+            if (job->failed) return PomeValue();
+            PomeValue part = job->takeResult(ctx.gc);
+            PomeList* mapped = part.asList();
+            for (size_t i = 0; i < mapped->size(); ++i) {
+                PomeValue value = mapped->at(i);
+                results->push(ctx.gc, value);
+                ctx.gc.writeBarrier(results, value);
+            }
+        }
+        ctx.gc.updateSize(results, sizeof(PomeList) + oldExtra, sizeof(PomeList) + results->extraSize());
+        return PomeValue(results);
+    }, 2);
+
+    // workers(): threads in the pool, one per core unless --workers says otherwise
+    registerFastNative(gc, module, "workers", [](NativeContext &, const PomeValue *, int)
+    {
+        return PomeValue((double)IsolatePool::instance().workerCount());
+    }, 0);
+
+    // freeze(value): an immutable copy every isolate shares; nil if value holds functions, objects or buffers
+    registerFastNative(gc, module, "freeze", [](NativeContext &ctx, const PomeValue *args, int)
+    {
+        if (!args[0].isObject() || args[0].asObject()->frozen) return args[0];
+        std::shared_ptr<FrozenHeap> heap = FrozenHeap::freeze(args[0]);
+        if (!heap) return PomeValue();
+        PomeValue frozen = heap->value();
+        ctx.gc.retainFrozen(std::move(heap));
+        return frozen;
+    }, 1);
+
+    registerFastNative(gc, module, "is_frozen", [](NativeContext &, const PomeValue *args, int)
+    {
+        return PomeValue(args[0].isObject() && args[0].asObject()->frozen);
+    }, 1);
+
+    // channel(capacity): a queue of at most capacity values (1 by default) that isolates pass each other
+    registerFastNative(gc, module, "channel", [](NativeContext &ctx, const PomeValue *args, int argc)
+    {
+        size_t capacity = 1;
+        if (argc > 0 && args[0].isNumber() && args[0].asNumber() >= 1) capacity = (size_t)args[0].asNumber();
+        return PomeValue(ctx.gc.allocate<PomeChannel>(std::make_shared<Channel>(capacity)));
+    }, 0);
+
+    // send(channel, value): waits for room; false once the channel is closed
+    registerFastNative(gc, module, "send", [](NativeContext &, const PomeValue *args, int)
+    {
+        Channel *channel = channelOf(args[0]);
+        if (!channel) return PomeValue();
+        return PomeValue(channel->send(args[1]));
+    }, 2);
+
+    // receive(channel): waits for a value; nil once the channel is closed and empty
+    registerFastNative(gc, module, "receive", [](NativeContext &ctx, const PomeValue *args, int)
+    {
+        Channel *channel = channelOf(args[0]);
+        PomeValue value;
+        if (!channel || !channel->receive(ctx.gc, value)) return PomeValue();
+        return value;
+    }, 1);
+
+    registerFastNative(gc, module, "close", [](NativeContext &, const PomeValue *args, int)
+    {
+        if (Channel *channel = channelOf(args[0])) channel->close();
+        return PomeValue();
+    }, 1);
+
     return module;
 }
 
@@ -449,12 +1088,360 @@ PomeModule *createThreadingModule(GarbageCollector &gc, ModuleLoader loader)
                 return PomeValue(std::monostate{}); 
             });
 
+            // sleep_async(seconds): a task that settles with nil after n seconds; other tasks run meanwhile
+            registerFastNative(gc, module, "sleep_async", [](NativeContext &ctx, const PomeValue *args, int)
+                               {
+                if (!args[0].isNumber()) return PomeValue(std::monostate{});
+                PomeTask* task = ctx.gc.allocate<PomeTask>(nullptr);
+                ctx.vm->getReactor().sleep(task, args[0].asNumber());
+                return PomeValue(task);
+            }, 1);
+
+            return module;
+        }
+
+        /**
+         * --- Net Module ---
+         */
+
+        static PomeSocket *openSocketOf(const PomeValue &value)
+        {
+            if (!value.isObject() || value.asObject()->type() != ObjectType::SOCKET) return nullptr;
+            PomeSocket *socket = static_cast<PomeSocket *>(value.asObject());
+            return socket->isOpen() ? socket : nullptr;
+        }
+
+        // A non-blocking TCP socket listening on host:port, or connecting to it; -1 with error set otherwise
+        static int openTcp(const std::string &host, int port, bool listening, std::string &error)
+        {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = listening ? AI_PASSIVE : 0;
+            addrinfo *found = nullptr;
+            int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found);
+            if (status != 0) {
+                error = gai_strerror(status);
+                return -1;
+            }
+            int fd = -1;
+            for (addrinfo *at = found; at && fd < 0; at = at->ai_next) {
+                fd = socket(at->ai_family, at->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, at->ai_protocol);
+                if (fd < 0) {
+                    error = strerror(errno);
+                    continue;
+                }
+                bool ok;
+                if (listening) {
+                    int on = 1;
+                    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+                    ok = bind(fd, at->ai_addr, at->ai_addrlen) == 0 && ::listen(fd, SOMAXCONN) == 0;
+                } else {
+                    // Finishes in the reactor once the socket turns writable
+                    ok = ::connect(fd, at->ai_addr, at->ai_addrlen) == 0 || errno == EINPROGRESS;
+                }
+                if (!ok) {
+                    error = strerror(errno);
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+            freeaddrinfo(found);
+            return fd;
+        }
+
+        // A task for an operation on socket, which the task keeps alive until the reactor settles it
+        static PomeTask *socketTask(NativeContext &ctx, const PomeValue &socket)
+        {
+            PomeTask *task = ctx.gc.allocate<PomeTask>(nullptr);
+            task->args.push_back(socket);
+            return task;
+        }
+
+        PomeModule *createNetModule(GarbageCollector &gc)
+        {
+            PomeModule *module = gc.allocate<PomeModule>();
+
+            // listen(port, host): a socket accepting connections on host (127.0.0.1 by default); nil on failure
+            registerFastNative(gc, module, "listen", [](NativeContext &ctx, const PomeValue *args, int argc)
+                               {
+                if (!args[0].isNumber()) return PomeValue(std::monostate{});
+                std::string host = (argc > 1 && args[1].isString()) ? args[1].asString() : "127.0.0.1";
+                std::string error;
+                int fd = openTcp(host, (int)args[0].asNumber(), true, error);
+                if (fd < 0) return PomeValue(std::monostate{});
+                return PomeValue(ctx.gc.allocate<PomeSocket>(fd));
+            }, 1);
+
+            // port(socket): the local port, which tells a listen on port 0 what it was given
+            registerFastNative(gc, module, "port", [](NativeContext &, const PomeValue *args, int)
+                               {
+                PomeSocket *socket = openSocketOf(args[0]);
+                sockaddr_storage address{};
+                socklen_t length = sizeof(address);
+                if (!socket || getsockname(socket->fd(), (sockaddr *)&address, &length) != 0) return PomeValue(std::monostate{});
+                if (address.ss_family == AF_INET6) return PomeValue((double)ntohs(((sockaddr_in6 *)&address)->sin6_port));
+                return PomeValue((double)ntohs(((sockaddr_in *)&address)->sin_port));
+            }, 1);
+
+            // connect(host, port): a task that settles with the connected socket, or fails with the reason
+            registerFastNative(gc, module, "connect", [](NativeContext &ctx, const PomeValue *args, int)
+                               {
+                if (!args[0].isString() || !args[1].isNumber()) return PomeValue(std::monostate{});
+                std::string error;
+                int fd = openTcp(args[0].asString(), (int)args[1].asNumber(), false, error);
+                PomeTask *task = ctx.gc.allocate<PomeTask>(nullptr);
+                RootGuard taskGuard(ctx.gc, task);
+                if (fd < 0) {
+                    task->result = PomeValue(ctx.gc.allocateString(error));
+                    task->state = TaskState::FAILED;
+                    return PomeValue(task);
+                }
+                task->args.push_back(PomeValue(ctx.gc.allocate<PomeSocket>(fd)));
+                ctx.vm->getReactor().connect(task, fd);
+                return PomeValue(task);
+            }, 2);
+
+            // accept(socket): a task that settles with the next connection's socket
+            registerFastNative(gc, module, "accept", [](NativeContext &ctx, const PomeValue *args, int)
+                               {
+                PomeSocket *socket = openSocketOf(args[0]);
+                if (!socket) return PomeValue(std::monostate{});
+                PomeTask *task = socketTask(ctx, args[0]);
+                ctx.vm->getReactor().accept(task, socket->fd());
+                return PomeValue(task);
+            }, 1);
+
+            // read(socket, max): a task that settles with up to max bytes (64 KiB by default); nil once the peer has closed
+            registerFastNative(gc, module, "read", [](NativeContext &ctx, const PomeValue *args, int argc)
+                               {
+                PomeSocket *socket = openSocketOf(args[0]);
+                if (!socket) return PomeValue(std::monostate{});
+                size_t max = 64 * 1024;
+                if (argc > 1 && args[1].isNumber() && args[1].asNumber() >= 1) max = (size_t)args[1].asNumber();
+                PomeTask *task = socketTask(ctx, args[0]);
+                ctx.vm->getReactor().read(task, socket->fd(), max);
+                return PomeValue(task);
+            }, 1);
+
+            // write(socket, text): a task that settles with the bytes written once all of text is sent
+            registerFastNative(gc, module, "write", [](NativeContext &ctx, const PomeValue *args, int)
+                               {
+                PomeSocket *socket = openSocketOf(args[0]);
+                if (!socket) return PomeValue(std::monostate{});
+                std::string text = args[1].toString();
+                PomeTask *task = socketTask(ctx, args[0]);
+                ctx.vm->getReactor().write(task, socket->fd(), std::move(text));
+                return PomeValue(task);
+            }, 2);
+
+            // close(socket): operations still waiting on it fail
+            registerFastNative(gc, module, "close", [](NativeContext &ctx, const PomeValue *args, int)
+                               {
+                PomeSocket *socket = openSocketOf(args[0]);
+                if (!socket) return PomeValue(false);
+                if (ctx.vm->hasPendingIo()) ctx.vm->getReactor().cancel(socket->fd(), "Socket closed.");
+                socket->close();
+                return PomeValue(true);
+            }, 1);
+
+            return module;
+        }
+
+        /**
+         * --- Buffer Module ---
+         */
+        PomeModule *createBufferModule(GarbageCollector &gc)
+        {
+            PomeModule *module = gc.allocate<PomeModule>();
+
+            auto typeArg = [](const std::vector<PomeValue> &args, size_t index, BufferType &type) {
+                if (index >= args.size() || args[index].isNil()) {
+                    type = BufferType::U8;
+                    return true;
+                }
+                return args[index].isString() && PomeBuffer::parseType(args[index].asPomeString()->view(), type);
+            };
+            auto bufferArg = [](const std::vector<PomeValue> &args, size_t index) -> PomeBuffer * {
+                return index < args.size() && args[index].isBuffer() ? args[index].asBuffer() : nullptr;
+            };
+
+            // new(type, count): count zeroed elements on the C heap
+            registerNative(gc, module, "new", [&gc, typeArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                BufferType type;
+                if (!typeArg(args, idx, type) || args.size() <= idx + 1 || !args[idx + 1].isNumber()) return PomeValue();
+                double count = args[idx + 1].asNumber();
+                if (!(count >= 0)) return PomeValue();
+                auto storage = BufferStorage::allocate((size_t)count * PomeBuffer::elementSize(type));
+                if (!storage) return PomeValue();
+                return PomeValue(gc.allocate<PomeBuffer>(std::move(storage), type, 0, (size_t)count, true));
+            });
+
+            // map(path, type, mode): the file's bytes without reading them; "rw" writes back to the file
+            registerNative(gc, module, "map", [&gc, typeArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                BufferType type;
+                if (args.size() <= idx || !args[idx].isString() || !typeArg(args, idx + 1, type)) return PomeValue();
+                bool writable = args.size() > idx + 2 && args[idx + 2].isString() && args[idx + 2].asString() == "rw";
+                auto storage = BufferStorage::map(args[idx].asString(), writable);
+                if (!storage) return PomeValue();
+                size_t count = storage->length / PomeBuffer::elementSize(type); // A partial last element is left out
+                return PomeValue(gc.allocate<PomeBuffer>(std::move(storage), type, 0, count, false));
+            });
+
+            // view(buffer, type, byteOffset, count): the same bytes read as another type
+            registerNative(gc, module, "view", [&gc, typeArg, bufferArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                PomeBuffer *source = bufferArg(args, idx);
+                BufferType type;
+                if (!source || !typeArg(args, idx + 1, type)) return PomeValue();
+                size_t available = source->byteLength();
+                double start = args.size() > idx + 2 && args[idx + 2].isNumber() ? args[idx + 2].asNumber() : 0;
+                if (!(start >= 0) || start > available) return PomeValue();
+                size_t maxCount = (available - (size_t)start) / PomeBuffer::elementSize(type);
+                double count = args.size() > idx + 3 && args[idx + 3].isNumber() ? args[idx + 3].asNumber() : maxCount;
+                if (!(count >= 0) || count > maxCount) return PomeValue();
+                return PomeValue(gc.allocate<PomeBuffer>(source->storage, type, source->offset + (size_t)start,
+                                                         (size_t)count, false));
+            });
+
+            registerNative(gc, module, "from_list", [&gc, typeArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                BufferType type;
+                if (args.size() <= idx || !args[idx].isList() || !typeArg(args, idx + 1, type)) return PomeValue();
+                PomeList *list = args[idx].asList();
+                size_t count = list->size();
+                for (size_t i = 0; i < count; ++i) {
+                    if (!list->at(i).isNumber()) return PomeValue();
+                }
+                auto storage = BufferStorage::allocate(count * PomeBuffer::elementSize(type));
+                if (!storage) return PomeValue();
+                PomeBuffer *buffer = gc.allocate<PomeBuffer>(std::move(storage), type, 0, count, true);
+                for (size_t i = 0; i < count; ++i) buffer->set(i, list->at(i).asNumber());
+                return PomeValue(buffer);
+            });
+
+            registerNative(gc, module, "to_list", [&gc, bufferArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                PomeBuffer *buffer = bufferArg(args, idx);
+                if (!buffer) return PomeValue();
+                PomeList *list = gc.allocateList();
+                size_t oldExtra = list->extraSize();
+                list->listType = buffer->elementType == BufferType::F64 ? ListType::DOUBLE : ListType::INT32;
+                list->ensureCapacity(buffer->count);
+                list->unboxedCount = buffer->count;
+                if (buffer->elementType == BufferType::F64) {
+                    memcpy(list->asDouble(), buffer->data(), buffer->byteLength());
+                } else if (buffer->elementType == BufferType::I32) {
+                    memcpy(list->asInt32(), buffer->data(), buffer->byteLength());
+                } else {
+                    for (size_t i = 0; i < buffer->count; ++i) list->asInt32()[i] = buffer->data()[i];
+                }
+                gc.updateSize(list, sizeof(PomeList) + oldExtra, sizeof(PomeList) + list->extraSize());
+                return PomeValue(list);
+            });
+
+            // to_string(buffer, byteOffset, length): the bytes as a string, whatever the element type
+            registerNative(gc, module, "to_string", [&gc, bufferArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                PomeBuffer *buffer = bufferArg(args, idx);
+                if (!buffer) return PomeValue();
+                size_t available = buffer->byteLength();
+                double start = args.size() > idx + 1 && args[idx + 1].isNumber() ? args[idx + 1].asNumber() : 0;
+                if (!(start >= 0)) start = 0;
+                size_t first = std::min((size_t)start, available);
+                double length = args.size() > idx + 2 && args[idx + 2].isNumber() ? args[idx + 2].asNumber() : available;
+                size_t count = !(length >= 0) ? 0 : std::min((size_t)length, available - first);
+                return PomeValue(gc.allocateString(std::string_view((const char *)buffer->data() + first, count)));
+            });
+
+            registerNative(gc, module, "from_string", [&gc](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                if (args.size() <= idx || !args[idx].isString()) return PomeValue();
+                std::string_view bytes = args[idx].asPomeString()->view();
+                auto storage = BufferStorage::allocate(bytes.size());
+                if (!storage) return PomeValue();
+                memcpy(storage->bytes, bytes.data(), bytes.size());
+                return PomeValue(gc.allocate<PomeBuffer>(std::move(storage), BufferType::U8, 0, bytes.size(), true));
+            });
+
+            // write(buffer, path): replaces the file with the buffer's bytes
+            registerNative(gc, module, "write", [bufferArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                PomeBuffer *buffer = bufferArg(args, idx);
+                if (!buffer || args.size() <= idx + 1 || !args[idx + 1].isString()) return PomeValue(false);
+                std::ofstream file(args[idx + 1].asString(), std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) return PomeValue(false);
+                file.write((const char *)buffer->data(), buffer->byteLength());
+                return PomeValue(file.good());
+            });
+
+            registerNative(gc, module, "type", [&gc, bufferArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                PomeBuffer *buffer = bufferArg(args, idx);
+                if (!buffer) return PomeValue();
+                return PomeValue(gc.allocateString(PomeBuffer::typeName(buffer->elementType)));
+            });
+
+            registerNative(gc, module, "bytes", [bufferArg](const std::vector<PomeValue> &args)
+            {
+                size_t idx = 0;
+                if (!args.empty() && args[0].isModule()) idx++;
+                PomeBuffer *buffer = bufferArg(args, idx);
+                if (!buffer) return PomeValue();
+                return PomeValue((double)buffer->byteLength());
+            });
+
             return module;
         }
 
         /**
          * --- FFI Module ---
          */
+        PomeModule *createJsonModule(GarbageCollector &gc)
+        {
+            PomeModule *module = gc.allocate<PomeModule>();
+
+            // parse(text): the value, or nil when text is not valid JSON
+            registerFastNative(gc, module, "parse", [](NativeContext& ctx, const PomeValue* args, int) {
+                if (!args[0].isString()) return PomeValue();
+                JsonParser parser(ctx.gc);
+                PomeValue result;
+                if (!parser.parse(args[0].asPomeString(), result)) return PomeValue();
+                return result;
+            }, 1);
+
+            // stringify(value, [indent]): the JSON text, or nil when value has no JSON form
+            registerFastNative(gc, module, "stringify", [](NativeContext& ctx, const PomeValue* args, int argc) {
+                static thread_local JsonWriter writer;
+                int indent = argc > 1 && args[1].isNumber() ? static_cast<int>(args[1].asNumber()) : 0;
+                writer.clear();
+                if (!writer.write(args[0], std::min(indent, 16))) return PomeValue();
+                return PomeValue(ctx.gc.allocateString(writer.text()));
+            }, 1);
+
+            return module;
+        }
+
         PomeModule *createFFIModule(GarbageCollector &gc)
         {
             PomeModule *module = gc.allocate<PomeModule>();
@@ -492,68 +1479,54 @@ PomeModule *createThreadingModule(GarbageCollector &gc, ModuleLoader loader)
                     return PomeValue(std::monostate{});
                 }
                 void* addr = ((PomeNativeObject*)args[0].asObject())->ptr;
-                std::string retTypeStr = args[1].toString();
-                
-                ffi_cif cif;
-                ffi_type *types[16];
-                void *values[16];
-                
-                // Storage for different types
-                double d_args[16];
-                int i_args[16];
-                const char* s_args[16];
-                
-                int argCount = 0;
+                // Unknown names keep their old meaning: a void result, double arguments
+                std::string retType = args[1].toString();
+                if (!FfiSignature::isTypeName(retType)) retType = "void";
+
+                std::vector<std::string> argTypes;
+                std::vector<PomeValue> values;
                 if (args[2].isList() && args[3].isList()) {
                     PomeList* typeList = args[2].asList();
                     PomeList* valList = args[3].asList();
-                    argCount = (int)valList->elements.size();
-                    for (int i = 0; i < argCount && i < 16; ++i) {
-                        std::string t = typeList->elements[i].toString();
-                        if (t == "int") {
-                            types[i] = &ffi_type_sint;
-                            i_args[i] = (int)valList->elements[i].asNumber();
-                            values[i] = &i_args[i];
-                        } else if (t == "string") {
-                            types[i] = &ffi_type_pointer;
-                            s_args[i] = valList->elements[i].asString().c_str();
-                            values[i] = &s_args[i];
-                        } else {
-                            types[i] = &ffi_type_double;
-                            d_args[i] = valList->elements[i].asNumber();
-                            values[i] = &d_args[i];
-                        }
+                    size_t argCount = std::min(valList->size(), typeList->size());
+                    for (size_t i = 0; i < argCount; ++i) {
+                        std::string t = typeList->at(i).toString();
+                        argTypes.push_back(FfiSignature::isTypeName(t) && t != "void" ? t : "double");
+                        values.push_back(valList->at(i));
                     }
                 }
 
-                ffi_type* retType = &ffi_type_void;
-                if (retTypeStr == "int") retType = &ffi_type_sint;
-                else if (retTypeStr == "double") retType = &ffi_type_double;
-                else if (retTypeStr == "string") retType = &ffi_type_pointer;
-                
-                if (ffi_prep_cif(&cif, FFI_DEFAULT_ABI, argCount, retType, types) == FFI_OK) {
-                    if (retType == &ffi_type_double) {
-                        double result;
-                        ffi_call(&cif, FFI_FN(addr), &result, values);
-                        return PomeValue(result);
-                    } else if (retType == &ffi_type_sint) {
-                        int result;
-                        ffi_call(&cif, FFI_FN(addr), &result, values);
-                        return PomeValue((double)result);
-                    } else if (retType == &ffi_type_pointer) {
-                        char* result;
-                        ffi_call(&cif, FFI_FN(addr), &result, values);
-                        if (result) return PomeValue(gc.allocateString(result));
-                        return PomeValue(std::monostate{});
-                    } else {
-                        ffi_call(&cif, FFI_FN(addr), nullptr, values);
-                        return PomeValue(std::monostate{});
-                    }
+                std::string error;
+                std::unique_ptr<FfiSignature> signature = FfiSignature::fromNames(retType, argTypes, error);
+                if (!signature) {
+                    std::cerr << "FFI Error: " << error << std::endl;
+                    return PomeValue(std::monostate{});
                 }
-                
-                return PomeValue(std::monostate{});
+                return signature->call(gc, addr, values.data());
             });
 
+            // bind(func, "result(argument, ...)"): a native that calls func through a cif prepared once
+            registerFastNative(gc, module, "bind", [](NativeContext& ctx, const PomeValue* args, int) {
+                if (!args[0].isObject() || args[0].asObject()->type() != ObjectType::NATIVE_OBJECT || !args[1].isString()) {
+                    return PomeValue(std::monostate{});
+                }
+                auto binding = std::make_shared<FfiBinding>();
+                binding->function = static_cast<PomeNativeObject*>(args[0].asObject())->ptr;
+                std::string error;
+                binding->signature = FfiSignature::parse(args[1].asString(), error);
+                if (!binding->signature) {
+                    std::cerr << "FFI Error: " << error << std::endl;
+                    return PomeValue(std::monostate{});
+                }
+                int arity = static_cast<int>(binding->signature->arity());
+                FastNativeFn callBound = [](NativeContext& ctx, const PomeValue* args, int) {
+                    auto* binding = static_cast<FfiBinding*>(ctx.callee->data());
+                    return binding->signature->call(ctx.gc, binding->function, args);
+                };
+                return PomeValue(ctx.gc.allocate<NativeFunction>(args[1].asString(), callBound, arity,
+                                                                 std::shared_ptr<void>(std::move(binding))));
+            }, 2);
+
             return module;
         }
 
@@ -0,0 +1,58 @@
+#include "../include/pome_string_pool.h"
+#include "../include/pome_value.h"
+
+namespace Pome {
+
+    PomeString* StringPool::find(std::string_view value, size_t hash) const {
+        if (slots_.empty()) return nullptr;
+        size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots_[i];
+            if (!slot.str) return nullptr;
+            if (slot.str != TOMBSTONE && slot.hash == hash && slot.str->view() == value) return slot.str;
+        }
+    }
+
+    void StringPool::insert(PomeString* str) {
+        if ((size_ + tombstones_ + 1) * 2 > slots_.size()) grow();
+        size_t hash = str->getHash();
+        size_t mask = slots_.size() - 1;
+        size_t i = hash & mask;
+        while (slots_[i].str && slots_[i].str != TOMBSTONE) i = (i + 1) & mask;
+        if (slots_[i].str == TOMBSTONE) --tombstones_;
+        slots_[i] = {hash, str};
+        ++size_;
+    }
+
+    void StringPool::erase(PomeString* str) {
+        if (slots_.empty()) return;
+        size_t hash = str->getHash();
+        size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask; slots_[i].str; i = (i + 1) & mask) {
+            if (slots_[i].str == str) {
+                slots_[i].str = TOMBSTONE;
+                --size_;
+                ++tombstones_;
+                return;
+            }
+        }
+    }
+
+    void StringPool::grow() {
+        // Rebuilt a quarter full, which also drops the tombstones and shrinks a pool that has emptied out
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < (size_ + 1) * 4) capacity *= 2;
+
+        std::vector<Slot> old(capacity);
+        old.swap(slots_);
+        tombstones_ = 0;
+        size_t mask = capacity - 1;
+        for (const Slot& slot : old) {
+            if (!slot.str || slot.str == TOMBSTONE) continue;
+            size_t i = slot.hash & mask;
+            while (slots_[i].str) i = (i + 1) & mask;
+            slots_[i] = slot;
+        }
+    }
+
+} // namespace Pome
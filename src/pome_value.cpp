@@ -2,11 +2,14 @@
 #include "pome_chunk.h"
 #include "pome_gc.h"
 #include "pome_shape.h"
+#include "pome_simd.h"
 #include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <sstream>
 #include <iomanip>
+#include <cstdio>
+#include <unistd.h>
 
 namespace Pome
 {
@@ -15,6 +18,40 @@ namespace Pome
         : value_(std::move(value)) 
     {
         hash_ = std::hash<std::string>{}(value_);
+        hashed_ = true;
+    }
+
+    PomeString::PomeString(std::string value, size_t hash)
+        : value_(std::move(value)), hash_(hash), hashed_(true)
+    {
+    }
+
+    PomeString::PomeString(std::shared_ptr<std::string> buffer, size_t offset, size_t length, size_t charged)
+        : borrowed_(new Borrowed{std::move(buffer), nullptr, offset, length, charged})
+    {
+    }
+
+    PomeString::PomeString(const PomeString *source, size_t offset, size_t length)
+        : borrowed_(new Borrowed{nullptr, source, offset, length, 0})
+    {
+        if (source->borrowed_)
+        {
+            *borrowed_ = *source->borrowed_;
+            borrowed_->offset += offset;
+            borrowed_->length = length;
+            borrowed_->charged = 0;
+        }
+    }
+
+    void PomeString::markChildren(GarbageCollector &gc)
+    {
+        if (borrowed_ && borrowed_->parent) gc.markObject(const_cast<PomeString *>(borrowed_->parent));
+    }
+
+    void PomeString::flatten() const
+    {
+        value_.assign(view());
+        borrowed_.reset();
     }
 
     // --- PomeValue ---
@@ -82,6 +119,8 @@ namespace Pome
     bool PomeValue::isModule() const { return isObject() && asObject()->type() == ObjectType::MODULE; }
     bool PomeValue::isTask() const { return isObject() && asObject()->type() == ObjectType::TASK; }
     bool PomeValue::isShape() const { return isObject() && asObject()->type() == ObjectType::SHAPE; }
+    bool PomeValue::isBuffer() const { return isObject() && asObject()->type() == ObjectType::BUFFER; }
+    bool PomeValue::isFile() const { return isObject() && asObject()->type() == ObjectType::FILE; }
 
     void PomeShape::markChildren(GarbageCollector& gc) {
         if (parent) gc.markObject(parent);
@@ -93,6 +132,13 @@ namespace Pome
     }
     
     int PomeShape::getIndex(PomeValue key) {
+        ensureIndex();
+        if (index) {
+            auto it = index->find(key);
+            if (it != index->end() && it->second <= propertyIndex) return it->second;
+            return -1;
+        }
+
         PomeShape* current = this;
         while (current && current->parent) {
             if (current->propertyKey == key) return current->propertyIndex;
@@ -101,12 +147,32 @@ namespace Pome
         return -1;
     }
 
+    void PomeShape::buildIndex() {
+        index = std::make_shared<PropertyIndex>();
+        index->reserve(propertyIndex + 1);
+        for (PomeShape* current = this; current && current->parent; current = current->parent) {
+            (*index)[current->propertyKey] = current->propertyIndex;
+        }
+    }
+
+    PomeShape* PomeShape::root() {
+        PomeShape* current = this;
+        while (current->parent) current = current->parent;
+        return current;
+    }
+
     PomeShape* PomeShape::transition(GarbageCollector& gc, PomeValue key) {
         auto it = transitions.find(key);
         if (it != transitions.end()) return it->second;
         
         PomeShape* next = gc.allocate<PomeShape>(this, key, propertyIndex + 1);
+        // The first child to extend the chain inherits the index; siblings build their own
+        if (index && (int)index->size() == propertyIndex + 1) {
+            next->index = index;
+            (*index)[key] = next->propertyIndex;
+        }
         transitions[key] = next;
+        gc.writeBarrier(this, PomeValue(next));
         return next;
     }
 
@@ -121,6 +187,11 @@ namespace Pome
         return static_cast<PomeString*>(asObject())->getValue();
     }
 
+    PomeString* PomeValue::asPomeString() const
+    {
+        return static_cast<PomeString*>(asObject());
+    }
+
     PomeFunction* PomeValue::asPomeFunction() const
     {
         return static_cast<PomeFunction*>(asObject());
@@ -136,6 +207,16 @@ namespace Pome
         return static_cast<PomeList*>(asObject());
     }
 
+    PomeBuffer* PomeValue::asBuffer() const
+    {
+        return static_cast<PomeBuffer*>(asObject());
+    }
+
+    PomeFile* PomeValue::asFile() const
+    {
+        return static_cast<PomeFile*>(asObject());
+    }
+
     PomeTable* PomeValue::asTable() const
     {
         return static_cast<PomeTable*>(asObject());
@@ -180,13 +261,13 @@ namespace Pome
 
     bool PomeValue::operator==(const PomeValue &other) const {
         if (value_ == other.value_) return true;
-        if (isString() && other.isString()) return asObject() == other.asObject();
+        if (isString() && other.isString()) return PomeString::equals(asPomeString(), other.asPomeString());
         return false;
     }
 
     bool PomeValue::operator<(const PomeValue &other) const {
         if (isNumber() && other.isNumber()) return asNumber() < other.asNumber();
-        if (isString() && other.isString()) return asString() < other.asString();
+        if (isString() && other.isString()) return asPomeString()->view() < other.asPomeString()->view();
         return value_ < other.value_;
     }
 
@@ -205,6 +286,11 @@ namespace Pome
     PomeValue PomeValue::deepCopy(GarbageCollector& targetGC, std::map<PomeObject*, PomeObject*>& copiedObjects) const {
         if (!isObject()) return *this;
         PomeObject* obj = asObject();
+        if (obj->frozen) {
+            // Shared, never copied; the target heap keeps it alive from now on
+            targetGC.retainFrozen(obj);
+            return *this;
+        }
         if (copiedObjects.count(obj)) return PomeValue(copiedObjects[obj]);
 
         if (isString()) {
@@ -220,7 +306,7 @@ namespace Pome
                 newList->listType = oldList->listType;
                 newList->unboxedCount = oldList->unboxedCount;
                 newList->unboxedCapacity = oldList->unboxedCount;
-                size_t elementSize = (newList->listType == ListType::DOUBLE) ? sizeof(double) : sizeof(int32_t);
+                size_t elementSize = PomeList::elementSize(newList->listType);
                 newList->unboxedData = malloc(newList->unboxedCount * elementSize);
                 memcpy(newList->unboxedData, oldList->unboxedData, newList->unboxedCount * elementSize);
             } else {
@@ -243,11 +329,28 @@ namespace Pome
                 newTable->set(targetGC, chain[i]->propertyKey.deepCopy(targetGC, copiedObjects), 
                                oldTable->properties[chain[i]->propertyIndex].deepCopy(targetGC, copiedObjects));
             }
+            for (size_t i = 0; i < oldTable->array.size(); ++i) {
+                if (oldTable->array[i].isNil()) continue;
+                newTable->set(targetGC, PomeValue(static_cast<double>(i)), oldTable->array[i].deepCopy(targetGC, copiedObjects));
+            }
             for (auto const& [key, val] : oldTable->backfill) {
                 newTable->set(targetGC, key.deepCopy(targetGC, copiedObjects), val.deepCopy(targetGC, copiedObjects));
             }
             return PomeValue(newTable);
         }
+        if (isBuffer()) {
+            // The copy shares the bytes rather than duplicating them; only the original charges its heap for them
+            PomeBuffer* oldBuffer = asBuffer();
+            PomeBuffer* newBuffer = targetGC.allocate<PomeBuffer>(oldBuffer->storage, oldBuffer->elementType,
+                                                                  oldBuffer->offset, oldBuffer->count, false);
+            copiedObjects[obj] = newBuffer;
+            return PomeValue(newBuffer);
+        }
+        if (obj->type() == ObjectType::CHANNEL) {
+            PomeChannel* newChannel = targetGC.allocate<PomeChannel>(static_cast<PomeChannel*>(obj)->channel);
+            copiedObjects[obj] = newChannel;
+            return PomeValue(newChannel);
+        }
         return *this;
     }
 
@@ -258,14 +361,14 @@ namespace Pome
     void PomeValue::incRef() const {
         if (isObject()) {
             PomeObject* obj = asObject();
-            if (obj) obj->refCount++;
+            if (obj && !obj->frozen) obj->refCount++;
         }
     }
 
     void PomeValue::decRef(GarbageCollector& gc) const {
         if (isObject()) {
             PomeObject* obj = asObject();
-            if (obj) {
+            if (obj && !obj->frozen) {
                 if (obj->refCount > 0) obj->refCount--;
                 if (obj->refCount == 0) {
                     gc.addToZCT(obj);
@@ -275,7 +378,7 @@ namespace Pome
     }
 
     size_t PomeValue::hash() const {
-        if (isString()) return ((PomeString*)asObject())->getHash();
+        if (isString()) return asPomeString()->getHash();
         return std::hash<uint64_t>{}(value_);
     }
 
@@ -283,9 +386,40 @@ namespace Pome
         return function_(args);
     }
 
+    PomeValue NativeFunction::call(NativeContext &ctx, const PomeValue *args, int argc) {
+        if (fast_) {
+            ctx.callee = this;
+            return fast_(ctx, args, argc);
+        }
+        return function_(std::vector<PomeValue>(args, args + argc));
+    }
+
     PomeTable::PomeTable(PomeShape* s) : shape(s) {}
 
     void PomeTable::set(GarbageCollector& gc, PomeValue key, PomeValue value) {
+        size_t slot;
+        bool isArrayKey = arrayIndex(key, slot);
+        if (isArrayKey) {
+            if (slot < array.size()) {
+                setArraySlot(gc, slot, value);
+                return;
+            }
+            if (slot == array.size() && !value.isNil()) {
+                // Appending keeps the array dense; pull in any keys that now follow it
+                auto it = backfill.find(key);
+                if (it != backfill.end()) {
+                    it->second.decRef(gc);
+                    backfill.erase(it);
+                    hashIntKeys--;
+                }
+                array.push_back(value);
+                value.incRef();
+                arrayCount++;
+                migrateFromBackfill();
+                return;
+            }
+        }
+
         int index = shape ? shape->getIndex(key) : -1;
         if (index >= 0) {
             gc.rcWriteBarrier(&properties[index], value);
@@ -297,11 +431,114 @@ namespace Pome
                 backfill[key] = value;
                 key.incRef();
                 value.incRef();
+                gc.writeBarrier(this, key);
+                if (isArrayKey && ++hashIntKeys >= rehashAt) rehashArray();
+            }
+        }
+    }
+
+    void PomeTable::setArraySlot(GarbageCollector& gc, size_t index, PomeValue value) {
+        PomeValue& current = array[index];
+        if (current.isNil() != value.isNil()) {
+            if (value.isNil()) arrayCount--;
+            else arrayCount++;
+        }
+        gc.rcWriteBarrier(&current, value);
+    }
+
+    void PomeTable::migrateFromBackfill() {
+        while (hashIntKeys > 0) {
+            auto it = backfill.find(PomeValue(static_cast<double>(array.size())));
+            if (it == backfill.end()) break;
+            // The value's reference moves with it; numeric keys hold none
+            array.push_back(it->second);
+            if (!it->second.isNil()) arrayCount++;
+            backfill.erase(it);
+            hashIntKeys--;
+        }
+    }
+
+    void PomeTable::rehashArray() {
+        // Lua's rule: pick the largest power of two n such that more than n/2
+        // of the integer keys below n are present. bins[i] counts keys in [2^(i-1), 2^i).
+        size_t bins[33] = {0};
+        auto binOf = [](size_t key) {
+            size_t b = 0;
+            while ((size_t(1) << b) <= key) b++;
+            return b;
+        };
+        for (size_t i = 0; i < array.size(); ++i) {
+            if (!array[i].isNil()) bins[binOf(i)]++;
+        }
+        for (auto const& [key, val] : backfill) {
+            size_t slot;
+            if (arrayIndex(key, slot)) bins[binOf(slot)]++;
+        }
+
+        size_t total = 0, bestSize = array.size();
+        for (size_t b = 0; b < 33; ++b) {
+            total += bins[b];
+            size_t size = size_t(1) << b;
+            if (total > size / 2 && size > bestSize) bestSize = size;
+        }
+
+        if (bestSize > array.size()) {
+            array.resize(bestSize);
+            for (auto it = backfill.begin(); it != backfill.end(); ) {
+                size_t slot;
+                if (arrayIndex(it->first, slot) && slot < bestSize) {
+                    array[slot] = it->second;
+                    if (!it->second.isNil()) arrayCount++;
+                    hashIntKeys--;
+                    it = backfill.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        rehashAt = std::max<size_t>(4, hashIntKeys * 2);
+    }
+
+    void PomeTable::setField(GarbageCollector& gc, PomeValue key, PomeValue value) {
+        int index = shape ? shape->getIndex(key) : -1;
+        if (index >= 0) {
+            if (index >= (int)properties.size()) properties.resize(index + 1);
+            gc.rcWriteBarrier(&properties[index], value);
+            return;
+        }
+
+        if (!isDictionary && shape && !backfill.count(key)) {
+            // Follow existing transitions; only mint new shapes while the tree stays small.
+            // The root is exempt from the fan-out limit since every first key hangs off it.
+            bool known = shape->transitions.count(key) > 0;
+            if (known || (shape->propertyIndex + 1 < PomeShape::MAX_TABLE_PROPERTIES &&
+                          (!shape->parent || shape->transitions.size() < PomeShape::MAX_TABLE_TRANSITIONS))) {
+                shape = shape->transition(gc, key);
+                properties.push_back(value);
+                value.incRef();
+                return;
             }
+            enterDictionaryMode();
         }
+        set(gc, key, value);
+    }
+
+    void PomeTable::enterDictionaryMode() {
+        // Shaped slots move into backfill; the values keep their references
+        for (PomeShape* s = shape; s && s->parent; s = s->parent) {
+            if (s->propertyIndex < (int)properties.size()) {
+                backfill[s->propertyKey] = properties[s->propertyIndex];
+                s->propertyKey.incRef();
+            }
+        }
+        properties.clear();
+        properties.shrink_to_fit();
+        shape = shape->root();
+        isDictionary = true;
     }
 
     PomeValue PomeTable::get(PomeValue key) {
+        if (PomeValue* slot = arraySlot(key)) return *slot;
         int index = shape ? shape->getIndex(key) : -1;
         if (index >= 0) return properties[index];
         auto it = backfill.find(key);
@@ -328,6 +565,9 @@ namespace Pome
 
     std::vector<PomeValue> PomeTable::getSortedKeys() const {
         std::vector<PomeValue> keys;
+        for (size_t i = 0; i < array.size(); ++i) {
+            if (!array[i].isNil()) keys.push_back(PomeValue(static_cast<double>(i)));
+        }
         PomeShape* s = shape;
         while (s && s->parent) {
             keys.push_back(s->propertyKey);
@@ -344,6 +584,13 @@ namespace Pome
         std::string res = "{";
         bool first = true;
         
+        for (size_t i = 0; i < array.size(); ++i) {
+            if (array[i].isNil()) continue;
+            if (!first) res += ", ";
+            res += PomeValue(static_cast<double>(i)).toString() + ": " + array[i].toString();
+            first = false;
+        }
+
         PomeShape* current = shape;
         std::vector<PomeShape*> chain;
         while (current && current->parent) {
@@ -381,40 +628,64 @@ namespace Pome
     PomeList::PomeList(std::vector<PomeValue> elems) : elements(std::move(elems)) {}
 
     size_t PomeList::extraSize() const {
-        size_t size = elements.capacity() * sizeof(PomeValue);
-        if (listType == ListType::DOUBLE) size += unboxedCapacity * sizeof(double);
-        else if (listType == ListType::INT32) size += unboxedCapacity * sizeof(int32_t);
-        return size;
+        return elements.capacity() * sizeof(PomeValue) + unboxedCapacity * elementSize(listType);
     }
 
-    std::string PomeList::toString() const {
-        std::string res = "[";
+    size_t PomeList::elementSize(ListType type) {
+        switch (type) {
+            case ListType::DOUBLE: return sizeof(double);
+            case ListType::INT32: return sizeof(int32_t);
+            case ListType::BOOL: return sizeof(uint8_t);
+            case ListType::MIXED: break;
+        }
+        return 0;
+    }
+
+    PomeValue PomeList::at(size_t i) const {
+        switch (listType) {
+            case ListType::DOUBLE: return PomeValue(asDouble()[i]);
+            case ListType::INT32: return PomeValue((double)asInt32()[i]);
+            case ListType::BOOL: return PomeValue(asBool()[i] != 0);
+            case ListType::MIXED: break;
+        }
+        return elements[i];
+    }
+
+    double PomeList::sum() const {
+        if (listType == ListType::DOUBLE) return Simd::sum(asDouble(), unboxedCount);
+        if (listType == ListType::INT32) return Simd::sum(asInt32(), unboxedCount);
+        double total = 0;
+        for (auto& val : elements) {
+            if (val.isNumber()) total += val.asNumber();
+        }
+        return total;
+    }
+
+    void PomeList::addScalar(double scalar) {
+        if (listType == ListType::INT32 && unboxedCount > 0) {
+            // Widen when the scalar or any sum leaves int32, rather than let the kernel wrap
+            double low = Simd::min(asInt32(), unboxedCount) + scalar;
+            double high = Simd::max(asInt32(), unboxedCount) + scalar;
+            bool whole = scalar == std::floor(scalar) && scalar >= INT32_MIN && scalar <= INT32_MAX;
+            if (!whole || low < INT32_MIN || high > INT32_MAX) switchTo(ListType::DOUBLE);
+        }
         if (listType == ListType::DOUBLE) {
-            double* data = asDouble();
-            for (size_t i = 0; i < unboxedCount; ++i) {
-                if (i > 0) res += ", ";
-                double d = data[i];
-                if (d == (long long)d) res += std::to_string((long long)d);
-                else {
-                    std::ostringstream ss;
-                    ss << std::fixed << std::setprecision(6) << d;
-                    std::string s = ss.str();
-                    s.erase(s.find_last_not_of('0') + 1, std::string::npos);
-                    if (!s.empty() && s.back() == '.') s.pop_back();
-                    res += s;
-                }
-            }
+            Simd::addScalar(asDouble(), unboxedCount, scalar);
         } else if (listType == ListType::INT32) {
-            int32_t* data = asInt32();
-            for (size_t i = 0; i < unboxedCount; ++i) {
-                if (i > 0) res += ", ";
-                res += std::to_string(data[i]);
-            }
-        } else {
-            for (size_t i = 0; i < elements.size(); ++i) {
-                if (i > 0) res += ", ";
-                res += elements[i].toString();
+            Simd::addScalar(asInt32(), unboxedCount, (int32_t)scalar);
+        } else if (listType == ListType::MIXED) {
+            for (auto& val : elements) {
+                if (val.isNumber()) val = PomeValue(val.asNumber() + scalar);
             }
+            tryUnbox();
+        }
+    }
+
+    std::string PomeList::toString() const {
+        std::string res = "[";
+        for (size_t i = 0; i < size(); ++i) {
+            if (i > 0) res += ", ";
+            res += at(i).toString();
         }
         res += "]";
         return res;
@@ -442,6 +713,21 @@ namespace Pome
     void PomeList::tryUnbox() {
         if (isUnboxed() || elements.empty()) return;
 
+        if (elements.front().isBool()) {
+            for (const auto& v : elements) {
+                if (!v.isBool()) return;
+            }
+            listType = ListType::BOOL;
+            unboxedCapacity = elements.size();
+            unboxedCount = elements.size();
+            unboxedData = malloc(unboxedCapacity);
+            uint8_t* data = asBool();
+            for (size_t i = 0; i < unboxedCount; ++i) data[i] = elements[i].isTrue();
+            elements.clear();
+            elements.shrink_to_fit();
+            return;
+        }
+
         bool allInt = true;
         for (const auto& v : elements) {
             if (!v.isNumber()) return;
@@ -473,13 +759,7 @@ namespace Pome
         if (!isUnboxed()) return;
 
         elements.reserve(unboxedCount);
-        if (listType == ListType::DOUBLE) {
-            double* data = asDouble();
-            for (size_t i = 0; i < unboxedCount; ++i) elements.push_back(PomeValue(data[i]));
-        } else if (listType == ListType::INT32) {
-            int32_t* data = asInt32();
-            for (size_t i = 0; i < unboxedCount; ++i) elements.push_back(PomeValue((double)data[i]));
-        }
+        for (size_t i = 0; i < unboxedCount; ++i) elements.push_back(at(i));
 
         if (unboxedData) free(unboxedData);
         unboxedData = nullptr;
@@ -491,8 +771,7 @@ namespace Pome
     void PomeList::ensureCapacity(size_t capacity) {
         if (isUnboxed()) {
             if (capacity > unboxedCapacity) {
-                size_t elementSize = (listType == ListType::DOUBLE) ? sizeof(double) : sizeof(int32_t);
-                unboxedData = realloc(unboxedData, capacity * elementSize);
+                unboxedData = realloc(unboxedData, capacity * elementSize(listType));
                 unboxedCapacity = capacity;
             }
         } else {
@@ -527,15 +806,64 @@ namespace Pome
                 elements.push_back(val);
                 val.incRef();
             }
+        } else if (listType == ListType::BOOL) {
+            if (val.isBool()) {
+                if (unboxedCount >= unboxedCapacity) ensureCapacity(unboxedCapacity == 0 ? 8 : unboxedCapacity * 2);
+                asBool()[unboxedCount++] = val.isTrue();
+            } else {
+                box();
+                elements.push_back(val);
+                val.incRef();
+            }
+        } else if (elements.empty() && (val.isBool() || val.isNumber())) {
+            // A list built by pushing flags or numbers starts out unboxed
+            if (val.isBool()) listType = ListType::BOOL;
+            else listType = val.asNumber() == (int32_t)val.asNumber() ? ListType::INT32 : ListType::DOUBLE;
+            push(gc, val);
         } else {
             elements.push_back(val);
             val.incRef();
         }
     }
 
+    PomeFile::PomeFile(FILE* handle, std::string p, bool autoClose)
+        : path(std::move(p)), closeAtEnd(autoClose), handle_(handle) {
+        if (handle_) setvbuf(handle_, nullptr, _IOFBF, BUFFER_SIZE);
+    }
+
+    PomeFile::~PomeFile() {
+        close();
+        free(line_);
+    }
+
+    bool PomeFile::readLine(std::string_view& line) {
+        if (!handle_) return false;
+        ssize_t length = getline(&line_, &lineCapacity_, handle_);
+        if (length < 0) return false;
+        if (length > 0 && line_[length - 1] == '\n') --length;
+        if (length > 0 && line_[length - 1] == '\r') --length;
+        line = std::string_view(line_, static_cast<size_t>(length));
+        return true;
+    }
+
+    void PomeFile::close() {
+        if (handle_) fclose(handle_);
+        handle_ = nullptr;
+    }
+
+    PomeSocket::~PomeSocket() {
+        close();
+    }
+
+    void PomeSocket::close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
     void PomeTable::markChildren(GarbageCollector& gc) {
         if (shape) gc.markObject(shape);
         for (auto& val : properties) val.mark(gc);
+        for (auto& val : array) val.mark(gc);
         for (auto const& [key, val] : backfill) {
             key.mark(gc);
             val.mark(gc);
@@ -580,6 +908,7 @@ namespace Pome
             for (auto& val : chunk->constants) {
                 val.mark(gc);
             }
+            chunk->markCaches(gc);
         }
     }
 
@@ -588,20 +917,12 @@ namespace Pome
             key.mark(gc); 
             val.mark(gc); 
         }
-        for (auto const& [key, val] : variables) {
-            key.mark(gc); 
-            val.mark(gc); 
-        }
+        variables.mark(gc);
     }
 
     void PomeThread::markChildren(GarbageCollector& gc) {
         result.mark(gc);
     }
 
-    void PomeTask::markChildren(GarbageCollector& gc) {
-        if (function) gc.markObject(function);
-        for (auto& arg : args) arg.mark(gc);
-        result.mark(gc);
-    }
 
 } // namespace Pome
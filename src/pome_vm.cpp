@@ -6,25 +6,53 @@
 #include <dlfcn.h>
 #include "pome_stdlib.h"
 #include "pome_shape.h"
+#include "pome_profiler.h"
+#include "pome_pool.h"
+#include "pome_reactor.h"
 
 namespace Pome {
 
 
 
+    static void markFrames(GarbageCollector& gc, const CallFrame* frames, int count);
+
     VM::VM(GarbageCollector& gc, ModuleLoader loader) 
-        : gc(gc), moduleLoader(loader), frameCount(0), stack(65536) {
-        stackTop = 0;
+        : gc(gc), moduleLoader(loader), frameCount(0), stack(INITIAL_STACK), frames(INITIAL_FRAMES) {
+        stackTop = stack.begin();
         rootShape = gc.allocate<PomeShape>(nullptr, PomeValue(), -1);
     }
 
-    VM::~VM() {}
+    VM::~VM() {
+        // Workers may still be running functions that live in this VM's heap
+        for (PomeTask* task : jobTasks) {
+            IsolatePool& pool = IsolatePool::instance();
+            while (true) {
+                uint64_t seen = pool.completedCount();
+                if (task->job->done.load(std::memory_order_acquire)) break;
+                pool.waitForCompletion(seen);
+            }
+        }
+    }
 
-    void VM::runtimeError(const std::string& message) {
-        if (handlers.empty()) {
+    // Saved ips point past the instruction that threw or, below the top, past the CALL
+    static uint32_t throwPc(const CallFrame& frame) {
+        return static_cast<uint32_t>(frame.ip - frame.chunk->code.data() - 1);
+    }
+
+    PomeValue VM::errorValue(const std::string& message) {
+        if (!canCatch()) {
+            StdLib::flushOutput(); // Keep the error after everything printed before it
             std::cerr << "Runtime Error: " << message << std::endl;
             for (int i = frameCount - 1; i >= 0; --i) {
+                // A deep stack shows its innermost and outermost frames
+                if (i == frameCount - 1 - TRACE_EDGE_FRAMES && i >= TRACE_EDGE_FRAMES) {
+                    std::cerr << "  ... " << (i - TRACE_EDGE_FRAMES + 1) << " more frames" << std::endl;
+                    i = TRACE_EDGE_FRAMES - 1;
+                }
                 CallFrame* frame = &frames[i];
-                int line = frame->chunk->lines[frame->ip - frame->chunk->code.data() - 1];
+                int line = frame->chunk->forEachInlinedCall(throwPc(*frame), [](const InlinedCall& call, int at) {
+                    std::cerr << "  at [line " << at << "] in " << call.name << std::endl;
+                });
                 std::cerr << "  at [line " << line << "] in ";
                 if (frame->function) std::cerr << frame->function->name;
                 else std::cerr << "script";
@@ -32,19 +60,48 @@ namespace Pome {
             }
         }
         // Construct exception object
-        PomeString* msgStr = gc.allocateString(message);
-        throw VMException{PomeValue(msgStr)};
+        return PomeValue(gc.allocateString(message));
+    }
+
+    void VM::runtimeError(const std::string& message) {
+        throw VMException{errorValue(message)};
     }
 
     void VM::throwException(PomeValue value) {
         throw VMException{value};
     }
 
-    PomeUpvalue* VM::captureUpvalue(PomeValue* local) {
+    bool VM::canCatch() const {
+        for (int i = frameCount - 1; i >= 0; --i) {
+            if (frames[i].chunk->findHandler(throwPc(frames[i]))) return true;
+        }
+        return false;
+    }
+
+    bool VM::unwind(PomeValue exception, int initialFrameIdx) {
+        for (int i = frameCount - 1; i >= initialFrameIdx; --i) {
+            CallFrame& frame = frames[i];
+            const ExceptionRange* range = frame.chunk->findHandler(throwPc(frame));
+            if (!range) continue;
+            if (frameCount > i + 1) {
+                closeUpvalues(frames[i + 1].base, frames[i + 1].segment);
+            }
+            frameCount = i + 1;
+            frame.ip = frame.chunk->code.data() + range->target;
+            pendingException = exception;
+            return true;
+        }
+        return false;
+    }
+
+    // Open upvalues are kept deepest-first. Segments sit at arbitrary
+    // addresses, so "deeper" is decided by RegisterStack, not by raw pointers.
+    PomeUpvalue* VM::captureUpvalue(PomeValue* local, int segment) {
         PomeUpvalue* prevUpvalue = nullptr;
         PomeUpvalue* upvalue = openUpvalues;
 
-        while (upvalue != nullptr && upvalue->location > local) {
+        while (upvalue != nullptr && upvalue->location != local &&
+               stack.isAbove(upvalue->location, local, segment)) {
             prevUpvalue = upvalue;
             upvalue = upvalue->next;
         }
@@ -65,43 +122,156 @@ namespace Pome {
         return createdUpvalue;
     }
 
-    void VM::closeUpvalues(PomeValue* last) {
-        while (openUpvalues != nullptr && openUpvalues->location >= last) {
+    void VM::closeUpvalues(PomeValue* last, int segment) {
+        while (openUpvalues != nullptr && stack.isAbove(openUpvalues->location, last, segment)) {
             PomeUpvalue* upvalue = openUpvalues;
             upvalue->closedValue = *upvalue->location;
             upvalue->closedValue.incRef();
             upvalue->location = &upvalue->closedValue;
+            gc.writeBarrier(upvalue, upvalue->closedValue);
             openUpvalues = upvalue->next;
         }
     }
 
+    bool VM::addFieldCacheEntry(InstructionMetadata& meta, const FieldCacheEntry& entry) {
+        if (meta.fieldState == CacheState::MEGAMORPHIC) return false;
+
+        for (int i = 0; i < meta.fieldCount; ++i) {
+            const FieldCacheEntry& existing = meta.fields[i];
+            if (existing.shape == entry.shape && existing.klass == entry.klass &&
+                existing.method == entry.method && existing.index == entry.index) {
+                return true;
+            }
+        }
+
+        if (meta.fieldCount == InstructionMetadata::MAX_FIELD_ENTRIES) {
+            // Too many receiver kinds: leave the site on the generic path for good
+            meta.fieldState = CacheState::MEGAMORPHIC;
+            meta.fieldCount = 0;
+            icStats.polymorphic--;
+            icStats.megamorphic++;
+            return false;
+        }
+
+        meta.fields[meta.fieldCount++] = entry;
+        gc.shade(entry.shape);
+        gc.shade(entry.klass);
+        gc.shade(entry.method);
+        if (meta.fieldState == CacheState::UNINITIALIZED) {
+            meta.fieldState = CacheState::MONOMORPHIC;
+            icStats.monomorphic++;
+        } else if (meta.fieldState == CacheState::MONOMORPHIC) {
+            meta.fieldState = CacheState::POLYMORPHIC;
+            icStats.monomorphic--;
+            icStats.polymorphic++;
+        }
+        return true;
+    }
+
     void VM::registerNative(const std::string& name, NativeFn fn) {
         PomeString* nameStr = gc.allocateString(name);
         RootGuard guard(gc, nameStr);
         NativeFunction* native = gc.allocate<NativeFunction>(name, fn);
-        gc.rcMapSet(globals, PomeValue(nameStr), PomeValue(native));
+        GlobalCell* cell = globals.intern(PomeValue(nameStr));
+        gc.rcWriteBarrier(&cell->value, PomeValue(native));
+        cell->defined = true;
+    }
+
+    void VM::registerFastNative(const std::string& name, FastNativeFn fn, int arity, NativeIntrinsic intrinsic) {
+        PomeString* nameStr = gc.allocateString(name);
+        RootGuard guard(gc, nameStr);
+        NativeFunction* native = gc.allocate<NativeFunction>(name, fn, arity, intrinsic);
+        GlobalCell* cell = globals.intern(PomeValue(nameStr));
+        gc.rcWriteBarrier(&cell->value, PomeValue(native));
+        cell->defined = true;
     }
 
     void VM::registerGlobal(const std::string& name, PomeValue value) {
         PomeString* nameStr = gc.allocateString(name);
-        gc.rcMapSet(globals, PomeValue(nameStr), value);
+        GlobalCell* cell = globals.intern(PomeValue(nameStr));
+        gc.rcWriteBarrier(&cell->value, value);
+        cell->defined = true;
     }
 
-    void VM::markRoots() {
-        for (int i = 0; i < stackTop; ++i) {
-            stack[i].mark(gc);
+    GlobalLink& VM::foreignGlobalLink(Chunk& chunk, const Instruction* pc) {
+        uint32_t owner = 0;
+        if (chunk.globalOwner.compare_exchange_strong(owner, gc.getHeapId(), std::memory_order_relaxed)) {
+            return chunk.cacheFor(pc).global;
+        }
+        // Shared with the VM that owns it: its metadata is never touched from here
+        ForeignLinks& foreign = foreignLinks[&chunk];
+        if (foreign.serial != chunk.serial) {
+            foreign.serial = chunk.serial;
+            foreign.links.assign(chunk.inlineCaches.size(), GlobalLink());
+        }
+        return foreign.links[chunk.cacheSlots[pc - chunk.code.data()]];
+    }
+
+    void VM::linkGlobal(GlobalLink& link, const PomeValue& key) {
+        // Interning reserves the module cell up front, so a later top-level
+        // definition is seen by sites already linked to the VM global
+        link.moduleCell = currentModule ? currentModule->variables.intern(key) : nullptr;
+        link.globalCell = globals.intern(key);
+        link.module = currentModule;
+    }
+
+    bool VM::tierUp(Chunk& chunk) {
+        if (chunk.jitCode) return true;
+        if (chunk.jitFailed || ++chunk.hotness < Jit::HOT_THRESHOLD) return false;
+        chunk.jitCode = Jit::compile(chunk);
+        if (!chunk.jitCode) {
+            chunk.jitFailed = true;
+            jitStats.failed++;
+            return false;
+        }
+        jitStats.compiled++;
+        jitStats.codeBytes += chunk.jitCode->size();
+        return true;
+    }
+
+    uint32_t* VM::runJit(CallFrame* frame) {
+        Chunk* chunk = frame->chunk;
+        std::shared_ptr<JitCode> code = chunk->jitCode; // A discard below must not free running code
+        uint32_t* start = chunk->code.data();
+        JitFrame jit{frame->base, this, frame, chunk, nullptr};
+        jitStats.entries++;
+        uint32_t exit = code->run(jit, (uint32_t)(frame->ip - start));
+
+        frame->ip = start + (exit & JitCode::PC_MASK);
+        switch (exit >> JitCode::EXIT_SHIFT) {
+            case JitCode::EXIT_GUARD:
+                jitStats.guardExits++;
+                // Types keep changing under this chunk: deopt to the interpreter for good
+                if (++code->guardExits >= Jit::MAX_GUARD_EXITS) {
+                    chunk->jitCode.reset();
+                    chunk->jitFailed = true;
+                    jitStats.discarded++;
+                }
+                break;
+            case JitCode::EXIT_THROW:
+                frame->ip++; // As if the interpreter had been running the CALL
+                std::rethrow_exception(jit.error);
+            default:
+                break;
         }
+        return frame->ip;
+    }
+
+    void VM::markRoots() {
+        stack.mark(gc, frames.data(), frameCount);
         for (auto& arg : args) {
             arg.mark(gc);
         }
-        for (auto const& [key, val] : globals) {
-            key.mark(gc);
-            val.mark(gc);
-        }
+        globals.mark(gc);
         for (auto const& [key, val] : moduleCache) {
             val.mark(gc);
         }
         if (currentModule) gc.markObject(currentModule);
+        for (auto& [chunk, foreign] : foreignLinks) {
+            for (const GlobalLink& link : foreign.links) {
+                if (link.module) gc.markObject(link.module);
+            }
+        }
         pendingException.mark(gc);
         
         if (rootShape) gc.markObject(rootShape);
@@ -115,24 +285,22 @@ namespace Pome {
             upvalue = upvalue->next;
         }
 
-        for (int i = 0; i < frameCount; ++i) {
-            if (frames[i].function) gc.markObject(frames[i].function);
-            if (frames[i].task) gc.markObject(frames[i].task);
-            if (frames[i].chunk) {
-                for (auto& val : frames[i].chunk->constants) {
-                    val.mark(gc);
-                }
-                for (auto& [offset, meta] : frames[i].chunk->metadata) {
-                    if (meta.globalCacheValid) meta.globalCache.mark(gc);
-                    if (meta.objectCache) gc.markObject(meta.objectCache);
-                    if (meta.klassCache) gc.markObject(meta.klassCache);
-                }
-            }
-        }
+        markFrames(gc, frames.data(), frameCount);
 
         for (auto* task : taskQueue) {
             gc.markObject(task);
         }
+        for (auto* task : suspendedTasks) {
+            gc.markObject(task);
+        }
+        for (auto* task : jobTasks) {
+            gc.markObject(task);
+        }
+        if (reactor) reactor->markTasks(gc);
+        for (auto* ctx : parkedContexts) {
+            ctx->mark(gc);
+        }
+        if (activeTask) gc.markObject(activeTask);
     }
 
 #ifdef __GNUC__
@@ -146,20 +314,84 @@ namespace Pome {
         RootGuard moduleGuard(gc, module);
 
         int initialFrameIdx = frameCount;
-        if (frameCount >= 8192) runtimeError("Stack overflow");
-        
-        CallFrame* frame = &frames[frameCount++];
+        int segment = frameCount > 0 ? frames[frameCount - 1].segment : 0;
+        if (frameCount == 0) stackTop = stack.begin();
+        CallFrame* frame = pushFrameAt(stackTop, segment, 0);
         frame->function = nullptr;
         frame->module = module ? module : currentModule;
         frame->chunk = chunk;
         frame->ip = chunk->code.data();
-        frame->base = stackTop;
         frame->destReg = 0;
-        
+        frame->task = nullptr;
+
+        // Kept out of execute(): resuming thousands of tasks must not rescan the ZCT each time
+        gc.processZCT();
+        return execute(initialFrameIdx);
+    }
+
+    PomeValue VM::call(PomeFunction* function, const std::vector<PomeValue>& args) {
+        hasError = false;
+        RootGuard functionGuard(gc, function);
+
+        int initialFrameIdx = frameCount;
+        int segment = frameCount > 0 ? frames[frameCount - 1].segment : 0;
+        if (frameCount == 0) stackTop = stack.begin();
+        CallFrame* frame = pushFrameAt(stackTop, segment, 0);
+        int argc = std::min<int>((int)args.size(), (int)RegisterStack::FRAME_WINDOW - 1);
+        frame->base[0] = PomeValue(function);
+        for (int i = 0; i < argc; ++i) {
+            frame->base[i + 1] = args[i];
+        }
+        // Missing parameters are nil, not whatever an earlier call left behind
+        int maxRegs = std::min<int>(function->chunk->maxRegisters, (int)RegisterStack::FRAME_WINDOW);
+        for (int i = argc + 1; i < maxRegs; ++i) {
+            frame->base[i] = PomeValue();
+        }
+        frame->function = function;
+        frame->module = function->module;
+        frame->chunk = function->chunk.get();
+        frame->ip = function->chunk->code.data();
+        frame->destReg = -1;
+        frame->task = nullptr;
+        return execute(initialFrameIdx);
+    }
+
+    // Runs frames above initialFrameIdx until they return, or until the active
+    // task suspends in AWAIT, which leaves its frames in place for resumeTask.
+    PomeValue VM::execute(int initialFrameIdx) {
+        struct DepthGuard {
+            int& depth;
+            explicit DepthGuard(int& d) : depth(d) { ++depth; }
+            ~DepthGuard() { --depth; }
+        } depthGuard(executeDepth);
+
+        // THROW and the interpreter's own errors unwind inside run(). Only a native
+        // (or a nested execute() it started) reaches here, through a C++ exception.
+        while (true) {
+            try {
+                return run(initialFrameIdx);
+            } catch (VMException& e) {
+                if (unwind(e.value, initialFrameIdx)) {
+                    hasError = false;
+                    continue;
+                }
+                hasError = true;
+                pendingException = e.value;
+                if (frameCount > initialFrameIdx) {
+                    closeUpvalues(frames[initialFrameIdx].base, frames[initialFrameIdx].segment);
+                }
+                frameCount = initialFrameIdx;
+                throw;
+            }
+        }
+    }
+
+    PomeValue VM::run(int initialFrameIdx) {
+        const bool useJit = jitEnabled && !profiler;
+
         CallFrame* currentFrame;
         PomeValue* K;
         uint32_t* ip;
-        int frameBase;
         PomeValue* R; 
         
         
@@ -171,30 +403,32 @@ namespace Pome {
             currentFrame = &frames[frameCount - 1]; \
             K = currentFrame->chunk->constants.data(); \
             ip = currentFrame->ip; \
-            frameBase = currentFrame->base; \
             currentModule = currentFrame->module; \
-            if (frameBase + 512 >= (int)stack.size()) { \
-                stack.resize(stack.size() * 2); \
-            } \
-            R = stack.data() + frameBase; \
-            stackTop = frameBase + 256
+            R = currentFrame->base; \
+            stackTop = R + RegisterStack::FRAME_WINDOW
 
         #define R(i) R[(i)]
 
         #define SAVE_FRAME() \
             currentFrame->ip = ip
 
+        // Runs machine code from ip; it returns at the first instruction it leaves to us
+        #define JIT_ENTER() \
+            do { SAVE_FRAME(); ip = runJit(currentFrame); } while (false)
+
+        // Both continue at the catch block of the innermost try, found through Chunk::handlers
+        PomeValue thrown;
+        #define THROW_VALUE(value) \
+            do { SAVE_FRAME(); thrown = (value); goto LABEL_UNWIND; } while (false)
+        #define RAISE(message) THROW_VALUE(errorValue(message))
+
         REFRESH_FRAME();
 
-    LABEL_EXCEPTION_LOOP:
-        gc.processZCT();
         if (gc.pendingGC) {
             gc.pendingGC = false;
-            bool minor = gc.shouldCollectMinor();
-            gc.collect(minor);
+            gc.collectIfDue();
         }
-        
-        try {
+
 #ifdef COMPUTED_GOTO
         static void* dispatchTable[] = {
     &&LABEL_MOVE, // 0
@@ -262,23 +496,23 @@ namespace Pome {
     &&LABEL_SETTABLE_CACHE, // 62
     &&LABEL_GETFIELD_CACHE, // 63
     &&LABEL_SETFIELD_CACHE, // 64
-    &&LABEL_CACHE, // 65
-    &&LABEL_LIST_ADD_SCALAR, // 66
-    &&LABEL_LIST_SUM, // 67
-    &&LABEL_GETLIST_N, // 68
-    &&LABEL_SETLIST_N, // 69
-    &&LABEL_GETLIST_D, // 70
-    &&LABEL_SETLIST_D, // 71
-    &&LABEL_GETLIST_I, // 72
-    &&LABEL_SETLIST_I, // 73
-    &&LABEL_CACHE, // 74
-    &&LABEL_CACHE, // 75
-    &&LABEL_CACHE, // 76
-    &&LABEL_CACHE, // 77
-    &&LABEL_CACHE, // 78
-    &&LABEL_CACHE, // 79
-    &&LABEL_CACHE, // 80
-    &&LABEL_CACHE, // 81
+    &&LABEL_LIST_ADD_SCALAR, // 65
+    &&LABEL_LIST_SUM, // 66
+    &&LABEL_GETLIST_N, // 67
+    &&LABEL_SETLIST_N, // 68
+    &&LABEL_GETLIST_D, // 69
+    &&LABEL_SETLIST_D, // 70
+    &&LABEL_GETLIST_I, // 71
+    &&LABEL_SETLIST_I, // 72
+    &&LABEL_LT_JMP, // 73
+    &&LABEL_LE_JMP, // 74
+    &&LABEL_LOADK_ADD, // 75
+    &&LABEL_LOADK_SUB, // 76
+    &&LABEL_LOADK_MUL, // 77
+    &&LABEL_LOADK_ADD_JMP, // 78
+    &&LABEL_MOVE2, // 79
+    &&LABEL_GETTABLE_ADD_SET, // 80
+    &&LABEL_CHECKMETHOD, // 81
     &&LABEL_CACHE, // 82
     &&LABEL_CACHE, // 83
     &&LABEL_CACHE, // 84
@@ -454,6 +688,15 @@ namespace Pome {
     &&LABEL_CACHE, // 254
     &&LABEL_CACHE // 255
 };        
+        // Every opcode routes through LABEL_PROFILE; chosen per execute(), so unprofiled runs never see it
+        #define PROFILE_4 &&LABEL_PROFILE, &&LABEL_PROFILE, &&LABEL_PROFILE, &&LABEL_PROFILE
+        #define PROFILE_32 PROFILE_4, PROFILE_4, PROFILE_4, PROFILE_4, PROFILE_4, PROFILE_4, PROFILE_4, PROFILE_4
+        static void* profileTable[256] = {
+            PROFILE_32, PROFILE_32, PROFILE_32, PROFILE_32, PROFILE_32, PROFILE_32, PROFILE_32, PROFILE_32
+        };
+        #undef PROFILE_32
+        #undef PROFILE_4
+        void* const* dispatch = profiler ? profileTable : dispatchTable;
 
             #define DISPATCH() \
                 do { \
@@ -463,12 +706,17 @@ namespace Pome {
                     c = (instruction >> 24) & 0xFF; \
                     bx = (instruction >> 16) & 0xFFFF; \
                     sbx = (int)bx - 32767; \
-                    goto *dispatchTable[static_cast<uint8_t>(instruction & 0xFF)]; \
+                    goto *dispatch[static_cast<uint8_t>(instruction & 0xFF)]; \
                 } while (false)
 
         DISPATCH();
+
+        LABEL_PROFILE:
+            profiler->onInstruction(ip - 1, currentFrame->chunk, frames.data(), frameCount);
+            goto *dispatchTable[static_cast<uint8_t>(instruction & 0xFF)];
 #else
             #define DISPATCH() break
+        LABEL_RESUME:
             while (true) {
                 instruction = *ip++;
                 a = (instruction >> 8) & 0xFF;
@@ -476,6 +724,7 @@ namespace Pome {
                 c = (instruction >> 24) & 0xFF;
                 bx = (instruction >> 16) & 0xFFFF;
                 sbx = (int)bx - 32767;
+                if (profiler) profiler->onInstruction(ip - 1, currentFrame->chunk, frames.data(), frameCount);
                 OpCode op = static_cast<OpCode>(instruction & 0xFF);
                 switch (op) {
 #endif
@@ -536,7 +785,10 @@ namespace Pome {
             #ifndef COMPUTED_GOTO
             case OpCode::SETUPVAL:
             #endif
-            *currentFrame->function->upvalues[b]->location = R(a);
+            PomeUpvalue* upvalue = currentFrame->function->upvalues[b];
+            *upvalue->location = R(a);
+            // A closed upvalue is a heap slot: old or already scanned, it must not hide the value
+            gc.writeBarrier(upvalue, R(a));
             DISPATCH();
         }
 
@@ -554,13 +806,15 @@ namespace Pome {
                 closure->isAsync = proto->isAsync;
                 closure->module = currentModule; 
                 proto->module = currentModule; 
+                // Rooted before captureUpvalue allocates
+                R(a) = PomeValue(closure);
 
                 for (int i = 0; i < closure->upvalueCount; ++i) {
                     Instruction uvMeta = *ip++;
                     OpCode op = static_cast<OpCode>(uvMeta & 0xFF);
                     int uvIdx = (uvMeta >> 16) & 0xFF;  // field B: bits 16-23
                     if (op == OpCode::MOVE) {
-                        PomeUpvalue* uv = captureUpvalue(&R(uvIdx));
+                        PomeUpvalue* uv = captureUpvalue(&R(uvIdx), currentFrame->segment);
                         closure->upvalues.push_back(uv);
                         gc.incrementRef(uv);
                     } else {
@@ -569,7 +823,6 @@ namespace Pome {
                         gc.incrementRef(uv);
                     }
                 }
-                R(a) = PomeValue(closure);
             }
             DISPATCH();
         }
@@ -579,36 +832,12 @@ namespace Pome {
             case OpCode::GETGLOBAL:
             #endif
             {
-                PomeValue key = K[bx];
-                
-                if (currentModule) {
-                    auto it = currentModule->variables.find(key);
-                    if (it != currentModule->variables.end()) {
-                        R(a) = it->second;
-                        int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                        auto& meta = currentFrame->chunk->metadata[offset];
-                        if (meta.globalCacheValid) meta.globalCache.decRef(gc);
-                        meta.globalCache = it->second;   // cache by value (pointer-safe)
-                        meta.globalCache.incRef();
-                        meta.globalCacheValid = true;
-                        *(ip - 1) = Chunk::makeABx(OpCode::GETGLOBAL_CACHE, a, bx);
-                        DISPATCH();
-                    }
-                }
-
-                auto it = globals.find(key);
-                if (it != globals.end()) {
-                    R(a) = it->second;
-                    int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                    auto& meta = currentFrame->chunk->metadata[offset];
-                    if (meta.globalCacheValid) meta.globalCache.decRef(gc);
-                    meta.globalCache = it->second;       // cache by value (pointer-safe)
-                    meta.globalCache.incRef();
-                    meta.globalCacheValid = true;
-                    *(ip - 1) = Chunk::makeABx(OpCode::GETGLOBAL_CACHE, a, bx);
-                } else {
-                    R(a) = PomeValue();
-                }
+                Chunk& chunk = *currentFrame->chunk;
+                GlobalLink& link = globalLink(chunk, ip - 1);
+                linkGlobal(link, K[bx]);
+                // The code is the owner's to rewrite too
+                if (&link == &chunk.cacheFor(ip - 1).global) *(ip - 1) = Chunk::makeABx(OpCode::GETGLOBAL_CACHE, a, bx);
+                R(a) = (link.moduleCell && link.moduleCell->defined) ? link.moduleCell->value : link.globalCell->value;
             }
             DISPATCH();
         }
@@ -618,16 +847,10 @@ namespace Pome {
             case OpCode::GETGLOBAL_CACHE:
             #endif
             {
-                int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                auto& meta = currentFrame->chunk->metadata[offset];
-                if (meta.globalCacheValid) {
-                    R(a) = meta.globalCache;
-                } else {
-                    if (meta.globalCache.isObject()) meta.globalCache.decRef(gc);
-                    meta.globalCacheValid = false;
-                    *(ip - 1) = Chunk::makeABx(OpCode::GETGLOBAL, a, bx);
-                    goto LABEL_GETGLOBAL;
-                }
+                GlobalLink& link = globalLink(*currentFrame->chunk, ip - 1);
+                if (!globalLinked(link)) goto LABEL_GETGLOBAL;
+                // Module bindings shadow VM globals such as natives
+                R(a) = (link.moduleCell && link.moduleCell->defined) ? link.moduleCell->value : link.globalCell->value;
             }
             DISPATCH();
         }
@@ -637,13 +860,12 @@ namespace Pome {
             case OpCode::SETGLOBAL:
             #endif
             {
-                PomeValue key = K[bx];
-                if (currentModule) {
-                    gc.rcMapSet(currentModule->variables, key, R(a));
-                    gc.writeBarrier(currentModule, R(a));
-                } else {
-                    gc.rcMapSet(globals, key, R(a));
-                }
+                GlobalLink& link = globalLink(*currentFrame->chunk, ip - 1);
+                if (!globalLinked(link)) linkGlobal(link, K[bx]);
+                GlobalCell* cell = currentModule ? link.moduleCell : link.globalCell;
+                gc.rcWriteBarrier(&cell->value, R(a));
+                cell->defined = true;
+                if (currentModule) gc.writeBarrier(currentModule, R(a));
             }
             DISPATCH();
         }
@@ -656,7 +878,9 @@ namespace Pome {
                 PomeValue obj = R(b);
                 PomeValue key = R(c);
                 if (obj.isTable()) {
-                    R(a) = obj.asTable()->get(key);
+                    PomeTable* tbl = obj.asTable();
+                    PomeValue* slot = tbl->arraySlot(key);
+                    R(a) = slot ? *slot : tbl->get(key);
                 } else if (obj.isList()) {
                     if (key.isNumber()) {
                         int idx = (int)key.asNumber();
@@ -672,6 +896,11 @@ namespace Pome {
                                 res = PomeValue((double)list->asInt32()[idx]);
                                 *(ip - 1) = Chunk::makeABC(OpCode::GETLIST_I, a, b, c);
                             }
+                        } else if (list->listType == ListType::BOOL) {
+                            if (idx >= 0 && (size_t)idx < list->unboxedCount) {
+                                res = PomeValue(list->asBool()[idx] != 0);
+                                *(ip - 1) = Chunk::makeABC(OpCode::GETTABLE_CACHE, a, b, c);
+                            }
                         } else {
                             if (idx >= 0 && idx < (int)list->elements.size()) {
                                 res = list->elements[idx];
@@ -684,16 +913,23 @@ namespace Pome {
                         R(a) = PomeValue();
                         DISPATCH();
                     }
+                } else if (obj.isBuffer()) {
+                    PomeBuffer* buffer = obj.asBuffer();
+                    size_t i;
+                    if (PomeTable::arrayIndex(key, i) && i < buffer->count) {
+                        R(a) = buffer->get(i);
+                        *(ip - 1) = Chunk::makeABC(OpCode::GETTABLE_CACHE, a, b, c);
+                    } else {
+                        R(a) = PomeValue();
+                    }
                 } else if (obj.isString()) {
                     if (key.isNumber()) {
                         int idx = (int)key.asNumber();
-                        const std::string& s = obj.asString();
+                        std::string_view s = obj.asPomeString()->view();
                         if (idx >= 0 && idx < (int)s.length()) {
                             unsigned char ch = (unsigned char)s[idx];
                             if (!charCache[ch]) {
-                                std::string charStr = "";
-                                charStr += (char)ch;
-                                charCache[ch] = gc.allocateString(charStr);
+                                charCache[ch] = gc.allocateString(s.substr(idx, 1));
                             }
                             R(a) = PomeValue(charCache[ch]);
                         } else {
@@ -723,9 +959,7 @@ namespace Pome {
                         R(a) = PomeValue();
                     }
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("Property access on non-object.");
-                    return PomeValue();
+                    RAISE("Property access on non-object.");
                 }
             }
             DISPATCH();
@@ -739,17 +973,26 @@ namespace Pome {
                 PomeValue obj = R(b);
                 if (obj.isInstance()) {
                     PomeInstance* inst = obj.asInstance();
-                    int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                    auto& meta = currentFrame->chunk->metadata[offset];
-                    if (inst->shape == meta.objectCache && meta.indexCache >= 0 && meta.indexCache < (int)inst->properties.size()) {
-                        R(a) = inst->properties[meta.indexCache];
-                        DISPATCH();
-                    } else if (inst->klass == meta.klassCache && meta.indexCache == -2) {
-                        R(a) = PomeValue(meta.objectCache);
-                        DISPATCH();
+                    auto& meta = currentFrame->chunk->cacheFor(ip - 1);
+                    const FieldCacheEntry* hit = nullptr;
+                    for (int i = 0; i < meta.fieldCount; ++i) {
+                        const FieldCacheEntry& entry = meta.fields[i];
+                        if (entry.shape == inst->shape && (!entry.method || entry.klass == inst->klass)) {
+                            hit = &entry;
+                            break;
+                        }
+                    }
+                    if (hit) {
+                        if (hit->method) {
+                            R(a) = PomeValue(hit->method);
+                            DISPATCH();
+                        } else if (hit->index < (int)inst->properties.size()) {
+                            R(a) = inst->properties[hit->index];
+                            DISPATCH();
+                        }
                     }
                 }
-                *(ip - 1) = Chunk::makeABC(OpCode::GETFIELD, a, b, c);
+                // Miss: the generic path adds this receiver or marks the site megamorphic
                 goto LABEL_GETFIELD;
             }
         }
@@ -779,6 +1022,18 @@ namespace Pome {
                             R(a) = PomeValue((double)list->asInt32()[idx]);
                             DISPATCH();
                         }
+                    } else if (list->listType == ListType::BOOL) {
+                        if (idx >= 0 && (size_t)idx < list->unboxedCount) {
+                            R(a) = PomeValue(list->asBool()[idx] != 0);
+                            DISPATCH();
+                        }
+                    }
+                } else if (obj.isBuffer()) {
+                    PomeBuffer* buffer = obj.asBuffer();
+                    size_t i;
+                    if (PomeTable::arrayIndex(key, i) && i < buffer->count) {
+                        R(a) = buffer->get(i);
+                        DISPATCH();
                     }
                 }
                 *(ip - 1) = Chunk::makeABC(OpCode::GETTABLE, a, b, c);
@@ -821,7 +1076,7 @@ namespace Pome {
                 PomeValue obj = R(a);
                 PomeValue key = R(b);
                 PomeValue val = R(c);
-                if (obj.isList() && key.isNumber()) {
+                if (obj.isList() && key.isNumber() && !obj.asList()->frozen) {
                     PomeList* list = obj.asList();
                     int idx = (int)key.asNumber();
                     if (list->listType == ListType::MIXED) {
@@ -879,6 +1134,31 @@ namespace Pome {
                             gc.writeBarrier(obj.asObject(), val);
                             DISPATCH();
                         }
+                    } else if (list->listType == ListType::BOOL) {
+                        if (idx >= 0 && (size_t)idx < list->unboxedCount) {
+                            if (val.isBool()) {
+                                list->asBool()[idx] = val.isTrue();
+                                DISPATCH();
+                            } else {
+                                list->box();
+                                gc.rcWriteBarrier(&list->elements[idx], val);
+                                gc.writeBarrier(obj.asObject(), val);
+                                DISPATCH();
+                            }
+                        } else if (idx == (int)list->unboxedCount) {
+                            size_t oldSize = list->extraSize();
+                            list->push(gc, val);
+                            gc.updateSize(obj.asObject(), sizeof(PomeList) + oldSize, sizeof(PomeList) + list->extraSize());
+                            gc.writeBarrier(obj.asObject(), val);
+                            DISPATCH();
+                        }
+                    }
+                } else if (obj.isBuffer() && val.isNumber()) {
+                    PomeBuffer* buffer = obj.asBuffer();
+                    size_t i;
+                    if (PomeTable::arrayIndex(key, i) && i < buffer->count && buffer->writable()) {
+                        buffer->set(i, val.asNumber());
+                        DISPATCH();
                     }
                 }
                 *(ip - 1) = Chunk::makeABC(OpCode::SETTABLE, a, b, c);
@@ -894,7 +1174,8 @@ namespace Pome {
                 PomeValue obj = R(a);
                 PomeValue key = R(b);
                 PomeValue val = R(c);
-                if (obj.isList() && key.isNumber()) {
+                if (obj.isList() && key.isNumber() && obj.asList()->listType != ListType::BOOL &&
+                    !obj.asList()->frozen) {
                     PomeList* list = obj.asList();
                     int idx = (int)key.asNumber();
                     if (list->isUnboxed()) {
@@ -996,7 +1277,7 @@ namespace Pome {
                 PomeValue obj = R(a);
                 PomeValue key = R(b);
                 PomeValue val = R(c);
-                if (obj.isList() && key.isNumber() && val.isNumber()) {
+                if (obj.isList() && key.isNumber() && val.isNumber() && !obj.asList()->frozen) {
                     PomeList* list = obj.asList();
                     int idx = (int)key.asNumber();
                     if (list->listType == ListType::DOUBLE) {
@@ -1019,7 +1300,7 @@ namespace Pome {
                 PomeValue obj = R(a);
                 PomeValue key = R(b);
                 PomeValue val = R(c);
-                if (obj.isList() && key.isNumber() && val.isNumber()) {
+                if (obj.isList() && key.isNumber() && val.isNumber() && !obj.asList()->frozen) {
                     PomeList* list = obj.asList();
                     int idx = (int)key.asNumber();
                     if (list->listType == ListType::INT32) {
@@ -1037,6 +1318,178 @@ namespace Pome {
             }
         }
 
+        // --- Superinstructions ---
+        // Operands of the covered instructions are decoded from the words that
+        // follow, which the compiler leaves in place.
+
+        LABEL_LT_JMP: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::LT_JMP:
+            #endif
+            {
+                PomeValue v1 = R(b);
+                PomeValue v2 = R(c);
+                if (v1.isNumber() && v2.isNumber()) {
+                    bool cond = v1.asNumber() < v2.asNumber();
+                    R(a) = PomeValue(cond);
+                    // ip[0] is the TEST, ip[1] the JMP it guards
+                    if (cond == (Chunk::getC(ip[0]) != 0)) ip += 2;
+                    else ip += 2 + Chunk::getSBx(ip[1]);
+                    DISPATCH();
+                }
+                *(ip - 1) = Chunk::makeABC(OpCode::LT, a, b, c);
+                goto LABEL_LT;
+            }
+        }
+
+        LABEL_LE_JMP: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::LE_JMP:
+            #endif
+            {
+                PomeValue v1 = R(b);
+                PomeValue v2 = R(c);
+                if (v1.isNumber() && v2.isNumber()) {
+                    bool cond = v1.asNumber() <= v2.asNumber();
+                    R(a) = PomeValue(cond);
+                    if (cond == (Chunk::getC(ip[0]) != 0)) ip += 2;
+                    else ip += 2 + Chunk::getSBx(ip[1]);
+                    DISPATCH();
+                }
+                *(ip - 1) = Chunk::makeABC(OpCode::LE, a, b, c);
+                goto LABEL_LE;
+            }
+        }
+
+        LABEL_LOADK_ADD: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::LOADK_ADD:
+            #endif
+            {
+                // The compiler only fuses numeric constants, so LOADK's class fixup never applies
+                R(a) = K[bx];
+                Instruction next = ip[0];
+                PomeValue v1 = R(Chunk::getB(next));
+                PomeValue v2 = R(Chunk::getC(next));
+                if (v1.isNumber() && v2.isNumber()) {
+                    R(Chunk::getA(next)) = PomeValue(v1.asNumber() + v2.asNumber());
+                    ip++;
+                } else {
+                    // The load is done; let the ADD that follows handle the operands
+                    *(ip - 1) = Chunk::makeABx(OpCode::LOADK, a, bx);
+                }
+            }
+            DISPATCH();
+        }
+
+        LABEL_LOADK_SUB: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::LOADK_SUB:
+            #endif
+            {
+                R(a) = K[bx];
+                Instruction next = ip[0];
+                PomeValue v1 = R(Chunk::getB(next));
+                PomeValue v2 = R(Chunk::getC(next));
+                if (v1.isNumber() && v2.isNumber()) {
+                    R(Chunk::getA(next)) = PomeValue(v1.asNumber() - v2.asNumber());
+                    ip++;
+                } else {
+                    *(ip - 1) = Chunk::makeABx(OpCode::LOADK, a, bx);
+                }
+            }
+            DISPATCH();
+        }
+
+        LABEL_LOADK_MUL: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::LOADK_MUL:
+            #endif
+            {
+                R(a) = K[bx];
+                Instruction next = ip[0];
+                PomeValue v1 = R(Chunk::getB(next));
+                PomeValue v2 = R(Chunk::getC(next));
+                if (v1.isNumber() && v2.isNumber()) {
+                    R(Chunk::getA(next)) = PomeValue(v1.asNumber() * v2.asNumber());
+                    ip++;
+                } else {
+                    *(ip - 1) = Chunk::makeABx(OpCode::LOADK, a, bx);
+                }
+            }
+            DISPATCH();
+        }
+
+        LABEL_LOADK_ADD_JMP: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::LOADK_ADD_JMP:
+            #endif
+            {
+                R(a) = K[bx];
+                Instruction next = ip[0];
+                PomeValue v1 = R(Chunk::getB(next));
+                PomeValue v2 = R(Chunk::getC(next));
+                if (v1.isNumber() && v2.isNumber()) {
+                    R(Chunk::getA(next)) = PomeValue(v1.asNumber() + v2.asNumber());
+                    int back = Chunk::getSBx(ip[1]);
+                    ip += 2 + back;
+                    if (back < 0 && useJit && tierUp(*currentFrame->chunk)) JIT_ENTER();
+                } else {
+                    *(ip - 1) = Chunk::makeABx(OpCode::LOADK, a, bx);
+                }
+            }
+            DISPATCH();
+        }
+
+        LABEL_MOVE2: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::MOVE2:
+            #endif
+            {
+                R(a) = R(b);
+                Instruction next = *ip++;
+                R(Chunk::getA(next)) = R(Chunk::getB(next));
+            }
+            DISPATCH();
+        }
+
+        LABEL_GETTABLE_ADD_SET: {
+            #ifndef COMPUTED_GOTO
+            case OpCode::GETTABLE_ADD_SET:
+            #endif
+            {
+                // R(B)[R(C)] += R(x), with R(A) left holding the sum as the unfused code would
+                PomeValue obj = R(b);
+                PomeValue key = R(c);
+                Instruction add = ip[0];
+                PomeValue delta = R(Chunk::getB(add) == a ? Chunk::getC(add) : Chunk::getB(add));
+                if (obj.isList() && key.isNumber() && delta.isNumber() && !obj.asList()->frozen) {
+                    PomeList* list = obj.asList();
+                    int idx = (int)key.asNumber();
+                    if (list->listType == ListType::DOUBLE) {
+                        if (idx >= 0 && (size_t)idx < list->unboxedCount) {
+                            double sum = list->asDouble()[idx] + delta.asNumber();
+                            list->asDouble()[idx] = sum;
+                            R(a) = PomeValue(sum);
+                            ip += 2;
+                            DISPATCH();
+                        }
+                    } else if (list->listType == ListType::MIXED) {
+                        // Number over number needs no barrier; anything else takes the slow path
+                        if (idx >= 0 && idx < (int)list->elements.size() && list->elements[idx].isNumber()) {
+                            PomeValue sum(list->elements[idx].asNumber() + delta.asNumber());
+                            list->elements[idx] = sum;
+                            R(a) = sum;
+                            ip += 2;
+                            DISPATCH();
+                        }
+                    }
+                }
+                *(ip - 1) = Chunk::makeABC(OpCode::GETTABLE, a, b, c);
+                goto LABEL_GETTABLE;
+            }
+        }
+
         LABEL_SETFIELD_CACHE: {
             #ifndef COMPUTED_GOTO
             case OpCode::SETFIELD_CACHE:
@@ -1045,24 +1498,55 @@ namespace Pome {
                 PomeValue obj = R(a);
                 if (obj.isInstance()) {
                     PomeInstance* inst = obj.asInstance();
-                    int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                    auto& meta = currentFrame->chunk->metadata[offset];
-                    if (inst->shape == meta.objectCache && meta.indexCache >= 0 && meta.indexCache < (int)inst->properties.size()) {
+                    auto& meta = currentFrame->chunk->cacheFor(ip - 1);
+                    int index = -1;
+                    for (int i = 0; i < meta.fieldCount; ++i) {
+                        if (meta.fields[i].shape == inst->shape) {
+                            index = meta.fields[i].index;
+                            break;
+                        }
+                    }
+                    if (index >= 0 && index < (int)inst->properties.size()) {
                         PomeValue val = R(b);
-                        gc.rcWriteBarrier(&inst->properties[meta.indexCache], val);
+                        gc.rcWriteBarrier(&inst->properties[index], val);
                         gc.writeBarrier(inst, val);
                         DISPATCH();
                     }
                 }
-                *(ip - 1) = Chunk::makeABC(OpCode::SETFIELD, a, b, c);
                 goto LABEL_SETFIELD;
             }
         }
 
-        LABEL_CACHE: {
+        LABEL_CHECKMETHOD: {
             #ifndef COMPUTED_GOTO
-            case OpCode::CACHE:
+            case OpCode::CHECKMETHOD:
             #endif
+            {
+                // An instance of the last class and shape seen resolves the name the same way
+                PomeValue obj = R(a);
+                if (obj.isInstance()) {
+                    PomeInstance* inst = obj.asInstance();
+                    InstructionMetadata& meta = currentFrame->chunk->cacheFor(ip - 1);
+                    if (inst->klass == meta.klassCache && inst->shape == meta.objectCache) {
+                        ip++;
+                        DISPATCH();
+                    }
+                    PomeFunction* expected = K[bx].asPomeFunction();
+                    PomeValue name(gc.allocateString(expected->name));
+                    if (inst->shape->getIndex(name) < 0 && inst->klass->findMethod(expected->name) == expected) {
+                        meta.klassCache = inst->klass;
+                        meta.objectCache = inst->shape;
+                        gc.shade(inst->klass);
+                        gc.shade(inst->shape);
+                        ip++;
+                    }
+                }
+            }
+            DISPATCH();
+        }
+
+        LABEL_CACHE: {
+            // Filler for unused dispatch slots
             DISPATCH();
         }
 
@@ -1074,9 +1558,17 @@ namespace Pome {
                 PomeValue obj = R(a);
                 PomeValue key = R(b);
                 PomeValue val = R(c);
+                // The specialised stores leave frozen lists to this one
+                if (obj.isObject() && obj.asObject()->frozen) RAISE("Cannot modify a frozen value.");
                 if (obj.isTable()) {
-                    obj.asTable()->set(gc, key, val);
-                    gc.writeBarrier(obj.asObject(), val);
+                    PomeTable* tbl = obj.asTable();
+                    PomeValue* slot = tbl->arraySlot(key);
+                    if (slot && !slot->isNil() && !val.isNil()) {
+                        gc.rcWriteBarrier(slot, val);
+                    } else {
+                        tbl->set(gc, key, val);
+                    }
+                    gc.writeBarrier(tbl, val);
                 } else if (obj.isInstance()) {
                     PomeInstance* inst = obj.asInstance();
                     int index = inst->shape->getIndex(key);
@@ -1096,7 +1588,9 @@ namespace Pome {
                         size_t oldSize = list->extraSize();
                         if (idx >= 0 && (size_t)idx < (list->isUnboxed() ? list->unboxedCount : list->elements.size())) {
                             if (list->isUnboxed()) {
-                                if (val.isNumber()) {
+                                if (list->listType == ListType::BOOL && val.isBool()) {
+                                    list->asBool()[idx] = val.isTrue();
+                                } else if (list->listType != ListType::BOOL && val.isNumber()) {
                                     double d = val.asNumber();
                                     if (list->listType == ListType::DOUBLE) {
                                         list->asDouble()[idx] = d;
@@ -1126,12 +1620,19 @@ namespace Pome {
                         }
                     }
                     DISPATCH();
+                } else if (obj.isBuffer()) {
+                    PomeBuffer* buffer = obj.asBuffer();
+                    size_t i;
+                    if (!PomeTable::arrayIndex(key, i) || i >= buffer->count) RAISE("Buffer index out of range.");
+                    if (!val.isNumber()) RAISE("Buffer elements must be numbers.");
+                    if (!buffer->writable()) RAISE("Buffer is read-only.");
+                    buffer->set(i, val.asNumber());
+                    *(ip - 1) = Chunk::makeABC(OpCode::SETTABLE_CACHE, a, b, c);
                 } else if (obj.isModule()) {
                     gc.rcWriteBarrier(&obj.asModule()->exports[key], val);
                     gc.writeBarrier(obj.asObject(), val);
-                    SAVE_FRAME();
-                    runtimeError("Cannot set property on non-object.");
-                    return PomeValue();
+                    gc.writeBarrier(obj.asObject(), key);
+                    RAISE("Cannot set property on non-object.");
                 }
             }
             DISPATCH();
@@ -1166,27 +1667,7 @@ namespace Pome {
                 PomeValue listVal = R(b);
                 PomeValue scalarVal = R(c);
                 if (listVal.isList() && scalarVal.isNumber()) {
-                    PomeList* list = listVal.asList();
-                    double scalar = scalarVal.asNumber();
-                    if (list->listType == ListType::DOUBLE) {
-                        double* data = list->asDouble();
-                        for (size_t i = 0; i < list->unboxedCount; ++i) data[i] += scalar;
-                    } else if (list->listType == ListType::INT32) {
-                        if (scalar == (int32_t)scalar) {
-                            int32_t* data = list->asInt32();
-                            int32_t iscalar = (int32_t)scalar;
-                            for (size_t i = 0; i < list->unboxedCount; ++i) data[i] += iscalar;
-                        } else {
-                            list->switchTo(ListType::DOUBLE);
-                            double* data = list->asDouble();
-                            for (size_t i = 0; i < list->unboxedCount; ++i) data[i] += scalar;
-                        }
-                    } else {
-                        for (auto& val : list->elements) {
-                            if (val.isNumber()) val = PomeValue(val.asNumber() + scalar);
-                        }
-                        list->tryUnbox();
-                    }
+                    listVal.asList()->addScalar(scalarVal.asNumber());
                     R(a) = listVal;
                 }
             }
@@ -1200,20 +1681,7 @@ namespace Pome {
             {
                 PomeValue listVal = R(b);
                 if (listVal.isList()) {
-                    PomeList* list = listVal.asList();
-                    double sum = 0;
-                    if (list->listType == ListType::DOUBLE) {
-                        double* data = list->asDouble();
-                        for (size_t i = 0; i < list->unboxedCount; ++i) sum += data[i];
-                    } else if (list->listType == ListType::INT32) {
-                        int32_t* data = list->asInt32();
-                        for (size_t i = 0; i < list->unboxedCount; ++i) sum += data[i];
-                    } else {
-                        for (auto& val : list->elements) {
-                            if (val.isNumber()) sum += val.asNumber();
-                        }
-                    }
-                    R(a) = PomeValue(sum);
+                    R(a) = PomeValue(listVal.asList()->sum());
                 }
             }
             DISPATCH();
@@ -1242,28 +1710,26 @@ namespace Pome {
                     PomeFunction* method = instance->klass->findMethod("__add__");
                     if (method) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(R + a + 3, currentFrame->segment, 0);
                         nextFrame->function = method;
                         nextFrame->module = method->module;
                         nextFrame->chunk = method->chunk.get();
                         nextFrame->ip = method->chunk->code.data();
-                        nextFrame->base = frameBase + a + 3;
                         nextFrame->destReg = a;
-                        stack[nextFrame->base] = PomeValue(method);
-                        stack[nextFrame->base + 1] = v1;
-                        stack[nextFrame->base + 2] = v2;
+                        nextFrame->base[0] = PomeValue(method);
+                        nextFrame->base[1] = v1;
+                        nextFrame->base[2] = v2;
                         REFRESH_FRAME();
                         DISPATCH();
                     } else {
                         R(a) = PomeValue(gc.allocateString(v1.toString() + v2.toString()));
                     }
-                } else if (v1.isString() || v2.isString()) {
+                } else if (v1.isString()) {
+                    R(a) = PomeValue(gc.concatStrings(v1.asPomeString(), v2.isString() ? v2.asString() : v2.toString()));
+                } else if (v2.isString()) {
                     R(a) = PomeValue(gc.allocateString(v1.toString() + v2.toString()));
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("Arithmetic on non-number.");
-                    return PomeValue();
+                    RAISE("Arithmetic on non-number.");
                 }
             }
             DISPATCH();
@@ -1301,28 +1767,22 @@ namespace Pome {
                     PomeFunction* method = instance->klass->findMethod("__sub__");
                     if (method) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(R + a + 3, currentFrame->segment, 0);
                         nextFrame->function = method;
                         nextFrame->module = method->module;
                         nextFrame->chunk = method->chunk.get();
                         nextFrame->ip = method->chunk->code.data();
-                        nextFrame->base = frameBase + a + 3;
                         nextFrame->destReg = a;
-                        stack[nextFrame->base] = PomeValue(method);
-                        stack[nextFrame->base + 1] = v1;
-                        stack[nextFrame->base + 2] = v2;
+                        nextFrame->base[0] = PomeValue(method);
+                        nextFrame->base[1] = v1;
+                        nextFrame->base[2] = v2;
                         REFRESH_FRAME();
                         DISPATCH();
                     } else {
-                        SAVE_FRAME();
-                        runtimeError("Arithmetic on non-number.");
-                        return PomeValue();
+                        RAISE("Arithmetic on non-number.");
                     }
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("Arithmetic on non-number.");
-                    return PomeValue();
+                    RAISE("Arithmetic on non-number.");
                 }
             }
             DISPATCH();
@@ -1360,28 +1820,22 @@ namespace Pome {
                     PomeFunction* method = instance->klass->findMethod("__mul__");
                     if (method) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(R + a + 3, currentFrame->segment, 0);
                         nextFrame->function = method;
                         nextFrame->module = method->module;
                         nextFrame->chunk = method->chunk.get();
                         nextFrame->ip = method->chunk->code.data();
-                        nextFrame->base = frameBase + a + 3;
                         nextFrame->destReg = a;
-                        stack[nextFrame->base] = PomeValue(method);
-                        stack[nextFrame->base + 1] = v1;
-                        stack[nextFrame->base + 2] = v2;
+                        nextFrame->base[0] = PomeValue(method);
+                        nextFrame->base[1] = v1;
+                        nextFrame->base[2] = v2;
                         REFRESH_FRAME();
                         DISPATCH();
                     } else {
-                        SAVE_FRAME();
-                        runtimeError("Arithmetic on non-number.");
-                        return PomeValue();
+                        RAISE("Arithmetic on non-number.");
                     }
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("Arithmetic on non-number.");
-                    return PomeValue();
+                    RAISE("Arithmetic on non-number.");
                 }
             }
             DISPATCH();
@@ -1413,9 +1867,7 @@ namespace Pome {
                 PomeValue v2 = R(c);
                 if (v1.isNumber() && v2.isNumber()) {
                     if (v2.asNumber() == 0.0) {
-                        SAVE_FRAME();
-                        runtimeError("Division by zero.");
-                        return PomeValue();
+                        RAISE("Division by zero.");
                     }
                     *(ip - 1) = Chunk::makeABC(OpCode::DIV_NN, a, b, c);
                     R(a) = PomeValue(v1.asNumber() / v2.asNumber());
@@ -1424,28 +1876,22 @@ namespace Pome {
                     PomeFunction* method = instance->klass->findMethod("__div__");
                     if (method) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(R + a + 3, currentFrame->segment, 0);
                         nextFrame->function = method;
                         nextFrame->module = method->module;
                         nextFrame->chunk = method->chunk.get();
                         nextFrame->ip = method->chunk->code.data();
-                        nextFrame->base = frameBase + a + 3;
                         nextFrame->destReg = a;
-                        stack[nextFrame->base] = PomeValue(method);
-                        stack[nextFrame->base + 1] = v1;
-                        stack[nextFrame->base + 2] = v2;
+                        nextFrame->base[0] = PomeValue(method);
+                        nextFrame->base[1] = v1;
+                        nextFrame->base[2] = v2;
                         REFRESH_FRAME();
                         DISPATCH();
                     } else {
-                        SAVE_FRAME();
-                        runtimeError("Arithmetic on non-number.");
-                        return PomeValue();
+                        RAISE("Arithmetic on non-number.");
                     }
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("Arithmetic on non-number.");
-                    return PomeValue();
+                    RAISE("Arithmetic on non-number.");
                 }
             }
             DISPATCH();
@@ -1458,7 +1904,8 @@ namespace Pome {
             {
                 PomeValue v1 = R(b);
                 PomeValue v2 = R(c);
-                if (v1.isNumber() && v2.isNumber()) {
+                // A zero divisor takes the generic path so it still raises
+                if (v1.isNumber() && v2.isNumber() && v2.asNumber() != 0.0) {
                     R(a) = PomeValue(v1.asNumber() / v2.asNumber());
                 } else {
                     *(ip - 1) = Chunk::makeABC(OpCode::DIV, a, b, c);
@@ -1479,9 +1926,7 @@ namespace Pome {
                     *(ip - 1) = Chunk::makeABC(OpCode::MOD_NN, a, b, c);
                     R(a) = PomeValue(std::fmod(v1.asNumber(), v2.asNumber()));
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("Arithmetic on non-number.");
-                    return PomeValue();
+                    RAISE("Arithmetic on non-number.");
                 }
             }
             DISPATCH();
@@ -1514,9 +1959,7 @@ namespace Pome {
                 if (v1.isNumber() && v2.isNumber()) {
                     R(a) = PomeValue(std::pow(v1.asNumber(), v2.asNumber()));
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("Arithmetic on non-number.");
-                    return PomeValue();
+                    RAISE("Arithmetic on non-number.");
                 }
             }
             DISPATCH();
@@ -1535,22 +1978,18 @@ namespace Pome {
                     PomeFunction* method = instance->klass->findMethod("__neg__");
                     if (method) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(R + a + 2, currentFrame->segment, 0);
                         nextFrame->function = method;
                         nextFrame->module = method->module;
                         nextFrame->chunk = method->chunk.get();
                         nextFrame->ip = method->chunk->code.data();
-                        nextFrame->base = frameBase + a + 2;
                         nextFrame->destReg = a;
-                        stack[nextFrame->base] = PomeValue(method);
-                        stack[nextFrame->base + 1] = v1;
+                        nextFrame->base[0] = PomeValue(method);
+                        nextFrame->base[1] = v1;
                         REFRESH_FRAME();
                         DISPATCH();
                     } else {
-                        SAVE_FRAME();
-                        runtimeError("Unary negation not implemented for this instance.");
-                        return PomeValue();
+                        RAISE("Unary negation not implemented for this instance.");
                     }
                 }
             }
@@ -1571,9 +2010,10 @@ namespace Pome {
             #endif
             {
                 PomeValue v = R(b);
-                if (v.isString()) R(a) = PomeValue((double)v.asString().length());
+                if (v.isString()) R(a) = PomeValue((double)v.asPomeString()->length());
                 else if (v.isList()) R(a) = PomeValue((double)(v.asList()->isUnboxed() ? v.asList()->unboxedCount : v.asList()->elements.size()));
-                else if (v.isTable()) R(a) = PomeValue((double)(v.asTable()->properties.size() + v.asTable()->backfill.size()));
+                else if (v.isTable()) R(a) = PomeValue((double)v.asTable()->count());
+                else if (v.isBuffer()) R(a) = PomeValue((double)v.asBuffer()->count);
             }
             DISPATCH();
         }
@@ -1585,14 +2025,8 @@ namespace Pome {
             {
                 const PomeValue& v1 = R(b);
                 const PomeValue& v2 = R(c);
-                if (v1.isString() && v2.isString()) {
-                    const std::string& s1 = v1.asString();
-                    const std::string& s2 = v2.asString();
-                    std::string res;
-                    res.reserve(s1.size() + s2.size());
-                    res.append(s1);
-                    res.append(s2);
-                    R(a) = PomeValue(gc.allocateString(std::move(res)));
+                if (v1.isString()) {
+                    R(a) = PomeValue(gc.concatStrings(v1.asPomeString(), v2.isString() ? v2.asString() : v2.toString()));
                 } else {
                     R(a) = PomeValue(gc.allocateString(v1.toString() + v2.toString()));
                 }
@@ -1605,6 +2039,12 @@ namespace Pome {
             case OpCode::JMP:
             #endif
             ip += sbx;
+            if (sbx < 0 && gc.pendingGC) {
+                // Loops that only grow existing objects still give the collector its next slice
+                gc.pendingGC = false;
+                gc.collectIfDue();
+            }
+            if (sbx < 0 && useJit && tierUp(*currentFrame->chunk)) JIT_ENTER();
             DISPATCH();
         }
 
@@ -1630,17 +2070,15 @@ namespace Pome {
                     PomeFunction* method = instance->klass->findMethod("__lt__");
                     if (method) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(R + a + 3, currentFrame->segment, 0);
                         nextFrame->function = method;
                         nextFrame->module = method->module;
                         nextFrame->chunk = method->chunk.get();
                         nextFrame->ip = method->chunk->code.data();
-                        nextFrame->base = frameBase + a + 3;
                         nextFrame->destReg = a;
-                        stack[nextFrame->base] = PomeValue(method);
-                        stack[nextFrame->base + 1] = v1;
-                        stack[nextFrame->base + 2] = v2;
+                        nextFrame->base[0] = PomeValue(method);
+                        nextFrame->base[1] = v1;
+                        nextFrame->base[2] = v2;
                         REFRESH_FRAME();
                         DISPATCH();
                     } else {
@@ -1734,36 +2172,25 @@ namespace Pome {
                 PomeValue callee = R(a);
                 int argCount = b - 1;
                 if (callee.isNativeFunction()) {
-                    int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                    auto& meta = currentFrame->chunk->metadata[offset];
-                    
-                    if (meta.objectCache != callee.asObject()) {
-                        meta.objectCache = callee.asObject();
-                        const std::string& name = callee.asNativeFunction()->getName();
-                        if (name == "len") meta.indexCache = 1;
-                        else if (name == "push") meta.indexCache = 2;
-                        else meta.indexCache = 0;
+                    NativeFunction* native = callee.asNativeFunction();
+                    int startIdx = 1;
+                    if (argCount > 0 && R(a + 1).isModule()) {
+                        startIdx = 2;
                     }
+                    int nativeArgc = argCount - (startIdx - 1);
                     
-                    if (meta.indexCache == 1 && argCount >= 1) {
-                        int valIdx = a + 1;
-                        if (R(valIdx).isModule() && argCount == 2) valIdx++;
-                        PomeValue v = R(valIdx);
+                    if (native->intrinsic() == NativeIntrinsic::LEN && nativeArgc >= 1) {
+                        PomeValue v = R(a + startIdx);
                         if (v.isList()) R(a) = PomeValue((double)(v.asList()->isUnboxed() ? v.asList()->unboxedCount : v.asList()->elements.size()));
-                        else if (v.isString()) R(a) = PomeValue((double)v.asString().length());
-                        else if (v.isTable()) R(a) = PomeValue((double)(v.asTable()->properties.size() + v.asTable()->backfill.size()));
+                        else if (v.isString()) R(a) = PomeValue((double)v.asPomeString()->length());
+                        else if (v.isTable()) R(a) = PomeValue((double)v.asTable()->count());
+                        else if (v.isBuffer()) R(a) = PomeValue((double)v.asBuffer()->count);
                         else R(a) = PomeValue();
                         DISPATCH();
-                    } else if (meta.indexCache == 2 && argCount >= 2) {
-                        int lstIdx = a + 1;
-                        int valIdx = a + 2;
-                        if (R(lstIdx).isModule() && argCount == 3) {
-                            lstIdx++;
-                            valIdx++;
-                        }
-                        PomeValue lstVal = R(lstIdx);
-                        PomeValue val = R(valIdx);
-                        if (lstVal.isList()) {
+                    } else if (native->intrinsic() == NativeIntrinsic::PUSH && nativeArgc >= 2) {
+                        PomeValue lstVal = R(a + startIdx);
+                        PomeValue val = R(a + startIdx + 1);
+                        if (lstVal.isList() && !lstVal.asList()->frozen) {
                             PomeList* lst = lstVal.asList();
                             size_t oldExtra = lst->extraSize();
                             lst->push(gc, val);
@@ -1774,40 +2201,39 @@ namespace Pome {
                         }
                     }
                     
-                    args.clear();
-                    int startIdx = 1;
-                    if (argCount > 0 && R(a + 1).isModule()) {
-                        startIdx = 2;
+                    if (FastNativeFn fast = native->fast()) {
+                        if (nativeArgc < native->arity()) {
+                            RAISE("Native function '" + native->getName() + "' expects " +
+                                  std::to_string(native->arity()) + " argument(s) but got " +
+                                  std::to_string(nativeArgc) + ".");
+                        }
+                        SAVE_FRAME();
+                        NativeContext ctx{this, gc, native};
+                        // The register window is passed as-is; stack segments never move
+                        PomeValue res = fast(ctx, &R(a + startIdx), nativeArgc);
+                        REFRESH_FRAME();
+                        R(a) = res;
+                        DISPATCH();
                     }
+                    
+                    args.clear();
                     for (int i = startIdx; i <= argCount; ++i) args.push_back(R(a + i));
                     SAVE_FRAME();
-                    PomeValue res = callee.asNativeFunction()->call(args);
+                    PomeValue res = native->call(args);
                     REFRESH_FRAME(); 
                     R(a) = res;
                     DISPATCH();
                 } else if (callee.isPomeFunction()) {
                     PomeFunction* func = callee.asPomeFunction();
-                    int nextFrameBase = frameBase + a;
 
                     // Automatically strip 'self' for module functions called as methods
                     if (func->module && !func->klass && argCount == (int)func->parameters.size() + 1) {
                         for (int i = 0; i < (int)func->parameters.size(); ++i) {
-                            stack[nextFrameBase + 1 + i] = stack[nextFrameBase + 2 + i];
+                            R(a + 1 + i) = R(a + 2 + i);
                         }
                         argCount--;
                     }
 
-                    // Zero out registers for the new frame (avoid garbage from previous calls)
-                    int maxRegs = func->chunk ? func->chunk->maxRegisters : 64;
-                    for (int i = argCount + 1; i < maxRegs; ++i) {
-                        stack[nextFrameBase + i] = PomeValue();
-                    }
-
-                    if (argCount < (int)func->parameters.size()) {
-                        for (int i = argCount; i < (int)func->parameters.size(); ++i) {
-                            R(a + 1 + i) = PomeValue();
-                        }
-                    }
                     if (func->isAsync) {
                         PomeTask* task = gc.allocate<PomeTask>(func);
                         for (int i = 0; i < argCount; ++i) {
@@ -1819,16 +2245,22 @@ namespace Pome {
                         DISPATCH();
                     }
                     SAVE_FRAME();
-                    if (frameCount >= 8192) runtimeError("Stack overflow");
-                    CallFrame* nextFrame = &frames[frameCount++];
+                    CallFrame* nextFrame = pushFrameAt(R + a, currentFrame->segment, argCount + 1);
+
+                    // Zero out registers for the new frame (avoid garbage from previous calls)
+                    int maxRegs = func->chunk ? func->chunk->maxRegisters : 64;
+                    for (int i = argCount + 1; i < maxRegs; ++i) {
+                        nextFrame->base[i] = PomeValue();
+                    }
+
                     nextFrame->function = func;
                     nextFrame->module = func->module;
                     nextFrame->chunk = func->chunk.get();
                     nextFrame->ip = func->chunk->code.data();
-                    nextFrame->base = nextFrameBase;
                     nextFrame->destReg = a; 
                     nextFrame->task = nullptr;
                     REFRESH_FRAME();
+                    if (useJit && tierUp(*currentFrame->chunk)) JIT_ENTER();
                     DISPATCH();
                 } else if (callee.isClass()) {
                     PomeClass* klass = callee.asClass();
@@ -1870,13 +2302,11 @@ namespace Pome {
                         R(a) = PomeValue(instance); // return value
                         R(a + 1) = PomeValue(instance); // this
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(R + a, currentFrame->segment, argCount + 2);
                         nextFrame->function = init;
                         nextFrame->module = init->module;
                         nextFrame->chunk = init->chunk.get();
                         nextFrame->ip = init->chunk->code.data();
-                        nextFrame->base = frameBase + a;
                         nextFrame->destReg = -1; // Don't overwrite instance in R(a)
                         nextFrame->task = nullptr;
                         REFRESH_FRAME();
@@ -1885,9 +2315,7 @@ namespace Pome {
                         R(a) = PomeValue(instance);
                         DISPATCH();
                     }                } else {
-                    SAVE_FRAME();
-                    runtimeError("Object is not callable.");
-                    return PomeValue();
+                    RAISE("Object is not callable.");
                 }
             }
             DISPATCH();
@@ -1902,7 +2330,7 @@ namespace Pome {
                 PomeValue callee = R(a);
                 if (callee.isPomeFunction()) {
                     PomeFunction* func = callee.asPomeFunction();
-                    closeUpvalues(stack.data() + frameBase);
+                    closeUpvalues(R, currentFrame->segment);
                     for (int i = 0; i <= nArgs; ++i) R(i) = R(a + i);
 
                     // Zero out remaining registers in the frame
@@ -1928,14 +2356,9 @@ namespace Pome {
             {
                 PomeValue result = (b == 0) ? PomeValue() : R(a);
                 int dest = currentFrame->destReg;
-                PomeTask* currentTask = currentFrame->task;
                 
-                closeUpvalues(stack.data() + frameBase);
+                closeUpvalues(R, currentFrame->segment);
 
-                if (currentTask) {
-                    currentTask->result = result;
-                    currentTask->isCompleted = true;
-                }
                 frameCount--;
                 if (frameCount <= initialFrameIdx) {
                     return result;
@@ -1944,6 +2367,8 @@ namespace Pome {
                 if (dest != -1) {
                     R(dest) = result;
                 }
+                // Resume the caller in machine code if it has been compiled
+                if (useJit && currentFrame->chunk->jitCode) JIT_ENTER();
             }
             DISPATCH();
         }
@@ -1996,14 +2421,37 @@ namespace Pome {
                     PomeValue state = R(b + 1);
                     int idx = state.isNil() ? 0 : (int)state.asNumber();
                     if (idx < size) {
-                        if (list->listType == ListType::DOUBLE) R(a) = PomeValue(list->asDouble()[idx]);
-                        else if (list->listType == ListType::INT32) R(a) = PomeValue((double)list->asInt32()[idx]);
-                        else R(a) = list->elements[idx];
+                        R(a) = list->at(idx);
                         R(a + 1) = PomeValue((double)idx);
                         R(b + 1) = PomeValue((double)(idx + 1));
                     } else {
                         R(a) = PomeValue();
                     }
+                } else if (iterObj.isBuffer()) {
+                    PomeBuffer* buffer = iterObj.asBuffer();
+                    PomeValue state = R(b + 1);
+                    size_t idx = state.isNil() ? 0 : (size_t)state.asNumber();
+                    if (idx < buffer->count) {
+                        R(a) = buffer->get(idx);
+                        R(a + 1) = PomeValue((double)idx);
+                        R(b + 1) = PomeValue((double)(idx + 1));
+                    } else {
+                        R(a) = PomeValue();
+                    }
+                } else if (iterObj.isFile()) {
+                    // One line per step, read through the file's buffer; the index counts lines
+                    PomeFile* file = iterObj.asFile();
+                    PomeValue state = R(b + 1);
+                    double idx = state.isNil() ? 0 : state.asNumber();
+                    std::string_view line;
+                    if (file->readLine(line)) {
+                        R(a) = PomeValue(gc.allocateString(line));
+                        R(a + 1) = PomeValue(idx);
+                        R(b + 1) = PomeValue(idx + 1);
+                    } else {
+                        if (file->closeAtEnd) file->close();
+                        R(a) = PomeValue();
+                    }
                 } else if (iterObj.isTable()) {
                     PomeTable* table = iterObj.asTable();
                     std::vector<PomeValue> sortedKeys = table->getSortedKeys();
@@ -2022,17 +2470,15 @@ namespace Pome {
                     PomeFunction* nextMethod = instance->klass->findMethod("next");
                     if (nextMethod) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nf = &frames[frameCount++];
+                        CallFrame* nf = pushFrameAt(stackTop, currentFrame->segment, 0);
                         nf->function = nextMethod;
                         nf->module = nextMethod->module;
                         nf->chunk = nextMethod->chunk.get();
                         nf->ip = nextMethod->chunk->code.data();
-                        nf->base = stackTop;
                         nf->destReg = a;
-                        stack[nf->base] = PomeValue(nextMethod);
-                        stack[nf->base + 1] = iterObj;
-                        stack[nf->base + 2] = R(b + 1);
+                        nf->base[0] = PomeValue(nextMethod);
+                        nf->base[1] = iterObj;
+                        nf->base[2] = R(b + 1);
                         REFRESH_FRAME();
                         DISPATCH();
                     } else R(a) = PomeValue();
@@ -2054,22 +2500,22 @@ namespace Pome {
                     PomeInstance* inst = obj.asInstance();
                     int index = inst->shape->getIndex(key);
                     if (index >= 0) {
-                        int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                        auto& meta = currentFrame->chunk->metadata[offset];
-                        meta.objectCache = inst->shape;
-                        meta.indexCache = index;
-                        *(ip - 1) = Chunk::makeABC(OpCode::GETFIELD_CACHE, a, b, c);
+                        FieldCacheEntry entry;
+                        entry.shape = inst->shape;
+                        entry.index = index;
+                        bool cached = addFieldCacheEntry(currentFrame->chunk->cacheFor(ip - 1), entry);
+                        *(ip - 1) = Chunk::makeABC(cached ? OpCode::GETFIELD_CACHE : OpCode::GETFIELD, a, b, c);
                         
                         R(a) = inst->properties[index];
                     } else {
                         PomeFunction* method = inst->klass->findMethod(key.asString());
                         if (method) {
-                            int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                            auto& meta = currentFrame->chunk->metadata[offset];
-                            meta.klassCache = inst->klass;
-                            meta.objectCache = method;
-                            meta.indexCache = -2; 
-                            *(ip - 1) = Chunk::makeABC(OpCode::GETFIELD_CACHE, a, b, c);
+                            FieldCacheEntry entry;
+                            entry.shape = inst->shape;
+                            entry.klass = inst->klass;
+                            entry.method = method;
+                            bool cached = addFieldCacheEntry(currentFrame->chunk->cacheFor(ip - 1), entry);
+                            *(ip - 1) = Chunk::makeABC(cached ? OpCode::GETFIELD_CACHE : OpCode::GETFIELD, a, b, c);
                             
                             R(a) = PomeValue(method);
                         } else {
@@ -2084,9 +2530,8 @@ namespace Pome {
                     if (it != mod->exports.end()) {
                         R(a) = it->second;
                     } else {
-                        auto it2 = mod->variables.find(key);
-                        if (it2 != mod->variables.end()) R(a) = it2->second;
-                        else R(a) = PomeValue();
+                        GlobalCell* cell = mod->variables.find(key);
+                        R(a) = (cell && cell->defined) ? cell->value : PomeValue();
                     }
                 } else if (obj.isList()) {
                     if (key.isString() && key.asString() == "len") {
@@ -2094,16 +2539,18 @@ namespace Pome {
                     } else R(a) = PomeValue();
                 } else if (obj.isString()) {
                     if (key.isString() && key.asString() == "len") {
-                        R(a) = PomeValue((double)obj.asString().length());
+                        R(a) = PomeValue((double)obj.asPomeString()->length());
+                    } else R(a) = PomeValue();
+                } else if (obj.isBuffer()) {
+                    if (key.isString() && key.asString() == "len") {
+                        R(a) = PomeValue((double)obj.asBuffer()->count);
                     } else R(a) = PomeValue();
                 } else {
-                    SAVE_FRAME();
                     if (obj.isNil()) {
-                        runtimeError("Property access on nil.");
+                        RAISE("Property access on nil.");
                     } else {
-                        runtimeError("Only instances, tables, modules, lists, and strings have properties.");
+                        RAISE("Only instances, tables, modules, lists, and strings have properties.");
                     }
-                    return PomeValue();
                 }
             }
             DISPATCH();
@@ -2124,11 +2571,11 @@ namespace Pome {
                         if (index >= (int)inst->properties.size()) inst->properties.resize(index + 1);
                         gc.rcWriteBarrier(&inst->properties[index], val);
                         
-                        int offset = (int)(ip - 1 - currentFrame->chunk->code.data());
-                        auto& meta = currentFrame->chunk->metadata[offset];
-                        meta.objectCache = inst->shape;
-                        meta.indexCache = index;
-                        *(ip - 1) = Chunk::makeABC(OpCode::SETFIELD_CACHE, a, b, c);
+                        FieldCacheEntry entry;
+                        entry.shape = inst->shape;
+                        entry.index = index;
+                        bool cached = addFieldCacheEntry(currentFrame->chunk->cacheFor(ip - 1), entry);
+                        *(ip - 1) = Chunk::makeABC(cached ? OpCode::SETFIELD_CACHE : OpCode::SETFIELD, a, b, c);
                     } else {
                         inst->shape = inst->shape->transition(gc, key);
                         inst->properties.push_back(val);
@@ -2137,18 +2584,13 @@ namespace Pome {
                     gc.writeBarrier(inst, val);
                 } else if (obj.isTable()) {
                     PomeTable* tbl = obj.asTable();
-                    int index = tbl->shape->getIndex(key);
-                    if (index >= 0) {
-                        if (index >= (int)tbl->properties.size()) tbl->properties.resize(index + 1);
-                        tbl->properties[index] = val;
-                    } else {
-                        tbl->shape = tbl->shape->transition(gc, key);
-                        tbl->properties.push_back(val);
-                    }
+                    if (tbl->frozen) RAISE("Cannot modify a frozen value.");
+                    tbl->setField(gc, key, val);
                     gc.writeBarrier(tbl, val);
                 } else if (obj.isModule()) {
                     obj.asModule()->exports[key] = val;
                     gc.writeBarrier(obj.asObject(), val);
+                    gc.writeBarrier(obj.asObject(), key);
                 }
             }
             DISPATCH();
@@ -2180,8 +2622,7 @@ namespace Pome {
                     mod = moduleLoader(fullName);
                     REFRESH_FRAME();
                     if (mod.isNil()) {
-                        runtimeError("Cannot find module '" + fullName + "'");
-                        return PomeValue();
+                        RAISE("Cannot find module '" + fullName + "'");
                     }
                     if (mod.isModule()) moduleCache[fullName] = mod;
                 } else {
@@ -2243,15 +2684,11 @@ namespace Pome {
                 PomeValue classVal = R(a);
                 PomeValue superVal = R(b);
                 if (!classVal.isClass()) {
-                    SAVE_FRAME();
-                    runtimeError("Inheritance target must be a class.");
-                    return PomeValue();
+                    RAISE("Inheritance target must be a class.");
                 }
                 if (!superVal.isNil()) {
                     if (!superVal.isClass()) {
-                        SAVE_FRAME();
-                        runtimeError("Superclass must be a class.");
-                        return PomeValue();
+                        RAISE("Superclass must be a class.");
                     }
                     classVal.asClass()->superclass = superVal.asClass();
                 }
@@ -2271,14 +2708,10 @@ namespace Pome {
                     if (method) {
                         R(a) = PomeValue(method);
                     } else {
-                        SAVE_FRAME();
-                        runtimeError("Superclass '" + super->name + "' has no method '" + methodName.asString() + "'");
-                        return PomeValue();
+                        RAISE("Superclass '" + super->name + "' has no method '" + methodName.asString() + "'");
                     }
                 } else {
-                    SAVE_FRAME();
-                    runtimeError("'super' used in a class with no superclass or outside of a method.");
-                    return PomeValue();
+                    RAISE("'super' used in a class with no superclass or outside of a method.");
                 }
             }
             DISPATCH();
@@ -2295,16 +2728,14 @@ namespace Pome {
                     PomeFunction* iterMethod = instance->klass->findMethod("iterator");
                     if (iterMethod) {
                         SAVE_FRAME();
-                        if (frameCount >= 8192) runtimeError("Stack overflow");
-                        CallFrame* nextFrame = &frames[frameCount++];
+                        CallFrame* nextFrame = pushFrameAt(stackTop, currentFrame->segment, 0);
                         nextFrame->function = iterMethod;
                         nextFrame->module = iterMethod->module;
                         nextFrame->chunk = iterMethod->chunk.get();
                         nextFrame->ip = iterMethod->chunk->code.data();
-                        nextFrame->base = stackTop;
                         nextFrame->destReg = a;
-                        stack[nextFrame->base] = PomeValue(iterMethod);
-                        stack[nextFrame->base + 1] = obj;
+                        nextFrame->base[0] = PomeValue(iterMethod);
+                        nextFrame->base[1] = obj;
                         REFRESH_FRAME();
                         DISPATCH();
                     } else {
@@ -2361,7 +2792,7 @@ namespace Pome {
                             res->listType = list->listType;
                             res->unboxedCount = e - s;
                             res->unboxedCapacity = res->unboxedCount;
-                            size_t elementSize = (res->listType == ListType::DOUBLE) ? sizeof(double) : sizeof(int32_t);
+                            size_t elementSize = PomeList::elementSize(res->listType);
                             res->unboxedData = malloc(res->unboxedCount * elementSize);
                             memcpy(res->unboxedData, (char*)list->unboxedData + s * elementSize, res->unboxedCount * elementSize);
                             diff = res->extraSize();
@@ -2378,16 +2809,17 @@ namespace Pome {
                     }
                     R(a) = PomeValue(res);
                 } else if (obj.isString()) {
-                    const std::string& str = obj.asString();
+                    PomeString* str = obj.asPomeString();
+                    int size = (int)str->length();
                     int s = startVal.isNil() ? 0 : (int)startVal.asNumber();
-                    int e = endVal.isNil() ? (int)str.length() : (int)endVal.asNumber();
+                    int e = endVal.isNil() ? size : (int)endVal.asNumber();
                     if (s < 0) s = 0;
-                    if (e > (int)str.length()) e = (int)str.length();
+                    if (e > size) e = size;
                     PomeString* res = nullptr;
                     if (s >= e) {
                         res = gc.allocateString("");
                     } else {
-                        res = gc.allocateString(str.substr(s, e - s));
+                        res = gc.sliceString(str, s, e - s);
                     }
                     R(a) = PomeValue(res);
                 }
@@ -2399,10 +2831,7 @@ namespace Pome {
             case OpCode::PRINT:
             #endif
             {
-                for (int i = 0; i < b; ++i) {
-                    std::cout << R(a + i).toString() << (i == b - 1 ? "" : " ");
-                }
-                std::cout << std::endl;
+                StdLib::printLine(&R(a), b);
             }
             DISPATCH();
         }
@@ -2411,13 +2840,7 @@ namespace Pome {
             #ifndef COMPUTED_GOTO
             case OpCode::TRY:
             #endif
-            {
-                ExceptionHandler handler;
-                handler.frameIdx = frameCount;
-                handler.stackTop = stackTop;
-                handler.catchIp = ip + sbx;
-                handlers.push_back(handler);
-            }
+            // Not emitted any more: the compiler records try blocks in Chunk::handlers
             DISPATCH();
         }
 
@@ -2425,7 +2848,7 @@ namespace Pome {
             #ifndef COMPUTED_GOTO
             case OpCode::THROW:
             #endif
-            throw VMException{R(a)};
+            THROW_VALUE(R(a));
         }
 
         LABEL_CATCH: {
@@ -2449,48 +2872,54 @@ namespace Pome {
             #endif
             {
                 PomeValue v = R(b);
-                if (v.isTask()) {
-                    PomeTask* task = (PomeTask*)v.asObject();
-                    if (task->isCompleted) {
-                        R(a) = task->result;
-                    } else {
-                        ip--; // Re-execute AWAIT
+                if (!v.isTask()) {
+                    R(a) = v;
+                    DISPATCH();
+                }
+                PomeTask* task = static_cast<PomeTask*>(v.asObject());
+                if (!task->isDone()) {
+                    if (activeTask && executeDepth == activeTaskDepth) {
+                        // Park this coroutine; it re-executes AWAIT once woken
+                        task->waiters.push_back(activeTask);
+                        gc.writeBarrier(task, PomeValue(activeTask));
+                        taskSuspended = true;
+                        ip--;
                         SAVE_FRAME();
-                        return PomeValue(); // Yield
+                        return PomeValue();
                     }
+                    // Not inside a suspendable task (main script, or native
+                    // re-entry): drive the scheduler until the task finishes
+                    SAVE_FRAME();
+                    runUntilComplete(task);
+                    REFRESH_FRAME();
+                }
+                if (task->state == TaskState::FAILED) {
+                    THROW_VALUE(task->result);
                 }
+                R(a) = task->result;
             }
             DISPATCH();
         }
 
         #ifndef COMPUTED_GOTO
             default:
-                runtimeError("Unknown opcode.");
-                frameCount = initialFrameIdx;
-                return PomeValue();
+                RAISE("Unknown opcode.");
             }
         }
         #endif
 
-    } catch (VMException& e) {
-        if (handlers.empty()) {
-            hasError = true;
-            pendingException = e.value;
-            frameCount = initialFrameIdx;
-            throw;
-        }
-        ExceptionHandler h = handlers.back();
-        handlers.pop_back();
-        frameCount = h.frameIdx;
-        stackTop = h.stackTop;
+    LABEL_UNWIND:
+        // Nothing in this execute() catches it: leave through execute(), as a native's error does
+        if (!unwind(thrown, initialFrameIdx)) throw VMException{thrown};
         REFRESH_FRAME();
-        ip = h.catchIp;
-        pendingException = e.value;
-        goto LABEL_EXCEPTION_LOOP;
-    }
-    
-    frameCount = initialFrameIdx;
-    return PomeValue();
+#ifdef COMPUTED_GOTO
+        DISPATCH();
+#else
+        goto LABEL_RESUME;
+#endif
+
+    #undef RAISE
+    #undef THROW_VALUE
 }
 
 PomeValue VM::loadNativeModule(const std::string& libraryPath, PomeModule* moduleObj) {
@@ -2513,14 +2942,345 @@ PomeValue VM::loadNativeModule(const std::string& libraryPath, PomeModule* modul
 }
 
 void VM::runEventLoop() {
-    while (!taskQueue.empty()) {
+    int untilIoPoll = IO_POLL_INTERVAL;
+    while (!taskQueue.empty() || !jobTasks.empty() || hasPendingIo()) {
+        if (!jobTasks.empty()) settleJobs();
+        if (taskQueue.empty()) {
+            if (!jobTasks.empty() || hasPendingIo()) waitForEvents();
+            continue;
+        }
+        // Ready tasks must not keep finished I/O waiting forever
+        if (--untilIoPoll == 0) {
+            untilIoPoll = IO_POLL_INTERVAL;
+            if (hasPendingIo()) settleIo(false);
+        }
         PomeTask* task = taskQueue.front();
         taskQueue.pop_front();
-        
-        if (task->isCompleted) continue;
-        
-        interpret(task->function->chunk.get(), task->function->module);
+        if (task->isDone() || task->state == TaskState::RUNNING) continue;
+        resumeTask(task);
+    }
+}
+
+void VM::runUntilComplete(PomeTask* task) {
+    int untilIoPoll = IO_POLL_INTERVAL;
+    while (!task->isDone()) {
+        if (!jobTasks.empty() && settleJobs()) continue;
+        if (taskQueue.empty()) {
+            if (!jobTasks.empty() || hasPendingIo()) {
+                waitForEvents();
+                continue;
+            }
+            runtimeError("Awaited task can never complete (every task is waiting).");
+        }
+        if (--untilIoPoll == 0) {
+            untilIoPoll = IO_POLL_INTERVAL;
+            if (hasPendingIo() && settleIo(false)) continue;
+        }
+        PomeTask* next = taskQueue.front();
+        taskQueue.pop_front();
+        if (next->isDone() || next->state == TaskState::RUNNING) continue;
+        resumeTask(next);
     }
 }
 
+void VM::saveContext(ExecutionContext& ctx) {
+    ctx.stack = std::move(stack);
+    ctx.frames = std::move(frames);
+    ctx.frameCount = frameCount;
+    ctx.stackTop = stackTop;
+    ctx.openUpvalues = openUpvalues;
+}
+
+void VM::loadContext(ExecutionContext& ctx) {
+    stack = std::move(ctx.stack);
+    frames = std::move(ctx.frames);
+    frameCount = ctx.frameCount;
+    stackTop = ctx.stackTop;
+    openUpvalues = ctx.openUpvalues;
+}
+
+void VM::resumeTask(PomeTask* task) {
+    RootGuard taskGuard(gc, task);
+    size_t oldSize = sizeof(PomeTask) + task->extraSize();
+
+    ExecutionContext caller;
+    saveContext(caller);
+    parkedContexts.push_back(&caller);
+    PomeTask* prevTask = activeTask;
+    int prevDepth = activeTaskDepth;
+    PomeModule* prevModule = currentModule;
+
+    if (task->state == TaskState::CREATED) {
+        // First run: build the coroutine's own stack with the call frame at its base
+        task->context = std::make_unique<ExecutionContext>();
+        task->context->stack = RegisterStack(TASK_INITIAL_STACK);
+        task->context->frames.resize(TASK_INITIAL_FRAMES);
+        loadContext(*task->context);
+        PomeFunction* func = task->function;
+        CallFrame* frame = pushFrameAt(stack.begin(), 0, 0);
+        int argc = std::min<int>((int)task->args.size(), (int)RegisterStack::FRAME_WINDOW - 1);
+        frame->base[0] = PomeValue(func);
+        for (int i = 0; i < argc; ++i) {
+            frame->base[i + 1] = task->args[i];
+        }
+        task->args.clear();
+        frame->function = func;
+        frame->module = func->module;
+        frame->chunk = func->chunk.get();
+        frame->ip = func->chunk->code.data();
+        frame->destReg = -1;
+        frame->task = task;
+        stackTop = frame->base + RegisterStack::FRAME_WINDOW;
+    } else {
+        suspendedTasks.erase(task);
+        loadContext(*task->context);
+    }
+
+    task->state = TaskState::RUNNING;
+    activeTask = task;
+    activeTaskDepth = executeDepth + 1;
+    taskSuspended = false;
+
+    PomeValue result;
+    bool failed = false;
+    try {
+        result = execute(0);
+    } catch (VMException& e) {
+        // The failure belongs to the task; whoever awaits it gets the exception
+        hasError = false;
+        result = e.value;
+        failed = true;
+    }
+
+    saveContext(*task->context);
+    // A suspended task only keeps the segments its live frames occupy
+    if (!failed && taskSuspended && task->context->frameCount > 0) {
+        const ExecutionContext& ctx = *task->context;
+        task->context->stack.trim(ctx.frames[ctx.frameCount - 1].segment);
+    }
+    loadContext(caller);
+    parkedContexts.pop_back();
+    activeTask = prevTask;
+    activeTaskDepth = prevDepth;
+    currentModule = prevModule;
+
+    if (taskSuspended && !failed) {
+        taskSuspended = false;
+        task->state = TaskState::SUSPENDED;
+        suspendedTasks.insert(task);
+    } else {
+        completeTask(task, result, failed);
+    }
+    gc.updateSize(task, oldSize, sizeof(PomeTask) + task->extraSize());
+}
+
+void VM::completeTask(PomeTask* task, PomeValue result, bool failed) {
+    task->result = result;
+    task->state = failed ? TaskState::FAILED : TaskState::COMPLETED;
+    gc.writeBarrier(task, result);
+    // A finished coroutine no longer needs its stack
+    task->context.reset();
+    for (PomeTask* waiter : task->waiters) {
+        taskQueue.push_back(waiter);
+    }
+    task->waiters.clear();
+}
+
+bool VM::settleJobs() {
+    bool settled = false;
+    for (size_t i = 0; i < jobTasks.size();) {
+        PomeTask* task = jobTasks[i];
+        PoolJob& job = *task->job;
+        if (!job.done.load(std::memory_order_acquire)) {
+            ++i;
+            continue;
+        }
+        PomeValue result = job.takeResult(gc);
+        bool failed = job.failed;
+        task->job.reset();
+        jobTasks[i] = jobTasks.back();
+        jobTasks.pop_back();
+        completeTask(task, result, failed);
+        settled = true;
+    }
+    return settled;
+}
+
+void VM::waitForJobs() {
+    IsolatePool& pool = IsolatePool::instance();
+    while (true) {
+        // Read before checking, so a job finishing in between still ends the wait
+        uint64_t seen = pool.completedCount();
+        if (settleJobs()) return;
+        pool.waitForCompletion(seen);
+    }
+}
+
+Reactor& VM::getReactor() {
+    if (!reactor) reactor = std::make_unique<Reactor>();
+    return *reactor;
+}
+
+bool VM::hasPendingIo() const {
+    return reactor && reactor->hasPending();
+}
+
+bool VM::settleIo(bool block) {
+    std::vector<Reactor::Completion> done;
+    reactor->poll(block, done);
+    // The reactor no longer roots these tasks
+    CollectionDeferral deferral(gc);
+    for (Reactor::Completion& completion : done) {
+        PomeTask* task = completion.task;
+        PomeValue result;
+        if (completion.failed) {
+            result = PomeValue(gc.allocateString(completion.data));
+        } else {
+            switch (completion.kind) {
+            case Reactor::Kind::SLEEP:
+                break;
+            case Reactor::Kind::READ:
+                // An empty read is the end of the stream
+                if (!completion.data.empty()) result = PomeValue(gc.allocateString(completion.data));
+                break;
+            case Reactor::Kind::READ_FILE:
+                result = PomeValue(gc.allocateString(completion.data));
+                break;
+            case Reactor::Kind::WRITE:
+            case Reactor::Kind::WRITE_FILE:
+                result = PomeValue(static_cast<double>(completion.count));
+                break;
+            case Reactor::Kind::ACCEPT:
+                result = PomeValue(gc.allocate<PomeSocket>(static_cast<int>(completion.count)));
+                break;
+            case Reactor::Kind::CONNECT:
+                // The socket the task was started with
+                if (!task->args.empty()) result = task->args[0];
+                break;
+            }
+        }
+        task->args.clear();
+        completeTask(task, result, completion.failed);
+    }
+    return !done.empty();
+}
+
+void VM::waitForEvents() {
+    if (!hasPendingIo()) {
+        waitForJobs();
+        return;
+    }
+    // The pool signals the reactor too, so one wait in the kernel covers both
+    settleIo(true);
+    if (!jobTasks.empty()) settleJobs();
+}
+
+size_t VM::getSuspendedTaskMemory() const {
+    size_t total = 0;
+    for (PomeTask* task : suspendedTasks) total += sizeof(PomeTask) + task->extraSize();
+    return total;
+}
+
+void VM::growFrames() {
+    if (frames.size() >= (size_t)maxFrames) runtimeError("Stack overflow");
+    frames.resize(std::min<size_t>(maxFrames, std::max<size_t>(16, frames.size() * 2)));
+}
+
+void VM::setMaxFrames(int count) {
+    maxFrames = std::max(count, 1);
+    // Shrinking never reallocates, so the running frames stay where they are. Frames already deeper
+    // than the new limit return normally; the next call past it overflows.
+    if (frames.size() > (size_t)maxFrames) frames.resize(std::max<size_t>(maxFrames, frameCount));
+}
+
+RegisterStack::RegisterStack(size_t firstSegment) {
+    segments.push_back({std::make_unique<PomeValue[]>(firstSegment), firstSegment});
+}
+
+PomeValue* RegisterStack::spill(PomeValue* base, int& segment, int carry) {
+    int next = segment + 1;
+    if (next == (int)segments.size()) {
+        size_t size = std::min(MAX_SEGMENT, segments[segment].size * 2);
+        segments.push_back({std::make_unique<PomeValue[]>(size), size});
+    }
+    PomeValue* target = segments[next].slots.get();
+    std::copy(base, base + carry, target);
+    segment = next;
+    return target;
+}
+
+int RegisterStack::segmentOf(const PomeValue* slot) const {
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const PomeValue* begin = segments[i].slots.get();
+        if (slot >= begin && slot < begin + segments[i].size) return (int)i;
+    }
+    return -1;
+}
+
+void RegisterStack::mark(GarbageCollector& gc, const CallFrame* frames, int count) const {
+    // Frames are pushed in segment order, so each run of frames marks one prefix
+    int i = 0;
+    while (i < count) {
+        int segment = frames[i].segment;
+        const PomeValue* begin = segments[segment].slots.get();
+        const PomeValue* end = begin + segments[segment].size;
+        const PomeValue* top = begin;
+        for (; i < count && frames[i].segment == segment; ++i) {
+            top = std::max(top, std::min(end, (const PomeValue*)frames[i].base + FRAME_WINDOW));
+        }
+        for (const PomeValue* slot = begin; slot < top; ++slot) slot->mark(gc);
+    }
+}
+
+void RegisterStack::trim(int inUse) {
+    if ((int)segments.size() > inUse + 1) segments.resize(inUse + 1);
+}
+
+size_t RegisterStack::memoryUsage() const {
+    size_t total = 0;
+    for (const Segment& segment : segments) total += segment.size * sizeof(PomeValue);
+    return total;
+}
+
+static void markFrames(GarbageCollector& gc, const CallFrame* frames, int count) {
+    Chunk* lastChunk = nullptr;
+    for (int i = 0; i < count; ++i) {
+        if (frames[i].function) gc.markObject(frames[i].function);
+        if (frames[i].task) gc.markObject(frames[i].task);
+        // Recursive calls push the same chunk repeatedly; scan it once per run
+        if (frames[i].chunk && frames[i].chunk != lastChunk) {
+            lastChunk = frames[i].chunk;
+            for (auto& val : lastChunk->constants) {
+                val.mark(gc);
+            }
+            lastChunk->markCaches(gc);
+        }
+    }
+}
+
+void ExecutionContext::mark(GarbageCollector& gc) const {
+    stack.mark(gc, frames.data(), frameCount);
+    for (PomeUpvalue* upvalue = openUpvalues; upvalue; upvalue = upvalue->next) {
+        gc.markObject(upvalue);
+    }
+    markFrames(gc, frames.data(), frameCount);
+}
+
+PomeTask::PomeTask(PomeFunction* f) : function(f) {}
+PomeTask::~PomeTask() = default;
+
+void PomeTask::markChildren(GarbageCollector& gc) {
+    if (function) gc.markObject(function);
+    for (auto& arg : args) arg.mark(gc);
+    result.mark(gc);
+    for (PomeTask* waiter : waiters) gc.markObject(waiter);
+    if (context) context->mark(gc);
+}
+
+size_t PomeTask::extraSize() const {
+    return args.capacity() * sizeof(PomeValue) +
+           waiters.capacity() * sizeof(PomeTask*) +
+           (context ? sizeof(ExecutionContext) + context->memoryUsage() : 0);
+}
+
 }